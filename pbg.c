@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <float.h>
+#include <limits.h>
 
 /*****************************
  *                           *
@@ -30,7 +32,8 @@ typedef struct {
 
 typedef struct {
 	char*  _msg;  /* Description of syntax error. */
-	char*  _str;  /* String in which error occurred. */
+	char*  _str;  /* String in which error occurred, NULL if streamed. */
+	int    _n;    /* Length of the string. */
 	int    _i;    /* Index of error in string. */
 } pbg_syntax_err;  /* PBG_ERR_SYNTAX */
 
@@ -39,6 +42,209 @@ typedef struct {
 	int    _n;      /* Length of field. */
 } pbg_unknown_type_err;  /* PBG_ERR_UNKNOWN_TYPE */
 
+/* PROGRAM REPRESENTATIONS */
+typedef struct pbg_node pbg_node;
+typedef struct pbg_program pbg_program;
+
+/* Runs a compiled node, returning PBG_TRUE, PBG_FALSE, or PBG_ERROR. */
+typedef int (*pbg_handler)(pbg_expr* e, pbg_error* err, pbg_program* prog, 
+		pbg_node* node);
+
+struct pbg_node {
+	pbg_handler     _run;       /* Handler, chosen once at compile time. */
+	pbg_node**      _kids;      /* Children of an AND, OR, or NOT, in run order. */
+	int             _numkids;   /* Number of children. */
+	pbg_field*      _field;     /* Field compiled from, NULL for a VAR. */
+	int             _safe;      /* 1 if the field can never produce an error. */
+	pbg_field*      _cmp;       /* Fused field, interpreted if types mismatch. */
+	int             _negate;    /* 1 if the fused field is inverted by a NOT. */
+	int             _accept[3]; /* Result when below, equal to, or above constant. */
+	int             _swap;      /* 1 if the constant is the first operand. */
+	int             _var;       /* Index of the VAR operand in _variables. */
+	pbg_lt_number   _number;    /* Inline NUMBER constant. */
+	pbg_lt_date     _date;      /* Inline DATE constant. */
+	pbg_lt_string*  _str;       /* STRING constant. */
+	int             _n;         /* Length of the STRING constant, or 1 if the 
+	                             * BOOL constant is TRUE. */
+	pbg_node**      _members;   /* EQ nodes of a set lookup, sorted by constant, 
+	                             * or hashed by it for STRINGs. */
+	int             _nummembers;/* Number of members, or of hash slots. */
+	void*           _bounds;    /* Sorted NUMBER or DATE bounds of an interval test. */
+	int             _numbounds; /* Number of bounds. */
+	char*           _regions;   /* Result below, at, and above every bound. */
+	pbg_node*       _merged;    /* Interval tests merged from runs of children. */
+	int             _nummerged; /* Number of merged interval tests. */
+	unsigned long   _runs;      /* Profiled runs of this node. */
+	unsigned long   _trues;     /* Profiled runs that were TRUE. */
+	unsigned long   _work;      /* Nodes run by profiled runs, this one included. */
+};
+
+/* ORs of fewer EQs are left to run one EQ at a time. */
+#define PBG_MIN_MEMBERS 4
+
+struct pbg_program {
+	pbg_node*      _nodes;      /* Constants in order, then VARs in reverse. */
+	int            _numnodes;   /* Number of nodes. */
+	pbg_node**     _kids;       /* Storage for the children of every node. */
+	int            _warmup;     /* Runs profiled before recompiling, 0 if unmanaged. */
+	int            _period;     /* Runs between profiles, 0 to profile once. */
+	int            _count;      /* Runs in the current phase. */
+	int            _profiling;  /* 1 while collecting statistics. */
+	unsigned long  _ticks;      /* Nodes run while profiling. */
+};
+
+/* DICTIONARY REPRESENTATIONS */
+typedef struct {
+	pbg_field (*_fn)(char*, int);  /* Plain dictionary given to pbg_evaluate. */
+} pbg_dict_fn;
+
+/* VAR NAME REPRESENTATIONS */
+typedef struct {
+	pbg_segment*    _segments;     /* Interned segments, or NULL if not split. */
+	int             _numsegments;  /* Number of interned segments. */
+	pbg_segment**   _path;         /* Segments of every VAR, one after another. */
+	int*            _starts;       /* Index of each VAR's first segment, then the end. */
+	unsigned long*  _hashes;       /* Hash of every VAR name, or NULL. */
+	pbg_hash_fn     _hashfn;       /* Function _hashes were computed with. */
+	pbg_hash_fn     _segfn;        /* Function segment hashes were computed with. */
+} pbg_names;
+
+/* TEXT EVALUATION REPRESENTATIONS */
+typedef struct {
+	char*      _str;   /* Text of the expression. */
+	int        _n;     /* Length of the text. */
+	pbg_dict*  _dict;  /* Dictionary used to resolve VARs. */
+} pbg_text;
+
+typedef struct {
+	pbg_field      _field;     /* Value of the field, or type of its operator. */
+	int            _i;         /* Index of the field in the text. */
+	int            _resolved;  /* 1 if _field came from the dictionary. */
+	int            _stop;      /* Index right after the text read of the field. */
+	int            _open;      /* Groups of the field still open at _stop. */
+	pbg_lt_number  _number;    /* Storage for a NUMBER constant. */
+	pbg_lt_date    _date;      /* Storage for a DATE constant. */
+} pbg_text_field;
+
+/* LAZY EXPRESSION REPRESENTATIONS */
+#define PBG_LAZY PBG_MAX_OP  /* Type of a field standing in for a subtree. */
+
+typedef struct {
+	int  _end;   /* Index of its closing parenthesis in the text. */
+	int  _argc;  /* Number of arguments of its operator. */
+	int  _size;  /* Number of groups it spans, itself included. */
+} pbg_lazy_group;
+
+typedef struct {
+	pbg_text         _text;    /* Copy of the text, and the dictionary in use. */
+	int              _depth;   /* Levels of a subtree built at once. */
+	pbg_lazy_group*  _groups;  /* Every group, in order of opening. */
+	pbg_expr         _expr;    /* Top levels of the expression. */
+} pbg_lazy_root;
+
+typedef struct {
+	pbg_lazy_root*  _root;   /* Expression the subtree belongs to. */
+	int             _start;  /* Index of the subtree in the text. */
+	int             _group;  /* Index of the subtree in _root->_groups. */
+	int             _built;  /* 1 once _expr is built. */
+	pbg_expr        _expr;   /* Top levels of the subtree. */
+} pbg_lazy_node;
+
+/* BATCH REPRESENTATIONS */
+#define PBG_WORD_BITS ((int) (sizeof(unsigned long) * CHAR_BIT))  /* Rows per block. */
+
+typedef struct {
+	pbg_batch*      _batch;    /* Batch being scanned. */
+	pbg_program*    _prog;     /* Fused program of the expression. */
+	int             _numvars;  /* Number of VARs in the expression. */
+	pbg_column**    _cols;     /* Column of each VAR, NULL if there is none. */
+	pbg_field*      _row;      /* Resolved VARs of the loaded row. */
+	pbg_lt_number*  _numbers;  /* Storage for the NUMBERs in _row. */
+	pbg_lt_date*    _dates;    /* Storage for the DATEs in _row. */
+	int             _loaded;   /* Row resolved in _row, -1 if none. */
+	int             _start;    /* First row of the current block. */
+	int             _len;      /* Number of rows in the current block. */
+} pbg_scan;
+
+/* ANALYSIS REPRESENTATIONS */
+#define PBG_AN_NULL      0x01  /* Types a VAR may have, as bits. */
+#define PBG_AN_NUMBER    0x02
+#define PBG_AN_DATE      0x04
+#define PBG_AN_STRING    0x08
+#define PBG_AN_TRUE      0x10
+#define PBG_AN_FALSE     0x20
+#define PBG_AN_ANY       0x3F
+#define PBG_AN_EXCLUDED  8     /* Values a VAR must not equal, kept per type. */
+#define PBG_AN_STEPS     4096  /* Goals expanded before an analysis gives up. */
+
+typedef struct {
+	pbg_field*  _lo;        /* Greatest lower bound, NULL if none. */
+	int         _lostrict;  /* 1 if the VAR cannot equal _lo. */
+	pbg_field*  _hi;        /* Least upper bound, NULL if none. */
+	int         _histrict;  /* 1 if the VAR cannot equal _hi. */
+	pbg_field*  _eq;        /* Value the VAR must equal, NULL if none. */
+	int         _empty;     /* 1 if two values it must equal differ. */
+	pbg_field*  _ne[PBG_AN_EXCLUDED];  /* Values the VAR must not equal. */
+	int         _numne;     /* Number of values in _ne. */
+} pbg_an_range;  /* Values a VAR of one type may have. */
+
+typedef struct {
+	int           _types;      /* Types the VAR may have. */
+	int           _nan;        /* 1 if the VAR may be a NUMBER that is NaN. */
+	pbg_an_range  _ranges[3];  /* Values it may have as a NUMBER, DATE, and STRING. */
+} pbg_an_var;
+
+typedef struct {
+	int  _id;    /* Index of the field. */
+	int  _want;  /* Result wanted: PBG_TRUE, PBG_FALSE, or PBG_ERROR. */
+} pbg_an_goal;
+
+typedef struct {
+	pbg_expr*  _expr;    /* Expression being analyzed. */
+	int*       _canon;   /* Index of the first VAR of the same name, per VAR. */
+	int        _cap;     /* Most goals pending at once. */
+	int        _steps;   /* Goals expanded so far. */
+	int        _failed;  /* 1 if memory ran out. */
+} pbg_an;
+
+/* PRINTER REPRESENTATIONS */
+typedef struct {
+	char*  _buf;   /* Output buffer. */
+	int    _n;     /* Size of the output buffer. */
+	int    _len;   /* Length of the text so far, whether it fit or not. */
+	int    _bare;  /* 1 if the last token ends where the parser expects a break. */
+} pbg_printer;
+
+/* STREAMING PARSER REPRESENTATIONS */
+#define PBG_PARSER_NONE    0  /* Not in a field. */
+#define PBG_PARSER_STRING  1  /* In a STRING. */
+#define PBG_PARSER_VAR     2  /* In a VAR. */
+#define PBG_PARSER_BARE    3  /* In any other field. */
+/* Each open group takes this many ints of pbg_parser._groups: the index of its
+ * operator, the offset of its operator, the type of its operator, its number 
+ * of fields and groups, and the index of its first child in _children. */
+#define PBG_PARSER_GROUP   5
+
+/* NORMAL FORM REPRESENTATIONS */
+typedef struct {
+	int*  _ids;         /* Field index of the atom of each literal. */
+	int*  _negs;        /* 1 if the literal is negated, 0 otherwise. */
+	int*  _starts;      /* Index of each clause's first literal, then the end. */
+	int   _numclauses;  /* Number of clauses. */
+} pbg_clauses;
+
+typedef struct {
+	pbg_expr*  _e;          /* Expression being rewritten. */
+	int        _cnf;        /* 1 for conjunctive normal form, 0 for disjunctive. */
+	int        _maxfields;  /* Maximum number of literals in the result. */
+	int*       _atoms;      /* Field index of each distinct atom. */
+	int        _numatoms;   /* Number of distinct atoms. */
+	int*       _table;      /* Hash table of distinct atoms, 1 plus their index. */
+	int        _tablecap;   /* Capacity of _table, a power of 2. */
+	int*       _marks;      /* For each distinct atom in the clause being merged,
+	                         * 1 plus its negation. 0 for the others. */
+} pbg_nf_state;
+
 
 /****************************
  *                          *
@@ -50,10 +256,11 @@ typedef struct {
 void pbg_err_init(pbg_error* err, pbg_error_type type, int line, char* file, int size, void* data);
 void pbg_err_alloc(pbg_error* err, int line, char* file);
 void pbg_err_unknown_type(pbg_error* err, int line, char* file, char* field, int n);
-void pbg_err_syntax(pbg_error* err, int line, char* file, char* str, int i, char* msg);
+void pbg_err_syntax(pbg_error* err, int line, char* file, char* str, int n, int i, char* msg);
 void pbg_err_op_arity(pbg_error* err, int line, char* file, pbg_field_type type, int arity);
 void pbg_err_state(pbg_error* err, int line, char* file, char* msg);
 void pbg_err_op_arg_type(pbg_error* err, int line, char* file, char* msg);
+void pbg_err_limit(pbg_error* err, int line, char* file, char* msg);
 char* pbg_error_str(pbg_error_type type);
 char* pbg_field_type_str(pbg_field_type type);
  
@@ -73,6 +280,34 @@ pbg_field pbg_parse_string(pbg_error* err, char* str, int n);
 
 /* FIELD PARSING TOOLKIT */
 int pbg_check_op_arity(pbg_field_type type, int numargs);
+int pbg_parse_skip(char* str, int n, int i);
+int pbg_parse_first(pbg_error* err, char* str, int n, int* numfields, int* numvars, int* numclosings, int* maxdepth);
+pbg_field pbg_parse_literal(pbg_error* err, pbg_field_type type, char* str, int n);
+
+/* STREAMING PARSER TOOLKIT */
+void* pbg_parser_grow(void* buf, int* cap, int need, int size);
+void pbg_parser_fail(pbg_parser* p);
+int pbg_parser_store(pbg_parser* p, pbg_field field);
+int pbg_parser_child(pbg_parser* p, int id);
+int pbg_parser_next(pbg_parser* p, pbg_field_type type, int start);
+int pbg_parser_building(pbg_parser* p);
+void pbg_parser_op(pbg_parser* p, pbg_field_type type, int start);
+void pbg_parser_literal(pbg_parser* p, pbg_field field, int start);
+void pbg_parser_unknown(pbg_parser* p, char* str, int n, int start);
+void pbg_parser_field(pbg_parser* p, char* str, int n, int start);
+void pbg_parser_group(pbg_parser* p, char c, int i);
+int pbg_parser_scan(pbg_parser* p, char* str, int n, int i);
+int pbg_parser_append(pbg_parser* p, char* str, int n);
+void pbg_parser_reset(pbg_parser* p);
+int pbg_builder_next(pbg_builder* b);
+void pbg_builder_add(pbg_builder* b, pbg_field_type type, void* src, int n, 
+		char close);
+
+/* VAR NAME TOOLKIT */
+int pbg_path_split(char* name, int j);
+pbg_names* pbg_names_get(pbg_expr* e, pbg_error* err);
+int pbg_paths_init(pbg_expr* e, pbg_error* err, int dotted, pbg_hash_fn fn);
+int pbg_hashes_init(pbg_expr* e, pbg_error* err, pbg_hash_fn fn);
 
 /* FIELD EVALUATION TOOLKIT */
 int pbg_evaluate_r(pbg_expr* e, pbg_error* err, pbg_field* field);
@@ -84,9 +319,160 @@ int pbg_evaluate_op_eq(pbg_expr* e, pbg_error* err, pbg_field* field);
 int pbg_evaluate_op_neq(pbg_expr* e, pbg_error* err, pbg_field* field);
 int pbg_evaluate_op_order(pbg_expr* e, pbg_error* err, pbg_field* field);
 int pbg_evaluate_op_type(pbg_expr* e, pbg_error* err, pbg_field* field);
+pbg_field pbg_dict_fn_get(void* ctx, char* key, int n);
+
+/* TEXT EVALUATION TOOLKIT */
+int pbg_text_skip(pbg_text* t, int i);
+int pbg_text_first(pbg_text* t, pbg_text_field* f);
+int pbg_text_next(pbg_text* t, pbg_text_field* f);
+void pbg_text_read(pbg_text* t, pbg_text_field* f, int i);
+void pbg_text_load(pbg_text* t, pbg_text_field* f, int i);
+void pbg_text_release(pbg_text* t, pbg_text_field* f);
+int pbg_text_r(pbg_text* t, pbg_error* err, pbg_text_field* f);
+int pbg_text_op_not(pbg_text* t, pbg_error* err, pbg_text_field* f);
+int pbg_text_op_and(pbg_text* t, pbg_error* err, pbg_text_field* f);
+int pbg_text_op_or(pbg_text* t, pbg_error* err, pbg_text_field* f);
+int pbg_text_op_exst(pbg_text* t, pbg_error* err, pbg_text_field* f);
+int pbg_text_op_eq(pbg_text* t, pbg_error* err, pbg_text_field* f);
+int pbg_text_op_neq(pbg_text* t, pbg_error* err, pbg_text_field* f);
+void pbg_text_pair(pbg_text* t, pbg_text_field* f, pbg_text_field* c0, 
+		pbg_text_field* c1, int* r0, pbg_error* err0);
+int pbg_text_op_order(pbg_text* t, pbg_error* err, pbg_text_field* f);
+int pbg_text_op_type(pbg_text* t, pbg_error* err, pbg_text_field* f);
+
+/* LAZY EXPRESSION TOOLKIT */
+int pbg_lazy_defers(pbg_field_type type);
+int pbg_lazy_index(pbg_lazy_root* root);
+int pbg_lazy_after(pbg_lazy_root* root, int i, int* g);
+void pbg_lazy_count_r(pbg_lazy_root* root, int i, int g, int level, int defer, int* numconst, int* numvars);
+int pbg_lazy_build_r(pbg_lazy_root* root, pbg_expr* e, pbg_error* err, int i, int g, int level, int defer);
+void pbg_lazy_build(pbg_lazy_root* root, pbg_expr* e, pbg_error* err, int i, int g);
+int pbg_lazy_run(pbg_error* err, pbg_field* field);
+
+/* COMPILATION TOOLKIT */
+pbg_program* pbg_program_init(pbg_expr* e, pbg_error* err, int warmup, int period);
+pbg_node* pbg_program_node(pbg_program* prog, int id);
+void pbg_program_step(pbg_expr* e, pbg_program* prog);
+void pbg_program_reorder(pbg_node* node);
+int pbg_program_before(pbg_node* parent, pbg_node* n1, pbg_node* n2);
+void pbg_compile_r(pbg_expr* e, pbg_program* prog, int id, int fuse);
+void pbg_compile_cmp(pbg_expr* e, pbg_node* node);
+void pbg_compile_in(pbg_expr* e, pbg_node* node);
+int pbg_member_cmp_number(const void* n1, const void* n2);
+int pbg_member_cmp_date(const void* n1, const void* n2);
+int pbg_member_find(pbg_node* node, void* key, int n);
+int pbg_node_isfused(pbg_node* node);
+int pbg_node_isset(pbg_node* node);
+void pbg_compile_range(pbg_expr* e, pbg_node* node);
+void pbg_compile_merge(pbg_expr* e, pbg_node* node);
+void pbg_compile_unmerge(pbg_node* node);
+int pbg_compile_samevar(pbg_expr* e, int v1, int v2);
+int pbg_range_isbound(pbg_node* node);
+int pbg_range_isdate(pbg_node* node);
+int pbg_range_joins(pbg_expr* e, pbg_node* n1, pbg_node* n2);
+int pbg_range_cmp(const void* n1, const void* n2);
+int pbg_range_cmp_date(const void* d1, const void* d2);
+int pbg_range_region(pbg_lt_number* bounds, int n, double val);
+int pbg_range_region_date(pbg_lt_date* bounds, int n, pbg_lt_date* val);
+int pbg_run_r(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_fallback(pbg_expr* e, pbg_error* err, pbg_node* node);
+int pbg_run_field(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_var(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_true(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_false(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_not(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_and(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_or(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_exst_var(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_number_eq(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_number_order(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_date_eq(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_date_order(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_string_eq(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_string_order(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_bool_eq(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_number_in(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_date_in(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_string_in(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_number_range(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+int pbg_run_date_range(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node);
+
+/* BATCH EVALUATION TOOLKIT */
+int pbg_scan_init(pbg_scan* scan, pbg_expr* e, pbg_error* err, pbg_batch* batch);
+void pbg_scan_load(pbg_scan* scan, int row);
+unsigned long pbg_scan_block(pbg_expr* e, pbg_scan* scan, int start, int end, unsigned long* x);
+void pbg_scan_r(pbg_expr* e, pbg_scan* scan, pbg_node* node, unsigned long need, unsigned long* t, unsigned long* x);
+int pbg_scan_cmp(pbg_scan* scan, pbg_node* node, unsigned long* t, unsigned long* x);
+unsigned long pbg_scan_numbers(pbg_scan* scan, pbg_column* col, pbg_node* node);
+unsigned long pbg_scan_dates(pbg_scan* scan, pbg_column* col, pbg_node* node);
+unsigned long pbg_scan_strings(pbg_scan* scan, pbg_column* col, pbg_node* node);
+unsigned long pbg_scan_bools(pbg_scan* scan, pbg_column* col, pbg_node* node);
+unsigned long pbg_scan_accept(pbg_node* node, unsigned long lt, unsigned long eq, 
+		unsigned long gt);
+void pbg_scan_range(pbg_expr* e, pbg_scan* scan, pbg_node* node, unsigned long need, 
+		unsigned long* t, unsigned long* x);
+void pbg_scan_kids(pbg_expr* e, pbg_scan* scan, pbg_node* node, unsigned long need, 
+		unsigned long* t, unsigned long* x);
+void pbg_scan_type(pbg_expr* e, pbg_scan* scan, pbg_node* node, unsigned long need, 
+		unsigned long* t, unsigned long* x);
+void pbg_scan_rows(pbg_expr* e, pbg_scan* scan, pbg_node* node, unsigned long need, unsigned long* t, unsigned long* x);
+pbg_column* pbg_batch_column(pbg_batch* batch, char* name, int n);
+unsigned long pbg_bitmap_word(unsigned char* bitmap, int start, int len);
+unsigned long pbg_word_mask(int len);
+int pbg_popcount(unsigned long word);
+
+/* ANALYSIS TOOLKIT */
+int pbg_an_init(pbg_an* an, pbg_expr* e);
+int pbg_an_implies(pbg_an* an, int id1, int id2);
+int pbg_an_query(pbg_an* an, pbg_an_goal* start, int n);
+int pbg_an_sat(pbg_an* an, pbg_an_goal* goals, int n, pbg_an_var* vars);
+int pbg_an_branch(pbg_an* an, pbg_an_goal* goals, int n, pbg_an_var* vars, 
+		pbg_field* field, int i, int want);
+int pbg_an_atom(pbg_an* an, pbg_an_var* vars, int id, int want);
+int pbg_an_cmp(pbg_an* an, pbg_an_var* vars, pbg_field* field, int want);
+int pbg_an_type(pbg_an* an, pbg_an_var* vars, pbg_field* field, int want);
+int pbg_an_restrict(pbg_an_var* var, int types);
+void pbg_an_bound(pbg_an_range* range, pbg_field_type rel, pbg_field* c);
+int pbg_an_isempty(pbg_an_range* range, int ordered);
+int pbg_an_compare(pbg_field* c1, pbg_field* c2);
+int pbg_an_typebits(pbg_field_type type);
+
+/* RULE SET TOOLKIT */
+int pbg_ruleset_bit(pbg_ruleset* rs, char* key, int n, int add);
+int pbg_ruleset_atoms(pbg_expr* e, unsigned long* hashes, int n);
+int pbg_ruleset_pair(pbg_ruleset* rs, pbg_error* err, int i, int r, int* dirs);
+int pbg_ruleset_link(pbg_ruleset* rs, pbg_error* err, int maxcheck);
+int pbg_ruleset_follows(pbg_ruleset* rs, int r, unsigned char* results);
+int pbg_ruleset_req_r(pbg_ruleset* rs, pbg_error* err, pbg_expr* e, int id, 
+		int* bits, unsigned long* req);
+
+/* PRINTING TOOLKIT */
+int pbg_print_r(pbg_expr* e, pbg_printer* p, int id);
+void pbg_print_token(pbg_printer* p, char* str, int n);
+int pbg_print_number(char* str, double val);
+char* pbg_op_str(pbg_field_type type);
+
+/* NORMAL FORM TOOLKIT */
+int pbg_nf_build_r(pbg_nf_state* st, pbg_error* err, pbg_clauses* out, int id, int neg);
+unsigned long pbg_nf_hash_r(pbg_expr* e, int id);
+int pbg_nf_key(pbg_nf_state* st, int id);
+int pbg_nf_atom(pbg_nf_state* st, pbg_error* err, pbg_clauses* out, int id, int neg);
+int pbg_nf_alloc(pbg_error* err, pbg_clauses* out, int numlits, int numclauses);
+int pbg_nf_join(pbg_nf_state* st, pbg_error* err, pbg_clauses* out, pbg_clauses* kids, int n);
+int pbg_nf_distribute(pbg_nf_state* st, pbg_clauses* kids, int n, int* work, pbg_clauses* out, int* sizes);
+int pbg_nf_product(pbg_nf_state* st, pbg_error* err, pbg_clauses* out, pbg_clauses* kids, int n);
+int pbg_nf_emit(pbg_nf* nf, pbg_error* err, pbg_expr* e, pbg_clauses* c, int cnf, int maxfields);
+int pbg_nf_literal(pbg_expr* dst, pbg_error* err, pbg_expr* src, int id, int nots, int* atom);
+void pbg_nf_count_r(pbg_expr* e, int id, int* numconst, int* numvars);
+int pbg_nf_copy_r(pbg_expr* dst, pbg_error* err, pbg_expr* src, int id);
+int pbg_nf_same_r(pbg_expr* e, int id1, int id2);
 
 /* JANITORIAL FUNCTIONS */
-/* No local functions. */
+void pbg_lazy_free_r(pbg_expr* e);
+void pbg_nf_clauses_free(pbg_clauses* c);
+void pbg_program_free(pbg_program* prog);
+void pbg_names_free(pbg_names* paths);
+void pbg_scan_free(pbg_scan* scan);
 
 /* CONVERSION & CHECKING TOOLKIT */
 pbg_field_type pbg_gettype(char* str, int n);
@@ -103,13 +489,16 @@ int pbg_isdate(char* str, int n);
 
 void pbg_tonumber(pbg_lt_number* ptr, char* str, int n);
 void pbg_todate(pbg_lt_date* ptr, char* str, int n);
+long pbg_days_from_date(pbg_lt_date* date);
+void pbg_date_from_days(pbg_lt_date* date, long days);
 
 int pbg_cmpnumber(pbg_lt_number* n1, pbg_lt_number* n2);
 int pbg_cmpdate(pbg_lt_date* d1, pbg_lt_date* d2);
-int pbg_cmpstring(pbg_lt_string* s1, pbg_lt_string* s2, int n);
+int pbg_cmpstring(pbg_lt_string* s1, int n1, pbg_lt_string* s2, int n2);
 
 int pbg_type_isbool(pbg_field_type type);
 int pbg_type_isop(pbg_field_type type);
+int pbg_type_istype(pbg_field_type tp, pbg_field_type type);
 
 /* HELPER FUNCTIONS */
 int pbg_isdigit(char c);
@@ -134,6 +523,7 @@ void pbg_error_print(pbg_error* err)
 	switch(err->_type) {
 		case PBG_ERR_OP_ARG_TYPE:
 		case PBG_ERR_STATE:
+		case PBG_ERR_LIMIT:
 			printf(": %s", (char*) err->_data);
 			break;
 		case PBG_ERR_OP_ARITY:
@@ -143,11 +533,17 @@ void pbg_error_print(pbg_error* err)
 			break;
 		case PBG_ERR_SYNTAX:
 			syntax = (pbg_syntax_err*) err->_data;
-			printf(": %s -> %s", (char*) syntax->_msg, syntax->_str+syntax->_i);
+			/* Streamed text is gone by now, so only its offset is known. */
+			if(syntax->_str == NULL)
+				printf(": %s -> at offset %d", (char*) syntax->_msg, syntax->_i);
+			else
+				printf(": %s -> %.*s", (char*) syntax->_msg, 
+						syntax->_n - syntax->_i, syntax->_str+syntax->_i);
 			break;
 		case PBG_ERR_UNKNOWN_TYPE:
 			utype = (pbg_unknown_type_err*) err->_data;
-			printf(": failed to recognize %s (%d bytes)\n", (char*)utype->_field, utype->_n);
+			printf(": failed to recognize %.*s (%d bytes)", 
+					utype->_n, utype->_field, utype->_n);
 			break;
 		default:
 			break;
@@ -173,18 +569,21 @@ void pbg_err_unknown_type(pbg_error* err, int line, char* file,
 		char* field, int n)
 {
 	pbg_unknown_type_err* data;
-	data = malloc(n * sizeof(char));
+	int size;
+	/* Keep a copy of the field, as the string may not outlive the error. */
+	data = malloc(size = sizeof(pbg_unknown_type_err) + n);
 	if(data == NULL) {
 		pbg_err_alloc(err, __LINE__, __FILE__);  /* gah. */
 		return;
 	}
-	data->_field = field;
+	data->_field = (char*) (data+1);
+	memcpy(data->_field, field, n);
 	data->_n = n;
-	pbg_err_init(err, PBG_ERR_UNKNOWN_TYPE, line, file, n, data);
+	pbg_err_init(err, PBG_ERR_UNKNOWN_TYPE, line, file, size, data);
 }
 
 void pbg_err_syntax(pbg_error* err, int line, char* file, 
-		char* str, int i, char* msg)
+		char* str, int n, int i, char* msg)
 {
 	pbg_syntax_err* data;
 	int size;
@@ -195,6 +594,7 @@ void pbg_err_syntax(pbg_error* err, int line, char* file,
 	}
 	data->_msg = msg;
 	data->_str = str;
+	data->_n = n;
 	data->_i = i;
 	pbg_err_init(err, PBG_ERR_SYNTAX, line, file, size, data);
 }
@@ -222,6 +622,10 @@ void pbg_err_op_arg_type(pbg_error* err, int line, char* file, char* msg) {
 	pbg_err_init(err, PBG_ERR_OP_ARG_TYPE, line, file, 0, msg);
 }
 
+void pbg_err_limit(pbg_error* err, int line, char* file, char* msg) {
+	pbg_err_init(err, PBG_ERR_LIMIT, line, file, 0, msg);
+}
+
 void pbg_error_free(pbg_error* err) {
 	if(err->_int != 0) free(err->_data);
 }
@@ -249,6 +653,10 @@ pbg_field* pbg_field_get(pbg_expr* e, int index)
 	return NULL;
 }
 
+pbg_field* pbg_field_child(pbg_expr* e, pbg_field* field, int i) {
+	return pbg_field_get(e, ((int*)field->_data)[i]);
+}
+
 /**
  * Free's the single pbg_field pointed to by the specified pointer.
  * @param field  pbg_field to free.
@@ -496,43 +904,47 @@ int pbg_check_op_arity(pbg_field_type type, int numargs)
 	return 1;
 }
 
-void pbg_parse(pbg_expr* e, pbg_error* err, char* str) {
-	pbg_parse_n(e, err, str, strlen(str));
+/**
+ * Finds the end of the field starting at the given index. A STRING or VAR ends
+ * at its closing quote or bracket. Anything else ends before the next 
+ * whitespace or bracket.
+ * @param str  String being parsed.
+ * @param n    Length of str.
+ * @param i    Index of the first character of the field.
+ * @return the index of the last character of the field,
+ *         n if a STRING or VAR is left unclosed.
+ */
+int pbg_parse_skip(char* str, int n, int i)
+{
+	/* It's a string! */
+	if(str[i] == '\'') {
+		do i++; while(i != n && !(str[i] == '\'' && str[i-1] != '\\'));
+	/* It's a variable! */
+	}else if(str[i] == '[') {
+		do i++; while(i != n && !(str[i] == ']' && str[i-1] != '\\'));
+	/* It's literally anything else! */
+	}else
+		while(i != n-1 && !pbg_iswhitespace(str[i+1]) && str[i+1] != '[' && 
+				str[i+1] != '(' && str[i+1] != ')') i++;
+	return i;
 }
 
-void pbg_parse_n(pbg_expr* e, pbg_error* err, char* str, int n)
+/**
+ * Performs the first pass of parsing, which checks that groups, STRINGs, and
+ * VARs are closed, and counts what the later passes must allocate.
+ * @param err          Used to store error, if any.
+ * @param str          String to parse.
+ * @param n            Length of str.
+ * @param numfields    Set to the number of fields.
+ * @param numvars      Set to the number of VARs.
+ * @param numclosings  Set to the number of groups.
+ * @param maxdepth     Set to the number of groups opened.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_parse_first(pbg_error* err, char* str, int n, int* numfields, 
+		int* numvars, int* numclosings, int* maxdepth)
 {
-	int i;
-	
-	int numfields, numvars, numclosings;
-	int depth, maxdepth, reachedend;
-	int instring, invar;
-	
-	int* stack, stacksz;
-	int* groupsz, groupi;
-	int opened;
-	
-	int* fields, *lengths, fieldi;
-	int* closings, closingi;
-	
-	int numconstant, numvariable;
-	
-	pbg_field_type type;
-	int* children, id;
-	int start, len;
-	
-	/* Always start with a clean error! */
-	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
-	
-	/* Set to NULL to allow for pbg_free to check if needing free. */
-	e->_constants = NULL;
-	e->_variables = NULL;
-	
-	/* These are initialized to 0 as they are used as counters for the number 
-	 * of each type of field created. In the end they should be equal to the 
-	 * associated local variables here. */
-	e->_numconst = 0;
-	e->_numvars = 0;
+	int i, depth, reachedend, ended, instring, invar;
 	
 	/*******************************************************************
 	 * FIRST PASS                                                      *
@@ -541,75 +953,258 @@ void pbg_parse_n(pbg_expr* e, pbg_error* err, char* str, int n)
 	 * 3    Ensure group, string, and variable formatting are correct. *
 	 *******************************************************************/
 	
-	numfields = numvars = numclosings = 0;
-	depth = reachedend = maxdepth = 0;
+	*numfields = *numvars = *numclosings = 0;
+	depth = reachedend = ended = *maxdepth = 0;
 	instring = invar = 0;
 	for(i = 0; i < n; i++) {
 		/* Ignore whitespaces. */
 		if(pbg_iswhitespace(str[i])) continue;
+		/* Nothing may follow the whole expression. */
+		if(depth == 0 && ended && str[i] != ')') break;
 		/* Open a new group. */
 		if(str[i] == '(') {
-			depth++, maxdepth++;
+			depth++, (*maxdepth)++;
 		/* Close current group. */
 		}else if(str[i] == ')') {
-			numclosings++, depth--;
-			if(depth < 0 || (depth == 0 && reachedend)) break;
-			if(depth == 0 && !reachedend) reachedend = i;
+			(*numclosings)++, depth--;
+			if(depth < 0) break;
+			if(depth == 0) reachedend = i, ended = 1;
 		/* Process a new field. */
 		}else{
-			/* It's a string! */
-			if(str[i] == '\'') {
-				instring = 1;
-				do i++; while(i != n && !(str[i] == '\'' && str[i-1] != '\\'));
-				if(i != n) instring = 0;
-			/* It's a variable! */
-			}else if(str[i] == '[') {
-				invar = 1, numvars++;
-				do i++; while(i != n && !(str[i] == ']' && str[i-1] != '\\'));
-				if(i != n) invar = 0;
-			/* It's literally anything else! */
+			if(str[i] == '[') (*numvars)++;
+			/* STRINGs and VARs left unclosed run to the end. */
+			if(str[i] == '\'' || str[i] == '[') {
+				invar = (str[i] == '[');
+				instring = !invar;
+				i = pbg_parse_skip(str, n, i);
+				if(i != n) instring = invar = 0;
 			}else
-				while(i != n-1 && !pbg_iswhitespace(str[i+1]) && str[i+1] != '[' && 
-						str[i+1] != '(' && str[i+1] != ')') i++;
-			numfields++;
+				i = pbg_parse_skip(str, n, i);
+			(*numfields)++;
+			if(depth == 0) reachedend = i, ended = 1;
 		}
 	}
 	/* Check if there aren't any fields. */
-	if(numfields == 0) {
-		pbg_err_syntax(err, __LINE__, __FILE__, str, 0,
+	if(*numfields == 0) {
+		pbg_err_syntax(err, __LINE__, __FILE__, str, n, 0,
 				"No fields in expression.");
-		return;
+		return 0;
 	}
 	/* Check if there are too many closing parentheses. */
 	if(depth < 0) {
-		pbg_err_syntax(err, __LINE__, __FILE__, str, i,
+		pbg_err_syntax(err, __LINE__, __FILE__, str, n, i,
 				"Too many closing parentheses.");
-		return;
+		return 0;
 	}
 	/* Check if there are not enough closing parentheses. */
 	if(depth != 0) {
-		pbg_err_syntax(err, __LINE__, __FILE__, str, 0,
+		pbg_err_syntax(err, __LINE__, __FILE__, str, n, 0,
 				"Too few closing parentheses.");
-		return;
+		return 0;
 	}
 	/* Check if there are multiple (possible) expressions. */
-	if(depth == 0 && reachedend && i != n) {
-		pbg_err_syntax(err, __LINE__, __FILE__, str, reachedend,
-				"Too many opening parentheses yield multiple expressions.");
-		return;
+	if(depth == 0 && ended && i != n) {
+		pbg_err_syntax(err, __LINE__, __FILE__, str, n, reachedend,
+				"Multiple expressions, one after another.");
+		return 0;
 	}
 	/* Check if string is left unclosed. */
 	if(instring) {
-		pbg_err_syntax(err, __LINE__, __FILE__, str, instring, 
+		pbg_err_syntax(err, __LINE__, __FILE__, str, n, instring, 
 				"Unclosed string.");
-		return;
+		return 0;
 	}
 	/* Check if variable is left unclosed. */
 	if(invar) {
-		pbg_err_syntax(err, __LINE__, __FILE__, str, invar, 
+		pbg_err_syntax(err, __LINE__, __FILE__, str, n, invar, 
 				"Unclosed variable.");
-		return;
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Makes the field of a literal of the given type.
+ * @param err   Used to store error, if any.
+ * @param type  Type of the literal, as given by pbg_gettype.
+ * @param str   String to parse as the literal.
+ * @param n     Length of str.
+ * @return the field of the literal,
+ *         a NULL field if the type is not that of a literal.
+ */
+pbg_field pbg_parse_literal(pbg_error* err, pbg_field_type type, char* str, int n)
+{
+	switch(type) {
+		case PBG_LT_VAR:    return pbg_parse_var(err, str, n);
+		case PBG_LT_DATE:   return pbg_parse_date(err, str, n);
+		case PBG_LT_NUMBER: return pbg_parse_number(err, str, n);
+		case PBG_LT_STRING: return pbg_parse_string(err, str, n);
+		/* It's a simple field. */
+		case PBG_LT_TRUE:
+		case PBG_LT_FALSE:
+		case PBG_LT_TP_DATE:
+		case PBG_LT_TP_BOOL:
+		case PBG_LT_TP_NUMBER:
+		case PBG_LT_TP_STRING:
+			return pbg_field_init(type, 0, NULL);
+		default:
+			return pbg_field_init(PBG_NULL, 0, NULL);
+	}
+}
+
+int pbg_validate(pbg_error* err, char* str, int n)
+{
+	int i, end, opened, depth, bad, badargc, unknown;
+	int numfields, numvars, numclosings, maxdepth;
+	int* stack;
+	pbg_field_type type;
+	
+	/* Always start with a clean error! */
+	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	
+	/* Groups, STRINGs, and VARs must be closed. */
+	if(!pbg_parse_first(err, str, n, &numfields, &numvars, &numclosings, &maxdepth))
+		return 0;
+	
+	/* Every group must open with an operator, and only there. As in the 
+	 * second pass of parsing, the first offending field is reported. */
+	opened = 0;
+	for(i = 0; i < n; i++) {
+		if(pbg_iswhitespace(str[i])) continue;
+		if(opened && (str[i] == '(' || str[i] == ')')) {
+			pbg_err_syntax(err, __LINE__, __FILE__, str, n, i, 
+					"Field ordering not respected.");
+			return 0;
+		}
+		if(str[i] == '(') {
+			opened = 1;
+		}else if(str[i] != ')') {
+			end = pbg_parse_skip(str, n, i);
+			type = pbg_gettype(str+i, end-i+1);
+			if(opened != pbg_type_isop(type) || (opened = 0)) {
+				pbg_err_syntax(err, __LINE__, __FILE__, str, n, i, 
+						"Field ordering not respected.");
+				return 0;
+			}
+			i = end;
+		}
+	}
+	
+	/* Check arity and literals in one pass, counting the arguments of each 
+	 * open operator on a stack of its index and count. Arity is only known once
+	 * a group closes, so the earliest operator of bad arity and the first 
+	 * unknown literal are kept, and whichever comes first is reported, as the
+	 * third pass of parsing builds fields in that order. */
+	stack = (int*) malloc(2*(maxdepth+1) * sizeof(int));
+	if(stack == NULL) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return 0;
+	}
+	depth = 0, bad = -1, badargc = 0, unknown = -1;
+	for(i = 0; i < n; i++) {
+		if(pbg_iswhitespace(str[i])) continue;
+		if(str[i] == '(') {
+			if(depth > 0) stack[2*depth-1]++;
+			continue;
+		}
+		if(str[i] == ')') {
+			depth--;
+			end = pbg_parse_skip(str, n, stack[2*depth]);
+			type = pbg_gettype(str+stack[2*depth], end-stack[2*depth]+1);
+			if(pbg_check_op_arity(type, stack[2*depth+1]) == 0 && 
+					(bad < 0 || stack[2*depth] < bad)) {
+				bad = stack[2*depth];
+				badargc = stack[2*depth+1];
+			}
+			continue;
+		}
+		end = pbg_parse_skip(str, n, i);
+		type = pbg_gettype(str+i, end-i+1);
+		if(pbg_type_isop(type)) {
+			stack[2*depth] = i;
+			stack[2*depth+1] = 0;
+			depth++;
+		}else{
+			if(depth > 0) stack[2*depth-1]++;
+			if(type == PBG_NULL && unknown < 0) unknown = i;
+		}
+		i = end;
+	}
+	free(stack);
+	if(unknown >= 0 && (bad < 0 || unknown < bad)) {
+		end = pbg_parse_skip(str, n, unknown);
+		pbg_err_unknown_type(err, __LINE__, __FILE__, str+unknown, end-unknown+1);
+		return 0;
+	}
+	if(bad >= 0) {
+		end = pbg_parse_skip(str, n, bad);
+		pbg_err_op_arity(err, __LINE__, __FILE__, 
+				pbg_gettype(str+bad, end-bad+1), badargc);
+		return 0;
 	}
+	return 1;
+}
+
+void pbg_parse(pbg_expr* e, pbg_error* err, char* str) {
+	pbg_parse_n(e, err, str, strlen(str));
+}
+
+void pbg_parse_n(pbg_expr* e, pbg_error* err, char* str, int n)
+{
+	pbg_parser p;
+	pbg_parser_init(&p);
+	pbg_parser_parse_n(&p, e, err, str, n);
+	pbg_parser_free(&p);
+}
+
+void pbg_parser_parse_n(pbg_parser* p, pbg_expr* e, pbg_error* err, 
+		char* str, int n)
+{
+	int i;
+	
+	int numfields, numvars, numclosings, maxdepth;
+	
+	int* scratch;
+	int* stack, stacksz;
+	int* groupsz, groupi;
+	int opened;
+	
+	int* fields, *lengths, fieldi;
+	int* closings, closingi;
+	
+	int numconstant, numvariable;
+	
+	pbg_field_type type;
+	pbg_field field;
+	int* children, id;
+	int start, len;
+	
+	/* Always start with a clean error! */
+	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	
+	/* Set to NULL to allow for pbg_free to check if needing free. */
+	e->_constants = NULL;
+	e->_variables = NULL;
+	
+	/* These are initialized to 0 as they are used as counters for the number 
+	 * of each type of field created. In the end they should be equal to the 
+	 * associated local variables here. */
+	e->_numconst = 0;
+	e->_numvars = 0;
+	
+	/* Parsed expressions start out uncompiled, with no VAR split. */
+	e->_program = NULL;
+	e->_names = NULL;
+	
+	/*******************************************************************
+	 * FIRST PASS                                                      *
+	 * 1    Count number of groups, fields, and variables.             *
+	 * 2    Identify depth of the tree.                                *
+	 * 3    Ensure group, string, and variable formatting are correct. *
+	 *******************************************************************/
+	
+	if(!pbg_parse_first(err, str, n, &numfields, &numvars, &numclosings, &maxdepth))
+		return;
 	
 	/*******************************************************************
 	 * SECOND PASS                                                     *
@@ -620,18 +1215,35 @@ void pbg_parse_n(pbg_expr* e, pbg_error* err, char* str, int n)
 	
 	/* Ensure we have a stack for TRUE/FALSE standalone literals. */
 	if(maxdepth == 0) maxdepth = 1;
+	
+	/* The scratch arrays are carved out of a single buffer kept by the parser,
+	 * which only grows when an expression needs more than any before it. Each
+	 * count is at most n, so this only fails for absurdly long strings. */
+	if(maxdepth > INT_MAX/6 || numclosings > INT_MAX/6 || numfields > INT_MAX/6) {
+		pbg_err_limit(err, __LINE__, __FILE__, "Expression is too long.");
+		return;
+	}
+	scratch = pbg_parser_grow(p->_scratch, &p->_scratchcap, 
+			2*maxdepth + 2*(numclosings+1) + 2*numfields, sizeof(int));
+	if(scratch == NULL) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return;
+	}
+	p->_scratch = scratch;
+	
 	/* Use a stack to identify number of fields in each group. */
-	stack = malloc(2*maxdepth * sizeof(int));
+	stack = scratch;
 	
 	/* Use to record number of fields in each group. Notice that the number of 
 	 * groups is equal to the number of closings. */
-	groupsz = calloc(numclosings+1, sizeof(int));
+	groupsz = stack + 2*maxdepth;
+	memset(groupsz, 0, (numclosings+1) * sizeof(int));
 	
-	/* Allocate space to record field starting positions & lengths as well as 
-	 * the positions of group closings. */
-	fields = (int*) malloc(numfields * sizeof(int));
-	lengths = (int*) malloc(numfields * sizeof(int));
-	closings = (int*) malloc((numclosings+1) * sizeof(int));
+	/* Record field starting positions & lengths as well as the positions of 
+	 * group closings. */
+	closings = groupsz + (numclosings+1);
+	fields = closings + (numclosings+1);
+	lengths = fields + numfields;
 	
 	/* Compute sizes of constant and variable arrays. */
 	numconstant = numfields - numvars;
@@ -642,22 +1254,27 @@ void pbg_parse_n(pbg_expr* e, pbg_error* err, char* str, int n)
 	e->_variables = (pbg_field*) malloc(numvariable * sizeof(pbg_field));
 	
 	/* Ensure we got all of the memory we need. */
-	if(stack == NULL || groupsz == NULL || fields == NULL || lengths == NULL || 
-			closings == NULL || e->_constants == NULL || e->_variables == NULL) {
-		free(stack); free(groupsz);
-		free(fields); free(lengths); free(closings);
+	if(e->_constants == NULL || e->_variables == NULL) {
 		pbg_err_alloc(err, __LINE__, __FILE__);
 		pbg_free(e);
 		return;
 	}
 	
-	/* Do the work! */
+	/* Do the work! id is only 0 once a literal fails to be stored. */
 	opened = stacksz = groupi = closingi = fieldi = 0;
+	id = 1;
 	stacksz = 1;
 	stack[0] = 0;
 	for(i = 0; i < n; i++) {
 		/* Ignore whitespaces. */
 		if(pbg_iswhitespace(str[i])) continue;
+		/* Ensure every group opens with a field. */
+		if(opened && (str[i] == '(' || str[i] == ')')) {
+			pbg_err_syntax(err, __LINE__, __FILE__, str, n, i, 
+					"Field ordering not respected.");
+			pbg_free(e);
+			return;
+		}
 		/* Open a new group. Push it onto the stack. */
 		if(str[i] == '(') {
 			opened = 1;
@@ -674,25 +1291,14 @@ void pbg_parse_n(pbg_expr* e, pbg_error* err, char* str, int n)
 		}else{
 			/* Save index of the field. */
 			fields[fieldi] = i;
-			/* It's a string! */
-			if(str[i] == '\'') {
-				do i++; while(i != n && !(str[i] == '\'' && str[i-1] != '\\'));
-			/* It's a variable! */
-			}else if(str[i] == '[') {
-				do i++; while(i != n && !(str[i] == ']' && str[i-1] != '\\'));
-			/* It's literally anything else! */
-			}else
-				while(i != n-1 && !pbg_iswhitespace(str[i+1]) && str[i+1] != '[' && 
-						str[i+1] != '(' && str[i+1] != ')') i++;
+			i = pbg_parse_skip(str, n, i);
 			/* Compute length of the field. */
 			lengths[fieldi] = i - fields[fieldi] + 1;
 			/* Identify type of field. */
 			type = pbg_gettype(str+fields[fieldi], lengths[fieldi]);
 			/* Ensure opener is operator, and no other field is an operator. */
 			if(opened != pbg_type_isop(type) || (opened = 0)) {
-				free(stack); free(groupsz);
-				free(fields); free(lengths); free(closings);
-				pbg_err_syntax(err, __LINE__, __FILE__, str, fields[fieldi], 
+				pbg_err_syntax(err, __LINE__, __FILE__, str, n, fields[fieldi], 
 						"Field ordering not respected.");
 				pbg_free(e);
 				return;
@@ -718,14 +1324,18 @@ void pbg_parse_n(pbg_expr* e, pbg_error* err, char* str, int n)
 		/* Alias field start and field length for easier use. */
 		start = fields[fieldi];
 		len = lengths[fieldi];
-		/* Parsed all inputs to current operator. Pop it from the stack. */
-		if(start > closings[closingi]) {
+		/* Parsed all inputs to current operator. Pop it from the stack. Several
+		 * groups may have closed since the last field. */
+		while(start > closings[closingi]) {
 			closingi++;
 			/* Pop from the stack. */
 			stacksz--;
-			id = pbg_stack_fieldid;
-			/* Restore list of children from parent operator. */
-			children = pbg_field_get(e, id)->_data;
+			/* Restore list of children from parent operator, if any. */
+			children = NULL;
+			if(stacksz > 0) {
+				id = pbg_stack_fieldid;
+				children = pbg_field_get(e, id)->_data;
+			}
 		}
 		/* Identify type of field. */
 		type = pbg_gettype(str+start, len);
@@ -753,36 +1363,17 @@ void pbg_parse_n(pbg_expr* e, pbg_error* err, char* str, int n)
 			children = pbg_field_get(e, id)->_data;
 		/* It's a literal! */
 		}else{
+			field = pbg_parse_literal(err, type, str+start, len);
 			/* It's a variable. */
-			if(type == PBG_LT_VAR)
-				id = pbg_store_variable(e, 
-						pbg_parse_var(err, str+start, len));
-			/* It's a date. */
-			else if(type == PBG_LT_DATE)
-				id = pbg_store_constant(e, 
-						pbg_parse_date(err, str+start, len));
-			/* It's a number. */
-			else if(type == PBG_LT_NUMBER)
-				id = pbg_store_constant(e, 
-						pbg_parse_number(err, str+start, len));
-			/* It's a string. */
-			else if(type == PBG_LT_STRING)
-				id = pbg_store_constant(e, 
-						pbg_parse_string(err, str+start, len));
-			/* It's a simple field. */
-			else if(type == PBG_LT_TRUE || 
-					type == PBG_LT_FALSE || 
-					type == PBG_LT_TP_DATE || 
-					type == PBG_LT_TP_BOOL || 
-					type == PBG_LT_TP_NUMBER || 
-					type == PBG_LT_TP_STRING)
-				id = pbg_store_constant(e, 
-							pbg_field_init(type, 0, NULL));
+			if(field._type == PBG_LT_VAR)
+				id = pbg_store_variable(e, field);
 			/* It's an error... */
-			else {
-				pbg_err_unknown_type(err, __LINE__, __FILE__, str+start, n);
+			else if(field._type == PBG_NULL) {
+				pbg_err_unknown_type(err, __LINE__, __FILE__, str+start, len);
 				id = 0;
-			}
+			/* It's a constant. */
+			}else
+				id = pbg_store_constant(e, field);
 			/* Check for errors when adding literal to tree. */
 			if(id == 0) break;
 			/* Add this literal as a child of the parent operator, if any. */
@@ -793,10 +1384,6 @@ void pbg_parse_n(pbg_expr* e, pbg_error* err, char* str, int n)
 	/* Free expression if a parse error occurred. */
 	if(id == 0) pbg_free(e);
 	
-	/* Clean up! */
-	free(stack), free(groupsz);
-	free(fields), free(lengths), free(closings);
-	
 	/* Do not perform sanity checks if an error occurred. */
 	if(pbg_iserror(err))
 		return;
@@ -807,268 +1394,5670 @@ void pbg_parse_n(pbg_expr* e, pbg_error* err, char* str, int n)
 				"Not all fields were parsed?");
 		return;
 	}
+	
+	/* Split dotted VAR names and hash all of them once and for all. */
+	if(!pbg_paths_init(e, err, 1, pbg_hash) || !pbg_hashes_init(e, err, pbg_hash))
+		pbg_free(e);
 }
 
 
+
 /****************************
  *                          *
- * FIELD EVALUATION TOOLKIT *
+ * STREAMING PARSER TOOLKIT *
  *                          *
  ****************************/
 
-int pbg_evaluate_op_not(pbg_expr* e, pbg_error* err, pbg_field* field)
+/**
+ * Makes room for the given number of elements in a parser buffer. The capacity
+ * is doubled as needed.
+ * @param buf   Buffer to grow, or NULL.
+ * @param cap   Capacity of buf, updated if it grows.
+ * @param need  Number of elements needed.
+ * @param size  Size of each element.
+ * @return the buffer, which may have moved, NULL if out of memory. The old 
+ *         buffer is left alone if growing fails.
+ */
+void* pbg_parser_grow(void* buf, int* cap, int need, int size)
 {
-	int child0, result;
-	child0 = ((int*)field->_data)[0];
-	result = pbg_evaluate_r(e, err, pbg_field_get(e, child0));
-	if(result == PBG_ERROR) return PBG_ERROR;  /* Pass error through. */
-	return result == PBG_TRUE ? PBG_FALSE : PBG_TRUE;
+	int newcap;
+	if(need <= *cap)
+		return buf;
+	newcap = (*cap > 0) ? *cap : 16;
+	while(newcap < need) {
+		if(newcap > INT_MAX/2) return NULL;
+		newcap *= 2;
+	}
+	if(newcap > INT_MAX/size)
+		return NULL;
+	buf = realloc(buf, newcap * size);
+	if(buf != NULL)
+		*cap = newcap;
+	return buf;
 }
 
-int pbg_evaluate_op_and(pbg_expr* e, pbg_error* err, pbg_field* field)
+/**
+ * Marks the parser as out of memory. Nothing more is parsed until it is reset.
+ * @param p  Parser that failed.
+ */
+void pbg_parser_fail(pbg_parser* p)
 {
-	int i, size, childi, result;
-	size = field->_int;
-	for(i = 0; i < size; i++) {
-		childi = ((int*)field->_data)[i];
-		result = pbg_evaluate_r(e, err, pbg_field_get(e, childi));
-		if(result == PBG_ERROR) return PBG_ERROR;  /* Pass error through. */
-		if(result == PBG_FALSE) return PBG_FALSE;
-	}
-	return PBG_TRUE;
+	if(p->_fail._type == PBG_ERR_NONE)
+		pbg_err_alloc(&p->_fail, __LINE__, __FILE__);
 }
 
-int pbg_evaluate_op_or(pbg_expr* e, pbg_error* err, pbg_field* field)
+/**
+ * Stores the field in the expression being built, growing its arrays as 
+ * needed. The field is freed if it cannot be stored.
+ * @param p      Parser building the expression.
+ * @param field  Field to store.
+ * @return the index of the field if successful, 0 otherwise.
+ */
+int pbg_parser_store(pbg_parser* p, pbg_field field)
 {
-	int i, childi, result;
-	for(i = 0; i < field->_int; i++) {
-		childi = ((int*)field->_data)[i];
-		result = pbg_evaluate_r(e, err, pbg_field_get(e, childi));
-		if(result == PBG_ERROR) return PBG_ERROR;  /* Pass error through. */
-		if(result == PBG_TRUE)  return PBG_TRUE;
+	pbg_expr* e;
+	pbg_field* fields;
+	e = &p->_expr;
+	if(field._type == PBG_LT_VAR) {
+		fields = pbg_parser_grow(e->_variables, &p->_varcap, 
+				e->_numvars+1, sizeof(pbg_field));
+		if(fields != NULL) {
+			e->_variables = fields;
+			return pbg_store_variable(e, field);
+		}
+	}else{
+		fields = pbg_parser_grow(e->_constants, &p->_constcap, 
+				e->_numconst+1, sizeof(pbg_field));
+		if(fields != NULL) {
+			e->_constants = fields;
+			return pbg_store_constant(e, field);
+		}
+	}
+	pbg_field_free(&field);
+	pbg_parser_fail(p);
+	return 0;
+}
+
+/**
+ * Adds the field as the next child of the operator of the innermost open group
+ * that it does not open itself.
+ * @param p   Parser building the expression.
+ * @param id  Index of the field.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_parser_child(pbg_parser* p, int id)
+{
+	int* children;
+	children = pbg_parser_grow(p->_children, &p->_childcap, 
+			p->_numchildren+1, sizeof(int));
+	if(children == NULL) {
+		pbg_parser_fail(p);
+		return 0;
+	}
+	p->_children = children;
+	p->_children[p->_numchildren++] = id;
+	return 1;
+}
+
+/**
+ * Counts the next field, and checks its place as the second pass of 
+ * pbg_parse_n does. Once ordering is broken, groups are no longer followed.
+ * @param p      Parser reading the field.
+ * @param type   Type of the field.
+ * @param start  Offset of the field.
+ * @return 1 if the field should be built, 0 otherwise.
+ */
+int pbg_parser_next(pbg_parser* p, pbg_field_type type, int start)
+{
+	/* Nothing may follow the whole expression. */
+	if(p->_depth == 0 && p->_ended) {
+		p->_stopped = start;
+		return 0;
+	}
+	p->_numfields++;
+	if(p->_depth == 0)
+		p->_reachedend = start, p->_ended = 1;
+	/* Ensure opener is operator, and no other field is an operator. */
+	if(p->_opened != pbg_type_isop(type) || (p->_opened = 0)) {
+		if(p->_orderi < 0) p->_orderi = start;
+		return 0;
+	}
+	if(p->_orderi >= 0)
+		return 0;
+	/* Add field to current group. */
+	if(p->_numgroups > 0)
+		p->_groups[PBG_PARSER_GROUP*(p->_numgroups-1)+3]++;
+	return 1;
+}
+
+/**
+ * Checks if the parser is still building, i.e. no error has been found.
+ * @param p  Parser to check.
+ * @return 1 if building, 0 otherwise.
+ */
+int pbg_parser_building(pbg_parser* p) {
+	return p->_orderi < 0 && p->_erri < 0 && p->_fail._type == PBG_ERR_NONE;
+}
+
+/**
+ * Reads an operator. It opens the current group, and is stored at once so 
+ * that fields are still stored in preorder, but gets its children once the
+ * group closes.
+ * @param p      Parser reading the operator.
+ * @param type   Type of the operator.
+ * @param start  Offset of the operator.
+ */
+void pbg_parser_op(pbg_parser* p, pbg_field_type type, int start)
+{
+	int* group;
+	int id;
+	if(!pbg_parser_next(p, type, start) || p->_numgroups == 0)
+		return;  /* The group may have been lost to a failure. */
+	group = p->_groups + PBG_PARSER_GROUP*(p->_numgroups-1);
+	id = 0;
+	if(pbg_parser_building(p)) {
+		id = pbg_parser_store(p, pbg_field_init(type, 0, NULL));
+		if(id != 0 && p->_numgroups > 1 && !pbg_parser_child(p, id))
+			id = 0;
+	}
+	group[0] = id;
+	group[1] = start;
+	group[2] = type;
+	group[4] = p->_numchildren;
+}
+
+/**
+ * Reads a literal that is already made into a field. The field is stored, or
+ * freed if the parser is no longer building.
+ * @param p      Parser reading the literal.
+ * @param field  Field of the literal.
+ * @param start  Offset of the literal.
+ */
+void pbg_parser_literal(pbg_parser* p, pbg_field field, int start)
+{
+	int id;
+	if(!pbg_parser_next(p, field._type, start) || !pbg_parser_building(p)) {
+		pbg_field_free(&field);
+		return;
+	}
+	id = pbg_parser_store(p, field);
+	if(id != 0 && p->_numgroups > 0)
+		pbg_parser_child(p, id);
+}
+
+/**
+ * Reports a field of unknown type, unless an earlier field is at fault.
+ * @param p      Parser reading the field.
+ * @param str    Text of the field.
+ * @param n      Length of str.
+ * @param start  Offset of the field.
+ */
+void pbg_parser_unknown(pbg_parser* p, char* str, int n, int start)
+{
+	if(!pbg_parser_next(p, PBG_NULL, start) || p->_erri >= 0)
+		return;
+	p->_erri = start;
+	pbg_err_unknown_type(&p->_err, __LINE__, __FILE__, str, n);
+}
+
+/**
+ * Reads a whole field. Fields are checked and stored as the passes of 
+ * pbg_parse_n do. Once an error is found, fields are only checked for errors
+ * that would take priority.
+ * @param p      Parser reading the field.
+ * @param str    Text of the field.
+ * @param n      Length of str.
+ * @param start  Offset of the field in the whole text.
+ */
+void pbg_parser_field(pbg_parser* p, char* str, int n, int start)
+{
+	pbg_field_type type;
+	pbg_field field;
+	pbg_error err;
+	type = pbg_gettype(str, n);
+	/* It's an operator! */
+	if(pbg_type_isop(type)) {
+		pbg_parser_op(p, type, start);
+		return;
+	}
+	/* It's an error... */
+	if(type == PBG_NULL) {
+		pbg_parser_unknown(p, str, n, start);
+		return;
+	}
+	/* It's a literal! Only make it if it is to be stored. */
+	if(!pbg_parser_building(p)) {
+		pbg_parser_next(p, type, start);
+		return;
+	}
+	pbg_err_init(&err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	field = pbg_parse_literal(&err, type, str, n);
+	if(err._type != PBG_ERR_NONE) {
+		pbg_field_free(&field);
+		pbg_parser_next(p, type, start);
+		pbg_parser_fail(p);
+		return;
+	}
+	pbg_parser_literal(p, field, start);
+}
+
+/**
+ * Reads a parenthesis. The first pass of pbg_parse_n stops at anything after
+ * the whole expression but a closing parenthesis, and at a closing parenthesis
+ * that has no group to close, and so does the parser.
+ * @param p  Parser reading the parenthesis.
+ * @param c  The parenthesis, '(' or ')'.
+ * @param i  Offset of the parenthesis in the whole text.
+ */
+void pbg_parser_group(pbg_parser* p, char c, int i)
+{
+	int* group, *groups;
+	int argc;
+	pbg_field field;
+	pbg_error err;
+	
+	/* Nothing may follow the whole expression. */
+	if(c == '(' && p->_depth == 0 && p->_ended) {
+		p->_stopped = i;
+		return;
+	}
+	/* Ensure every group opens with a field. */
+	if(p->_opened && p->_orderi < 0)
+		p->_orderi = i;
+	
+	/* Open a new group. Push it onto the stack. */
+	if(c == '(') {
+		p->_depth++;
+		p->_opened = 1;
+		if(p->_orderi >= 0)
+			return;
+		groups = pbg_parser_grow(p->_groups, &p->_groupcap, 
+				PBG_PARSER_GROUP*(p->_numgroups+1), sizeof(int));
+		if(groups == NULL) {
+			pbg_parser_fail(p);
+			return;
+		}
+		p->_groups = groups;
+		/* The group is an argument of its parent. */
+		if(p->_numgroups > 0)
+			p->_groups[PBG_PARSER_GROUP*(p->_numgroups-1)+3]++;
+		group = p->_groups + PBG_PARSER_GROUP*p->_numgroups++;
+		group[0] = 0;
+		group[1] = i;
+		group[2] = PBG_NULL;
+		group[3] = 0;
+		group[4] = p->_numchildren;
+		return;
+	}
+	
+	/* Close current group. */
+	p->_depth--;
+	if(p->_depth < 0) {
+		p->_stopped = i;
+		return;
+	}
+	if(p->_depth == 0)
+		p->_reachedend = i, p->_ended = 1;
+	if(p->_orderi >= 0 || p->_numgroups == 0)
+		return;
+	/* Pop the group off of the stack. */
+	group = p->_groups + PBG_PARSER_GROUP*(--p->_numgroups);
+	p->_numchildren = group[4];
+	/* An empty group has no operator. */
+	if(group[2] == PBG_NULL) {
+		p->_orderi = i;
+		return;
+	}
+	/* Enforce operator arity. Only an operator before every error found so far
+	 * takes priority. */
+	argc = group[3]-1;
+	if(pbg_check_op_arity((pbg_field_type) group[2], argc) == 0) {
+		if(p->_erri < 0 || group[1] < p->_erri) {
+			pbg_error_free(&p->_err);
+			p->_erri = group[1];
+			pbg_err_op_arity(&p->_err, __LINE__, __FILE__, 
+					(pbg_field_type) group[2], argc);
+		}
+		return;
+	}
+	/* Hand the operator its children. */
+	if(p->_erri >= 0 || p->_fail._type != PBG_ERR_NONE || group[0] == 0)
+		return;
+	pbg_err_init(&err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	field = pbg_parse_op(&err, (pbg_field_type) group[2], argc);
+	if(err._type != PBG_ERR_NONE) {
+		pbg_parser_fail(p);
+		return;
+	}
+	memcpy(field._data, p->_children+group[4], argc * sizeof(int));
+	*pbg_field_get(&p->_expr, group[0]) = field;
+}
+
+/**
+ * Finds the end of the field the parser is in, as pbg_parse_skip does. The
+ * field may have started in an earlier chunk.
+ * @param p    Parser in a field.
+ * @param str  Chunk being read.
+ * @param n    Length of str.
+ * @param i    Index of the first character of str left to read.
+ * @return the index of the last character of the field, which is -1 if the 
+ *         field ended with the last chunk,
+ *         n if the field goes on past this chunk.
+ */
+int pbg_parser_scan(pbg_parser* p, char* str, int n, int i)
+{
+	char close;
+	/* It's literally anything else! */
+	if(p->_state == PBG_PARSER_BARE) {
+		for(; i < n; i++)
+			if(pbg_iswhitespace(str[i]) || str[i] == '[' || 
+					str[i] == '(' || str[i] == ')')
+				return i-1;
+		return n;
+	}
+	/* It's a string or a variable! The character before a closing quote or 
+	 * bracket may be in an earlier chunk. */
+	close = (p->_state == PBG_PARSER_STRING) ? '\'' : ']';
+	for(; i < n; i++) {
+		if(str[i] == close && p->_prev != '\\')
+			return i;
+		p->_prev = str[i];
+	}
+	return n;
+}
+
+/**
+ * Copies part of a field cut by the end of a chunk. The copy is kept 
+ * terminated, so that nothing left of a longer field is read as part of it.
+ * @param p    Parser in the field.
+ * @param str  Part of the field.
+ * @param n    Length of str.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_parser_append(pbg_parser* p, char* str, int n)
+{
+	char* tok;
+	tok = pbg_parser_grow(p->_tok, &p->_tokcap, p->_toklen+n+1, sizeof(char));
+	if(tok == NULL) {
+		pbg_parser_fail(p);
+		return 0;
+	}
+	p->_tok = tok;
+	memcpy(p->_tok+p->_toklen, str, n);
+	p->_toklen += n;
+	p->_tok[p->_toklen] = '\0';
+	return 1;
+}
+
+/**
+ * Readies the parser for a new expression. Any expression being built and any
+ * error held back are freed, but the buffers are kept.
+ * @param p  Parser to reset.
+ */
+void pbg_parser_reset(pbg_parser* p)
+{
+	pbg_free(&p->_expr);
+	p->_constcap = p->_varcap = 0;
+	pbg_error_free(&p->_err);
+	pbg_err_init(&p->_err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	pbg_err_init(&p->_fail, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	p->_numgroups = p->_numchildren = p->_toklen = 0;
+	p->_tokstart = p->_pos = p->_numfields = 0;
+	p->_state = PBG_PARSER_NONE;
+	p->_prev = '\0';
+	p->_depth = p->_reachedend = p->_ended = p->_opened = 0;
+	p->_stopped = p->_orderi = p->_erri = -1;
+}
+
+void pbg_parser_init(pbg_parser* p)
+{
+	p->_expr._constants = NULL;
+	p->_expr._variables = NULL;
+	p->_expr._numconst = 0;
+	p->_expr._numvars = 0;
+	p->_expr._program = NULL;
+	p->_expr._names = NULL;
+	p->_groups = p->_children = NULL;
+	p->_tok = NULL;
+	p->_groupcap = p->_childcap = p->_tokcap = 0;
+	p->_scratch = NULL;
+	p->_scratchcap = 0;
+	pbg_err_init(&p->_err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	pbg_parser_reset(p);
+}
+
+void pbg_parser_feed(pbg_parser* p, pbg_error* err, char* str, int n)
+{
+	int i, seg, end;
+	
+	/* Offsets into the whole text must fit in an int. */
+	if(p->_fail._type == PBG_ERR_NONE && n > INT_MAX - p->_pos)
+		pbg_err_limit(&p->_fail, __LINE__, __FILE__, "Expression is too long.");
+	
+	for(i = 0; i < n && p->_stopped < 0 && p->_fail._type == PBG_ERR_NONE; i++) {
+		if(p->_state == PBG_PARSER_NONE) {
+			/* Ignore whitespaces. */
+			if(pbg_iswhitespace(str[i])) continue;
+			/* Open or close a group. */
+			if(str[i] == '(' || str[i] == ')') {
+				pbg_parser_group(p, str[i], p->_pos+i);
+				continue;
+			}
+			/* Start a new field. */
+			p->_tokstart = p->_pos+i;
+			p->_state = (str[i] == '\'') ? PBG_PARSER_STRING : 
+					(str[i] == '[') ? PBG_PARSER_VAR : PBG_PARSER_BARE;
+			p->_prev = str[i];
+			seg = i++;
+		}else
+			seg = i;
+		/* The field may run past this chunk. Keep what we have of it. */
+		end = pbg_parser_scan(p, str, n, i);
+		if(end == n) {
+			pbg_parser_append(p, str+seg, n-seg);
+			break;
+		}
+		/* Fields within the chunk are read in place. */
+		if(p->_toklen == 0)
+			pbg_parser_field(p, str+seg, end-seg+1, p->_tokstart);
+		else if(pbg_parser_append(p, str+seg, end-seg+1))
+			pbg_parser_field(p, p->_tok, p->_toklen, p->_tokstart);
+		p->_toklen = 0;
+		p->_state = PBG_PARSER_NONE;
+		i = end;
+	}
+	if(p->_fail._type == PBG_ERR_NONE)
+		p->_pos += n;
+	
+	/* Failures own no data, so the parser keeps its own copy. */
+	*err = p->_fail;
+}
+
+void pbg_parser_finish(pbg_parser* p, pbg_expr* e, pbg_error* err)
+{
+	char* msg;
+	int i;
+	
+	/* Always start with a clean error! */
+	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	e->_constants = NULL;
+	e->_variables = NULL;
+	e->_numconst = 0;
+	e->_numvars = 0;
+	e->_program = NULL;
+	e->_names = NULL;
+	
+	/* A field running to the end of the text is whole, unless it is a STRING 
+	 * or VAR left unclosed. */
+	if(p->_state == PBG_PARSER_BARE && p->_fail._type == PBG_ERR_NONE) {
+		pbg_parser_field(p, p->_tok, p->_toklen, p->_tokstart);
+		p->_state = PBG_PARSER_NONE;
+	}
+	
+	/* Report errors in the order pbg_parse_n finds them. */
+	msg = NULL;
+	i = 0;
+	if(p->_fail._type != PBG_ERR_NONE)
+		*err = p->_fail;
+	else if(p->_numfields == 0)
+		msg = "No fields in expression.";
+	else if(p->_depth < 0)
+		msg = "Too many closing parentheses.", i = p->_stopped;
+	else if(p->_depth != 0)
+		msg = "Too few closing parentheses.";
+	else if(p->_stopped >= 0)
+		msg = "Multiple expressions, one after another.", 
+				i = p->_reachedend;
+	else if(p->_state == PBG_PARSER_STRING)
+		msg = "Unclosed string.", i = p->_tokstart;
+	else if(p->_state == PBG_PARSER_VAR)
+		msg = "Unclosed variable.", i = p->_tokstart;
+	else if(p->_orderi >= 0)
+		msg = "Field ordering not respected.", i = p->_orderi;
+	/* Hand over the held back error. */
+	else if(p->_erri >= 0) {
+		*err = p->_err;
+		pbg_err_init(&p->_err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	/* Hand over the expression. */
+	}else{
+		*e = p->_expr;
+		p->_expr._constants = NULL;
+		p->_expr._variables = NULL;
+		p->_expr._numconst = 0;
+		p->_expr._numvars = 0;
+		/* Split dotted VAR names and hash all of them once and for all. */
+		if(!pbg_paths_init(e, err, 1, pbg_hash) || !pbg_hashes_init(e, err, pbg_hash))
+			pbg_free(e);
+	}
+	if(msg != NULL)
+		pbg_err_syntax(err, __LINE__, __FILE__, NULL, p->_pos, i, msg);
+	pbg_parser_reset(p);
+}
+
+void pbg_parser_free(pbg_parser* p)
+{
+	pbg_parser_reset(p);
+	free(p->_groups);
+	free(p->_children);
+	free(p->_tok);
+	free(p->_scratch);
+	p->_groups = p->_children = p->_scratch = NULL;
+	p->_tok = NULL;
+	p->_groupcap = p->_childcap = p->_tokcap = p->_scratchcap = 0;
+}
+
+/**********************
+ *                    *
+ * EXPRESSION BUILDER *
+ *                    *
+ **********************/
+
+/**
+ * Takes the offset of the next call. Once the parser would have stopped 
+ * reading, has failed, or is left in an unclosed STRING or VAR, calls are 
+ * ignored.
+ * @param b  Builder being called.
+ * @return the offset of the call, -1 if it is to be ignored.
+ */
+int pbg_builder_next(pbg_builder* b)
+{
+	if(b->_stopped >= 0 || b->_fail._type != PBG_ERR_NONE || 
+			b->_state != PBG_PARSER_NONE)
+		return -1;
+	if(b->_pos == INT_MAX) {
+		pbg_err_limit(&b->_fail, __LINE__, __FILE__, "Expression is too long.");
+		return -1;
+	}
+	return b->_pos++;
+}
+
+/**
+ * Adds a literal, copying its data into a new field. STRINGs and VARs are 
+ * stored as they would be written, so their closing character is escaped. 
+ * Data ending in a backslash would escape the closing character itself, so the 
+ * literal is left unclosed, as in the text the calls spell out.
+ * @param b      Builder to add to.
+ * @param type   Type of the literal.
+ * @param src    Data of the literal, or NULL.
+ * @param n      Size of the data.
+ * @param close  Character to escape, or '\0' to copy the data as is.
+ */
+void pbg_builder_add(pbg_builder* b, pbg_field_type type, void* src, int n, 
+		char close)
+{
+	int start, size, i;
+	char* data;
+	if((start = pbg_builder_next(b)) < 0)
+		return;
+	if(close != '\0' && n > 0 && ((char*) src)[n-1] == '\\') {
+		b->_state = (close == ']') ? PBG_PARSER_VAR : PBG_PARSER_STRING;
+		b->_tokstart = start;
+		return;
+	}
+	if(!pbg_parser_building(b)) {
+		pbg_parser_next(b, type, start);
+		return;
+	}
+	size = n;
+	for(i = 0; close != '\0' && i < n; i++)
+		if(((char*) src)[i] == close && size++ == INT_MAX) {
+			pbg_parser_next(b, type, start);
+			pbg_err_limit(&b->_fail, __LINE__, __FILE__, "Literal is too long.");
+			return;
+		}
+	data = NULL;
+	if(size > 0 && (data = (char*) malloc(size)) == NULL) {
+		pbg_parser_next(b, type, start);
+		pbg_parser_fail(b);
+		return;
+	}
+	for(i = size = 0; i < n; i++) {
+		if(close != '\0' && ((char*) src)[i] == close) data[size++] = '\\';
+		data[size++] = ((char*) src)[i];
+	}
+	pbg_parser_literal(b, pbg_field_init(type, size, data), start);
+}
+
+void pbg_builder_op(pbg_builder* b, pbg_field_type type)
+{
+	int start;
+	char* name;
+	if((start = pbg_builder_next(b)) < 0)
+		return;
+	pbg_parser_group(b, '(', start);
+	if(pbg_type_isop(type)) {
+		pbg_parser_op(b, type, start);
+		return;
+	}
+	name = pbg_field_type_str(type);
+	pbg_parser_unknown(b, name, strlen(name), start);
+}
+
+void pbg_builder_end(pbg_builder* b)
+{
+	int start;
+	if((start = pbg_builder_next(b)) >= 0)
+		pbg_parser_group(b, ')', start);
+}
+
+void pbg_builder_var(pbg_builder* b, char* name, int n) {
+	pbg_builder_add(b, PBG_LT_VAR, name, n, ']');
+}
+
+void pbg_builder_number(pbg_builder* b, double value)
+{
+	pbg_lt_number number;
+	number._val = value;
+	pbg_builder_add(b, PBG_LT_NUMBER, &number, sizeof(pbg_lt_number), '\0');
+}
+
+void pbg_builder_date(pbg_builder* b, int year, int month, int day)
+{
+	int start;
+	char text[40];
+	pbg_lt_date date;
+	/* Only DATEs that can be written as YYYY-MM-DD are DATEs. */
+	if(year < 0 || year > 9999 || month < 0 || month > 99 || day < 0 || day > 99) {
+		if((start = pbg_builder_next(b)) < 0)
+			return;
+		sprintf(text, "%04d-%02d-%02d", year, month, day);
+		pbg_parser_unknown(b, text, strlen(text), start);
+		return;
+	}
+	date._YYYY = year;
+	date._MM = month;
+	date._DD = day;
+	pbg_builder_add(b, PBG_LT_DATE, &date, sizeof(pbg_lt_date), '\0');
+}
+
+void pbg_builder_string(pbg_builder* b, char* str, int n) {
+	pbg_builder_add(b, PBG_LT_STRING, str, n, '\'');
+}
+
+void pbg_builder_bool(pbg_builder* b, int truth) {
+	pbg_builder_add(b, truth ? PBG_LT_TRUE : PBG_LT_FALSE, NULL, 0, '\0');
+}
+
+void pbg_builder_type(pbg_builder* b, pbg_field_type type)
+{
+	int start;
+	char* name;
+	if(type > PBG_MIN_LT_TP && type < PBG_MAX_LT_TP) {
+		pbg_builder_add(b, type, NULL, 0, '\0');
+		return;
+	}
+	if((start = pbg_builder_next(b)) < 0)
+		return;
+	name = pbg_field_type_str(type);
+	pbg_parser_unknown(b, name, strlen(name), start);
+}
+
+void pbg_builder_finish(pbg_builder* b, pbg_expr* e, pbg_error* err) {
+	pbg_parser_finish(b, e, err);
+}
+
+/*********************
+ *                   *
+ * VAR NAME TOOLKIT  *
+ *                   *
+ *********************/
+
+/**
+ * Checks if the character of a VAR name at the given index splits the name.
+ * @param name  VAR name, as written.
+ * @param j     Index of the character.
+ * @return 1 if it is an unescaped '.', 0 otherwise.
+ */
+int pbg_path_split(char* name, int j) {
+	return name[j] == '.' && (j == 0 || name[j-1] != '\\');
+}
+
+unsigned long pbg_hash(char* str, int n)
+{
+	int i;
+	unsigned long hash;
+#if ULONG_MAX > 0xFFFFFFFFUL
+	/* 64-bit FNV-1a. */
+	hash = 14695981039346656037UL;
+	for(i = 0; i < n; i++) {
+		hash ^= (unsigned char) str[i];
+		hash *= 1099511628211UL;
+	}
+#else
+	/* 32-bit FNV-1a. */
+	hash = 2166136261UL;
+	for(i = 0; i < n; i++) {
+		hash ^= (unsigned char) str[i];
+		hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+	}
+#endif
+	return hash;
+}
+
+/**
+ * Gets the split and hashed VAR names of the expression, which starts out
+ * with neither once it has some.
+ * @param e    PBG expression whose VAR names to get.
+ * @param err  Used to store error, if any.
+ * @return the VAR names if successful, NULL otherwise.
+ */
+pbg_names* pbg_names_get(pbg_expr* e, pbg_error* err)
+{
+	pbg_names* names;
+	if(e->_names != NULL)
+		return (pbg_names*) e->_names;
+	names = (pbg_names*) malloc(sizeof(pbg_names));
+	if(names == NULL) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return NULL;
+	}
+	names->_segments = NULL;
+	names->_numsegments = 0;
+	names->_path = NULL;
+	names->_starts = NULL;
+	names->_hashes = NULL;
+	names->_hashfn = NULL;
+	names->_segfn = NULL;
+	e->_names = names;
+	return names;
+}
+
+/**
+ * Splits every VAR name of the expression on '.', interns the segments, and
+ * hashes them with the given function.
+ * @param e       PBG expression whose VARs to split. Any split already made is
+ *                kept, and only hashed again if fn differs.
+ * @param err     Used to store error, if any.
+ * @param dotted  1 to split only if some name has a '.', 0 to always split.
+ * @param fn      Hash function of the segments.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_paths_init(pbg_expr* e, pbg_error* err, int dotted, pbg_hash_fn fn)
+{
+	int i, j, k, n, start, size, slot, *table;
+	long total;
+	char* name;
+	unsigned long hash;
+	pbg_names* names;
+	pbg_segment* seg;
+	
+	if(e->_numvars == 0)
+		return 1;
+	names = (pbg_names*) e->_names;
+	if(names != NULL && names->_segments != NULL) {
+		if(names->_segfn != fn) {
+			for(i = 0; i < names->_numsegments; i++)
+				names->_segments[i]._hash = fn(names->_segments[i]._str, 
+						names->_segments[i]._n);
+			names->_segfn = fn;
+		}
+		return 1;
+	}
+	
+	/* Count segments. Each name has one more than it has splits. */
+	total = e->_numvars;
+	for(i = 0; i < e->_numvars; i++) {
+		name = (char*) e->_variables[i]._data;
+		for(j = 0; j < e->_variables[i]._int; j++)
+			total += pbg_path_split(name, j);
+	}
+	if(dotted && total == e->_numvars)
+		return 1;
+	if(total > INT_MAX/4) {
+		pbg_err_limit(err, __LINE__, __FILE__, "Too many VAR segments.");
+		return 0;
+	}
+	if((names = pbg_names_get(e, err)) == NULL)
+		return 0;
+	
+	/* Allocate everything up front. The table is at most half full. */
+	for(size = 2; size < 2*total; size *= 2);
+	table = (int*) calloc(size, sizeof(int));
+	names->_segments = (pbg_segment*) malloc(total * sizeof(pbg_segment));
+	names->_path = (pbg_segment**) malloc(total * sizeof(pbg_segment*));
+	names->_starts = (int*) malloc((e->_numvars+1) * sizeof(int));
+	if(table == NULL || names->_segments == NULL || names->_path == NULL || 
+			names->_starts == NULL) {
+		free(table);
+		free(names->_segments);
+		free(names->_path);
+		free(names->_starts);
+		names->_segments = NULL;
+		names->_path = NULL;
+		names->_starts = NULL;
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return 0;
+	}
+	
+	/* Split each name, looking every segment up in the table. */
+	names->_numsegments = 0;
+	for(i = k = 0; i < e->_numvars; i++) {
+		name = (char*) e->_variables[i]._data;
+		n = e->_variables[i]._int;
+		names->_starts[i] = k;
+		for(start = j = 0; j <= n; j++) {
+			if(j < n && !pbg_path_split(name, j))
+				continue;
+			hash = fn(name+start, j-start);
+			for(slot = hash & (size-1); table[slot] != 0; slot = (slot+1) & (size-1)) {
+				seg = names->_segments + table[slot]-1;
+				if(seg->_hash == hash && seg->_n == j-start && 
+						memcmp(seg->_str, name+start, j-start) == 0)
+					break;
+			}
+			/* It's a new segment! */
+			if(table[slot] == 0) {
+				seg = names->_segments + names->_numsegments++;
+				seg->_str = name+start;
+				seg->_n = j-start;
+				seg->_hash = hash;
+				table[slot] = names->_numsegments;
+			}
+			names->_path[k++] = names->_segments + table[slot]-1;
+			start = j+1;
+		}
+	}
+	names->_starts[e->_numvars] = k;
+	names->_segfn = fn;
+	free(table);
+	return 1;
+}
+
+/**
+ * Hashes every VAR name of the expression with the given function. Hashes
+ * already made with the same function are kept.
+ * @param e    PBG expression whose VAR names to hash.
+ * @param err  Used to store error, if any.
+ * @param fn   Hash function to use.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_hashes_init(pbg_expr* e, pbg_error* err, pbg_hash_fn fn)
+{
+	int i;
+	pbg_names* names;
+	if(e->_numvars == 0)
+		return 1;
+	if((names = pbg_names_get(e, err)) == NULL)
+		return 0;
+	if(names->_hashes != NULL && names->_hashfn == fn)
+		return 1;
+	if(names->_hashes == NULL) {
+		names->_hashes = (unsigned long*) malloc(e->_numvars * sizeof(unsigned long));
+		if(names->_hashes == NULL) {
+			pbg_err_alloc(err, __LINE__, __FILE__);
+			return 0;
+		}
+	}
+	for(i = 0; i < e->_numvars; i++)
+		names->_hashes[i] = fn((char*) e->_variables[i]._data, e->_variables[i]._int);
+	names->_hashfn = fn;
+	return 1;
+}
+
+/****************************
+ *                          *
+ * FIELD EVALUATION TOOLKIT *
+ *                          *
+ ****************************/
+
+int pbg_evaluate_op_not(pbg_expr* e, pbg_error* err, pbg_field* field)
+{
+	int child0, result;
+	child0 = ((int*)field->_data)[0];
+	result = pbg_evaluate_r(e, err, pbg_field_get(e, child0));
+	if(result == PBG_ERROR) return PBG_ERROR;  /* Pass error through. */
+	return result == PBG_TRUE ? PBG_FALSE : PBG_TRUE;
+}
+
+int pbg_evaluate_op_and(pbg_expr* e, pbg_error* err, pbg_field* field)
+{
+	int i, size, childi, result;
+	size = field->_int;
+	for(i = 0; i < size; i++) {
+		childi = ((int*)field->_data)[i];
+		result = pbg_evaluate_r(e, err, pbg_field_get(e, childi));
+		if(result == PBG_ERROR) return PBG_ERROR;  /* Pass error through. */
+		if(result == PBG_FALSE) return PBG_FALSE;
+	}
+	return PBG_TRUE;
+}
+
+int pbg_evaluate_op_or(pbg_expr* e, pbg_error* err, pbg_field* field)
+{
+	int i, childi, result;
+	for(i = 0; i < field->_int; i++) {
+		childi = ((int*)field->_data)[i];
+		result = pbg_evaluate_r(e, err, pbg_field_get(e, childi));
+		if(result == PBG_ERROR) return PBG_ERROR;  /* Pass error through. */
+		if(result == PBG_TRUE)  return PBG_TRUE;
+	}
+	return PBG_FALSE;
+}
+
+int pbg_evaluate_op_exst(pbg_expr* e, pbg_error* err, pbg_field* field)
+{
+	int i, childi;
+	PBG_UNUSED(err);
+	for(i = 0; i < field->_int; i++) {
+		childi = ((int*)field->_data)[i];
+		if(pbg_field_get(e, childi)->_type == PBG_NULL)
+			return PBG_FALSE;
+	}
+	return PBG_TRUE;
+}
+
+int pbg_evaluate_op_eq(pbg_expr* e, pbg_error* err, pbg_field* field)
+{
+	int i, child0, childi, result;
+	pbg_field* c0, *ci;
+	PBG_UNUSED(err);
+	/* Ensure type and size of all children are identical. */
+	child0 = ((int*)field->_data)[0];
+	c0 = pbg_field_get(e, child0);
+	if(c0->_type == PBG_NULL) {
+		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
+				"NULL input given to EQ operator.");
+		return PBG_ERROR;
+	}
+	/* We have a bunch of BOOLs! Evaluate them. */
+	if(pbg_type_isbool(c0->_type)) {
+		result = pbg_evaluate_r(e, err, c0);
+		for(i = 1; i < field->_int; i++) {
+			childi = ((int*)field->_data)[i];
+			ci = pbg_field_get(e, childi);
+			if(ci->_type == PBG_NULL) {
+				pbg_err_op_arg_type(err, __LINE__, __FILE__, 
+						"NULL input given to EQ operator.");
+				return PBG_ERROR;
+			}
+			if(result != pbg_evaluate_r(e, err, ci))
+				return PBG_FALSE;
+		}
+		return PBG_TRUE;
+	/* We don't have a bunch of BOOLs! Do standard equality test. */
+	}else{
+		for(i = 1; i < field->_int; i++) {
+			childi = ((int*)field->_data)[i];
+			ci = pbg_field_get(e, childi);
+			if(ci->_type == PBG_NULL) {
+				pbg_err_op_arg_type(err, __LINE__, __FILE__, 
+						"NULL input given to EQ operator.");
+				return PBG_ERROR;
+			}
+			if(ci->_int != c0->_int || 
+					ci->_type != c0->_type)
+				return PBG_FALSE;
+			/* Ensure each data byte is identical. */
+			if(memcmp(ci->_data, c0->_data, c0->_int) != 0)
+				return PBG_FALSE;
+		}
+		return PBG_TRUE;
+	}
+}
+
+int pbg_evaluate_op_neq(pbg_expr* e, pbg_error* err, pbg_field* field)
+{
+	int child0, child1;
+	pbg_field* c0, *c1;
+	PBG_UNUSED(err);
+	child0 = ((int*)field->_data)[0], child1 = ((int*)field->_data)[1];
+	c0 = pbg_field_get(e, child0), c1 = pbg_field_get(e, child1);
+	if(c0->_type == PBG_NULL || c1->_type == PBG_NULL) {
+		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
+				"NULL input given to NEQ operator.");
+		return PBG_ERROR;
+	}
+	/* We have two BOOLs! Evaluate them, and check if they are different. */
+	if(pbg_type_isbool(c0->_type) && pbg_type_isbool(c1->_type))
+		return (pbg_evaluate_r(e, err, c0) != pbg_evaluate_r(e, err, c1)) ? 
+			PBG_TRUE : PBG_FALSE;
+	/* We don't have a bunch of BOOLs! Do standard difference check. */
+	else return (c1->_type != c0->_type || c1->_int != c0->_int || 
+			memcmp(c1->_data, c0->_data, c0->_int)) ? PBG_TRUE : PBG_FALSE;
+}
+
+int pbg_evaluate_op_order(pbg_expr* e, pbg_error* err, pbg_field* field)
+{
+	int result;
+	int child0, child1;
+	pbg_field* c0, *c1;
+	child0 = ((int*)field->_data)[0], child1 = ((int*)field->_data)[1];
+	c0 = pbg_field_get(e, child0), c1 = pbg_field_get(e, child1);
+	if(c0->_type == PBG_NULL || c1->_type == PBG_NULL) {
+		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
+				"NULL input given to comparison operator.");
+		return PBG_ERROR;
+	}
+	result = -2;
+	/* Both are NUMBERs. */
+	if(c0->_type == PBG_LT_NUMBER &&
+			c1->_type == PBG_LT_NUMBER)
+		result = pbg_cmpnumber(c0->_data, c1->_data);
+	/* Both are DATEs. */
+	if(c0->_type == PBG_LT_DATE &&
+			c1->_type == PBG_LT_DATE)
+		result = pbg_cmpdate(c0->_data, c1->_data);
+	/* Both are STRINGs. */
+	if(c0->_type == PBG_LT_STRING &&
+			c1->_type == PBG_LT_STRING)
+		result = pbg_cmpstring(c0->_data, c0->_int, c1->_data, c1->_int);
+	/* Both are BOOLs. */
+	if(pbg_type_isbool(c0->_type) && pbg_type_isbool(c1->_type))
+		result = pbg_evaluate_r(e, err, c0) - pbg_evaluate_r(e, err, c1);
+	/* Check if mismatched or invalid types. */
+	if(result == -2) {
+		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
+				"Unknown input type to comparison operator");
+		return PBG_ERROR;
+	/* Compare results according to type of comparison operator. */
+	}else{
+		if(field->_type == PBG_OP_LT) return result < 0 ? PBG_TRUE : PBG_FALSE;
+		if(field->_type == PBG_OP_GT) return result > 0 ? PBG_TRUE : PBG_FALSE;
+		if(field->_type == PBG_OP_LTE) return result <= 0 ? PBG_TRUE : PBG_FALSE;
+		if(field->_type == PBG_OP_GTE) return result >= 0 ? PBG_TRUE : PBG_FALSE;
+		pbg_err_state(err, __LINE__, __FILE__, 
+				"Unknown result from select comparison function.");
+		return PBG_ERROR;
+	}
+}
+
+int pbg_evaluate_op_type(pbg_expr* e, pbg_error* err, pbg_field* field)
+{
+	int i, child0, childi;
+	pbg_field* c0, *ci;
+	pbg_field_type type;
+	child0 = ((int*)field->_data)[0];
+	c0 = pbg_field_get(e, child0);
+	type = c0->_type;
+	/* Ensure the first argument is a type literal. */
+	if(type < PBG_MIN_LT_TP || type > PBG_MAX_LT_TP) {
+		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
+				"First input to TYPE operator must be a type literal.");
+		return PBG_ERROR;
+	}
+	/* Verify types of all trailing arguments. */
+	for(i = 1; i < field->_int; i++) {
+		childi = ((int*)field->_data)[i];
+		ci = pbg_field_get(e, childi);
+		if(!pbg_type_istype(type, ci->_type))
+			return PBG_FALSE;
+	}
+	return PBG_TRUE;
+}
+
+int pbg_evaluate_r(pbg_expr* e, pbg_error* err, pbg_field* field)
+{
+	/* Subtrees of lazy expressions are built when first reached. */
+	if(field->_type == PBG_LAZY)
+		return pbg_lazy_run(err, field);
+	if(pbg_type_isbool(field->_type)) {
+		switch(field->_type) {
+			case PBG_OP_NOT:   return pbg_evaluate_op_not(e, err, field);
+			case PBG_OP_AND:   return pbg_evaluate_op_and(e, err, field);
+			case PBG_OP_OR:    return pbg_evaluate_op_or(e, err, field);
+			case PBG_OP_EXST:  return pbg_evaluate_op_exst(e, err, field);
+			case PBG_OP_EQ:    return pbg_evaluate_op_eq(e, err, field);
+			case PBG_OP_NEQ:   return pbg_evaluate_op_neq(e, err, field);
+			case PBG_OP_LT:
+			case PBG_OP_GT:
+			case PBG_OP_LTE:
+			case PBG_OP_GTE:   return pbg_evaluate_op_order(e, err, field);
+			case PBG_OP_TYPE:  return pbg_evaluate_op_type(e, err, field);
+			case PBG_LT_TRUE:  return PBG_TRUE;
+			case PBG_LT_FALSE: return PBG_FALSE;
+			default: pbg_err_state(err, __LINE__, __FILE__,
+							"Unsupported operation.");
+		}
+	}
+	pbg_err_state(err, __LINE__, __FILE__, 
+			"Cannot evaluate a non-BOOL value.");
+	return PBG_ERROR;
+}
+
+/**
+ * Adapts a plain dictionary function to the pbg_dict interface.
+ * @param ctx  Pointer to a pbg_dict_fn.
+ * @param key  VAR name to resolve.
+ * @param n    Length of key.
+ * @return the field returned by the plain dictionary.
+ */
+pbg_field pbg_dict_fn_get(void* ctx, char* key, int n) {
+	return ((pbg_dict_fn*) ctx)->_fn(key, n);
+}
+
+int pbg_evaluate(pbg_expr* e, pbg_error* err, pbg_field (*dict)(char*, int))
+{
+	pbg_dict_fn fn;
+	pbg_dict wrapper;
+	fn._fn = dict;
+	wrapper._get = pbg_dict_fn_get;
+	wrapper._release = NULL;
+	wrapper._ctx = &fn;
+	wrapper._get_path = NULL;
+	wrapper._get_hashed = NULL;
+	wrapper._hash = NULL;
+	return pbg_evaluate_dict(e, err, &wrapper);
+}
+
+int pbg_evaluate_dict(pbg_expr* e, pbg_error* err, pbg_dict* dict)
+{
+	int i, result;
+	pbg_field* newvars, *var, *oldvars;
+	pbg_names* names;
+	pbg_hash_fn hash;
+	
+	/* Always start with a clean error! */
+	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	
+	/* An expression that was never parsed, or was freed, has no fields. */
+	if(e->_numconst == 0) {
+		pbg_err_state(err, __LINE__, __FILE__, "Expression was not parsed.");
+		return PBG_ERROR;
+	}
+	
+	/* Variable resolution. Lookup every variable in provided dictionary. */
+	newvars = (pbg_field*) malloc(e->_numvars * sizeof(pbg_field));
+	if(newvars == NULL) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return PBG_ERROR;
+	}
+	/* Names are split and hashed once, and kept with the expression. */
+	hash = (dict->_hash != NULL) ? dict->_hash : pbg_hash;
+	if((dict->_get_path != NULL && !pbg_paths_init(e, err, 0, hash)) || 
+			(dict->_get_hashed != NULL && !pbg_hashes_init(e, err, hash))) {
+		free(newvars);
+		return PBG_ERROR;
+	}
+	names = (pbg_names*) e->_names;
+	for(i = 0; i < e->_numvars; i++) {
+		var = e->_variables+i;
+		if(dict->_get_path != NULL)
+			newvars[i] = dict->_get_path(dict->_ctx, names->_path+names->_starts[i], 
+					names->_starts[i+1] - names->_starts[i]);
+		else if(dict->_get_hashed != NULL)
+			newvars[i] = dict->_get_hashed(dict->_ctx, (char*)(var->_data), var->_int, 
+					names->_hashes[i]);
+		else
+			newvars[i] = dict->_get(dict->_ctx, (char*)(var->_data), var->_int);
+	}
+	
+	/* Swap out variable literals with dictionary equivalents. */
+	oldvars = e->_variables;
+	e->_variables = newvars;
+	
+	/* Evaluate expression! Use the compiled program if there is one. */
+	if(e->_program != NULL) {
+		result = pbg_run_r(e, err, e->_program, 
+				((pbg_program*) e->_program)->_nodes);
+	}else
+		result = pbg_evaluate_r(e, err, e->_constants);
+	
+	/* Restore old variable literal array. */
+	e->_variables = oldvars;
+	
+	/* Recompiling compares VARs by name, so it needs the literals back. */
+	if(e->_program != NULL)
+		pbg_program_step(e, e->_program);
+	
+	/* Hand resolved fields back to the dictionary, or free them. */
+	for(i = 0; i < e->_numvars; i++)
+		if(dict->_release != NULL)
+			dict->_release(dict->_ctx, newvars+i);
+		else
+			pbg_field_free(newvars+i);
+	free(newvars);
+	
+	/* Done! */
+	return result;
+}
+
+
+
+/***************************
+ *                         *
+ * TEXT EVALUATION TOOLKIT *
+ *                         *
+ ***************************/
+
+/* These functions evaluate an expression straight from its text, which must 
+ * have passed pbg_validate. Each mirrors its counterpart in the FIELD 
+ * EVALUATION TOOLKIT, so results and errors are the same, but fields are read
+ * from the text as they are needed and never stored. */
+
+/**
+ * Skips whitespace.
+ * @param t  Text being evaluated.
+ * @param i  Index to start at.
+ * @return the index of the next character that is not whitespace.
+ */
+int pbg_text_skip(pbg_text* t, int i)
+{
+	while(i < t->_n && pbg_iswhitespace(t->_str[i])) i++;
+	return i;
+}
+
+/**
+ * Finds the first argument of an operator.
+ * @param t  Text being evaluated.
+ * @param f  Operator just read from the text.
+ * @return the index of its first argument.
+ */
+int pbg_text_first(pbg_text* t, pbg_text_field* f) {
+	return pbg_text_skip(t, f->_stop);
+}
+
+/**
+ * Finds the argument after the given one. Only the text of the argument that 
+ * was not read, e.g. arguments its operator did not need, is passed over, by
+ * matching parentheses without looking into its fields.
+ * @param t  Text being evaluated.
+ * @param f  Argument read from the text.
+ * @return the index of the next argument, 
+ *         the index of the closing parenthesis if there is none.
+ */
+int pbg_text_next(pbg_text* t, pbg_text_field* f)
+{
+	int i, depth;
+	i = f->_stop;
+	for(depth = f->_open; depth > 0 && i < t->_n; i++) {
+		if(pbg_iswhitespace(t->_str[i])) continue;
+		if(t->_str[i] == '(') depth++;
+		else if(t->_str[i] == ')') depth--;
+		else i = pbg_parse_skip(t->_str, t->_n, i);
+	}
+	return pbg_text_skip(t, i);
+}
+
+/**
+ * Records how far an operator read its group.
+ * @param t  Text being evaluated.
+ * @param f  Operator being evaluated.
+ * @param i  Index of the next argument it did not read, or of its closing 
+ *           parenthesis.
+ */
+void pbg_text_read(pbg_text* t, pbg_text_field* f, int i)
+{
+	f->_stop = (t->_str[i] == ')') ? i+1 : i;
+	f->_open = (t->_str[i] == ')') ? 0 : 1;
+}
+
+/**
+ * Reads the argument starting at the given index. A literal is made into a
+ * field as pbg_parse_n would make it, but its data is kept in f or left in the
+ * text. A VAR is resolved with the dictionary. A group is read as the type of
+ * its operator.
+ * @param t  Text being evaluated.
+ * @param f  Set to the argument.
+ * @param i  Index of the argument.
+ */
+void pbg_text_load(pbg_text* t, pbg_text_field* f, int i)
+{
+	int end, len;
+	pbg_field_type type;
+	char* str;
+	f->_i = i;
+	f->_resolved = 0;
+	f->_open = 0;
+	/* It's a group! Read its operator. */
+	if(t->_str[i] == '(') {
+		i = pbg_text_skip(t, i+1);
+		f->_open = 1;
+	}
+	str = t->_str+i;
+	end = pbg_parse_skip(t->_str, t->_n, i);
+	len = end-i+1;
+	f->_stop = end+1;
+	type = pbg_gettype(str, len);
+	switch(type) {
+		case PBG_LT_VAR:
+			f->_field = t->_dict->_get(t->_dict->_ctx, str+1, len-2);
+			f->_resolved = 1;
+			break;
+		case PBG_LT_NUMBER:
+			pbg_tonumber(&f->_number, str, len);
+			f->_field = pbg_field_init(type, sizeof(pbg_lt_number), &f->_number);
+			break;
+		case PBG_LT_DATE:
+			memset(&f->_date, 0, sizeof(pbg_lt_date));
+			pbg_todate(&f->_date, str, len);
+			f->_field = pbg_field_init(type, sizeof(pbg_lt_date), &f->_date);
+			break;
+		case PBG_LT_STRING:
+			f->_field = pbg_field_init(type, (len-2) * sizeof(pbg_lt_string), str+1);
+			break;
+		default:
+			f->_field = pbg_field_init(type, 0, NULL);
+			break;
+	}
+}
+
+/**
+ * Hands a resolved VAR back to the dictionary, or frees it.
+ * @param t  Text being evaluated.
+ * @param f  Argument read with pbg_text_load.
+ */
+void pbg_text_release(pbg_text* t, pbg_text_field* f)
+{
+	if(!f->_resolved)
+		return;
+	if(t->_dict->_release != NULL)
+		t->_dict->_release(t->_dict->_ctx, &f->_field);
+	else
+		pbg_field_free(&f->_field);
+	f->_resolved = 0;
+}
+
+int pbg_text_op_not(pbg_text* t, pbg_error* err, pbg_text_field* f)
+{
+	int result;
+	pbg_text_field c0;
+	pbg_text_load(t, &c0, pbg_text_first(t, f));
+	result = pbg_text_r(t, err, &c0);
+	pbg_text_release(t, &c0);
+	pbg_text_read(t, f, pbg_text_next(t, &c0));
+	if(result == PBG_ERROR) return PBG_ERROR;  /* Pass error through. */
+	return result == PBG_TRUE ? PBG_FALSE : PBG_TRUE;
+}
+
+int pbg_text_op_and(pbg_text* t, pbg_error* err, pbg_text_field* f)
+{
+	int i, result;
+	pbg_text_field ci;
+	result = PBG_TRUE;
+	for(i = pbg_text_first(t, f); t->_str[i] != ')' && result == PBG_TRUE; 
+			i = pbg_text_next(t, &ci)) {
+		pbg_text_load(t, &ci, i);
+		result = pbg_text_r(t, err, &ci);
+		pbg_text_release(t, &ci);
+	}
+	pbg_text_read(t, f, i);
+	return result;
+}
+
+int pbg_text_op_or(pbg_text* t, pbg_error* err, pbg_text_field* f)
+{
+	int i, result;
+	pbg_text_field ci;
+	result = PBG_FALSE;
+	for(i = pbg_text_first(t, f); t->_str[i] != ')' && result == PBG_FALSE; 
+			i = pbg_text_next(t, &ci)) {
+		pbg_text_load(t, &ci, i);
+		result = pbg_text_r(t, err, &ci);
+		pbg_text_release(t, &ci);
+	}
+	pbg_text_read(t, f, i);
+	return result;
+}
+
+int pbg_text_op_exst(pbg_text* t, pbg_error* err, pbg_text_field* f)
+{
+	int i, output;
+	pbg_text_field ci;
+	PBG_UNUSED(err);
+	output = PBG_TRUE;
+	for(i = pbg_text_first(t, f); t->_str[i] != ')' && output == PBG_TRUE; 
+			i = pbg_text_next(t, &ci)) {
+		pbg_text_load(t, &ci, i);
+		if(ci._field._type == PBG_NULL)
+			output = PBG_FALSE;
+		pbg_text_release(t, &ci);
+	}
+	pbg_text_read(t, f, i);
+	return output;
+}
+
+int pbg_text_op_eq(pbg_text* t, pbg_error* err, pbg_text_field* f)
+{
+	int i, result, output;
+	pbg_text_field c0, ci;
+	pbg_field* f0, *fi;
+	pbg_text_load(t, &c0, pbg_text_first(t, f));
+	f0 = &c0._field;
+	/* Ensure type and size of all children are identical. */
+	output = PBG_TRUE;
+	result = PBG_FALSE;
+	if(f0->_type == PBG_NULL) {
+		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
+				"NULL input given to EQ operator.");
+		output = PBG_ERROR;
+	/* We have a bunch of BOOLs! Evaluate them. */
+	}else if(pbg_type_isbool(f0->_type))
+		result = pbg_text_r(t, err, &c0);
+	for(i = pbg_text_next(t, &c0); t->_str[i] != ')' && output == PBG_TRUE; 
+			i = pbg_text_next(t, &ci)) {
+		pbg_text_load(t, &ci, i);
+		fi = &ci._field;
+		if(fi->_type == PBG_NULL) {
+			pbg_err_op_arg_type(err, __LINE__, __FILE__, 
+					"NULL input given to EQ operator.");
+			output = PBG_ERROR;
+		}else if(pbg_type_isbool(f0->_type)) {
+			if(result != pbg_text_r(t, err, &ci))
+				output = PBG_FALSE;
+		/* We don't have a bunch of BOOLs! Do standard equality test. */
+		}else if(fi->_int != f0->_int || fi->_type != f0->_type)
+			output = PBG_FALSE;
+		/* Ensure each data byte is identical. */
+		else if(memcmp(fi->_data, f0->_data, f0->_int) != 0)
+			output = PBG_FALSE;
+		pbg_text_release(t, &ci);
+	}
+	pbg_text_release(t, &c0);
+	pbg_text_read(t, f, i);
+	return output;
+}
+
+/**
+ * Reads the two arguments of NEQ or an order, evaluating the first before the
+ * second is found if it is a BOOL, so that its text is read once. Its result
+ * and error are only used if the second is a BOOL too.
+ * @param t     Text being evaluated.
+ * @param f     Operator being evaluated.
+ * @param c0    Set to the first argument.
+ * @param c1    Set to the second argument.
+ * @param r0    Set to the result of the first argument, if it is a BOOL.
+ * @param err0  Set to the error of the first argument, if any. It must be 
+ *              freed.
+ */
+void pbg_text_pair(pbg_text* t, pbg_text_field* f, pbg_text_field* c0, 
+		pbg_text_field* c1, int* r0, pbg_error* err0)
+{
+	pbg_err_init(err0, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	*r0 = PBG_ERROR;
+	pbg_text_load(t, c0, pbg_text_first(t, f));
+	if(pbg_type_isbool(c0->_field._type))
+		*r0 = pbg_text_r(t, err0, c0);
+	pbg_text_load(t, c1, pbg_text_next(t, c0));
+	pbg_text_read(t, f, pbg_text_next(t, c1));
+}
+
+int pbg_text_op_neq(pbg_text* t, pbg_error* err, pbg_text_field* f)
+{
+	int r0, output;
+	pbg_text_field c0, c1;
+	pbg_field* f0, *f1;
+	pbg_error err0;
+	pbg_text_pair(t, f, &c0, &c1, &r0, &err0);
+	f0 = &c0._field, f1 = &c1._field;
+	if(f0->_type == PBG_NULL || f1->_type == PBG_NULL) {
+		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
+				"NULL input given to NEQ operator.");
+		output = PBG_ERROR;
+	/* We have two BOOLs! Evaluate them, and check if they are different. */
+	}else if(pbg_type_isbool(f0->_type) && pbg_type_isbool(f1->_type)) {
+		if(err0._type != PBG_ERR_NONE) {
+			*err = err0;
+			pbg_err_init(&err0, PBG_ERR_NONE, 0, NULL, 0, NULL);
+		}
+		output = (r0 != pbg_text_r(t, err, &c1)) ? PBG_TRUE : PBG_FALSE;
+	/* We don't have a bunch of BOOLs! Do standard difference check. */
+	}else
+		output = (f1->_type != f0->_type || f1->_int != f0->_int || 
+				memcmp(f1->_data, f0->_data, f0->_int)) ? PBG_TRUE : PBG_FALSE;
+	pbg_error_free(&err0);
+	pbg_text_release(t, &c0);
+	pbg_text_release(t, &c1);
+	return output;
+}
+
+int pbg_text_op_order(pbg_text* t, pbg_error* err, pbg_text_field* f)
+{
+	int r0, result, output;
+	pbg_text_field c0, c1;
+	pbg_field* f0, *f1;
+	pbg_error err0;
+	pbg_text_pair(t, f, &c0, &c1, &r0, &err0);
+	f0 = &c0._field, f1 = &c1._field;
+	result = -2;
+	if(f0->_type == PBG_NULL || f1->_type == PBG_NULL) {
+		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
+				"NULL input given to comparison operator.");
+		pbg_error_free(&err0);
+		pbg_text_release(t, &c0);
+		pbg_text_release(t, &c1);
+		return PBG_ERROR;
+	}
+	/* Both are NUMBERs. */
+	if(f0->_type == PBG_LT_NUMBER && f1->_type == PBG_LT_NUMBER)
+		result = pbg_cmpnumber(f0->_data, f1->_data);
+	/* Both are DATEs. */
+	if(f0->_type == PBG_LT_DATE && f1->_type == PBG_LT_DATE)
+		result = pbg_cmpdate(f0->_data, f1->_data);
+	/* Both are STRINGs. */
+	if(f0->_type == PBG_LT_STRING && f1->_type == PBG_LT_STRING)
+		result = pbg_cmpstring(f0->_data, f0->_int, f1->_data, f1->_int);
+	/* Both are BOOLs. */
+	if(pbg_type_isbool(f0->_type) && pbg_type_isbool(f1->_type)) {
+		if(err0._type != PBG_ERR_NONE) {
+			*err = err0;
+			pbg_err_init(&err0, PBG_ERR_NONE, 0, NULL, 0, NULL);
+		}
+		result = r0 - pbg_text_r(t, err, &c1);
+	}
+	pbg_error_free(&err0);
+	pbg_text_release(t, &c0);
+	pbg_text_release(t, &c1);
+	/* Check if mismatched or invalid types. */
+	if(result == -2) {
+		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
+				"Unknown input type to comparison operator");
+		output = PBG_ERROR;
+	/* Compare results according to type of comparison operator. */
+	}else if(f->_field._type == PBG_OP_LT) output = result < 0;
+	else if(f->_field._type == PBG_OP_GT)  output = result > 0;
+	else if(f->_field._type == PBG_OP_LTE) output = result <= 0;
+	else                                   output = result >= 0;
+	return output;
+}
+
+int pbg_text_op_type(pbg_text* t, pbg_error* err, pbg_text_field* f)
+{
+	int i, output;
+	pbg_text_field c0, ci;
+	pbg_field_type type, itype;
+	pbg_text_load(t, &c0, pbg_text_first(t, f));
+	type = c0._field._type;
+	pbg_text_release(t, &c0);
+	/* Ensure the first argument is a type literal. */
+	if(type < PBG_MIN_LT_TP || type > PBG_MAX_LT_TP) {
+		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
+				"First input to TYPE operator must be a type literal.");
+		pbg_text_read(t, f, pbg_text_next(t, &c0));
+		return PBG_ERROR;
+	}
+	/* Verify types of all trailing arguments. */
+	output = PBG_TRUE;
+	for(i = pbg_text_next(t, &c0); t->_str[i] != ')' && output == PBG_TRUE; 
+			i = pbg_text_next(t, &ci)) {
+		pbg_text_load(t, &ci, i);
+		itype = ci._field._type;
+		pbg_text_release(t, &ci);
+		if(!pbg_type_istype(type, itype))
+			output = PBG_FALSE;
+	}
+	pbg_text_read(t, f, i);
+	return output;
+}
+
+int pbg_text_r(pbg_text* t, pbg_error* err, pbg_text_field* f)
+{
+	/* Only groups of the text have arguments to evaluate. */
+	if(pbg_type_isop(f->_field._type) && f->_resolved) {
+		pbg_err_state(err, __LINE__, __FILE__, "Unsupported operation.");
+		return PBG_ERROR;
+	}
+	if(pbg_type_isbool(f->_field._type)) {
+		switch(f->_field._type) {
+			case PBG_OP_NOT:   return pbg_text_op_not(t, err, f);
+			case PBG_OP_AND:   return pbg_text_op_and(t, err, f);
+			case PBG_OP_OR:    return pbg_text_op_or(t, err, f);
+			case PBG_OP_EXST:  return pbg_text_op_exst(t, err, f);
+			case PBG_OP_EQ:    return pbg_text_op_eq(t, err, f);
+			case PBG_OP_NEQ:   return pbg_text_op_neq(t, err, f);
+			case PBG_OP_LT:
+			case PBG_OP_GT:
+			case PBG_OP_LTE:
+			case PBG_OP_GTE:   return pbg_text_op_order(t, err, f);
+			case PBG_OP_TYPE:  return pbg_text_op_type(t, err, f);
+			case PBG_LT_TRUE:  return PBG_TRUE;
+			case PBG_LT_FALSE: return PBG_FALSE;
+			default: pbg_err_state(err, __LINE__, __FILE__,
+							"Unsupported operation.");
+		}
+	}
+	pbg_err_state(err, __LINE__, __FILE__, 
+			"Cannot evaluate a non-BOOL value.");
+	return PBG_ERROR;
+}
+
+int pbg_eval_text(pbg_error* err, char* str, int n, pbg_field (*dict)(char*, int))
+{
+	int result;
+	pbg_dict_fn fn;
+	pbg_dict wrapper;
+	pbg_text t;
+	pbg_text_field root;
+	
+	/* Report the same errors parsing would. Only the validation stack is 
+	 * allocated, and it is freed before evaluating. */
+	if(!pbg_validate(err, str, n))
+		return PBG_ERROR;
+	
+	fn._fn = dict;
+	wrapper._get = pbg_dict_fn_get;
+	wrapper._release = NULL;
+	wrapper._ctx = &fn;
+	wrapper._get_path = NULL;
+	wrapper._get_hashed = NULL;
+	wrapper._hash = NULL;
+	t._str = str;
+	t._n = n;
+	t._dict = &wrapper;
+	
+	/* The first field or group is the root, as it is when parsed. */
+	pbg_text_load(&t, &root, pbg_text_skip(&t, 0));
+	result = pbg_text_r(&t, err, &root);
+	pbg_text_release(&t, &root);
+	return result;
+}
+
+
+/***************************
+ *                         *
+ * LAZY EXPRESSION TOOLKIT *
+ *                         *
+ ***************************/
+
+/**
+ * Checks if the operator may have its subtrees left unbuilt. Only AND, OR, and
+ * NOT qualify, as they evaluate their arguments and never look at them 
+ * otherwise.
+ * @param type  Type of operator.
+ * @return 1 if its subtrees may be deferred, 0 otherwise.
+ */
+int pbg_lazy_defers(pbg_field_type type) {
+	return type == PBG_OP_AND || type == PBG_OP_OR || type == PBG_OP_NOT;
+}
+
+/**
+ * Indexes every group of the text, so building a subtree never reads the text
+ * of the groups it defers. The text must have passed pbg_validate.
+ * @param root  Lazy expression whose text to index.
+ * @return 1 if successful, 0 if the index could not be allocated.
+ */
+int pbg_lazy_index(pbg_lazy_root* root)
+{
+	int i, g, n, num, open, outer;
+	char* str;
+	pbg_lazy_group* groups;
+	str = root->_text._str;
+	n = root->_text._n;
+	
+	/* Count the groups. */
+	for(num = 0, i = 0; i < n; i++) {
+		if(pbg_iswhitespace(str[i]) || str[i] == ')') continue;
+		if(str[i] == '(') num++;
+		else i = pbg_parse_skip(str, n, i);
+	}
+	groups = (pbg_lazy_group*) malloc(num * sizeof(pbg_lazy_group));
+	if(num > 0 && groups == NULL)
+		return 0;
+	
+	/* Fill them in. While a group is open, its _end is the group it is in. */
+	for(g = 0, open = -1, i = 0; i < n; i++) {
+		if(pbg_iswhitespace(str[i])) continue;
+		if(str[i] == '(') {
+			if(open >= 0) groups[open]._argc++;
+			groups[g]._end = open;
+			groups[g]._argc = -1;  /* Its operator is no argument. */
+			open = g++;
+		}else if(str[i] == ')') {
+			outer = groups[open]._end;
+			groups[open]._end = i;
+			groups[open]._size = g - open;
+			open = outer;
+		}else{
+			if(open >= 0) groups[open]._argc++;
+			i = pbg_parse_skip(str, n, i);
+		}
+	}
+	root->_groups = groups;
+	return 1;
+}
+
+/**
+ * Finds the argument after the one at the given index. A group is passed over
+ * with the index of groups, without reading its text.
+ * @param root  Lazy expression being built.
+ * @param i     Index of an argument.
+ * @param g     Index in root->_groups of the argument if it is a group, or of
+ *              the next group otherwise. Moved past the groups it spans.
+ * @return the index of the next argument, 
+ *         the index of the closing parenthesis if there is none.
+ */
+int pbg_lazy_after(pbg_lazy_root* root, int i, int* g)
+{
+	pbg_text* t;
+	t = &root->_text;
+	if(t->_str[i] != '(')
+		return pbg_text_skip(t, pbg_parse_skip(t->_str, t->_n, i)+1);
+	i = root->_groups[*g]._end;
+	*g += root->_groups[*g]._size;
+	return pbg_text_skip(t, i+1);
+}
+
+/**
+ * Counts the fields that building the argument at the given index stores.
+ * @param root      Lazy expression being built.
+ * @param i         Index of the argument in the text.
+ * @param g         Index of the argument in root->_groups, if it is a group.
+ * @param level     Level of the argument below the subtree being built.
+ * @param defer     1 if the argument may be deferred.
+ * @param numconst  Incremented by the number of constants.
+ * @param numvars   Incremented by the number of VARs.
+ */
+void pbg_lazy_count_r(pbg_lazy_root* root, int i, int g, int level, int defer, 
+		int* numconst, int* numvars)
+{
+	pbg_text* t;
+	pbg_text_field op;
+	t = &root->_text;
+	if(t->_str[i] != '(') {
+		if(t->_str[i] == '[') (*numvars)++;
+		else (*numconst)++;
+		return;
+	}
+	/* A deferred group is a single field until it is reached. */
+	(*numconst)++;
+	if(defer && level >= root->_depth)
+		return;
+	pbg_text_load(t, &op, i);
+	defer = pbg_lazy_defers(op._field._type);
+	for(i = pbg_text_first(t, &op), g++; t->_str[i] != ')'; i = pbg_lazy_after(root, i, &g))
+		pbg_lazy_count_r(root, i, g, level+1, defer, numconst, numvars);
+}
+
+/**
+ * Builds the argument at the given index, storing fields in preorder as 
+ * pbg_parse_n does. Groups below the depth of the root are stored as a single
+ * PBG_LAZY field if their operator allows it.
+ * @param root   Lazy expression being built.
+ * @param e      Expression to store fields in.
+ * @param err    Used to store error, if any.
+ * @param i      Index of the argument in the text.
+ * @param g      Index of the argument in root->_groups, if it is a group.
+ * @param level  Level of the argument below the subtree being built.
+ * @param defer  1 if the argument may be deferred.
+ * @return the index of the argument's field if successful, 0 otherwise.
+ */
+int pbg_lazy_build_r(pbg_lazy_root* root, pbg_expr* e, pbg_error* err, 
+		int i, int g, int level, int defer)
+{
+	int id, cid, k, end;
+	int* children;
+	pbg_text* t;
+	pbg_text_field op;
+	pbg_field_type type;
+	pbg_lazy_node* node;
+	t = &root->_text;
+	/* It's a literal! */
+	if(t->_str[i] != '(') {
+		end = pbg_parse_skip(t->_str, t->_n, i);
+		type = pbg_gettype(t->_str+i, end-i+1);
+		if(type == PBG_LT_VAR)
+			return pbg_store_variable(e, pbg_parse_var(err, t->_str+i, end-i+1));
+		return pbg_store_constant(e, pbg_parse_literal(err, type, t->_str+i, end-i+1));
+	}
+	/* It's a deferred group! Remember where it is. */
+	if(defer && level >= root->_depth) {
+		node = malloc(sizeof(pbg_lazy_node));
+		if(node == NULL) {
+			pbg_err_alloc(err, __LINE__, __FILE__);
+			return 0;
+		}
+		node->_root = root;
+		node->_start = i;
+		node->_group = g;
+		node->_built = 0;
+		return pbg_store_constant(e, pbg_field_init(PBG_LAZY, 
+				sizeof(pbg_lazy_node), node));
+	}
+	/* It's an operator! Build its arguments. */
+	pbg_text_load(t, &op, i);
+	type = op._field._type;
+	id = pbg_store_constant(e, pbg_parse_op(err, type, root->_groups[g]._argc));
+	if(id == 0 || pbg_iserror(err))
+		return 0;
+	k = 0;
+	for(i = pbg_text_first(t, &op), g++; t->_str[i] != ')'; i = pbg_lazy_after(root, i, &g)) {
+		cid = pbg_lazy_build_r(root, e, err, i, g, level+1, pbg_lazy_defers(type));
+		if(cid == 0 || pbg_iserror(err))
+			return 0;
+		children = pbg_field_get(e, id)->_data;
+		children[k++] = cid;
+	}
+	return id;
+}
+
+/**
+ * Builds the top levels of the subtree at the given index.
+ * @param root  Lazy expression being built.
+ * @param e     Expression to initialize.
+ * @param err   Used to store error, if any.
+ * @param i     Index of the subtree in the text.
+ * @param g     Index of the subtree in root->_groups, if it is a group.
+ */
+void pbg_lazy_build(pbg_lazy_root* root, pbg_expr* e, pbg_error* err, int i, int g)
+{
+	int numconst, numvars;
+	e->_numconst = e->_numvars = 0;
+	e->_program = NULL;
+	e->_names = NULL;
+	numconst = numvars = 0;
+	pbg_lazy_count_r(root, i, g, 0, 0, &numconst, &numvars);
+	e->_constants = (pbg_field*) malloc(numconst * sizeof(pbg_field));
+	e->_variables = (pbg_field*) malloc(numvars * sizeof(pbg_field));
+	if((numconst > 0 && e->_constants == NULL) || (numvars > 0 && e->_variables == NULL)) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		pbg_free(e);
+		return;
+	}
+	if(pbg_lazy_build_r(root, e, err, i, g, 0, 0) == 0 || pbg_iserror(err)) {
+		if(!pbg_iserror(err))
+			pbg_err_alloc(err, __LINE__, __FILE__);
+		pbg_lazy_free_r(e);
+	}
+}
+
+/**
+ * Evaluates a deferred subtree, building it first if it was never reached.
+ * @param err    Used to store error, if any.
+ * @param field  PBG_LAZY field of the subtree.
+ * @return the result of the subtree, PBG_ERROR if err was set.
+ */
+int pbg_lazy_run(pbg_error* err, pbg_field* field)
+{
+	int result;
+	pbg_lazy_node* node;
+	pbg_error suberr;
+	node = field->_data;
+	if(!node->_built) {
+		pbg_err_init(&suberr, PBG_ERR_NONE, 0, NULL, 0, NULL);
+		pbg_lazy_build(node->_root, &node->_expr, &suberr, node->_start, node->_group);
+		if(pbg_iserror(&suberr)) {
+			*err = suberr;
+			return PBG_ERROR;
+		}
+		node->_built = 1;
+	}
+	/* The subtree resolves its own VARs. Keep any error it reports. */
+	result = pbg_evaluate_dict(&node->_expr, &suberr, node->_root->_text._dict);
+	if(pbg_iserror(&suberr)) {
+		pbg_error_free(err);
+		*err = suberr;
+	}
+	return result;
+}
+
+void pbg_parse_lazy(pbg_lazy* l, pbg_error* err, char* str, int n, int depth)
+{
+	pbg_lazy_root* root;
+	
+	/* Report the same errors parsing would. */
+	l->_root = NULL;
+	if(!pbg_validate(err, str, n))
+		return;
+	
+	/* Keep a copy of the text, as subtrees are built from it later on. */
+	root = malloc(sizeof(pbg_lazy_root));
+	if(root != NULL)
+		root->_text._str = malloc(n);
+	if(root == NULL || root->_text._str == NULL) {
+		free(root);
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return;
+	}
+	memcpy(root->_text._str, str, n);
+	root->_text._n = n;
+	root->_text._dict = NULL;
+	root->_depth = (depth > 0) ? depth : 1;
+	
+	/* Index its groups once, so no build step reads a deferred group. */
+	if(!pbg_lazy_index(root)) {
+		free(root->_text._str);
+		free(root);
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return;
+	}
+	
+	/* Build the top levels. */
+	pbg_lazy_build(root, &root->_expr, err, pbg_text_skip(&root->_text, 0), 0);
+	if(pbg_iserror(err)) {
+		free(root->_groups);
+		free(root->_text._str);
+		free(root);
+		return;
+	}
+	l->_root = root;
+}
+
+int pbg_lazy_evaluate(pbg_lazy* l, pbg_error* err, pbg_field (*dict)(char*, int))
+{
+	int result;
+	pbg_dict_fn fn;
+	pbg_dict wrapper;
+	pbg_lazy_root* root;
+	root = l->_root;
+	if(root == NULL) {
+		pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+		pbg_err_state(err, __LINE__, __FILE__, "Lazy expression was not parsed.");
+		return PBG_ERROR;
+	}
+	fn._fn = dict;
+	wrapper._get = pbg_dict_fn_get;
+	wrapper._release = NULL;
+	wrapper._ctx = &fn;
+	wrapper._get_path = NULL;
+	wrapper._get_hashed = NULL;
+	wrapper._hash = NULL;
+	/* Deferred subtrees reached during evaluation use the same dictionary. */
+	root->_text._dict = &wrapper;
+	result = pbg_evaluate_dict(&root->_expr, err, &wrapper);
+	root->_text._dict = NULL;
+	return result;
+}
+
+void pbg_lazy_free(pbg_lazy* l)
+{
+	pbg_lazy_root* root;
+	root = l->_root;
+	if(root == NULL)
+		return;
+	pbg_lazy_free_r(&root->_expr);
+	free(root->_groups);
+	free(root->_text._str);
+	free(root);
+	l->_root = NULL;
+}
+
+/***********************
+ *                     *
+ * COMPILATION TOOLKIT *
+ *                     *
+ ***********************/
+
+/**
+ * Gets the node of the given field.
+ * @param prog  Program holding the node.
+ * @param id    Index of the field.
+ * @return the node of the field.
+ */
+pbg_node* pbg_program_node(pbg_program* prog, int id) {
+	return (id > 0) ? prog->_nodes + (id-1) : prog->_nodes + prog->_numnodes + id;
+}
+
+/**
+ * Allocates a program for the expression. There is one node per constant field
+ * followed by one per VAR, last VAR first. Every node starts out running its field in the
+ * interpreter, and every operator node points straight at its children's nodes.
+ * @param e       PBG expression to compile.
+ * @param err     Used to store error, if any.
+ * @param warmup  Runs to profile before recompiling, 0 if unmanaged.
+ * @param period  Runs between profiles, 0 to profile once.
+ * @return the new program if successful, NULL otherwise.
+ */
+pbg_program* pbg_program_init(pbg_expr* e, pbg_error* err, int warmup, int period)
+{
+	int i, j, numkids;
+	pbg_program* prog;
+	pbg_field* field;
+	pbg_node* node;
+	
+	/* Count children of ANDs, ORs, and NOTs. */
+	numkids = 0;
+	for(i = 0; i < e->_numconst; i++) {
+		field = e->_constants+i;
+		if(field->_type == PBG_OP_AND || field->_type == PBG_OP_OR || 
+				field->_type == PBG_OP_NOT)
+			numkids += field->_int;
+	}
+	
+	/* Allocate everything up front. */
+	prog = (pbg_program*) malloc(sizeof(pbg_program));
+	if(prog == NULL) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return NULL;
+	}
+	prog->_numnodes = e->_numconst + e->_numvars;
+	prog->_nodes = (pbg_node*) calloc(prog->_numnodes, sizeof(pbg_node));
+	prog->_kids = (pbg_node**) malloc((numkids+1) * sizeof(pbg_node*));
+	if(prog->_nodes == NULL || prog->_kids == NULL) {
+		pbg_program_free(prog);
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return NULL;
+	}
+	prog->_warmup = warmup;
+	prog->_period = period;
+	prog->_count = 0;
+	prog->_profiling = (warmup > 0);
+	prog->_ticks = 0;
+	
+	/* Every node starts out running its field in the interpreter. */
+	numkids = 0;
+	for(i = 0; i < e->_numconst; i++) {
+		field = e->_constants+i;
+		node = prog->_nodes+i;
+		node->_run = pbg_run_field;
+		node->_field = field;
+		node->_cmp = field;
+		if(field->_type == PBG_OP_AND || field->_type == PBG_OP_OR || 
+				field->_type == PBG_OP_NOT) {
+			node->_kids = prog->_kids + numkids;
+			node->_numkids = field->_int;
+			for(j = 0; j < field->_int; j++)
+				node->_kids[j] = pbg_program_node(prog, ((int*)field->_data)[j]);
+			numkids += field->_int;
+		}
+	}
+	/* VARs are read from the resolved variables when run. Like their fields,
+	 * they are indexed backwards from the end. */
+	for(i = e->_numconst; i < prog->_numnodes; i++) {
+		prog->_nodes[i]._run = pbg_run_var;
+		prog->_nodes[i]._var = prog->_numnodes-1 - i;
+	}
+	return prog;
+}
+
+/**
+ * Fuses a comparison between a VAR and a NUMBER, DATE, or STRING constant, or
+ * an EQ or NEQ between a VAR and TRUE or FALSE, into a single node, if the 
+ * field has that shape. Otherwise the node is left as is.
+ * @param e     PBG expression being compiled.
+ * @param node  Node of the comparison field.
+ */
+void pbg_compile_cmp(pbg_expr* e, pbg_node* node)
+{
+	int child0, child1, var, eq;
+	pbg_field* constant;
+	if(node->_field->_int != 2) return;
+	child0 = ((int*)node->_field->_data)[0];
+	child1 = ((int*)node->_field->_data)[1];
+	/* Exactly one operand must be a VAR. */
+	if((child0 < 0) == (child1 < 0)) return;
+	var = (child0 < 0) ? child0 : child1;
+	constant = pbg_field_get(e, (child0 < 0) ? child1 : child0);
+	eq = (node->_field->_type == PBG_OP_EQ || node->_field->_type == PBG_OP_NEQ);
+	switch(constant->_type) {
+		case PBG_LT_NUMBER:
+			node->_run = eq ? pbg_run_number_eq : pbg_run_number_order;
+			node->_number = *(pbg_lt_number*) constant->_data;
+			break;
+		case PBG_LT_DATE:
+			node->_run = eq ? pbg_run_date_eq : pbg_run_date_order;
+			node->_date = *(pbg_lt_date*) constant->_data;
+			break;
+		case PBG_LT_STRING:
+			node->_run = eq ? pbg_run_string_eq : pbg_run_string_order;
+			node->_str = constant->_data;
+			node->_n = constant->_int;
+			break;
+		case PBG_LT_TRUE:
+		case PBG_LT_FALSE:
+			/* BOOLs are only ever equal or not. */
+			if(!eq) return;
+			node->_run = pbg_run_bool_eq;
+			node->_n = (constant->_type == PBG_LT_TRUE);
+			break;
+		default:
+			return;
+	}
+	node->_swap = (child1 == var);
+	node->_var = -(var+1);
+	/* Resolve the operator now, as a result for each outcome of comparing. */
+	node->_accept[0] = (node->_field->_type == PBG_OP_LT || 
+			node->_field->_type == PBG_OP_LTE || node->_field->_type == PBG_OP_NEQ);
+	node->_accept[1] = (node->_field->_type == PBG_OP_EQ || 
+			node->_field->_type == PBG_OP_LTE || node->_field->_type == PBG_OP_GTE);
+	node->_accept[2] = (node->_field->_type == PBG_OP_GT || 
+			node->_field->_type == PBG_OP_GTE || node->_field->_type == PBG_OP_NEQ);
+}
+
+/**
+ * Orders EQ nodes by the bytes of their NUMBER constants, which is how EQ
+ * compares them.
+ * @param n1  Pointer to the first node.
+ * @param n2  Pointer to the second node.
+ * @return <0 if n1 goes first, >0 if n2 goes first, 0 if they are equal.
+ */
+int pbg_member_cmp_number(const void* n1, const void* n2)
+{
+	return memcmp(&(*(pbg_node* const*) n1)->_number, 
+			&(*(pbg_node* const*) n2)->_number, sizeof(pbg_lt_number));
+}
+
+/**
+ * Orders EQ nodes by the bytes of their DATE constants, which is how EQ
+ * compares them.
+ * @param n1  Pointer to the first node.
+ * @param n2  Pointer to the second node.
+ * @return <0 if n1 goes first, >0 if n2 goes first, 0 if they are equal.
+ */
+int pbg_member_cmp_date(const void* n1, const void* n2)
+{
+	return memcmp(&(*(pbg_node* const*) n1)->_date, 
+			&(*(pbg_node* const*) n2)->_date, sizeof(pbg_lt_date));
+}
+
+/**
+ * Turns an OR of fused EQs between one VAR and constants of one type into a set
+ * lookup, if the node has that shape. NUMBERs and DATEs are sorted for binary
+ * search, and STRINGs are hashed into an open-addressing table. The EQ nodes
+ * are kept as children, so the node can still be scanned or recompiled. If the
+ * set cannot be allocated, the node is left as an OR.
+ * @param e     PBG expression being compiled.
+ * @param node  Node of the OR.
+ */
+void pbg_compile_in(pbg_expr* e, pbg_node* node)
+{
+	int i, size;
+	unsigned long slot;
+	pbg_node* kid, *first;
+	pbg_handler run;
+	free(node->_members);
+	node->_members = NULL;
+	node->_nummembers = 0;
+	if(node->_numkids < PBG_MIN_MEMBERS || node->_numkids > INT_MAX/4) return;
+	
+	/* Every child must be an EQ of the same VAR with the same type. */
+	first = node->_kids[0];
+	run = first->_run;
+	if(run != pbg_run_number_eq && run != pbg_run_date_eq && run != pbg_run_string_eq)
+		return;
+	for(i = 0; i < node->_numkids; i++) {
+		kid = node->_kids[i];
+		if(kid->_run != run || !pbg_compile_samevar(e, kid->_var, first->_var) || 
+				kid->_accept[0] || !kid->_accept[1] || kid->_accept[2])
+			return;
+	}
+	
+	if(run == pbg_run_string_eq) {
+		/* Keep the table at most half full. */
+		for(size = 1; size < 2*node->_numkids; size *= 2);
+		node->_members = (pbg_node**) calloc(size, sizeof(pbg_node*));
+		if(node->_members == NULL) return;
+		for(i = 0; i < node->_numkids; i++) {
+			kid = node->_kids[i];
+			slot = pbg_hash(kid->_str, kid->_n) & (size-1);
+			while(node->_members[slot] != NULL)
+				slot = (slot+1) & (size-1);
+			node->_members[slot] = kid;
+		}
+		node->_run = pbg_run_string_in;
+	}else{
+		size = node->_numkids;
+		node->_members = (pbg_node**) malloc(size * sizeof(pbg_node*));
+		if(node->_members == NULL) return;
+		memcpy(node->_members, node->_kids, size * sizeof(pbg_node*));
+		if(run == pbg_run_number_eq) {
+			qsort(node->_members, size, sizeof(pbg_node*), pbg_member_cmp_number);
+			node->_run = pbg_run_number_in;
+		}else{
+			qsort(node->_members, size, sizeof(pbg_node*), pbg_member_cmp_date);
+			node->_run = pbg_run_date_in;
+		}
+	}
+	node->_nummembers = size;
+	node->_var = first->_var;
+	node->_accept[0] = 0;
+	node->_accept[1] = 1;
+	node->_accept[2] = 0;
+}
+
+/**
+ * Checks if a VAR value is a member of a set lookup. NUMBERs and DATEs are
+ * compared byte for byte, and STRINGs by length and characters, as EQ does.
+ * @param node  Node of the set lookup.
+ * @param key   Value to look up: a pbg_lt_number, a pbg_lt_date, or characters.
+ * @param n     Length of a STRING key.
+ * @return 1 if the value is a member, 0 otherwise.
+ */
+int pbg_member_find(pbg_node* node, void* key, int n)
+{
+	int lo, hi, mid, cmp;
+	unsigned long slot;
+	pbg_node* kid;
+	if(node->_run == pbg_run_string_in) {
+		slot = pbg_hash((char*) key, n) & (node->_nummembers-1);
+		for(; (kid = node->_members[slot]) != NULL; 
+				slot = (slot+1) & (node->_nummembers-1))
+			if(kid->_n == n && memcmp(kid->_str, key, n) == 0)
+				return 1;
+		return 0;
+	}
+	lo = 0, hi = node->_nummembers;
+	while(lo < hi) {
+		mid = lo + (hi-lo)/2;
+		kid = node->_members[mid];
+		cmp = (node->_run == pbg_run_number_in) ? 
+				memcmp(key, &kid->_number, sizeof(pbg_lt_number)) : 
+				memcmp(key, &kid->_date, sizeof(pbg_lt_date));
+		if(cmp == 0) return 1;
+		if(cmp < 0) hi = mid;
+		else lo = mid+1;
+	}
+	return 0;
+}
+
+/**
+ * Checks if a node runs a set lookup.
+ * @param node  Node to check.
+ * @return 1 if the node is a set lookup, 0 otherwise.
+ */
+int pbg_node_isset(pbg_node* node) {
+	return node->_run == pbg_run_number_in || node->_run == pbg_run_date_in || 
+			node->_run == pbg_run_string_in;
+}
+
+/**
+ * Checks if two VARs of the expression have the same name. VARs of the same
+ * name resolve to the same field, so either can be read for both.
+ * @param e   PBG expression being compiled.
+ * @param v1  Index of the first VAR in _variables.
+ * @param v2  Index of the second VAR in _variables.
+ * @return 1 if the VARs have the same name, 0 otherwise.
+ */
+int pbg_compile_samevar(pbg_expr* e, int v1, int v2)
+{
+	pbg_field* f1, *f2;
+	if(v1 == v2) return 1;
+	f1 = e->_variables+v1, f2 = e->_variables+v2;
+	return f1->_int == f2->_int && memcmp(f1->_data, f2->_data, f1->_int) == 0;
+}
+
+/**
+ * Checks if a node can be a bound of an interval test.
+ * @param node  Node to check.
+ * @return 1 if the node compares a VAR to a NUMBER other than NaN, or to a 
+ *         DATE, 0 otherwise.
+ */
+int pbg_range_isbound(pbg_node* node) {
+	return ((node->_run == pbg_run_number_eq || node->_run == pbg_run_number_order) && 
+			node->_number._val == node->_number._val) || pbg_range_isdate(node);
+}
+
+/**
+ * Checks if a node is a bound of a DATE interval test.
+ * @param node  Node to check.
+ * @return 1 if the node compares a VAR to a DATE, 0 otherwise.
+ */
+int pbg_range_isdate(pbg_node* node) {
+	return node->_run == pbg_run_date_eq || node->_run == pbg_run_date_order;
+}
+
+/**
+ * Checks if two nodes can be bounds of the same interval test: both compare the
+ * same VAR to a NUMBER other than NaN, or both compare it to a DATE.
+ * @param e   PBG expression being compiled.
+ * @param n1  First node.
+ * @param n2  Second node.
+ * @return 1 if the nodes can share an interval test, 0 otherwise.
+ */
+int pbg_range_joins(pbg_expr* e, pbg_node* n1, pbg_node* n2)
+{
+	return pbg_range_isbound(n1) && pbg_range_isbound(n2) && 
+			pbg_range_isdate(n1) == pbg_range_isdate(n2) && 
+			pbg_compile_samevar(e, n1->_var, n2->_var);
+}
+
+/**
+ * Orders NUMBERs by value.
+ * @param n1  First NUMBER.
+ * @param n2  Second NUMBER.
+ * @return <0 if n1 goes first, >0 if n2 goes first, 0 if they are equal.
+ */
+int pbg_range_cmp(const void* n1, const void* n2)
+{
+	return pbg_cmpnumber((pbg_lt_number*) n1, (pbg_lt_number*) n2);
+}
+
+/**
+ * Orders DATEs as the comparison operators do.
+ * @param d1  First DATE.
+ * @param d2  Second DATE.
+ * @return <0 if d1 goes first, >0 if d2 goes first, 0 if they are equal.
+ */
+int pbg_range_cmp_date(const void* d1, const void* d2)
+{
+	return pbg_cmpdate((pbg_lt_date*) d1, (pbg_lt_date*) d2);
+}
+
+/**
+ * Finds the region of an interval test holding a value. Region 2i+1 is bound 
+ * i itself, and region 2i lies between bound i-1 and bound i.
+ * @param bounds  Sorted bounds of the test.
+ * @param n       Number of bounds.
+ * @param val     Value to find, which must not be NaN.
+ * @return the region of val, from 0 to 2n.
+ */
+int pbg_range_region(pbg_lt_number* bounds, int n, double val)
+{
+	int lo, hi, mid;
+	lo = 0, hi = n;
+	while(lo < hi) {
+		mid = lo + (hi-lo)/2;
+		if(bounds[mid]._val < val) lo = mid+1;
+		else hi = mid;
+	}
+	return 2*lo + (lo < n && bounds[lo]._val == val);
+}
+
+/**
+ * Finds the region of a DATE interval test holding a value, as 
+ * pbg_range_region does for NUMBERs.
+ * @param bounds  Sorted bounds of the test.
+ * @param n       Number of bounds.
+ * @param val     DATE to find.
+ * @return the region of val, from 0 to 2n.
+ */
+int pbg_range_region_date(pbg_lt_date* bounds, int n, pbg_lt_date* val)
+{
+	int lo, hi, mid;
+	lo = 0, hi = n;
+	while(lo < hi) {
+		mid = lo + (hi-lo)/2;
+		if(pbg_cmpdate(bounds+mid, val) < 0) lo = mid+1;
+		else hi = mid;
+	}
+	return 2*lo + (lo < n && pbg_cmpdate(bounds+lo, val) == 0);
+}
+
+/**
+ * Turns an AND or OR of fused comparisons between one VAR and NUMBER or DATE
+ * constants into a single interval test, if the node has that shape. Every 
+ * constant is a bound, and the result of the whole node is worked out once for
+ * each bound and each gap between bounds. Bounds that do not change the result
+ * are then dropped, so the test is a normalized, sorted set of intervals. The
+ * children are kept, and run instead when the VAR does not have the type of
+ * the constants, or is a NUMBER 0 or NaN, whose comparisons depend on more 
+ * than their position. DATEs compare equal exactly when they are in order, so
+ * every DATE is placed by the test. If the test cannot be allocated, the node
+ * is left as is.
+ * @param e     PBG expression being compiled.
+ * @param node  Node of the AND or OR.
+ */
+void pbg_compile_range(pbg_expr* e, pbg_node* node)
+{
+	int i, j, k, r, cmp, result, isand, isdate;
+	size_t size;
+	char* bounds;
+	pbg_node* kid, *first;
+	int (*order)(const void*, const void*);
+	free(node->_bounds);
+	node->_bounds = NULL;
+	node->_regions = NULL;
+	node->_numbounds = 0;
+	if(node->_run != pbg_run_and && node->_run != pbg_run_or) return;
+	if(node->_numkids < 2 || node->_numkids > INT_MAX/4) return;
+	
+	/* Every child must compare the same VAR to a constant of one type. */
+	first = node->_kids[0];
+	for(i = 1; i < node->_numkids; i++)
+		if(!pbg_range_joins(e, first, node->_kids[i]))
+			return;
+	isdate = pbg_range_isdate(first);
+	size = isdate ? sizeof(pbg_lt_date) : sizeof(pbg_lt_number);
+	order = isdate ? pbg_range_cmp_date : pbg_range_cmp;
+	
+	/* Bounds and regions share one block. */
+	node->_bounds = malloc(node->_numkids * size + 2*node->_numkids + 1);
+	if(node->_bounds == NULL) return;
+	bounds = (char*) node->_bounds;
+	node->_regions = bounds + node->_numkids * size;
+	for(i = 0; i < node->_numkids; i++)
+		memcpy(bounds + i*size, isdate ? (void*) &node->_kids[i]->_date : 
+				(void*) &node->_kids[i]->_number, size);
+	qsort(bounds, node->_numkids, size, order);
+	for(i = 1, k = 1; i < node->_numkids; i++)
+		if(order(bounds + i*size, bounds + (k-1)*size) != 0)
+			memmove(bounds + (k++)*size, bounds + i*size, size);
+	
+	/* Work out the result in every region, as the children would. */
+	isand = (node->_run == pbg_run_and);
+	for(r = 0; r <= 2*k; r++) {
+		result = isand;
+		for(i = 0; i < node->_numkids; i++) {
+			kid = node->_kids[i];
+			j = isdate ? pbg_range_region_date((pbg_lt_date*) bounds, k, &kid->_date) : 
+					pbg_range_region((pbg_lt_number*) bounds, k, kid->_number._val);
+			cmp = (r > j) - (r < j);
+			if(kid->_run == pbg_run_number_eq || kid->_run == pbg_run_date_eq)
+				cmp = (cmp != 0);
+			else if(kid->_swap)
+				cmp = -cmp;
+			if(isand) result = result && kid->_accept[1+cmp];
+			else result = result || kid->_accept[1+cmp];
+		}
+		node->_regions[r] = (char) result;
+	}
+	
+	/* Drop every bound with the same result on both sides and at itself. */
+	for(i = 0, j = 0; i < k; i++) {
+		if(node->_regions[2*i+1] == node->_regions[2*j] && 
+				node->_regions[2*i+2] == node->_regions[2*j])
+			continue;
+		memmove(bounds + j*size, bounds + i*size, size);
+		node->_regions[2*j+1] = node->_regions[2*i+1];
+		node->_regions[2*j+2] = node->_regions[2*i+2];
+		j++;
+	}
+	node->_numbounds = j;
+	node->_var = first->_var;
+	node->_run = isdate ? pbg_run_date_range : pbg_run_number_range;
+}
+
+/**
+ * Merges every run of two or more neighboring children of an AND or OR that 
+ * can share an interval test into a single child, which is compiled as one,
+ * e.g. the first two children of (& (>= [age] 18) (< [age] 65) (= [c] 'US')).
+ * A run under an AND is the AND of its children, and a run under an OR is 
+ * their OR, so short-circuiting and errors are unchanged. The merged children
+ * are held by the node, and put back by pbg_compile_unmerge. If they cannot be
+ * allocated, the node is left as is.
+ * @param e     PBG expression being compiled.
+ * @param node  Node of the AND or OR.
+ */
+void pbg_compile_merge(pbg_expr* e, pbg_node* node)
+{
+	int i, j, k, numruns, numkids;
+	pbg_node** kids;
+	pbg_node* run;
+	if(node->_run != pbg_run_and && node->_run != pbg_run_or) return;
+	
+	/* Count the runs, and the children in them. */
+	numruns = numkids = 0;
+	for(i = 0; i < node->_numkids; i = j) {
+		for(j = i+1; j < node->_numkids && 
+				pbg_range_joins(e, node->_kids[i], node->_kids[j]); j++);
+		if(j - i >= 2) {
+			numruns++;
+			numkids += j - i;
+		}
+	}
+	if(numruns == 0) return;
+	
+	/* Runs and their children share one block. */
+	node->_merged = (pbg_node*) calloc(1, numruns * sizeof(pbg_node) + 
+			numkids * sizeof(pbg_node*));
+	if(node->_merged == NULL) return;
+	kids = (pbg_node**) (node->_merged + numruns);
+	for(i = 0, k = 0; i < node->_numkids; i = j) {
+		for(j = i+1; j < node->_numkids && 
+				pbg_range_joins(e, node->_kids[i], node->_kids[j]); j++);
+		if(j - i < 2) {
+			node->_kids[k++] = node->_kids[i];
+			continue;
+		}
+		run = node->_merged + node->_nummerged++;
+		run->_run = node->_run;
+		run->_field = node->_field;
+		run->_kids = kids;
+		run->_numkids = j - i;
+		memcpy(kids, node->_kids + i, (j-i) * sizeof(pbg_node*));
+		kids += j - i;
+		pbg_compile_range(e, run);
+		node->_kids[k++] = run;
+	}
+	node->_numkids = k;
+}
+
+/**
+ * Puts the children of every run merged by pbg_compile_merge back in the place
+ * of the run, and frees the runs.
+ * @param node  Node of the AND or OR.
+ */
+void pbg_compile_unmerge(pbg_node* node)
+{
+	int i, j, k, numkids;
+	pbg_node* kid;
+	if(node->_merged == NULL) return;
+	numkids = node->_numkids;
+	for(i = 0; i < node->_nummerged; i++)
+		numkids += node->_merged[i]._numkids - 1;
+	/* Fill from the end, so no child is overwritten before it is moved. */
+	for(i = node->_numkids-1, k = numkids; i >= 0; i--) {
+		kid = node->_kids[i];
+		for(j = 0; j < node->_nummerged && kid != node->_merged+j; j++);
+		if(j == node->_nummerged) {
+			node->_kids[--k] = kid;
+			continue;
+		}
+		for(j = kid->_numkids-1; j >= 0; j--)
+			node->_kids[--k] = kid->_kids[j];
+	}
+	for(i = 0; i < node->_nummerged; i++)
+		free(node->_merged[i]._bounds);
+	free(node->_merged);
+	node->_merged = NULL;
+	node->_nummerged = 0;
+	node->_numkids = numkids;
+}
+
+/**
+ * Checks if a node runs a fused field.
+ * @param node  Node to check.
+ * @return 1 if the node is fused, 0 otherwise.
+ */
+int pbg_node_isfused(pbg_node* node) {
+	return node->_run == pbg_run_exst_var || 
+			node->_run == pbg_run_number_eq || node->_run == pbg_run_number_order || 
+			node->_run == pbg_run_date_eq || node->_run == pbg_run_date_order || 
+			node->_run == pbg_run_string_eq || node->_run == pbg_run_string_order || 
+			node->_run == pbg_run_bool_eq;
+}
+
+/**
+ * Compiles the subtree rooted at the given field. Children are compiled before
+ * their parents, so a NOT can absorb a fused child. Compiling a subtree again
+ * gives the same result.
+ * @param e     PBG expression being compiled.
+ * @param prog  Program to store nodes in.
+ * @param id    Index of the field to compile.
+ * @param fuse  1 to fuse leaves, 0 to leave them to the interpreter.
+ */
+void pbg_compile_r(pbg_expr* e, pbg_program* prog, int id, int fuse)
+{
+	int i, child0;
+	pbg_node* node, *kid;
+	/* VARs are resolved by the dictionary, there is nothing to compile. */
+	if(id < 0) return;
+	node = pbg_program_node(prog, id);
+	/* Children merged by an earlier compile are put back first. */
+	pbg_compile_unmerge(node);
+	if(pbg_type_isop(node->_field->_type))
+		for(i = 0; i < node->_field->_int; i++)
+			pbg_compile_r(e, prog, ((int*)node->_field->_data)[i], fuse);
+	
+	/* Note which fields can never produce an error. */
+	switch(node->_field->_type) {
+		case PBG_LT_TRUE:
+		case PBG_LT_FALSE:
+		case PBG_OP_EXST:
+			node->_safe = 1;
+			break;
+		case PBG_OP_TYPE:
+			child0 = ((int*)node->_field->_data)[0];
+			node->_safe = child0 > 0 && pbg_field_get(e, child0)->_type > PBG_MIN_LT_TP && 
+					pbg_field_get(e, child0)->_type < PBG_MAX_LT_TP;
+			break;
+		case PBG_OP_NOT:
+		case PBG_OP_AND:
+		case PBG_OP_OR:
+			node->_safe = 1;
+			for(i = 0; i < node->_numkids; i++)
+				if(!node->_kids[i]->_safe)
+					node->_safe = 0;
+			break;
+		default:
+			node->_safe = 0;
+	}
+	
+	/* Choose the handler. */
+	node->_run = pbg_run_field;
+	switch(node->_field->_type) {
+		case PBG_LT_TRUE:  node->_run = pbg_run_true; break;
+		case PBG_LT_FALSE: node->_run = pbg_run_false; break;
+		case PBG_OP_AND:
+		case PBG_OP_OR:
+			node->_run = (node->_field->_type == PBG_OP_AND) ? pbg_run_and : pbg_run_or;
+			if(fuse) {
+				pbg_compile_in(e, node);
+				pbg_compile_range(e, node);
+				pbg_compile_merge(e, node);
+			}
+			break;
+		case PBG_OP_NOT:
+			node->_run = pbg_run_not;
+			/* NOT over a fused node becomes that node, inverted. */
+			kid = node->_kids[0];
+			if(pbg_node_isfused(kid)) {
+				node->_run = kid->_run;
+				node->_cmp = kid->_cmp;
+				node->_negate = !kid->_negate;
+				for(i = 0; i < 3; i++)
+					node->_accept[i] = !kid->_accept[i];
+				node->_swap = kid->_swap;
+				node->_var = kid->_var;
+				node->_number = kid->_number;
+				node->_date = kid->_date;
+				node->_str = kid->_str;
+				node->_n = kid->_n;
+			}
+			break;
+		case PBG_OP_EXST:
+			child0 = ((int*)node->_field->_data)[0];
+			if(fuse && node->_field->_int == 1 && child0 < 0) {
+				node->_run = pbg_run_exst_var;
+				node->_var = -(child0+1);
+				node->_accept[0] = 0;
+				node->_accept[1] = 1;
+			}
+			break;
+		case PBG_OP_EQ:
+		case PBG_OP_NEQ:
+		case PBG_OP_LT:
+		case PBG_OP_GT:
+		case PBG_OP_LTE:
+		case PBG_OP_GTE:
+			if(fuse) pbg_compile_cmp(e, node);
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ * Decides which of two children of an AND or OR should run first. A child is
+ * decisive when it is FALSE under an AND or TRUE under an OR. The child that
+ * was decisive most often per node run goes first. Children that never ran go
+ * last.
+ * @param parent  Node of the AND or OR.
+ * @param n1      Node of the first child.
+ * @param n2      Node of the second child.
+ * @return 1 if n1 should run before n2, 0 otherwise.
+ */
+int pbg_program_before(pbg_node* parent, pbg_node* n1, pbg_node* n2)
+{
+	double d1, d2;
+	if(n1->_work == 0) return 0;
+	if(n2->_work == 0) return 1;
+	d1 = (double) (parent->_run == pbg_run_and ? n1->_runs - n1->_trues : n1->_trues);
+	d2 = (double) (parent->_run == pbg_run_and ? n2->_runs - n2->_trues : n2->_trues);
+	return d1 * n2->_work > d2 * n1->_work;
+}
+
+/**
+ * Reorders the children of an AND or OR from profiled statistics. Only children
+ * that can never produce an error are moved, and never across a child that can,
+ * so results and errors are unchanged.
+ * @param node  Node of the AND or OR.
+ */
+void pbg_program_reorder(pbg_node* node)
+{
+	int i, j, k, start;
+	pbg_node* kid;
+	for(start = 0; start < node->_numkids; start = i+1) {
+		/* Find the run of safe children beginning at start. */
+		for(i = start; i < node->_numkids && node->_kids[i]->_safe; i++);
+		/* Insertion sort keeps ties in their current order. */
+		for(j = start+1; j < i; j++) {
+			kid = node->_kids[j];
+			for(k = j; k > start && pbg_program_before(node, kid, node->_kids[k-1]); k--)
+				node->_kids[k] = node->_kids[k-1];
+			node->_kids[k] = kid;
+		}
+	}
+}
+
+/**
+ * Advances a managed program by one run. Once warmed up, the program fuses its
+ * leaves and reorders every AND and OR. It then runs unprofiled for a period
+ * before profiling again, so that it follows changes in the data.
+ * @param e     PBG expression holding the program.
+ * @param prog  Program that just ran.
+ */
+void pbg_program_step(pbg_expr* e, pbg_program* prog)
+{
+	int i;
+	pbg_node* node;
+	if(prog->_warmup == 0) return;
+	prog->_count++;
+	if(prog->_profiling && prog->_count >= prog->_warmup) {
+		pbg_compile_r(e, prog, 1, 1);
+		for(i = 0; i < prog->_numnodes; i++) {
+			node = prog->_nodes+i;
+			if(node->_run == pbg_run_and || node->_run == pbg_run_or)
+				pbg_program_reorder(node);
+		}
+		prog->_profiling = 0;
+		prog->_count = 0;
+	}else if(!prog->_profiling && prog->_period > 0 && prog->_count >= prog->_period) {
+		for(i = 0; i < prog->_numnodes; i++) {
+			node = prog->_nodes+i;
+			node->_runs = node->_trues = node->_work = 0;
+		}
+		prog->_profiling = 1;
+		prog->_count = 0;
+		prog->_ticks = 0;
+	}
+}
+
+void pbg_compile(pbg_expr* e, pbg_error* err)
+{
+	/* Always start with a clean error! */
+	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	
+	/* Compiling twice is harmless. */
+	if(e->_program != NULL)
+		return;
+	if(e->_numconst == 0) {
+		pbg_err_state(err, __LINE__, __FILE__, 
+				"Cannot compile an empty expression.");
+		return;
+	}
+	
+	/* Specialize the nodes reachable from the root. */
+	e->_program = pbg_program_init(e, err, 0, 0);
+	if(e->_program != NULL)
+		pbg_compile_r(e, e->_program, 1, 1);
+}
+
+void pbg_manage(pbg_expr* e, pbg_error* err, int warmup, int period)
+{
+	/* Always start with a clean error! */
+	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	
+	if(e->_numconst == 0) {
+		pbg_err_state(err, __LINE__, __FILE__, 
+				"Cannot manage an empty expression.");
+		return;
+	}
+	if(warmup <= 0 || period < 0) {
+		pbg_err_state(err, __LINE__, __FILE__, 
+				"Warm-up must be positive and period non-negative.");
+		return;
+	}
+	
+	/* Start over from the interpreter, profiling. */
+	pbg_program_free(e->_program);
+	e->_program = pbg_program_init(e, err, warmup, period);
+	if(e->_program != NULL)
+		pbg_compile_r(e, e->_program, 1, 0);
+}
+
+/**
+ * Runs a node, profiling it if needed. This is the only place nodes are run
+ * from, so each node costs a single indirect call.
+ * @param e     PBG expression being evaluated.
+ * @param err   Used to store error, if any.
+ * @param prog  Compiled program of e.
+ * @param node  Node to run.
+ * @return PBG_TRUE, PBG_FALSE, or PBG_ERROR.
+ */
+int pbg_run_r(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	int result;
+	unsigned long start;
+	if(!prog->_profiling)
+		return node->_run(e, err, prog, node);
+	start = prog->_ticks++;
+	result = node->_run(e, err, prog, node);
+	node->_runs++;
+	if(result == PBG_TRUE) node->_trues++;
+	node->_work += prog->_ticks - start;
+	return result;
+}
+
+/**
+ * Runs the field of a fused node in the interpreter. Used when the resolved VAR
+ * does not have the type of the constant, so that results and errors match the
+ * interpreter exactly.
+ * @param e     PBG expression being evaluated.
+ * @param err   Used to store error, if any.
+ * @param node  Fused node.
+ * @return PBG_TRUE, PBG_FALSE, or PBG_ERROR.
+ */
+int pbg_run_fallback(pbg_expr* e, pbg_error* err, pbg_node* node)
+{
+	int result;
+	result = pbg_evaluate_r(e, err, node->_cmp);
+	if(result == PBG_ERROR || !node->_negate)
+		return result;
+	return result == PBG_TRUE ? PBG_FALSE : PBG_TRUE;
+}
+
+int pbg_run_field(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	PBG_UNUSED(prog);
+	return pbg_evaluate_r(e, err, node->_field);
+}
+
+int pbg_run_var(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	PBG_UNUSED(prog);
+	return pbg_evaluate_r(e, err, e->_variables + node->_var);
+}
+
+int pbg_run_true(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	PBG_UNUSED(e); PBG_UNUSED(err); PBG_UNUSED(prog); PBG_UNUSED(node);
+	return PBG_TRUE;
+}
+
+int pbg_run_false(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	PBG_UNUSED(e); PBG_UNUSED(err); PBG_UNUSED(prog); PBG_UNUSED(node);
+	return PBG_FALSE;
+}
+
+int pbg_run_not(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	int result;
+	result = pbg_run_r(e, err, prog, node->_kids[0]);
+	if(result == PBG_ERROR) return PBG_ERROR;  /* Pass error through. */
+	return result == PBG_TRUE ? PBG_FALSE : PBG_TRUE;
+}
+
+int pbg_run_and(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	int i, result;
+	for(i = 0; i < node->_numkids; i++) {
+		result = pbg_run_r(e, err, prog, node->_kids[i]);
+		if(result == PBG_ERROR) return PBG_ERROR;  /* Pass error through. */
+		if(result == PBG_FALSE) return PBG_FALSE;
+	}
+	return PBG_TRUE;
+}
+
+int pbg_run_or(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	int i, result;
+	for(i = 0; i < node->_numkids; i++) {
+		result = pbg_run_r(e, err, prog, node->_kids[i]);
+		if(result == PBG_ERROR) return PBG_ERROR;  /* Pass error through. */
+		if(result == PBG_TRUE)  return PBG_TRUE;
 	}
 	return PBG_FALSE;
 }
 
-int pbg_evaluate_op_exst(pbg_expr* e, pbg_error* err, pbg_field* field)
+int pbg_run_exst_var(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	PBG_UNUSED(err); PBG_UNUSED(prog);
+	return node->_accept[e->_variables[node->_var]._type != PBG_NULL];
+}
+
+int pbg_run_number_eq(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	pbg_field* var;
+	PBG_UNUSED(prog);
+	var = e->_variables + node->_var;
+	if(var->_type != PBG_LT_NUMBER || var->_int != sizeof(pbg_lt_number))
+		return pbg_run_fallback(e, err, node);
+	return node->_accept[1 + (memcmp(var->_data, &node->_number, 
+			sizeof(pbg_lt_number)) != 0)];
+}
+
+int pbg_run_number_order(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	pbg_field* var;
+	PBG_UNUSED(prog);
+	var = e->_variables + node->_var;
+	if(var->_type != PBG_LT_NUMBER)
+		return pbg_run_fallback(e, err, node);
+	return node->_accept[1 + (node->_swap ? 
+			pbg_cmpnumber(&node->_number, var->_data) : 
+			pbg_cmpnumber(var->_data, &node->_number))];
+}
+
+int pbg_run_date_eq(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	pbg_field* var;
+	PBG_UNUSED(prog);
+	var = e->_variables + node->_var;
+	if(var->_type != PBG_LT_DATE || var->_int != sizeof(pbg_lt_date))
+		return pbg_run_fallback(e, err, node);
+	return node->_accept[1 + (memcmp(var->_data, &node->_date, 
+			sizeof(pbg_lt_date)) != 0)];
+}
+
+int pbg_run_date_order(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	pbg_field* var;
+	PBG_UNUSED(prog);
+	var = e->_variables + node->_var;
+	if(var->_type != PBG_LT_DATE)
+		return pbg_run_fallback(e, err, node);
+	return node->_accept[1 + (node->_swap ? 
+			pbg_cmpdate(&node->_date, var->_data) : 
+			pbg_cmpdate(var->_data, &node->_date))];
+}
+
+int pbg_run_string_eq(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	pbg_field* var;
+	PBG_UNUSED(prog);
+	var = e->_variables + node->_var;
+	if(var->_type != PBG_LT_STRING)
+		return pbg_run_fallback(e, err, node);
+	return node->_accept[1 + (var->_int != node->_n || 
+			memcmp(var->_data, node->_str, node->_n) != 0)];
+}
+
+int pbg_run_string_order(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	int cmp;
+	pbg_field* var;
+	PBG_UNUSED(prog);
+	var = e->_variables + node->_var;
+	if(var->_type != PBG_LT_STRING)
+		return pbg_run_fallback(e, err, node);
+	cmp = node->_swap ? pbg_cmpstring(node->_str, node->_n, var->_data, var->_int) : 
+			pbg_cmpstring(var->_data, var->_int, node->_str, node->_n);
+	return node->_accept[1 + (cmp > 0) - (cmp < 0)];
+}
+
+int pbg_run_bool_eq(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	pbg_field* var;
+	PBG_UNUSED(prog);
+	var = e->_variables + node->_var;
+	if(var->_type != PBG_LT_TRUE && var->_type != PBG_LT_FALSE)
+		return pbg_run_fallback(e, err, node);
+	return node->_accept[1 + ((var->_type == PBG_LT_TRUE) != node->_n)];
+}
+
+int pbg_run_number_in(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	pbg_field* var;
+	PBG_UNUSED(prog);
+	var = e->_variables + node->_var;
+	if(var->_type != PBG_LT_NUMBER || var->_int != sizeof(pbg_lt_number))
+		return pbg_run_fallback(e, err, node);
+	return pbg_member_find(node, var->_data, 0) ? PBG_TRUE : PBG_FALSE;
+}
+
+int pbg_run_date_in(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	pbg_field* var;
+	PBG_UNUSED(prog);
+	var = e->_variables + node->_var;
+	if(var->_type != PBG_LT_DATE || var->_int != sizeof(pbg_lt_date))
+		return pbg_run_fallback(e, err, node);
+	return pbg_member_find(node, var->_data, 0) ? PBG_TRUE : PBG_FALSE;
+}
+
+int pbg_run_string_in(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	pbg_field* var;
+	PBG_UNUSED(prog);
+	var = e->_variables + node->_var;
+	if(var->_type != PBG_LT_STRING)
+		return pbg_run_fallback(e, err, node);
+	return pbg_member_find(node, var->_data, var->_int) ? PBG_TRUE : PBG_FALSE;
+}
+
+int pbg_run_number_range(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	double val;
+	pbg_field* var;
+	var = e->_variables + node->_var;
+	if(var->_type == PBG_LT_NUMBER && var->_int == sizeof(pbg_lt_number)) {
+		val = ((pbg_lt_number*) var->_data)->_val;
+		/* EQ tells 0 from -0, and NaN is equal in order to everything. */
+		if(val == val && val != 0)
+			return node->_regions[pbg_range_region((pbg_lt_number*) node->_bounds, 
+					node->_numbounds, val)] ? PBG_TRUE : PBG_FALSE;
+	}
+	return (node->_field->_type == PBG_OP_AND) ? pbg_run_and(e, err, prog, node) : 
+			pbg_run_or(e, err, prog, node);
+}
+
+int pbg_run_date_range(pbg_expr* e, pbg_error* err, pbg_program* prog, pbg_node* node)
+{
+	pbg_field* var;
+	var = e->_variables + node->_var;
+	if(var->_type == PBG_LT_DATE && var->_int == sizeof(pbg_lt_date))
+		return node->_regions[pbg_range_region_date((pbg_lt_date*) node->_bounds, 
+				node->_numbounds, var->_data)] ? PBG_TRUE : PBG_FALSE;
+	return (node->_field->_type == PBG_OP_AND) ? pbg_run_and(e, err, prog, node) : 
+			pbg_run_or(e, err, prog, node);
+}
+
+
+/****************************
+ *                          *
+ * BATCH EVALUATION TOOLKIT *
+ *                          *
+ ****************************/
+
+/**
+ * Finds the column of a batch with the given name. Columns of unknown types are
+ * skipped, so VARs naming them are NULL.
+ * @param batch  Batch to search.
+ * @param name   Name of the column.
+ * @param n      Length of name.
+ * @return the first column with the name, NULL if there is none.
+ */
+pbg_column* pbg_batch_column(pbg_batch* batch, char* name, int n)
+{
+	int i;
+	pbg_column* col;
+	for(i = 0; i < batch->_numcolumns; i++) {
+		col = batch->_columns+i;
+		if(col->_type <= PBG_MIN_LT_TP || col->_type >= PBG_MAX_LT_TP)
+			continue;
+		if((int) strlen(col->_name) == n && memcmp(col->_name, name, n) == 0)
+			return col;
+	}
+	return NULL;
+}
+
+/**
+ * Makes a mask of the first rows of a block.
+ * @param len  Number of rows, at most PBG_WORD_BITS.
+ * @return a word whose len lowest bits are set.
+ */
+unsigned long pbg_word_mask(int len) {
+	return (len >= PBG_WORD_BITS) ? ~0UL : (1UL << len) - 1;
+}
+
+/**
+ * Counts the rows set in a mask.
+ * @param word  Mask to count.
+ * @return the number of bits set in word.
+ */
+int pbg_popcount(unsigned long word)
+{
+	int n;
+	for(n = 0; word != 0; n++)
+		word &= word-1;
+	return n;
+}
+
+/**
+ * Reads the bits of a block of rows from a bitmap.
+ * @param bitmap  Bitmap to read, NULL if every bit is set.
+ * @param start   First row of the block.
+ * @param len     Number of rows, at most PBG_WORD_BITS.
+ * @return a word holding the bit of row start+i at position i.
+ */
+unsigned long pbg_bitmap_word(unsigned char* bitmap, int start, int len)
+{
+	int i;
+	unsigned long word;
+	if(bitmap == NULL)
+		return pbg_word_mask(len);
+	word = 0;
+	/* Read whole bytes when the block starts on one. */
+	if(start % 8 == 0) {
+		for(i = 0; i < len; i += 8)
+			word |= (unsigned long) bitmap[(start+i)/8] << i;
+		return word & pbg_word_mask(len);
+	}
+	for(i = 0; i < len; i++)
+		word |= (unsigned long) ((bitmap[(start+i)/8] >> ((start+i)%8)) & 1) << i;
+	return word;
+}
+
+/**
+ * Prepares to scan a batch with an expression. The expression is compiled into
+ * a fused program of its own, and each VAR is bound to its column.
+ * @param scan   Scan to initialize.
+ * @param e      PBG expression to evaluate.
+ * @param err    Used to store error, if any.
+ * @param batch  Batch to scan.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_scan_init(pbg_scan* scan, pbg_expr* e, pbg_error* err, pbg_batch* batch)
+{
+	int i, size;
+	pbg_field* var;
+	memset(scan, 0, sizeof(pbg_scan));
+	if(e->_numconst == 0) {
+		pbg_err_state(err, __LINE__, __FILE__, 
+				"Cannot evaluate an empty expression.");
+		return 0;
+	}
+	scan->_batch = batch;
+	scan->_numvars = e->_numvars;
+	scan->_loaded = -1;
+	
+	/* Allocate everything up front. */
+	size = (e->_numvars > 0) ? e->_numvars : 1;
+	scan->_cols = (pbg_column**) malloc(size * sizeof(pbg_column*));
+	scan->_row = (pbg_field*) malloc(size * sizeof(pbg_field));
+	scan->_numbers = (pbg_lt_number*) malloc(size * sizeof(pbg_lt_number));
+	scan->_dates = (pbg_lt_date*) malloc(size * sizeof(pbg_lt_date));
+	if(scan->_cols == NULL || scan->_row == NULL || scan->_numbers == NULL || 
+			scan->_dates == NULL) {
+		pbg_scan_free(scan);
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return 0;
+	}
+	
+	/* Bind every VAR to its column. */
+	for(i = 0; i < e->_numvars; i++) {
+		var = e->_variables+i;
+		scan->_cols[i] = pbg_batch_column(batch, (char*) var->_data, var->_int);
+	}
+	
+	/* Fuse every comparison, so they can be scanned a block at a time. */
+	scan->_prog = pbg_program_init(e, err, 0, 0);
+	if(scan->_prog == NULL) {
+		pbg_scan_free(scan);
+		return 0;
+	}
+	pbg_compile_r(e, scan->_prog, 1, 1);
+	return 1;
+}
+
+/**
+ * Resolves every VAR for a single row. The fields point into the batch or into
+ * storage held by the scan, so nothing is allocated.
+ * @param scan  Scan to load the row into.
+ * @param row   Row to load.
+ */
+void pbg_scan_load(pbg_scan* scan, int row)
+{
+	int i, j, start;
+	pbg_column* col;
+	pbg_field* field;
+	if(scan->_loaded == row) return;
+	for(i = 0; i < scan->_numvars; i++) {
+		col = scan->_cols[i];
+		field = scan->_row+i;
+		field->_type = PBG_NULL;
+		field->_int = 0;
+		field->_data = NULL;
+		if(col == NULL || !pbg_bitmap_word(col->_valid, col->_offset+row, 1))
+			continue;
+		j = col->_offset+row;
+		switch(col->_type) {
+			case PBG_LT_TP_NUMBER:
+				scan->_numbers[i]._val = ((double*) col->_values)[j];
+				field->_type = PBG_LT_NUMBER;
+				field->_int = sizeof(pbg_lt_number);
+				field->_data = scan->_numbers+i;
+				break;
+			case PBG_LT_TP_DATE:
+				pbg_date_from_days(scan->_dates+i, ((int*) col->_values)[j]);
+				field->_type = PBG_LT_DATE;
+				field->_int = sizeof(pbg_lt_date);
+				field->_data = scan->_dates+i;
+				break;
+			case PBG_LT_TP_STRING:
+				start = col->_offsets[j];
+				field->_type = PBG_LT_STRING;
+				field->_int = col->_offsets[j+1] - start;
+				field->_data = (char*) col->_values + start;
+				break;
+			case PBG_LT_TP_BOOL:
+				field->_type = pbg_bitmap_word(col->_values, j, 1) ? 
+						PBG_LT_TRUE : PBG_LT_FALSE;
+				break;
+			default:
+				break;
+		}
+	}
+	scan->_loaded = row;
+}
+
+/**
+ * Runs a node one row at a time, for nodes that cannot be scanned as a block.
+ * The VARs of the expression must be the resolved VARs of the scan.
+ * @param e     PBG expression being evaluated.
+ * @param scan  Scan holding the current block.
+ * @param node  Node to run.
+ * @param need  Rows of the block to run the node for.
+ * @param t     Set to the rows for which the node is TRUE.
+ * @param x     Set to the rows for which the node is PBG_ERROR.
+ */
+void pbg_scan_rows(pbg_expr* e, pbg_scan* scan, pbg_node* node, unsigned long need, 
+		unsigned long* t, unsigned long* x)
+{
+	int i, result;
+	pbg_error rowerr;
+	for(i = 0; i < scan->_len; i++) {
+		if(((need >> i) & 1UL) == 0)
+			continue;
+		pbg_scan_load(scan, scan->_start+i);
+		pbg_err_init(&rowerr, PBG_ERR_NONE, 0, NULL, 0, NULL);
+		result = pbg_run_r(e, &rowerr, scan->_prog, node);
+		pbg_error_free(&rowerr);
+		if(result == PBG_TRUE)  *t |= 1UL << i;
+		if(result == PBG_ERROR) *x |= 1UL << i;
+	}
+}
+
+/**
+ * Gets the rows of the current block a fused comparison accepts, from the rows
+ * where the VAR is less than, equal to, and greater than the constant.
+ * @param node  Fused node being scanned.
+ * @param lt    Rows where the VAR is less than the constant.
+ * @param eq    Rows where the VAR equals the constant.
+ * @param gt    Rows where the VAR is greater than the constant.
+ * @return the rows for which the node is TRUE.
+ */
+unsigned long pbg_scan_accept(pbg_node* node, unsigned long lt, unsigned long eq, 
+		unsigned long gt)
+{
+	return (node->_accept[0] ? lt : 0) | (node->_accept[1] ? eq : 0) | 
+			(node->_accept[2] ? gt : 0);
+}
+
+/**
+ * Scans a fused comparison or set lookup on a NUMBER column over the current 
+ * block. Orders are worked out as in pbg_run_number_order, so NaN is equal in
+ * order to everything.
+ * @param scan  Scan holding the current block.
+ * @param col   NUMBER column of the VAR.
+ * @param node  Fused node to scan.
+ * @return the rows for which the node is TRUE, NULL rows included.
+ */
+unsigned long pbg_scan_numbers(pbg_scan* scan, pbg_column* col, pbg_node* node)
+{
+	int i, len;
+	unsigned long lt, eq, gt, mask;
+	double c, *vals;
+	vals = (double*) col->_values + col->_offset + scan->_start;
+	len = scan->_len;
+	mask = pbg_word_mask(len);
+	c = node->_number._val;
+	lt = eq = gt = 0;
+	if(node->_run == pbg_run_number_in) {
+		for(i = 0; i < len; i++)
+			eq |= (unsigned long) (pbg_member_find(node, vals+i, 0) != 0) << i;
+		return pbg_scan_accept(node, 0, eq, ~eq & mask);
+	}
+	if(node->_run == pbg_run_number_eq) {
+		for(i = 0; i < len; i++)
+			eq |= (unsigned long) (memcmp(vals+i, &c, sizeof(double)) == 0) << i;
+		return pbg_scan_accept(node, 0, eq, ~eq & mask);
+	}
+	for(i = 0; i < len; i++) {
+		lt |= (unsigned long) (vals[i] < c) << i;
+		gt |= (unsigned long) (vals[i] > c) << i;
+	}
+	eq = ~lt & ~gt & mask;
+	return node->_swap ? pbg_scan_accept(node, gt, eq, lt) : 
+			pbg_scan_accept(node, lt, eq, gt);
+}
+
+/**
+ * Scans a fused comparison or set lookup on a DATE column over the current 
+ * block. Rows are compared as days when the constant is on the calendar, and
+ * as dates otherwise.
+ * @param scan  Scan holding the current block.
+ * @param col   DATE column of the VAR.
+ * @param node  Fused node to scan.
+ * @return the rows for which the node is TRUE, NULL rows included.
+ */
+unsigned long pbg_scan_dates(pbg_scan* scan, pbg_column* col, pbg_node* node)
+{
+	int i, len, cmp, *vals;
+	long days;
+	unsigned long lt, eq, gt, mask;
+	pbg_lt_date date;
+	vals = (int*) col->_values + col->_offset + scan->_start;
+	len = scan->_len;
+	mask = pbg_word_mask(len);
+	lt = eq = gt = 0;
+	if(node->_run == pbg_run_date_in) {
+		for(i = 0; i < len; i++) {
+			pbg_date_from_days(&date, vals[i]);
+			eq |= (unsigned long) (pbg_member_find(node, &date, 0) != 0) << i;
+		}
+		return pbg_scan_accept(node, 0, eq, ~eq & mask);
+	}
+	days = pbg_days_from_date(&node->_date);
+	pbg_date_from_days(&date, days);
+	if(memcmp(&date, &node->_date, sizeof(pbg_lt_date)) == 0) {
+		for(i = 0; i < len; i++) {
+			lt |= (unsigned long) (vals[i] < days) << i;
+			gt |= (unsigned long) (vals[i] > days) << i;
+		}
+		eq = ~lt & ~gt & mask;
+	}else{
+		/* No row equals a DATE off the calendar, but it is still ordered. */
+		for(i = 0; i < len; i++) {
+			pbg_date_from_days(&date, vals[i]);
+			cmp = pbg_cmpdate(&date, &node->_date);
+			lt |= (unsigned long) (cmp < 0) << i;
+			gt |= (unsigned long) (cmp > 0) << i;
+		}
+	}
+	if(node->_run == pbg_run_date_eq)
+		return pbg_scan_accept(node, 0, eq, ~eq & mask);
+	return node->_swap ? pbg_scan_accept(node, gt, eq, lt) : 
+			pbg_scan_accept(node, lt, eq, gt);
+}
+
+/**
+ * Scans a fused comparison or set lookup on a STRING column over the current
+ * block.
+ * @param scan  Scan holding the current block.
+ * @param col   STRING column of the VAR.
+ * @param node  Fused node to scan.
+ * @return the rows for which the node is TRUE, NULL rows included.
+ */
+unsigned long pbg_scan_strings(pbg_scan* scan, pbg_column* col, pbg_node* node)
+{
+	int i, n, len, cmp, *offs;
+	unsigned long lt, eq, gt, mask;
+	char* chars;
+	offs = col->_offsets + col->_offset + scan->_start;
+	chars = (char*) col->_values;
+	len = scan->_len;
+	mask = pbg_word_mask(len);
+	lt = eq = gt = 0;
+	if(node->_run == pbg_run_string_in) {
+		for(i = 0; i < len; i++)
+			eq |= (unsigned long) (pbg_member_find(node, chars + offs[i], 
+					offs[i+1] - offs[i]) != 0) << i;
+		return pbg_scan_accept(node, 0, eq, ~eq & mask);
+	}
+	if(node->_run == pbg_run_string_eq) {
+		for(i = 0; i < len; i++)
+			eq |= (unsigned long) (offs[i+1] - offs[i] == node->_n && 
+					memcmp(chars + offs[i], node->_str, node->_n) == 0) << i;
+		return pbg_scan_accept(node, 0, eq, ~eq & mask);
+	}
+	/* pbg_cmpstring is not symmetric, so compare in the order written. */
+	for(i = 0; i < len; i++) {
+		n = offs[i+1] - offs[i];
+		cmp = node->_swap ? pbg_cmpstring(node->_str, node->_n, chars + offs[i], n) : 
+				pbg_cmpstring(chars + offs[i], n, node->_str, node->_n);
+		lt |= (unsigned long) (cmp < 0) << i;
+		gt |= (unsigned long) (cmp > 0) << i;
+	}
+	eq = ~lt & ~gt & mask;
+	return pbg_scan_accept(node, lt, eq, gt);
+}
+
+/**
+ * Scans a fused EQ or NEQ on a BOOL column over the current block. The rows are
+ * a bitmap, so the whole block is compared at once.
+ * @param scan  Scan holding the current block.
+ * @param col   BOOL column of the VAR.
+ * @param node  Fused node to scan.
+ * @return the rows for which the node is TRUE, NULL rows included.
+ */
+unsigned long pbg_scan_bools(pbg_scan* scan, pbg_column* col, pbg_node* node)
+{
+	unsigned long eq, mask;
+	mask = pbg_word_mask(scan->_len);
+	eq = pbg_bitmap_word(col->_values, col->_offset + scan->_start, scan->_len);
+	if(!node->_n)
+		eq = ~eq & mask;
+	return pbg_scan_accept(node, 0, eq, ~eq & mask);
+}
+
+/**
+ * Scans a fused comparison or a set lookup over the current block. A set lookup
+ * scans as an EQ whose constant is the whole set. NULL rows are errors, as in 
+ * the interpreter, and so are the rows of a column whose type cannot be 
+ * ordered against the constant. The kind of comparison is picked once, and 
+ * each kind has its own loop over the block.
+ * @param scan  Scan holding the current block.
+ * @param node  Fused node to scan.
+ * @param t     Set to the rows for which the node is TRUE.
+ * @param x     Set to the rows for which the node is PBG_ERROR.
+ * @return 1 if the node was scanned, 0 if it must be run row by row.
+ */
+int pbg_scan_cmp(pbg_scan* scan, pbg_node* node, unsigned long* t, unsigned long* x)
+{
+	unsigned long valid;
+	pbg_field_type type;
+	pbg_column* col;
+	col = scan->_cols[node->_var];
+	
+	/* Missing columns are NULL in every row. */
+	if(col == NULL) {
+		*x = pbg_word_mask(scan->_len);
+		return 1;
+	}
+	if(node->_run == pbg_run_number_eq || node->_run == pbg_run_number_order || 
+			node->_run == pbg_run_number_in)
+		type = PBG_LT_TP_NUMBER;
+	else if(node->_run == pbg_run_date_eq || node->_run == pbg_run_date_order || 
+			node->_run == pbg_run_date_in)
+		type = PBG_LT_TP_DATE;
+	else if(node->_run == pbg_run_string_eq || node->_run == pbg_run_string_order || 
+			node->_run == pbg_run_string_in)
+		type = PBG_LT_TP_STRING;
+	else if(node->_run == pbg_run_bool_eq)
+		type = PBG_LT_TP_BOOL;
+	else
+		return 0;
+	
+	valid = pbg_bitmap_word(col->_valid, col->_offset + scan->_start, scan->_len);
+	*x = ~valid & pbg_word_mask(scan->_len);
+	
+	/* A column of another type never equals the constant, and cannot be 
+	 * ordered against it. This holds for BOOL columns too: their rows are 
+	 * TRUE or FALSE, which the interpreter never finds equal to a NUMBER, 
+	 * DATE, or STRING. */
+	if(col->_type != type) {
+		if(node->_run == pbg_run_number_eq || node->_run == pbg_run_date_eq || 
+				node->_run == pbg_run_string_eq || node->_run == pbg_run_bool_eq || 
+				pbg_node_isset(node))
+			*t = node->_accept[2] ? valid : 0;
+		else
+			*x = pbg_word_mask(scan->_len);
+		return 1;
+	}
+	if(type == PBG_LT_TP_NUMBER)
+		*t = pbg_scan_numbers(scan, col, node) & valid;
+	else if(type == PBG_LT_TP_DATE)
+		*t = pbg_scan_dates(scan, col, node) & valid;
+	else if(type == PBG_LT_TP_STRING)
+		*t = pbg_scan_strings(scan, col, node) & valid;
+	else
+		*t = pbg_scan_bools(scan, col, node) & valid;
+	return 1;
+}
+
+/**
+ * Scans an interval test over the current block. NULL rows are errors. Rows the
+ * test cannot decide on its own, and columns that do not hold the type of its
+ * bounds, are scanned through the children of the test instead.
+ * @param e     PBG expression being evaluated.
+ * @param scan  Scan holding the current block.
+ * @param node  Node of the interval test.
+ * @param need  Rows of the block whose result is needed.
+ * @param t     Set to the rows for which the node is TRUE.
+ * @param x     Set to the rows for which the node is PBG_ERROR.
+ */
+void pbg_scan_range(pbg_expr* e, pbg_scan* scan, pbg_node* node, unsigned long need, 
+		unsigned long* t, unsigned long* x)
+{
+	int i, isdate, *days;
+	unsigned long valid, slow, kt, kx;
+	double val;
+	pbg_lt_date date;
+	pbg_column* col;
+	col = scan->_cols[node->_var];
+	if(col == NULL) {
+		*x = need;
+		return;
+	}
+	isdate = (node->_run == pbg_run_date_range);
+	if(col->_type != (isdate ? PBG_LT_TP_DATE : PBG_LT_TP_NUMBER)) {
+		pbg_scan_kids(e, scan, node, need, t, x);
+		return;
+	}
+	valid = pbg_bitmap_word(col->_valid, col->_offset + scan->_start, scan->_len);
+	*x = ~valid & need;
+	if(isdate) {
+		days = (int*) col->_values + col->_offset + scan->_start;
+		for(i = 0; i < scan->_len; i++) {
+			pbg_date_from_days(&date, days[i]);
+			if(node->_regions[pbg_range_region_date((pbg_lt_date*) node->_bounds, 
+					node->_numbounds, &date)])
+				*t |= 1UL << i;
+		}
+		*t &= need & valid;
+		return;
+	}
+	slow = 0;
+	for(i = 0; i < scan->_len; i++) {
+		if(((need & valid) >> i & 1UL) == 0)
+			continue;
+		val = ((double*) col->_values)[col->_offset + scan->_start+i];
+		if(val != val || val == 0)
+			slow |= 1UL << i;
+		else if(node->_regions[pbg_range_region((pbg_lt_number*) node->_bounds, 
+				node->_numbounds, val)])
+			*t |= 1UL << i;
+	}
+	if(slow != 0) {
+		pbg_scan_kids(e, scan, node, slow, &kt, &kx);
+		*t |= kt;
+		*x |= kx;
+	}
+}
+
+/**
+ * Scans the children of an AND or OR over the current block, with the same 
+ * short-circuiting as the interpreter: a row stays live until a child decides
+ * it. Interval tests are scanned as the AND or OR they were compiled from.
+ * @param e     PBG expression being evaluated.
+ * @param scan  Scan holding the current block.
+ * @param node  Node of the AND or OR.
+ * @param need  Rows of the block whose result is needed.
+ * @param t     Set to the needed rows for which the node is TRUE.
+ * @param x     Set to the needed rows for which the node is PBG_ERROR.
+ */
+void pbg_scan_kids(pbg_expr* e, pbg_scan* scan, pbg_node* node, unsigned long need, 
+		unsigned long* t, unsigned long* x)
+{
+	int i, isand;
+	unsigned long live, kt, kx;
+	isand = (node->_field->_type == PBG_OP_AND);
+	*t = 0, *x = 0;
+	live = need;
+	for(i = 0; i < node->_numkids && live != 0; i++) {
+		pbg_scan_r(e, scan, node->_kids[i], live, &kt, &kx);
+		*x |= kx;
+		if(isand)
+			live &= kt & ~kx;
+		else {
+			*t |= kt & ~kx;
+			live &= ~kt & ~kx;
+		}
+	}
+	if(isand)
+		*t = live;
+}
+
+/**
+ * Scans a TYPE over the current block. Constants have the same type in every
+ * row, and a VAR has the type of its column in every row that is not NULL, so
+ * no row has to be run on its own. A TYPE whose first argument is not a type
+ * literal is run row by row, which reports the error.
+ * @param e     PBG expression being evaluated.
+ * @param scan  Scan holding the current block.
+ * @param node  Node of the TYPE.
+ * @param need  Rows of the block whose result is needed.
+ * @param t     Set to the needed rows for which the node is TRUE.
+ * @param x     Set to the needed rows for which the node is PBG_ERROR.
+ */
+void pbg_scan_type(pbg_expr* e, pbg_scan* scan, pbg_node* node, unsigned long need, 
+		unsigned long* t, unsigned long* x)
+{
+	int i, childi;
+	pbg_field_type tp;
+	pbg_column* col;
+	tp = pbg_field_get(e, ((int*)node->_field->_data)[0])->_type;
+	if(tp <= PBG_MIN_LT_TP || tp >= PBG_MAX_LT_TP) {
+		pbg_scan_rows(e, scan, node, need, t, x);
+		return;
+	}
+	*t = need;
+	for(i = 1; i < node->_field->_int && *t != 0; i++) {
+		childi = ((int*)node->_field->_data)[i];
+		if(childi > 0) {
+			if(!pbg_type_istype(tp, pbg_field_get(e, childi)->_type))
+				*t = 0;
+			continue;
+		}
+		/* Columns hold a single type literal, and NULL rows have no type. */
+		col = scan->_cols[-(childi+1)];
+		if(col == NULL || col->_type != tp)
+			*t = 0;
+		else
+			*t &= pbg_bitmap_word(col->_valid, col->_offset + scan->_start, scan->_len);
+	}
+}
+
+/**
+ * Scans a node over the current block. ANDs, ORs, and NOTs combine the masks
+ * of their children, with the same short-circuiting as the interpreter. The
+ * VARs of the expression must be the resolved VARs of the scan.
+ * @param e     PBG expression being evaluated.
+ * @param scan  Scan holding the current block.
+ * @param node  Node to scan.
+ * @param need  Rows of the block whose result is needed.
+ * @param t     Set to the needed rows for which the node is TRUE.
+ * @param x     Set to the needed rows for which the node is PBG_ERROR.
+ */
+void pbg_scan_r(pbg_expr* e, pbg_scan* scan, pbg_node* node, unsigned long need, 
+		unsigned long* t, unsigned long* x)
+{
+	unsigned long kt, kx, valid;
+	pbg_column* col;
+	*t = 0, *x = 0;
+	if(node->_run == pbg_run_true) {
+		*t = need;
+	}else if(node->_run == pbg_run_false) {
+		/* Nothing is TRUE. */
+	}else if(node->_run == pbg_run_not) {
+		pbg_scan_r(e, scan, node->_kids[0], need, &kt, &kx);
+		*t = ~kt & ~kx;
+		*x = kx;
+	}else if(node->_run == pbg_run_and || node->_run == pbg_run_or) {
+		pbg_scan_kids(e, scan, node, need, t, x);
+	}else if(node->_run == pbg_run_var) {
+		/* Only BOOL columns can be evaluated; anything else is an error. */
+		col = scan->_cols[node->_var];
+		if(col != NULL && col->_type == PBG_LT_TP_BOOL) {
+			valid = pbg_bitmap_word(col->_valid, col->_offset + scan->_start, scan->_len);
+			*t = pbg_bitmap_word(col->_values, col->_offset + scan->_start, 
+					scan->_len) & valid;
+			*x = ~valid;
+		}else
+			*x = need;
+	}else if(node->_run == pbg_run_exst_var) {
+		col = scan->_cols[node->_var];
+		valid = (col == NULL) ? 0 : 
+				pbg_bitmap_word(col->_valid, col->_offset + scan->_start, scan->_len);
+		*t = (node->_accept[1] ? valid : 0) | (node->_accept[0] ? ~valid : 0);
+	}else if(node->_run == pbg_run_number_range || node->_run == pbg_run_date_range) {
+		pbg_scan_range(e, scan, node, need, t, x);
+	}else if(node->_run == pbg_run_field && node->_field->_type == PBG_OP_TYPE) {
+		pbg_scan_type(e, scan, node, need, t, x);
+	}else if((!pbg_node_isfused(node) && !pbg_node_isset(node)) || 
+			!pbg_scan_cmp(scan, node, t, x)) {
+		*t = 0, *x = 0;
+		pbg_scan_rows(e, scan, node, need, t, x);
+	}
+	*t &= need;
+	*x &= need;
+}
+
+/**
+ * Scans the expression over a block of rows. The block holds PBG_WORD_BITS
+ * rows, or fewer if the scan ends sooner.
+ * @param e      PBG expression being evaluated.
+ * @param scan   Scan of the batch.
+ * @param start  First row of the block.
+ * @param end    Row after the last row of the scan.
+ * @param x      Set to the rows of the block for which e is PBG_ERROR.
+ * @return the rows of the block for which e is TRUE.
+ */
+unsigned long pbg_scan_block(pbg_expr* e, pbg_scan* scan, int start, int end, 
+		unsigned long* x)
+{
+	unsigned long t;
+	pbg_field* vars;
+	scan->_start = start;
+	scan->_len = end - start;
+	if(scan->_len > PBG_WORD_BITS) scan->_len = PBG_WORD_BITS;
+	/* Swap in the resolved VARs, as pbg_evaluate_dict does. */
+	vars = e->_variables;
+	e->_variables = scan->_row;
+	pbg_scan_r(e, scan, scan->_prog->_nodes, pbg_word_mask(scan->_len), &t, x);
+	e->_variables = vars;
+	return t;
+}
+
+int pbg_evaluate_batch(pbg_expr* e, pbg_error* err, pbg_batch* batch, 
+		unsigned char* selection)
+{
+	return pbg_evaluate_batch_errors(e, err, batch, selection, NULL);
+}
+
+int pbg_evaluate_batch_errors(pbg_expr* e, pbg_error* err, pbg_batch* batch, 
+		unsigned char* selection, unsigned char* errors)
+{
+	int i, start, count;
+	unsigned long t, x;
+	pbg_scan scan;
+	
+	/* Always start with a clean error! */
+	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	
+	if(!pbg_scan_init(&scan, e, err, batch))
+		return PBG_ERROR;
+	count = 0;
+	for(start = 0; start < batch->_numrows; start += PBG_WORD_BITS) {
+		t = pbg_scan_block(e, &scan, start, batch->_numrows, &x);
+		count += pbg_popcount(t);
+		/* Blocks start on a byte, so the masks are stored a byte at a time. */
+		for(i = 0; i < scan._len; i += 8) {
+			selection[(start+i)/8] = (unsigned char) ((t >> i) & 0xFF);
+			if(errors != NULL)
+				errors[(start+i)/8] = (unsigned char) ((x >> i) & 0xFF);
+		}
+	}
+	pbg_scan_free(&scan);
+	return count;
+}
+
+int pbg_count_batch(pbg_expr* e, pbg_error* err, pbg_batch* batch)
+{
+	int start, count;
+	unsigned long x;
+	pbg_scan scan;
+	
+	/* Always start with a clean error! */
+	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	
+	if(!pbg_scan_init(&scan, e, err, batch))
+		return PBG_ERROR;
+	count = 0;
+	for(start = 0; start < batch->_numrows; start += PBG_WORD_BITS)
+		count += pbg_popcount(pbg_scan_block(e, &scan, start, batch->_numrows, &x));
+	pbg_scan_free(&scan);
+	return count;
+}
+
+int pbg_any_batch(pbg_expr* e, pbg_error* err, pbg_batch* batch, int start, 
+		int end, int* row)
+{
+	int i, result;
+	unsigned long t, x;
+	pbg_scan scan;
+	
+	/* Always start with a clean error! */
+	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	
+	if(start < 0 || end > batch->_numrows || start > end) {
+		pbg_err_state(err, __LINE__, __FILE__, 
+				"Range of rows must lie within the batch.");
+		return PBG_ERROR;
+	}
+	if(!pbg_scan_init(&scan, e, err, batch))
+		return PBG_ERROR;
+	/* Stop at the first block holding a match. */
+	result = PBG_FALSE;
+	for(; start < end && result == PBG_FALSE; start += PBG_WORD_BITS) {
+		t = pbg_scan_block(e, &scan, start, end, &x);
+		if(t == 0)
+			continue;
+		for(i = 0; ((t >> i) & 1UL) == 0; i++);
+		if(row != NULL)
+			*row = start+i;
+		result = PBG_TRUE;
+	}
+	pbg_scan_free(&scan);
+	return result;
+}
+
+void pbg_aggregate(pbg_expr* e, pbg_error* err, pbg_batch* batch, char* target, 
+		pbg_agg* agg)
+{
+	int i, start;
+	unsigned long t, x;
+	double val;
+	pbg_column* col;
+	pbg_scan scan;
+	
+	/* Always start with a clean error! */
+	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	
+	agg->_matches = 0;
+	agg->_count = 0;
+	agg->_sum = agg->_min = agg->_max = 0;
+	col = pbg_batch_column(batch, target, strlen(target));
+	if(col == NULL || col->_type != PBG_LT_TP_NUMBER) {
+		pbg_err_state(err, __LINE__, __FILE__, 
+				"Aggregate target must be a NUMBER column.");
+		return;
+	}
+	if(!pbg_scan_init(&scan, e, err, batch))
+		return;
+	for(start = 0; start < batch->_numrows; start += PBG_WORD_BITS) {
+		t = pbg_scan_block(e, &scan, start, batch->_numrows, &x);
+		agg->_matches += pbg_popcount(t);
+		/* Fold in the block's values while they are at hand. */
+		t &= pbg_bitmap_word(col->_valid, col->_offset+start, scan._len);
+		for(i = 0; t != 0; i++, t >>= 1) {
+			if((t & 1UL) == 0)
+				continue;
+			val = ((double*) col->_values)[col->_offset+start+i];
+			if(agg->_count == 0 || val < agg->_min) agg->_min = val;
+			if(agg->_count == 0 || val > agg->_max) agg->_max = val;
+			agg->_sum += val;
+			agg->_count++;
+		}
+	}
+	pbg_scan_free(&scan);
+}
+
+
+/*********************
+ *                   *
+ * ANALYSIS TOOLKIT  *
+ *                   *
+ *********************/
+
+/**
+ * Gets the type bits of a field type.
+ * @param type  Type of a field.
+ * @return the PBG_AN_* bits a field of that type may have, 0 if it is not a
+ *         value, e.g. a type literal.
+ */
+int pbg_an_typebits(pbg_field_type type)
+{
+	switch(type) {
+		case PBG_LT_NUMBER: return PBG_AN_NUMBER;
+		case PBG_LT_DATE:   return PBG_AN_DATE;
+		case PBG_LT_STRING: return PBG_AN_STRING;
+		case PBG_LT_TRUE:   return PBG_AN_TRUE;
+		case PBG_LT_FALSE:  return PBG_AN_FALSE;
+		default: return pbg_type_isbool(type) ? PBG_AN_TRUE | PBG_AN_FALSE : 0;
+	}
+}
+
+/**
+ * Compares two constants of the same type. NUMBERs and DATEs are ordered, and
+ * STRINGs are only told apart.
+ * @param c1  First constant.
+ * @param c2  Second constant.
+ * @return <0, 0, or >0 as c1 is less than, equal to, or greater than c2.
+ */
+int pbg_an_compare(pbg_field* c1, pbg_field* c2)
+{
+	if(c1->_type == PBG_LT_NUMBER)
+		return pbg_cmpnumber(c1->_data, c2->_data);
+	if(c1->_type == PBG_LT_DATE)
+		return pbg_cmpdate(c1->_data, c2->_data);
+	return c1->_int != c2->_int || memcmp(c1->_data, c2->_data, c1->_int) != 0;
+}
+
+/**
+ * Narrows the values a VAR of one type may have.
+ * @param range  Values the VAR may have.
+ * @param rel    The VAR must be EQ, NEQ, LT, GT, LTE, or GTE to c.
+ * @param c      Constant of the type.
+ */
+void pbg_an_bound(pbg_an_range* range, pbg_field_type rel, pbg_field* c)
+{
+	int cmp, strict;
+	strict = (rel == PBG_OP_LT || rel == PBG_OP_GT);
+	switch(rel) {
+		case PBG_OP_EQ:
+			if(range->_eq != NULL && pbg_an_compare(range->_eq, c) != 0)
+				range->_empty = 1;
+			range->_eq = c;
+			break;
+		case PBG_OP_NEQ:
+			/* Past the limit, the value is simply not excluded. */
+			if(range->_numne < PBG_AN_EXCLUDED)
+				range->_ne[range->_numne++] = c;
+			break;
+		case PBG_OP_GT:
+		case PBG_OP_GTE:
+			cmp = (range->_lo == NULL) ? 1 : pbg_an_compare(c, range->_lo);
+			if(cmp > 0 || (cmp == 0 && strict)) {
+				range->_lo = c;
+				range->_lostrict = strict;
+			}
+			break;
+		case PBG_OP_LT:
+		case PBG_OP_LTE:
+			cmp = (range->_hi == NULL) ? -1 : pbg_an_compare(c, range->_hi);
+			if(cmp < 0 || (cmp == 0 && strict)) {
+				range->_hi = c;
+				range->_histrict = strict;
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ * Checks if no value is left in a range.
+ * @param range    Values a VAR of one type may have.
+ * @param ordered  1 if the type is ordered, 0 for STRINGs.
+ * @return 1 if the range is empty, 0 if it may not be.
+ */
+int pbg_an_isempty(pbg_an_range* range, int ordered)
+{
+	int i, cmp;
+	pbg_field* point;
+	if(range->_empty)
+		return 1;
+	point = range->_eq;
+	if(ordered && range->_lo != NULL && range->_hi != NULL) {
+		cmp = pbg_an_compare(range->_lo, range->_hi);
+		if(cmp > 0 || (cmp == 0 && (range->_lostrict || range->_histrict)))
+			return 1;
+		if(cmp == 0 && point == NULL)
+			point = range->_lo;
+	}
+	if(point == NULL)
+		return 0;
+	if(ordered && range->_lo != NULL) {
+		cmp = pbg_an_compare(point, range->_lo);
+		if(cmp < 0 || (cmp == 0 && range->_lostrict))
+			return 1;
+	}
+	if(ordered && range->_hi != NULL) {
+		cmp = pbg_an_compare(point, range->_hi);
+		if(cmp > 0 || (cmp == 0 && range->_histrict))
+			return 1;
+	}
+	for(i = 0; i < range->_numne; i++)
+		if(pbg_an_compare(point, range->_ne[i]) == 0)
+			return 1;
+	return 0;
+}
+
+/**
+ * Restricts the types a VAR may have, dropping types with no values left.
+ * @param var    VAR to restrict.
+ * @param types  Types the VAR may have, as PBG_AN_* bits.
+ * @return 1 if the VAR may still have some type, 0 otherwise.
+ */
+int pbg_an_restrict(pbg_an_var* var, int types)
+{
+	var->_types &= types;
+	if(!var->_nan && pbg_an_isempty(var->_ranges, 1))
+		var->_types &= ~PBG_AN_NUMBER;
+	if(pbg_an_isempty(var->_ranges+1, 1))
+		var->_types &= ~PBG_AN_DATE;
+	if(pbg_an_isempty(var->_ranges+2, 0))
+		var->_types &= ~PBG_AN_STRING;
+	return var->_types != 0;
+}
+
+/**
+ * Applies a comparison between a VAR and a NUMBER, DATE, or STRING constant 
+ * to the VAR. Other comparisons are left alone.
+ * @param an      Analysis in progress.
+ * @param vars    Values each VAR may have.
+ * @param field   Comparison field.
+ * @param want    Result the comparison must have.
+ * @return 1 if the comparison may have that result, 0 otherwise.
+ */
+int pbg_an_cmp(pbg_an* an, pbg_an_var* vars, pbg_field* field, int want)
+{
+	int child0, child1, bits, isnan;
+	pbg_field* c;
+	pbg_field_type rel;
+	pbg_an_var* var;
+	pbg_an_range* range;
+	if(field->_int != 2) return 1;
+	child0 = ((int*)field->_data)[0];
+	child1 = ((int*)field->_data)[1];
+	if((child0 < 0) == (child1 < 0)) return 1;
+	c = pbg_field_get(an->_expr, (child0 < 0) ? child1 : child0);
+	var = vars + an->_canon[-((child0 < 0) ? child0 : child1) - 1];
+	bits = pbg_an_typebits(c->_type);
+	if(bits != PBG_AN_NUMBER && bits != PBG_AN_DATE && bits != PBG_AN_STRING)
+		return 1;
+	/* NaN compares as equal in order to everything, so say nothing about it. */
+	if(bits == PBG_AN_NUMBER && ((pbg_lt_number*) c->_data)->_val != 
+			((pbg_lt_number*) c->_data)->_val)
+		return 1;
+	range = var->_ranges + (bits == PBG_AN_NUMBER ? 0 : bits == PBG_AN_DATE ? 1 : 2);
+	
+	/* Put the VAR first. */
+	rel = field->_type;
+	if(child1 < 0) {
+		if(rel == PBG_OP_LT) rel = PBG_OP_GT;
+		else if(rel == PBG_OP_GT) rel = PBG_OP_LT;
+		else if(rel == PBG_OP_LTE) rel = PBG_OP_GTE;
+		else if(rel == PBG_OP_GTE) rel = PBG_OP_LTE;
+	}
+	
+	/* EQ and NEQ are never errors, unless the VAR is NULL. */
+	if(rel == PBG_OP_EQ || rel == PBG_OP_NEQ) {
+		if(want == PBG_ERROR)
+			return pbg_an_restrict(var, PBG_AN_NULL);
+		if((rel == PBG_OP_EQ) == (want == PBG_TRUE)) {
+			var->_nan = 0;
+			pbg_an_bound(range, PBG_OP_EQ, c);
+			return pbg_an_restrict(var, bits);
+		}
+		/* EQ tells 0 from -0, so they are not excluded. */
+		if(bits != PBG_AN_NUMBER || ((pbg_lt_number*) c->_data)->_val != 0)
+			pbg_an_bound(range, PBG_OP_NEQ, c);
+		return pbg_an_restrict(var, PBG_AN_ANY & ~PBG_AN_NULL);
+	}
+	
+	/* Anything but a VAR of the constant's type is an error. */
+	if(want == PBG_ERROR)
+		return pbg_an_restrict(var, PBG_AN_ANY & ~bits);
+	if(bits == PBG_AN_STRING)
+		return pbg_an_restrict(var, bits);
+	if(bits == PBG_AN_NUMBER) {
+		isnan = (rel == PBG_OP_LTE || rel == PBG_OP_GTE) ? PBG_TRUE : PBG_FALSE;
+		if(isnan != want) var->_nan = 0;
+	}
+	if(want == PBG_FALSE) {
+		if(rel == PBG_OP_LT) rel = PBG_OP_GTE;
+		else if(rel == PBG_OP_GT) rel = PBG_OP_LTE;
+		else if(rel == PBG_OP_LTE) rel = PBG_OP_GT;
+		else rel = PBG_OP_LT;
+	}
+	pbg_an_bound(range, rel, c);
+	return pbg_an_restrict(var, bits);
+}
+
+/**
+ * Applies a TYPE field to its VARs.
+ * @param an      Analysis in progress.
+ * @param vars    Values each VAR may have.
+ * @param field   TYPE field.
+ * @param want    Result the field must have.
+ * @return 1 if the field may have that result, 0 otherwise.
+ */
+int pbg_an_type(pbg_an* an, pbg_an_var* vars, pbg_field* field, int want)
+{
+	int i, kid, bits, numvars, lastvar, mismatch;
+	kid = ((int*)field->_data)[0];
+	if(kid < 0) return 1;
+	/* The first input must be a type literal. */
+	switch(pbg_field_get(an->_expr, kid)->_type) {
+		case PBG_LT_TP_NUMBER: bits = PBG_AN_NUMBER; break;
+		case PBG_LT_TP_DATE:   bits = PBG_AN_DATE; break;
+		case PBG_LT_TP_STRING: bits = PBG_AN_STRING; break;
+		case PBG_LT_TP_BOOL:   bits = PBG_AN_TRUE | PBG_AN_FALSE; break;
+		default: return want == PBG_ERROR;
+	}
+	if(want == PBG_ERROR)
+		return 0;
+	numvars = 0, lastvar = 0, mismatch = 0;
+	for(i = 1; i < field->_int; i++) {
+		kid = ((int*)field->_data)[i];
+		if(kid < 0) {
+			numvars++;
+			lastvar = kid;
+			if(want == PBG_TRUE && !pbg_an_restrict(vars + an->_canon[-kid-1], bits))
+				return 0;
+		}else if((pbg_an_typebits(pbg_field_get(an->_expr, kid)->_type) & bits) == 0)
+			mismatch = 1;
+	}
+	if(want == PBG_TRUE)
+		return !mismatch;
+	/* Only a lone VAR is known to have another type. */
+	if(mismatch || numvars != 1)
+		return mismatch || numvars > 0;
+	return pbg_an_restrict(vars + an->_canon[-lastvar-1], PBG_AN_ANY & ~bits);
+}
+
+/**
+ * Applies a field that is not an AND, OR, or NOT to its VARs.
+ * @param an      Analysis in progress.
+ * @param vars    Values each VAR may have.
+ * @param id      Index of the field.
+ * @param want    Result the field must have.
+ * @return 1 if the field may have that result, 0 otherwise.
+ */
+int pbg_an_atom(pbg_an* an, pbg_an_var* vars, int id, int want)
+{
+	int i, kid, numvars;
+	pbg_field* field;
+	/* A VAR is evaluated as a BOOL. */
+	if(id < 0) {
+		if(want == PBG_ERROR)
+			return pbg_an_restrict(vars + an->_canon[-id-1], 
+					PBG_AN_ANY & ~(PBG_AN_TRUE | PBG_AN_FALSE));
+		return pbg_an_restrict(vars + an->_canon[-id-1], 
+				want == PBG_TRUE ? PBG_AN_TRUE : PBG_AN_FALSE);
+	}
+	field = pbg_field_get(an->_expr, id);
+	switch(field->_type) {
+		case PBG_LT_TRUE:  return want == PBG_TRUE;
+		case PBG_LT_FALSE: return want == PBG_FALSE;
+		case PBG_OP_EQ:
+		case PBG_OP_NEQ:
+		case PBG_OP_LT:
+		case PBG_OP_GT:
+		case PBG_OP_LTE:
+		case PBG_OP_GTE:
+			return pbg_an_cmp(an, vars, field, want);
+		case PBG_OP_TYPE:
+			return pbg_an_type(an, vars, field, want);
+		case PBG_OP_EXST:
+			if(want == PBG_ERROR)
+				return 0;
+			numvars = 0;
+			for(i = 0; i < field->_int; i++) {
+				kid = ((int*)field->_data)[i];
+				if(kid >= 0) continue;
+				numvars++;
+				if(want == PBG_TRUE && !pbg_an_restrict(vars + an->_canon[-kid-1], 
+						PBG_AN_ANY & ~PBG_AN_NULL))
+					return 0;
+			}
+			/* Only a lone VAR is known to be NULL. */
+			if(want == PBG_FALSE && numvars == 1 && field->_int == 1)
+				return pbg_an_restrict(vars + an->_canon[-((int*)field->_data)[0]-1], 
+						PBG_AN_NULL);
+			return want == PBG_TRUE || numvars > 0;
+		case PBG_LAZY:
+			return 1;
+		default:
+			/* Any other value cannot be evaluated as a BOOL. */
+			return want == PBG_ERROR || pbg_type_isbool(field->_type);
+	}
+}
+
+/**
+ * Tries one way for an AND or OR to have a result: its first i children keep
+ * it going, and child i gives the result.
+ * @param an      Analysis in progress.
+ * @param goals   Goals left, which are not changed.
+ * @param n       Number of goals left.
+ * @param vars    Values each VAR may have, which are not changed.
+ * @param field   AND or OR field.
+ * @param i       Child giving the result.
+ * @param want    Result the field must have.
+ * @return 1 if the goals may all be met this way, 0 otherwise.
+ */
+int pbg_an_branch(pbg_an* an, pbg_an_goal* goals, int n, pbg_an_var* vars, 
+		pbg_field* field, int i, int want)
+{
+	int j, numvars, result;
+	pbg_an_goal* copy;
+	pbg_an_var* vcopy;
+	numvars = (an->_expr->_numvars > 0) ? an->_expr->_numvars : 1;
+	copy = (pbg_an_goal*) malloc(an->_cap * sizeof(pbg_an_goal));
+	vcopy = (pbg_an_var*) malloc(numvars * sizeof(pbg_an_var));
+	if(copy == NULL || vcopy == NULL) {
+		free(copy);
+		free(vcopy);
+		an->_failed = 1;
+		return 1;
+	}
+	memcpy(copy, goals, n * sizeof(pbg_an_goal));
+	memcpy(vcopy, vars, an->_expr->_numvars * sizeof(pbg_an_var));
+	for(j = 0; j <= i; j++) {
+		copy[n]._id = ((int*)field->_data)[j];
+		copy[n]._want = (j < i) ? 
+				(field->_type == PBG_OP_AND ? PBG_TRUE : PBG_FALSE) : want;
+		n++;
+	}
+	result = pbg_an_sat(an, copy, n, vcopy);
+	free(copy);
+	free(vcopy);
+	return result;
+}
+
+/**
+ * Checks if a list of goals may all be met at once. ANDs and ORs follow the 
+ * short-circuiting of the interpreter, trying each child that may give their
+ * result in turn. Atoms narrow the types and values of their VARs. What is not
+ * understood is assumed possible, as is everything once the step budget runs
+ * out, so a 0 is always a proof.
+ * @param an     Analysis in progress.
+ * @param goals  Goals to meet, with room for an->_cap goals. Changed.
+ * @param n      Number of goals.
+ * @param vars   Values each VAR may have. Changed.
+ * @return 1 if the goals may all be met, 0 if they cannot be.
+ */
+int pbg_an_sat(pbg_an* an, pbg_an_goal* goals, int n, pbg_an_var* vars)
+{
+	int i, id, want, conj;
+	pbg_field* field;
+	while(n > 0) {
+		if(an->_failed || ++an->_steps > PBG_AN_STEPS)
+			return 1;
+		n--;
+		id = goals[n]._id;
+		want = goals[n]._want;
+		field = (id > 0) ? pbg_field_get(an->_expr, id) : NULL;
+		if(field == NULL || (field->_type != PBG_OP_AND && 
+				field->_type != PBG_OP_OR && field->_type != PBG_OP_NOT)) {
+			if(!pbg_an_atom(an, vars, id, want))
+				return 0;
+			continue;
+		}
+		/* NOT keeps errors, and swaps TRUE and FALSE. */
+		if(field->_type == PBG_OP_NOT) {
+			goals[n]._id = ((int*)field->_data)[0];
+			goals[n]._want = (want == PBG_ERROR) ? want : 
+					(want == PBG_TRUE ? PBG_FALSE : PBG_TRUE);
+			n++;
+			continue;
+		}
+		/* Every child must keep an AND TRUE or an OR FALSE. */
+		conj = (field->_type == PBG_OP_AND) ? PBG_TRUE : PBG_FALSE;
+		if(want == conj) {
+			for(i = 0; i < field->_int; i++) {
+				goals[n]._id = ((int*)field->_data)[i];
+				goals[n]._want = want;
+				n++;
+			}
+			continue;
+		}
+		/* Otherwise some child gives the result. */
+		for(i = 0; i < field->_int; i++)
+			if(pbg_an_branch(an, goals, n, vars, field, i, want))
+				return 1;
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Checks if some fields of the expression may have results all at once.
+ * @param an     Analysis to run.
+ * @param start  Fields and the results they must have, at most 2.
+ * @param n      Number of goals in start.
+ * @return 1 if the goals may all be met, 0 if they cannot be.
+ */
+int pbg_an_query(pbg_an* an, pbg_an_goal* start, int n)
+{
+	int i, numvars, result;
+	pbg_an_goal* goals;
+	pbg_an_var* vars;
+	numvars = (an->_expr->_numvars > 0) ? an->_expr->_numvars : 1;
+	goals = (pbg_an_goal*) malloc(an->_cap * sizeof(pbg_an_goal));
+	vars = (pbg_an_var*) calloc(numvars, sizeof(pbg_an_var));
+	if(goals == NULL || vars == NULL) {
+		free(goals);
+		free(vars);
+		an->_failed = 1;
+		return 1;
+	}
+	for(i = 0; i < an->_expr->_numvars; i++) {
+		vars[i]._types = PBG_AN_ANY;
+		vars[i]._nan = 1;
+	}
+	memcpy(goals, start, n * sizeof(pbg_an_goal));
+	an->_steps = 0;
+	result = pbg_an_sat(an, goals, n, vars);
+	free(goals);
+	free(vars);
+	return result;
+}
+
+/**
+ * Starts an analysis of an expression.
+ * @param an  Analysis to start. Its _canon must be freed when it is done.
+ * @param e   PBG expression to analyze.
+ * @return 1 if successful, 0 if out of memory.
+ */
+int pbg_an_init(pbg_an* an, pbg_expr* e)
+{
+	int i, j, slot, tablecap, *table;
+	pbg_field* field, *var;
+	an->_expr = e;
+	an->_failed = 0;
+	for(tablecap = 2; tablecap < 2*e->_numvars; tablecap *= 2);
+	an->_canon = (int*) malloc((e->_numvars > 0 ? e->_numvars : 1) * sizeof(int));
+	table = (int*) calloc(tablecap, sizeof(int));
+	if(an->_canon == NULL || table == NULL) {
+		free(an->_canon);
+		free(table);
+		an->_canon = NULL;
+		return 0;
+	}
+	
+	/* VARs of the same name are the same VAR. Names are found by hash. */
+	for(i = 0; i < e->_numvars; i++) {
+		var = e->_variables+i;
+		slot = (int) (pbg_hash((char*) var->_data, var->_int) & (tablecap-1));
+		for(j = i; table[slot] != 0; slot = (slot+1) & (tablecap-1))
+			if(pbg_compile_samevar(e, table[slot]-1, i)) {
+				j = table[slot]-1;
+				break;
+			}
+		if(j == i)
+			table[slot] = i+1;
+		an->_canon[i] = j;
+	}
+	free(table);
+	
+	/* Each child is pending at most once at a time, beside two starting goals. */
+	an->_cap = 2;
+	for(i = 0; i < e->_numconst; i++) {
+		field = e->_constants+i;
+		if(field->_type == PBG_OP_AND || field->_type == PBG_OP_OR || 
+				field->_type == PBG_OP_NOT)
+			an->_cap += field->_int;
+	}
+	return 1;
+}
+
+/**
+ * Checks if one field of the expression being analyzed implies another.
+ * @param an   Analysis in progress.
+ * @param id1  Index of the field assumed TRUE.
+ * @param id2  Index of the field to prove TRUE.
+ * @return 1 if id2 is TRUE whenever id1 is, 0 if that was not proven.
+ */
+int pbg_an_implies(pbg_an* an, int id1, int id2)
+{
+	pbg_an_goal goals[2];
+	goals[0]._id = id1;
+	goals[0]._want = PBG_TRUE;
+	goals[1]._id = id2;
+	goals[1]._want = PBG_FALSE;
+	if(pbg_an_query(an, goals, 2))
+		return 0;
+	goals[1]._want = PBG_ERROR;
+	return !pbg_an_query(an, goals, 2);
+}
+
+pbg_analysis pbg_analyze(pbg_expr* e, pbg_error* err)
+{
+	pbg_an an;
+	pbg_an_goal goal;
+	pbg_analysis result;
+	
+	/* Always start with a clean error! */
+	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	
+	if(e->_numconst == 0) {
+		pbg_err_state(err, __LINE__, __FILE__, 
+				"Cannot analyze an empty expression.");
+		return PBG_AN_UNKNOWN;
+	}
+	if(!pbg_an_init(&an, e)) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return PBG_AN_UNKNOWN;
+	}
+	
+	result = PBG_AN_UNKNOWN;
+	goal._id = 1;
+	goal._want = PBG_TRUE;
+	if(!pbg_an_query(&an, &goal, 1))
+		result = PBG_AN_NEVER;
+	else {
+		goal._want = PBG_FALSE;
+		if(!pbg_an_query(&an, &goal, 1)) {
+			goal._want = PBG_ERROR;
+			if(!pbg_an_query(&an, &goal, 1))
+				result = PBG_AN_ALWAYS;
+		}
+	}
+	free(an._canon);
+	if(an._failed) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return PBG_AN_UNKNOWN;
+	}
+	return result;
+}
+
+int pbg_implies(pbg_expr* a, pbg_expr* b, pbg_error* err)
+{
+	int result, *kids;
+	pbg_an an;
+	pbg_expr e, *exprs[2];
+	
+	/* Analyze both rules as the children of one AND. This also clears err. */
+	exprs[0] = a;
+	exprs[1] = b;
+	pbg_combine(&e, err, PBG_OP_AND, exprs, 2);
+	if(err->_type != PBG_ERR_NONE)
+		return 0;
+	if(!pbg_an_init(&an, &e)) {
+		pbg_free(&e);
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return 0;
+	}
+	kids = (int*) pbg_field_get(&e, 1)->_data;
+	result = pbg_an_implies(&an, kids[0], kids[1]);
+	free(an._canon);
+	pbg_free(&e);
+	if(an._failed) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return 0;
+	}
+	return result;
+}
+
+
+/********************
+ *                  *
+ * RULE SET TOOLKIT *
+ *                  *
+ ********************/
+
+/**
+ * Looks up the bit of a VAR name, adding the name if asked to.
+ * @param rs   Rule set to look in. Its table must have room for the name.
+ * @param key  VAR name, as written.
+ * @param n    Length of key.
+ * @param add  1 to add the name if it is new, 0 otherwise.
+ * @return the bit of the name, -1 if it is not in the rule set.
+ */
+int pbg_ruleset_bit(pbg_ruleset* rs, char* key, int n, int add)
+{
+	int slot, bit;
+	slot = (int) (pbg_hash(key, n) & (rs->_tablecap-1));
+	for(; rs->_table[slot] != 0; slot = (slot+1) & (rs->_tablecap-1)) {
+		bit = rs->_table[slot]-1;
+		if(rs->_lens[bit] == n && memcmp(rs->_keys[bit], key, n) == 0)
+			return bit;
+	}
+	if(!add)
+		return -1;
+	/* It's a new name! */
+	bit = rs->_numkeys++;
+	rs->_keys[bit] = key;
+	rs->_lens[bit] = n;
+	rs->_table[slot] = bit+1;
+	return bit;
+}
+
+/**
+ * Adds the VARs a field requires to be non-NULL to be TRUE to a bitmap.
+ * @param rs    Rule set being initialized.
+ * @param err   Used to store error, if any.
+ * @param e     Rule holding the field.
+ * @param id    Index of the field.
+ * @param bits  Bit of each VAR of the rule.
+ * @param req   Bitmap to add to.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_ruleset_req_r(pbg_ruleset* rs, pbg_error* err, pbg_expr* e, int id, 
+		int* bits, unsigned long* req)
+{
+	int i, w, kid, bit, ok;
+	unsigned long* both, *one;
+	pbg_field* field;
+	/* A NULL evaluated as a BOOL is an error. */
+	if(id < 0) {
+		bit = bits[-id-1];
+		req[bit / PBG_WORD_BITS] |= 1UL << (bit % PBG_WORD_BITS);
+		return 1;
+	}
+	field = pbg_field_get(e, id);
+	switch(field->_type) {
+		/* Every child must be TRUE. */
+		case PBG_OP_AND:
+			for(i = 0; i < field->_int; i++)
+				if(!pbg_ruleset_req_r(rs, err, e, ((int*)field->_data)[i], bits, req))
+					return 0;
+			return 1;
+		/* Some child must be TRUE, so only what all of them require is. */
+		case PBG_OP_OR:
+			both = (unsigned long*) malloc(2 * rs->_numwords * sizeof(unsigned long));
+			if(both == NULL) {
+				pbg_err_alloc(err, __LINE__, __FILE__);
+				return 0;
+			}
+			one = both + rs->_numwords;
+			ok = 1;
+			for(i = 0; i < field->_int && ok; i++) {
+				memset(one, 0, rs->_numwords * sizeof(unsigned long));
+				ok = pbg_ruleset_req_r(rs, err, e, ((int*)field->_data)[i], bits, one);
+				for(w = 0; w < rs->_numwords; w++)
+					both[w] = (i == 0) ? one[w] : (both[w] & one[w]);
+			}
+			for(w = 0; w < rs->_numwords; w++)
+				req[w] |= both[w];
+			free(both);
+			return ok;
+		/* A NULL operand is an error, or FALSE. */
+		case PBG_OP_EQ:
+		case PBG_OP_NEQ:
+		case PBG_OP_LT:
+		case PBG_OP_GT:
+		case PBG_OP_LTE:
+		case PBG_OP_GTE:
+		case PBG_OP_EXST:
+		case PBG_OP_TYPE:
+			for(i = 0; i < field->_int; i++) {
+				kid = ((int*)field->_data)[i];
+				if(kid < 0) {
+					bit = bits[-kid-1];
+					req[bit / PBG_WORD_BITS] |= 1UL << (bit % PBG_WORD_BITS);
+				}
+			}
+			return 1;
+		/* Anything else may be TRUE whatever is NULL. */
+		default:
+			return 1;
+	}
+}
+
+/**
+ * Adds the atoms of a rule to a list, each once. An atom is a VAR operand of a
+ * field, keyed by the VAR's name and the literal it is compared to, if any. 
+ * Atoms keyed by the literal's type and value come first, then atoms keyed by
+ * its type alone, since bounds of any values of a type may relate two rules.
+ * @param e       Rule to look in.
+ * @param hashes  Atoms, by hash, with room for two more per VAR of e.
+ * @param n       Number of atoms already in hashes, none of them of e.
+ * @return the number of atoms in hashes.
+ */
+int pbg_ruleset_atoms(pbg_expr* e, unsigned long* hashes, int n)
+{
+	int i, j, k, pass, first, *kids;
+	unsigned long hash;
+	pbg_field* field, *var, *lit;
+	first = n;
+	for(pass = 0; pass < 2; pass++) {
+		for(i = 0; i < e->_numconst; i++) {
+			field = e->_constants+i;
+			if(!pbg_type_isop(field->_type))
+				continue;
+			kids = (int*) field->_data;
+			/* Find the literal, if any. */
+			lit = NULL;
+			for(j = 0; j < field->_int && lit == NULL; j++)
+				if(kids[j] > 0 && !pbg_type_isop(pbg_field_get(e, kids[j])->_type))
+					lit = pbg_field_get(e, kids[j]);
+			if(pass == 1 && lit == NULL)
+				continue;
+			for(j = 0; j < field->_int; j++) {
+				if(kids[j] >= 0)
+					continue;
+				var = pbg_field_get(e, kids[j]);
+				hash = pbg_hash((char*) var->_data, var->_int);
+				if(lit != NULL) {
+					hash = hash*31 + lit->_type;
+					if(pass == 0)
+						hash = hash*31 + pbg_hash((char*) lit->_data, lit->_int);
+				}
+				for(k = first; k < n && hashes[k] != hash; k++);
+				if(k == n)
+					hashes[n++] = hash;
+			}
+		}
+	}
+	return n;
+}
+
+/**
+ * Checks which ways two rules of a rule set imply each other. The two rules 
+ * are analyzed as the children of an AND of their own, so the work done only
+ * depends on their size. A rule is only checked to imply a rule whose required
+ * VARs it also requires, since a missing field would otherwise tell them apart.
+ * @param rs    Rule set being initialized, with its required VARs.
+ * @param err   Used to store error, if any.
+ * @param i     Earlier rule.
+ * @param r     Later rule.
+ * @param dirs  Set to 1 if i implies r, plus 2 if r implies i.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_ruleset_pair(pbg_ruleset* rs, pbg_error* err, int i, int r, int* dirs)
 {
-	int i, childi;
-	PBG_UNUSED(err);
-	for(i = 0; i < field->_int; i++) {
-		childi = ((int*)field->_data)[i];
-		if(pbg_field_get(e, childi)->_type == PBG_NULL)
+	int k, w, a, b, *kids;
+	unsigned long *reqa, *reqb;
+	pbg_expr e, *exprs[2];
+	pbg_an an;
+	
+	*dirs = 0;
+	exprs[0] = rs->_rules[i];
+	exprs[1] = rs->_rules[r];
+	pbg_combine(&e, err, PBG_OP_AND, exprs, 2);
+	if(err->_type != PBG_ERR_NONE)
+		return 0;
+	if(!pbg_an_init(&an, &e)) {
+		pbg_free(&e);
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return 0;
+	}
+	kids = (int*) pbg_field_get(&e, 1)->_data;
+	for(k = 0; k < 2 && !an._failed; k++) {
+		a = (k == 0) ? i : r;
+		b = (k == 0) ? r : i;
+		reqa = rs->_required + a * rs->_numwords;
+		reqb = rs->_required + b * rs->_numwords;
+		for(w = 0; w < rs->_numwords && (reqb[w] & ~reqa[w]) == 0; w++);
+		if(w == rs->_numwords && pbg_an_implies(&an, kids[k], kids[1-k]))
+			*dirs |= 1 << k;
+	}
+	free(an._canon);
+	pbg_free(&e);
+	if(an._failed) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Relates every rule of a rule set to the earlier rules it implies or is 
+ * implied by. Rules proven never or always TRUE are left out. A rule is only
+ * checked against the earlier rules sharing one of its atoms, found through a
+ * hash table of atoms. Its rarest atoms are tried first, rules sharing each 
+ * newest first, and at most maxcheck rules in all.
+ * @param rs        Rule set being initialized, with its required VARs and 
+ *                  analyses.
+ * @param err       Used to store error, if any.
+ * @param maxcheck  Most earlier rules to check each rule against, or negative
+ *                  for no limit.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_ruleset_link(pbg_ruleset* rs, pbg_error* err, int maxcheck)
+{
+	int r, i, j, k, a, first, slot, total, tablecap, numatoms, numchecks;
+	int numlinks, cap, dirs, ok, *heads, *counts, *next, *owner, *slots;
+	int *seen, *links;
+	unsigned long *keys, *hashes;
+	
+	rs->_linkstart = (int*) calloc(rs->_numrules+1, sizeof(int));
+	if(rs->_linkstart == NULL) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return 0;
+	}
+	if(maxcheck == 0)
+		return 1;
+	
+	/* Each VAR gives at most two atoms. pbg_ruleset_init bounds the total. */
+	total = 0;
+	for(r = 0; r < rs->_numrules; r++)
+		total += 2 * rs->_rules[r]->_numvars;
+	for(tablecap = 2; tablecap < 2*total; tablecap *= 2);
+	keys = (unsigned long*) malloc(tablecap * sizeof(unsigned long));
+	heads = (int*) calloc(tablecap, sizeof(int));
+	counts = (int*) calloc(tablecap, sizeof(int));
+	hashes = (unsigned long*) malloc((total+1) * sizeof(unsigned long));
+	next = (int*) malloc((total+1) * sizeof(int));
+	owner = (int*) malloc((total+1) * sizeof(int));
+	slots = (int*) malloc((total+1) * sizeof(int));
+	seen = (int*) malloc((rs->_numrules+1) * sizeof(int));
+	ok = keys != NULL && heads != NULL && counts != NULL && hashes != NULL && 
+			next != NULL && owner != NULL && slots != NULL && seen != NULL;
+	if(!ok)
+		pbg_err_alloc(err, __LINE__, __FILE__);
+	
+	numatoms = numlinks = cap = 0;
+	for(r = 0; r < rs->_numrules && ok; r++)
+		seen[r] = -1;
+	for(r = 0; r < rs->_numrules && ok; r++) {
+		rs->_linkstart[r] = numlinks;
+		if(rs->_rules[r]->_numconst == 0 || rs->_analyses[r] != PBG_AN_UNKNOWN)
+			continue;
+		first = numatoms;
+		numatoms = pbg_ruleset_atoms(rs->_rules[r], hashes, numatoms);
+		
+		/* Add each atom to the table, and sort them from rarest. */
+		for(a = first; a < numatoms; a++) {
+			slot = (int) (hashes[a] & (tablecap-1));
+			while(heads[slot] != 0 && keys[slot] != hashes[a])
+				slot = (slot+1) & (tablecap-1);
+			keys[slot] = hashes[a];
+			next[a] = heads[slot];
+			owner[a] = r;
+			heads[slot] = a+1;
+			counts[slot]++;
+			for(j = a; j > first && counts[slots[j-1]] > counts[slot]; j--)
+				slots[j] = slots[j-1];
+			slots[j] = slot;
+		}
+		
+		/* Try both ways with the earlier rules sharing an atom. */
+		seen[r] = r;
+		numchecks = 0;
+		for(a = first; a < numatoms && ok && numchecks != maxcheck; a++) {
+			j = heads[slots[a]];
+			for(; j != 0 && ok && numchecks != maxcheck; j = next[j-1]) {
+				i = owner[j-1];
+				if(seen[i] == r)
+					continue;
+				seen[i] = r;
+				numchecks++;
+				ok = pbg_ruleset_pair(rs, err, i, r, &dirs);
+				for(k = 0; k < 2 && ok; k++) {
+					if(!(dirs & (1 << k)))
+						continue;
+					links = (int*) pbg_parser_grow(rs->_links, &cap, numlinks+1, 
+							sizeof(int));
+					if(links == NULL) {
+						pbg_err_alloc(err, __LINE__, __FILE__);
+						ok = 0;
+						break;
+					}
+					rs->_links = links;
+					rs->_links[numlinks++] = (k == 0) ? i : -i-1;
+				}
+			}
+		}
+	}
+	rs->_linkstart[rs->_numrules] = numlinks;
+	free(keys);
+	free(heads);
+	free(counts);
+	free(hashes);
+	free(next);
+	free(owner);
+	free(slots);
+	free(seen);
+	return ok;
+}
+
+/**
+ * Checks if a rule follows from the earlier rules of a rule set.
+ * @param rs       Rule set being evaluated.
+ * @param r        Rule to check.
+ * @param results  Rules selected so far, which holds every earlier rule.
+ * @return PBG_TRUE if an earlier rule implying r was selected, PBG_FALSE if an
+ *         earlier rule r implies was not, PBG_ERROR if r must be evaluated.
+ */
+int pbg_ruleset_follows(pbg_ruleset* rs, int r, unsigned char* results)
+{
+	int k, i, sel;
+	for(k = rs->_linkstart[r]; k < rs->_linkstart[r+1]; k++) {
+		i = (rs->_links[k] >= 0) ? rs->_links[k] : -rs->_links[k]-1;
+		sel = (results[i/8] >> (i%8)) & 1;
+		if(rs->_links[k] >= 0 && sel)
+			return PBG_TRUE;
+		if(rs->_links[k] < 0 && !sel)
 			return PBG_FALSE;
 	}
-	return PBG_TRUE;
+	return PBG_ERROR;
 }
 
-int pbg_evaluate_op_eq(pbg_expr* e, pbg_error* err, pbg_field* field)
+void pbg_ruleset_init(pbg_ruleset* rs, pbg_error* err, pbg_expr** rules, int n,
+		int maxcheck)
 {
-	int i, child0, childi, result;
-	pbg_field* c0, *ci;
-	PBG_UNUSED(err);
-	/* Ensure type and size of all children are identical. */
-	child0 = ((int*)field->_data)[0];
-	c0 = pbg_field_get(e, child0);
-	if(c0->_type == PBG_NULL) {
-		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
-				"NULL input given to EQ operator.");
-		return PBG_ERROR;
+	int i, r, total, *bits;
+	pbg_expr* e;
+	
+	/* Always start with a clean error! */
+	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	
+	/* Start empty, so that pbg_ruleset_free is safe whatever happens. */
+	rs->_rules = rules;
+	rs->_numrules = n;
+	rs->_keys = NULL;
+	rs->_lens = NULL;
+	rs->_numkeys = 0;
+	rs->_table = NULL;
+	rs->_tablecap = 0;
+	rs->_numwords = 0;
+	rs->_required = NULL;
+	rs->_analyses = NULL;
+	rs->_links = NULL;
+	rs->_linkstart = NULL;
+	
+	/* Count VARs, to size the name table. */
+	total = 0;
+	for(r = 0; r < n; r++) {
+		if(rules[r]->_numvars > INT_MAX/8 - total) {
+			pbg_err_limit(err, __LINE__, __FILE__, "Too many VARs in rule set.");
+			return;
+		}
+		total += rules[r]->_numvars;
 	}
-	/* We have a bunch of BOOLs! Evaluate them. */
-	if(pbg_type_isbool(c0->_type)) {
-		result = pbg_evaluate_r(e, err, c0);
-		for(i = 1; i < field->_int; i++) {
-			childi = ((int*)field->_data)[i];
-			ci = pbg_field_get(e, childi);
-			if(ci->_type == PBG_NULL) {
-				pbg_err_op_arg_type(err, __LINE__, __FILE__, 
-						"NULL input given to EQ operator.");
-				return PBG_ERROR;
+	for(rs->_tablecap = 2; rs->_tablecap < 2*total; rs->_tablecap *= 2);
+	rs->_table = (int*) calloc(rs->_tablecap, sizeof(int));
+	rs->_keys = (char**) malloc((total+1) * sizeof(char*));
+	rs->_lens = (int*) malloc((total+1) * sizeof(int));
+	bits = (int*) malloc((total+1) * sizeof(int));
+	if(rs->_table == NULL || rs->_keys == NULL || rs->_lens == NULL || bits == NULL) {
+		free(bits);
+		pbg_ruleset_free(rs);
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return;
+	}
+	
+	/* Give every distinct name a bit. */
+	for(r = 0; r < n; r++)
+		for(i = 0; i < rules[r]->_numvars; i++)
+			pbg_ruleset_bit(rs, (char*) rules[r]->_variables[i]._data, 
+					rules[r]->_variables[i]._int, 1);
+	rs->_numwords = (rs->_numkeys + PBG_WORD_BITS-1) / PBG_WORD_BITS;
+	
+	/* Work out what each rule requires. */
+	rs->_required = (unsigned long*) calloc(n * rs->_numwords + 1, 
+			sizeof(unsigned long));
+	rs->_analyses = (pbg_analysis*) malloc((n+1) * sizeof(pbg_analysis));
+	if(rs->_required == NULL || rs->_analyses == NULL) {
+		free(bits);
+		pbg_ruleset_free(rs);
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return;
+	}
+	for(r = 0; r < n; r++) {
+		e = rules[r];
+		for(i = 0; i < e->_numvars; i++)
+			bits[i] = pbg_ruleset_bit(rs, (char*) e->_variables[i]._data, 
+					e->_variables[i]._int, 0);
+		if(e->_numconst > 0 && !pbg_ruleset_req_r(rs, err, e, 1, bits, 
+				rs->_required + r * rs->_numwords)) {
+			free(bits);
+			pbg_ruleset_free(rs);
+			return;
+		}
+		/* Find the rules that need not be evaluated at all. */
+		rs->_analyses[r] = PBG_AN_UNKNOWN;
+		if(e->_numconst > 0) {
+			rs->_analyses[r] = pbg_analyze(e, err);
+			if(err->_type != PBG_ERR_NONE) {
+				free(bits);
+				pbg_ruleset_free(rs);
+				return;
 			}
-			if(result != pbg_evaluate_r(e, err, ci))
-				return PBG_FALSE;
 		}
-		return PBG_TRUE;
-	/* We don't have a bunch of BOOLs! Do standard equality test. */
-	}else{
-		for(i = 1; i < field->_int; i++) {
-			childi = ((int*)field->_data)[i];
-			ci = pbg_field_get(e, childi);
-			if(ci->_type == PBG_NULL) {
-				pbg_err_op_arg_type(err, __LINE__, __FILE__, 
-						"NULL input given to EQ operator.");
+	}
+	free(bits);
+	
+	/* Find the rules that follow from others. */
+	if(!pbg_ruleset_link(rs, err, maxcheck))
+		pbg_ruleset_free(rs);
+}
+
+int pbg_ruleset_words(pbg_ruleset* rs) {
+	return rs->_numwords;
+}
+
+void pbg_ruleset_present(pbg_ruleset* rs, unsigned long* present, char* key, 
+		int n)
+{
+	int bit;
+	if(rs->_numkeys == 0 || (bit = pbg_ruleset_bit(rs, key, n, 0)) < 0)
+		return;
+	present[bit / PBG_WORD_BITS] |= 1UL << (bit % PBG_WORD_BITS);
+}
+
+int pbg_ruleset_evaluate(pbg_ruleset* rs, pbg_error* err, unsigned long* present, 
+		pbg_field (*dict)(char*, int), unsigned char* results)
+{
+	int r, w, count, result;
+	unsigned long* req;
+	
+	/* Always start with a clean error! */
+	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	
+	memset(results, 0, (rs->_numrules+7)/8);
+	count = 0;
+	for(r = 0; r < rs->_numrules; r++) {
+		/* Skip dead rules, and rules that need a field the record does not 
+		 * have. */
+		if(rs->_analyses[r] == PBG_AN_NEVER)
+			continue;
+		req = rs->_required + r * rs->_numwords;
+		for(w = 0; w < rs->_numwords && (req[w] & ~present[w]) == 0; w++);
+		if(w < rs->_numwords)
+			continue;
+		/* Rules always TRUE, or following from earlier rules, need not be 
+		 * evaluated. */
+		result = (rs->_analyses[r] == PBG_AN_ALWAYS) ? PBG_TRUE : 
+				pbg_ruleset_follows(rs, r, results);
+		if(result == PBG_ERROR) {
+			result = pbg_evaluate(rs->_rules[r], err, dict);
+			if(err->_type == PBG_ERR_ALLOC)
 				return PBG_ERROR;
-			}
-			if(ci->_int != c0->_int || 
-					ci->_type != c0->_type)
-				return PBG_FALSE;
-			/* Ensure each data byte is identical. */
-			if(memcmp(ci->_data, c0->_data, c0->_int) != 0)
-				return PBG_FALSE;
+			pbg_error_free(err);
+			pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
 		}
-		return PBG_TRUE;
+		if(result == PBG_TRUE) {
+			results[r/8] |= (unsigned char) (1 << (r%8));
+			count++;
+		}
+	}
+	return count;
+}
+
+void pbg_ruleset_free(pbg_ruleset* rs)
+{
+	free(rs->_keys);
+	free(rs->_lens);
+	free(rs->_table);
+	free(rs->_required);
+	free(rs->_analyses);
+	free(rs->_links);
+	free(rs->_linkstart);
+	rs->_keys = NULL;
+	rs->_lens = NULL;
+	rs->_table = NULL;
+	rs->_required = NULL;
+	rs->_analyses = NULL;
+	rs->_links = NULL;
+	rs->_linkstart = NULL;
+	rs->_numkeys = rs->_numwords = rs->_tablecap = 0;
+	rs->_numrules = 0;
+}
+
+/********************
+ *                  *
+ * PRINTING TOOLKIT *
+ *                  *
+ ********************/
+
+/**
+ * Translates the given operator type to its symbol in PBG.
+ * @param type  Operator type to translate.
+ * @return the symbol of the operator, or NULL if type is not an operator.
+ */
+char* pbg_op_str(pbg_field_type type)
+{
+	switch(type) {
+		case PBG_OP_NOT:  return "!";
+		case PBG_OP_AND:  return "&";
+		case PBG_OP_OR:   return "|";
+		case PBG_OP_EQ:   return "=";
+		case PBG_OP_LT:   return "<";
+		case PBG_OP_GT:   return ">";
+		case PBG_OP_EXST: return "?";
+		case PBG_OP_NEQ:  return "!=";
+		case PBG_OP_LTE:  return "<=";
+		case PBG_OP_GTE:  return ">=";
+		case PBG_OP_TYPE: return "@";
+		default:          return NULL;
+	}
+}
+
+/**
+ * Writes the shortest text that pbg_parse reads back as the same NUMBER. The 
+ * mantissa always has a dot if there is an exponent, and the exponent has no
+ * '+' or leading zeros. Infinities are written as out-of-range exponents.
+ * @param str  Buffer of at least 32 characters to write to.
+ * @param val  Value to write.
+ * @return the length of the text, or -1 for NaN, which has no PBG text.
+ */
+int pbg_print_number(char* str, double val)
+{
+	int p, i, j;
+	char raw[32], *exp;
+	if(val != val)
+		return -1;
+	if(val > DBL_MAX || val < -DBL_MAX) {
+		strcpy(str, val < 0 ? "-1.0e999" : "1.0e999");
+		return strlen(str);
+	}
+	/* Find the shortest precision that reads back exactly. */
+	for(p = 1; p <= 17; p++) {
+		sprintf(raw, "%.*g", p, val);
+		if(strtod(raw, NULL) == val) break;
+	}
+	/* Spell out whole numbers rather than writing 10 as 1e+01. */
+	exp = strchr(raw, 'e');
+	if(exp != NULL && atoi(exp+1) >= p && atoi(exp+1) < 17) {
+		p = atoi(exp+1)+1;
+		sprintf(raw, "%.*g", p, val);
+		exp = strchr(raw, 'e');
+	}
+	if(exp == NULL) {
+		strcpy(str, raw);
+		return strlen(str);
+	}
+	/* Copy the mantissa, adding a dot if it has none. */
+	for(i = 0, j = 0; raw+i != exp; i++) str[j++] = raw[i];
+	if(memchr(raw, '.', exp-raw) == NULL) str[j++] = '.', str[j++] = '0';
+	str[j++] = 'e';
+	/* Copy the exponent without '+' or leading zeros. */
+	i++;
+	if(raw[i] == '-') str[j++] = raw[i];
+	if(raw[i] == '-' || raw[i] == '+') i++;
+	while(raw[i] == '0' && raw[i+1] != '\0') i++;
+	while(raw[i] != '\0') str[j++] = raw[i++];
+	str[j] = '\0';
+	return j;
+}
+
+/**
+ * Appends a token to the printed text, separated from the previous one by a
+ * space only if the parser could not otherwise tell them apart.
+ * @param p    Printer to append to.
+ * @param str  Token to append.
+ * @param n    Length of the token.
+ */
+void pbg_print_token(pbg_printer* p, char* str, int n)
+{
+	int i;
+	if(p->_bare && str[0] != '(' && str[0] != ')' && str[0] != '[') {
+		if(p->_len < p->_n-1) p->_buf[p->_len] = ' ';
+		p->_len++;
+	}
+	for(i = 0; i < n; i++, p->_len++)
+		if(p->_len < p->_n-1) p->_buf[p->_len] = str[i];
+	/* Operators and plain literals run on until a break. */
+	p->_bare = str[n-1] != '(' && str[n-1] != ')' && 
+			str[n-1] != ']' && str[n-1] != '\'';
+}
+
+/**
+ * Prints the subtree rooted at the given field.
+ * @param e   PBG expression to print.
+ * @param p   Printer to append to.
+ * @param id  Index of the field to print.
+ * @return 1 if successful, 0 if the subtree has no PBG text.
+ */
+int pbg_print_r(pbg_expr* e, pbg_printer* p, int id)
+{
+	int i, len;
+	char tmp[32];
+	pbg_field* field;
+	pbg_lt_date* date;
+	field = pbg_field_get(e, id);
+	if(pbg_type_isop(field->_type)) {
+		pbg_print_token(p, "(", 1);
+		pbg_print_token(p, pbg_op_str(field->_type), strlen(pbg_op_str(field->_type)));
+		for(i = 0; i < field->_int; i++)
+			if(!pbg_print_r(e, p, ((int*)field->_data)[i]))
+				return 0;
+		pbg_print_token(p, ")", 1);
+		return 1;
+	}
+	switch(field->_type) {
+		case PBG_LT_TRUE:      pbg_print_token(p, "TRUE", 4); return 1;
+		case PBG_LT_FALSE:     pbg_print_token(p, "FALSE", 5); return 1;
+		case PBG_LT_TP_DATE:   pbg_print_token(p, "DATE", 4); return 1;
+		case PBG_LT_TP_BOOL:   pbg_print_token(p, "BOOL", 4); return 1;
+		case PBG_LT_TP_NUMBER: pbg_print_token(p, "NUMBER", 6); return 1;
+		case PBG_LT_TP_STRING: pbg_print_token(p, "STRING", 6); return 1;
+		case PBG_LT_NUMBER:
+			len = pbg_print_number(tmp, ((pbg_lt_number*) field->_data)->_val);
+			if(len < 0) return 0;
+			pbg_print_token(p, tmp, len);
+			return 1;
+		case PBG_LT_DATE:
+			date = (pbg_lt_date*) field->_data;
+			sprintf(tmp, "%04u-%02u-%02u", date->_YYYY % 10000, date->_MM % 100, 
+					date->_DD % 100);
+			pbg_print_token(p, tmp, 10);
+			return 1;
+		case PBG_LT_STRING:
+		case PBG_LT_VAR:
+			/* Both are stored exactly as they were written, escapes included. */
+			pbg_print_token(p, field->_type == PBG_LT_VAR ? "[" : "'", 1);
+			p->_bare = 0;
+			for(i = 0; i < field->_int; i++, p->_len++)
+				if(p->_len < p->_n-1) p->_buf[p->_len] = ((char*) field->_data)[i];
+			pbg_print_token(p, field->_type == PBG_LT_VAR ? "]" : "'", 1);
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+int pbg_print(pbg_expr* e, char* buf, int n)
+{
+	pbg_printer p;
+	p._buf = buf;
+	p._n = n;
+	p._len = 0;
+	p._bare = 0;
+	if(e->_numconst == 0 || !pbg_print_r(e, &p, 1))
+		p._len = -1;
+	/* Always terminate, like snprintf. */
+	if(n > 0)
+		buf[(p._len >= 0 && p._len < n) ? p._len : n-1] = '\0';
+	return p._len;
+}
+
+
+/***********************
+ *                     *
+ * NORMAL FORM TOOLKIT *
+ *                     *
+ ***********************/
+
+/**
+ * Checks if two fields of an expression describe identical subtrees.
+ * @param e    PBG expression holding both fields.
+ * @param id1  Index of the first field.
+ * @param id2  Index of the second field.
+ * @return 1 if the subtrees are identical, 0 otherwise.
+ */
+int pbg_nf_same_r(pbg_expr* e, int id1, int id2)
+{
+	int i;
+	pbg_field* f1, *f2;
+	if(id1 == id2) return 1;
+	f1 = pbg_field_get(e, id1), f2 = pbg_field_get(e, id2);
+	if(f1->_type != f2->_type || f1->_int != f2->_int)
+		return 0;
+	if(pbg_type_isop(f1->_type)) {
+		for(i = 0; i < f1->_int; i++)
+			if(!pbg_nf_same_r(e, ((int*)f1->_data)[i], ((int*)f2->_data)[i]))
+				return 0;
+		return 1;
+	}
+	if(f1->_data == NULL || f2->_data == NULL)
+		return f1->_data == f2->_data;
+	return memcmp(f1->_data, f2->_data, f1->_int) == 0;
+}
+
+/**
+ * Hashes the subtree rooted at a field, so that identical subtrees, as told by
+ * pbg_nf_same_r, hash alike.
+ * @param e   PBG expression holding the subtree.
+ * @param id  Index of the root of the subtree.
+ * @return the hash of the subtree.
+ */
+unsigned long pbg_nf_hash_r(pbg_expr* e, int id)
+{
+	int i;
+	unsigned long hash;
+	pbg_field* field;
+	field = pbg_field_get(e, id);
+	hash = (unsigned long) field->_type * 31 + (unsigned long) field->_int;
+	if(pbg_type_isop(field->_type)) {
+		for(i = 0; i < field->_int; i++)
+			hash = hash*31 + pbg_nf_hash_r(e, ((int*)field->_data)[i]);
+		return hash;
+	}
+	if(field->_data != NULL)
+		hash = hash*31 + pbg_hash((char*) field->_data, field->_int);
+	return hash;
+}
+
+/**
+ * Finds the distinct atom a field stands for, adding it if it is new. Atoms are
+ * found by the hash of their subtree.
+ * @param st  Rewrite in progress.
+ * @param id  Index of the atom.
+ * @return the index of the distinct atom in st->_atoms.
+ */
+int pbg_nf_key(pbg_nf_state* st, int id)
+{
+	int slot, mask;
+	mask = st->_tablecap-1;
+	slot = (int) (pbg_nf_hash_r(st->_e, id) & mask);
+	for(; st->_table[slot] != 0; slot = (slot+1) & mask)
+		if(pbg_nf_same_r(st->_e, st->_atoms[st->_table[slot]-1], id))
+			return st->_table[slot]-1;
+	st->_table[slot] = st->_numatoms+1;
+	st->_atoms[st->_numatoms] = id;
+	return st->_numatoms++;
+}
+
+/**
+ * Makes a clause list with a single clause holding a single literal.
+ * @param st   Rewrite in progress.
+ * @param err  Used to store error, if any.
+ * @param out  Clause list to initialize.
+ * @param id   Index of the atom.
+ * @param neg  1 if the atom is negated, 0 otherwise.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_nf_atom(pbg_nf_state* st, pbg_error* err, pbg_clauses* out, int id, int neg)
+{
+	out->_ids = malloc(sizeof(int));
+	out->_negs = malloc(sizeof(int));
+	out->_starts = malloc(2 * sizeof(int));
+	out->_numclauses = 1;
+	if(out->_ids == NULL || out->_negs == NULL || out->_starts == NULL) {
+		pbg_nf_clauses_free(out);
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return 0;
+	}
+	out->_ids[0] = pbg_nf_key(st, id), out->_negs[0] = neg;
+	out->_starts[0] = 0, out->_starts[1] = 1;
+	return 1;
+}
+
+/**
+ * Allocates a clause list of the given size.
+ * @param err         Used to store error, if any.
+ * @param out         Clause list to initialize.
+ * @param numlits     Number of literals.
+ * @param numclauses  Number of clauses.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_nf_alloc(pbg_error* err, pbg_clauses* out, int numlits, int numclauses)
+{
+	out->_ids = malloc((numlits+1) * sizeof(int));
+	out->_negs = malloc((numlits+1) * sizeof(int));
+	out->_starts = malloc((numclauses+1) * sizeof(int));
+	out->_numclauses = 0;
+	if(out->_ids == NULL || out->_negs == NULL || out->_starts == NULL) {
+		pbg_nf_clauses_free(out);
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return 0;
+	}
+	out->_starts[0] = 0;
+	return 1;
+}
+
+/**
+ * Lists the clauses of all clause lists one after another, in one allocation.
+ * @param st    Rewrite in progress.
+ * @param err   Used to store error, if any.
+ * @param out   Clause list to initialize.
+ * @param kids  Clause lists to join.
+ * @param n     Number of clause lists.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_nf_join(pbg_nf_state* st, pbg_error* err, pbg_clauses* out, 
+		pbg_clauses* kids, int n)
+{
+	int i, j, numlits, numclauses, len;
+	numlits = numclauses = 0;
+	for(i = 0; i < n; i++) {
+		len = kids[i]._starts[kids[i]._numclauses];
+		if(len > st->_maxfields - numlits) {
+			pbg_err_limit(err, __LINE__, __FILE__, 
+					"Normal form exceeds the field budget.");
+			return 0;
+		}
+		numlits += len;
+		numclauses += kids[i]._numclauses;
+	}
+	if(!pbg_nf_alloc(err, out, numlits, numclauses))
+		return 0;
+	for(numlits = i = 0; i < n; i++) {
+		len = kids[i]._starts[kids[i]._numclauses];
+		memcpy(out->_ids+numlits, kids[i]._ids, len * sizeof(int));
+		memcpy(out->_negs+numlits, kids[i]._negs, len * sizeof(int));
+		for(j = 1; j <= kids[i]._numclauses; j++)
+			out->_starts[out->_numclauses+j] = numlits + kids[i]._starts[j];
+		out->_numclauses += kids[i]._numclauses;
+		numlits += len;
+	}
+	return 1;
+}
+
+/**
+ * Merges one clause of each clause list, for every way of picking them, in 
+ * order. Literals already in the merged clause are skipped, and a clause that
+ * would hold an atom and its negation is dropped along with every clause it 
+ * would be merged into. Picks are made depth first, so only the clause being 
+ * merged is kept, and its atoms are marked in st->_marks.
+ * @param st     Rewrite in progress.
+ * @param kids   Clause lists to distribute.
+ * @param n      Number of clause lists.
+ * @param work   Space for 3*n ints, then two stacks as long as the literals of
+ *               all clause lists.
+ * @param out    Clause list to append the merged clauses to, or NULL to only 
+ *               count them.
+ * @param sizes  Incremented by the number of literals and clauses, when 
+ *               counting.
+ * @return 1 if successful, 0 if the merged clauses of some clause lists, or of
+ *         all of them, exceed the field budget.
+ */
+int pbg_nf_distribute(pbg_nf_state* st, pbg_clauses* kids, int n, int* work, 
+		pbg_clauses* out, int* sizes)
+{
+	int t, j, k, top, ok, lit, numlits;
+	int *picks, *pushed, *reached, *ids, *negs;
+	picks = work, pushed = work+n, reached = work+2*n;
+	numlits = 0;
+	for(t = 0; t < n; t++)
+		numlits += kids[t]._starts[kids[t]._numclauses];
+	ids = work+3*n, negs = work+3*n+numlits;
+	memset(reached, 0, n * sizeof(int));
+	t = top = 0;
+	ok = 1;
+	picks[0] = -1, pushed[0] = 0;
+	while(t >= 0) {
+		/* Take back the last pick of this list. */
+		for(; pushed[t] > 0; pushed[t]--)
+			st->_marks[ids[--top]] = 0;
+		if(!ok) break;
+		if(++picks[t] == kids[t]._numclauses) {
+			t--;
+			continue;
+		}
+		/* Merge its next clause, unless it contradicts the clause so far. */
+		j = picks[t];
+		for(k = kids[t]._starts[j]; k < kids[t]._starts[j+1]; k++) {
+			lit = kids[t]._ids[k];
+			if(st->_marks[lit] == 0) {
+				st->_marks[lit] = 1 + kids[t]._negs[k];
+				ids[top] = lit, negs[top++] = kids[t]._negs[k];
+				pushed[t]++;
+			}else if(st->_marks[lit] != 1 + kids[t]._negs[k])
+				break;
+		}
+		if(k < kids[t]._starts[j+1])
+			continue;
+		/* Mirror the budget of merging the lists one after another. */
+		if(out == NULL && top > st->_maxfields - reached[t]) {
+			ok = 0;
+			continue;
+		}
+		reached[t] += top;
+		if(t < n-1) {
+			t++;
+			picks[t] = -1, pushed[t] = 0;
+			continue;
+		}
+		/* Every list has a pick. Keep the merged clause. */
+		if(out == NULL) {
+			sizes[0] += top, sizes[1]++;
+			continue;
+		}
+		k = out->_starts[out->_numclauses];
+		memcpy(out->_ids+k, ids, top * sizeof(int));
+		memcpy(out->_negs+k, negs, top * sizeof(int));
+		out->_starts[++out->_numclauses] = k + top;
+	}
+	/* Unmark the clause left behind by an early stop. */
+	for(; top > 0; top--)
+		st->_marks[ids[top-1]] = 0;
+	return ok;
+}
+
+/**
+ * Distributes the clause lists over one another, in one allocation.
+ * @param st    Rewrite in progress.
+ * @param err   Used to store error, if any.
+ * @param out   Clause list to initialize.
+ * @param kids  Clause lists to distribute.
+ * @param n     Number of clause lists.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_nf_product(pbg_nf_state* st, pbg_error* err, pbg_clauses* out, 
+		pbg_clauses* kids, int n)
+{
+	int i, numlits, sizes[2], *work;
+	numlits = 0;
+	for(i = 0; i < n; i++)
+		numlits += kids[i]._starts[kids[i]._numclauses];
+	work = (int*) malloc((3*n + 2*numlits) * sizeof(int));
+	if(work == NULL) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return 0;
+	}
+	/* Size the result first, so the budget is enforced before allocating. */
+	sizes[0] = sizes[1] = 0;
+	if(!pbg_nf_distribute(st, kids, n, work, NULL, sizes)) {
+		free(work);
+		pbg_err_limit(err, __LINE__, __FILE__, 
+				"Normal form exceeds the field budget.");
+		return 0;
+	}
+	if(!pbg_nf_alloc(err, out, sizes[0], sizes[1])) {
+		free(work);
+		return 0;
+	}
+	pbg_nf_distribute(st, kids, n, work, out, NULL);
+	free(work);
+	return 1;
+}
+
+/**
+ * Computes the clauses of the subtree rooted at the given field. NOTs are
+ * pushed down to the atoms using De Morgan's laws. The clauses of an AND or OR
+ * are gathered from those of all its children at once. If an error occurs, 
+ * out is left empty.
+ * @param st   Rewrite in progress.
+ * @param err  Used to store error, if any.
+ * @param out  Clause list to initialize.
+ * @param id   Index of the field to rewrite.
+ * @param neg  1 if the field is negated, 0 otherwise.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_nf_build_r(pbg_nf_state* st, pbg_error* err, pbg_clauses* out, int id, 
+		int neg)
+{
+	int i, n, conj, ok, *children;
+	pbg_field* field;
+	pbg_clauses* kids;
+	field = pbg_field_get(st->_e, id);
+	children = (int*) field->_data;
+	if(field->_type == PBG_OP_NOT)
+		return pbg_nf_build_r(st, err, out, children[0], !neg);
+	if(field->_type != PBG_OP_AND && field->_type != PBG_OP_OR)
+		return pbg_nf_atom(st, err, out, id, neg);
+	kids = (pbg_clauses*) malloc(field->_int * sizeof(pbg_clauses));
+	if(kids == NULL) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return 0;
+	}
+	for(n = ok = 0; n < field->_int; n++)
+		if(!(ok = pbg_nf_build_r(st, err, kids+n, children[n], neg)))
+			break;
+	/* A negated OR is an AND of negations, and vice versa. Conjunctions join 
+	 * clause lists in CNF and distribute in DNF; disjunctions are the dual. */
+	if(ok) {
+		conj = (field->_type == PBG_OP_AND) != neg;
+		ok = (conj == st->_cnf) ? pbg_nf_join(st, err, out, kids, n) : 
+				pbg_nf_product(st, err, out, kids, n);
+	}
+	for(i = 0; i < n; i++)
+		pbg_nf_clauses_free(kids+i);
+	free(kids);
+	return ok;
+}
+
+/**
+ * Counts the constant and variable fields in the subtree rooted at a field.
+ * @param e         PBG expression holding the subtree.
+ * @param id        Index of the root of the subtree.
+ * @param numconst  Incremented by the number of constants.
+ * @param numvars   Incremented by the number of variables.
+ */
+void pbg_nf_count_r(pbg_expr* e, int id, int* numconst, int* numvars)
+{
+	int i;
+	pbg_field* field;
+	if(id < 0) {
+		(*numvars)++;
+		return;
 	}
+	(*numconst)++;
+	field = pbg_field_get(e, id);
+	if(pbg_type_isop(field->_type))
+		for(i = 0; i < field->_int; i++)
+			pbg_nf_count_r(e, ((int*)field->_data)[i], numconst, numvars);
 }
 
-int pbg_evaluate_op_neq(pbg_expr* e, pbg_error* err, pbg_field* field)
+/**
+ * Copies the subtree rooted at a field of src into dst. dst must have room for
+ * every field of the subtree.
+ * @param dst  PBG expression to copy into.
+ * @param err  Used to store error, if any.
+ * @param src  PBG expression to copy from.
+ * @param id   Index of the root of the subtree in src.
+ * @return the index of the copy in dst if successful, 0 otherwise.
+ */
+int pbg_nf_copy_r(pbg_expr* dst, pbg_error* err, pbg_expr* src, int id)
 {
-	int child0, child1;
-	pbg_field* c0, *c1;
-	PBG_UNUSED(err);
-	child0 = ((int*)field->_data)[0], child1 = ((int*)field->_data)[1];
-	c0 = pbg_field_get(e, child0), c1 = pbg_field_get(e, child1);
-	if(c0->_type == PBG_NULL || c1->_type == PBG_NULL) {
-		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
-				"NULL input given to NEQ operator.");
-		return PBG_ERROR;
+	int i, copyi, kid;
+	pbg_field field, *copy;
+	field = *pbg_field_get(src, id);
+	if(pbg_type_isop(field._type)) {
+		copyi = pbg_store_constant(dst, pbg_parse_op(err, field._type, field._int));
+		copy = pbg_field_get(dst, copyi);
+		if(copy->_data == NULL) return 0;
+		for(i = 0; i < field._int; i++) {
+			kid = pbg_nf_copy_r(dst, err, src, ((int*)field._data)[i]);
+			if(kid == 0) return 0;
+			((int*)copy->_data)[i] = kid;
+		}
+		return copyi;
 	}
-	/* We have two BOOLs! Evaluate them, and check if they are different. */
-	if(pbg_type_isbool(c0->_type) && pbg_type_isbool(c1->_type))
-		return (pbg_evaluate_r(e, err, c0) != pbg_evaluate_r(e, err, c1)) ? 
-			PBG_TRUE : PBG_FALSE;
-	/* We don't have a bunch of BOOLs! Do standard difference check. */
-	else return (c1->_type != c0->_type || c1->_int != c0->_int || 
-			memcmp(c1->_data, c0->_data, c0->_int)) ? PBG_TRUE : PBG_FALSE;
+	/* Literals get their own copy of any data. */
+	if(field._data != NULL) {
+		field._data = malloc(field._int > 0 ? field._int : 1);
+		if(field._data == NULL) {
+			pbg_err_alloc(err, __LINE__, __FILE__);
+			return 0;
+		}
+		memcpy(field._data, pbg_field_get(src, id)->_data, field._int);
+	}
+	return (id < 0) ? pbg_store_variable(dst, field) : 
+			pbg_store_constant(dst, field);
 }
 
-int pbg_evaluate_op_order(pbg_expr* e, pbg_error* err, pbg_field* field)
+/**
+ * Copies an atom of src into dst beneath the given number of NOTs.
+ * @param dst   PBG expression to copy into.
+ * @param err   Used to store error, if any.
+ * @param src   PBG expression holding the atom.
+ * @param id    Index of the atom in src.
+ * @param nots  Number of NOTs to place above the atom.
+ * @param atom  Set to the index of the copied atom in dst.
+ * @return the index of the outermost field in dst if successful, 0 otherwise.
+ */
+int pbg_nf_literal(pbg_expr* dst, pbg_error* err, pbg_expr* src, int id, 
+		int nots, int* atom)
 {
-	int result;
-	int child0, child1;
-	pbg_field* c0, *c1;
-	child0 = ((int*)field->_data)[0], child1 = ((int*)field->_data)[1];
-	c0 = pbg_field_get(e, child0), c1 = pbg_field_get(e, child1);
-	if(c0->_type == PBG_NULL || c1->_type == PBG_NULL) {
-		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
-				"NULL input given to comparison operator.");
-		return PBG_ERROR;
+	int top, *child;
+	if(nots == 0)
+		return *atom = pbg_nf_copy_r(dst, err, src, id);
+	top = pbg_store_constant(dst, pbg_parse_op(err, PBG_OP_NOT, 1));
+	child = pbg_field_get(dst, top)->_data;
+	if(child == NULL) return 0;
+	*child = pbg_nf_literal(dst, err, src, id, nots-1, atom);
+	return (*child == 0) ? 0 : top;
+}
+
+/**
+ * Builds the normal form of an expression from its clauses.
+ * @param nf         Normal form to fill in. It must be empty.
+ * @param err        Used to store error, if any.
+ * @param e          PBG expression holding the atoms.
+ * @param c          Clauses of the normal form.
+ * @param cnf        1 for conjunctive normal form, 0 for disjunctive.
+ * @param maxfields  Maximum number of fields in the rewritten expression.
+ * @return 1 if successful, 0 otherwise.
+ */
+int pbg_nf_emit(pbg_nf* nf, pbg_error* err, pbg_expr* e, pbg_clauses* c, 
+		int cnf, int maxfields)
+{
+	int i, k, wrap, numlits, numconst, numvars;
+	int id, atom, *children, *kids;
+	pbg_expr* out;
+	out = &nf->_expr;
+	numlits = c->_starts[c->_numclauses];
+	
+	/* A lone VAR cannot be the root of an expression, so it is double negated. */
+	wrap = (numlits == 1 && c->_ids[0] < 0 && !c->_negs[0]) ? 2 : 0;
+	
+	/* Count fields: the root, one operator per clause with more than one 
+	 * literal, and every literal with its NOT, if any. */
+	numconst = (c->_numclauses != 1) + wrap;
+	numvars = 0;
+	for(i = 0; i < c->_numclauses; i++)
+		numconst += (c->_starts[i+1] - c->_starts[i] > 1);
+	for(k = 0; k < numlits; k++) {
+		numconst += c->_negs[k];
+		pbg_nf_count_r(e, c->_ids[k], &numconst, &numvars);
 	}
-	result = -2;
-	/* Both are NUMBERs. */
-	if(c0->_type == PBG_LT_NUMBER &&
-			c1->_type == PBG_LT_NUMBER)
-		result = pbg_cmpnumber(c0->_data, c1->_data);
-	/* Both are DATEs. */
-	if(c0->_type == PBG_LT_DATE &&
-			c1->_type == PBG_LT_DATE)
-		result = pbg_cmpdate(c0->_data, c1->_data);
-	/* Both are STRINGs. */
-	if(c0->_type == PBG_LT_STRING &&
-			c1->_type == PBG_LT_STRING)
-		result = pbg_cmpstring(c0->_data, c1->_data, c0->_int);
-	/* Both are BOOLs. */
-	if(pbg_type_isbool(c0->_type) && pbg_type_isbool(c1->_type))
-		result = pbg_evaluate_r(e, err, c0) - pbg_evaluate_r(e, err, c1);
-	/* Check if mismatched or invalid types. */
-	if(result == -2) {
-		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
-				"Unknown input type to comparison operator");
-		return PBG_ERROR;
-	/* Compare results according to type of comparison operator. */
-	}else{
-		if(field->_type == PBG_OP_LT) return result < 0 ? PBG_TRUE : PBG_FALSE;
-		if(field->_type == PBG_OP_GT) return result > 0 ? PBG_TRUE : PBG_FALSE;
-		if(field->_type == PBG_OP_LTE) return result <= 0 ? PBG_TRUE : PBG_FALSE;
-		if(field->_type == PBG_OP_GTE) return result >= 0 ? PBG_TRUE : PBG_FALSE;
+	if(numconst > maxfields - numvars) {
+		pbg_err_limit(err, __LINE__, __FILE__, 
+				"Normal form exceeds the field budget.");
+		return 0;
+	}
+	
+	/* Allocate everything up front. */
+	out->_constants = (pbg_field*) malloc(numconst * sizeof(pbg_field));
+	out->_variables = (pbg_field*) malloc((numvars+1) * sizeof(pbg_field));
+	nf->_atoms = (pbg_field**) malloc((numlits+1) * sizeof(pbg_field*));
+	nf->_negated = (int*) malloc((numlits+1) * sizeof(int));
+	nf->_clauses = (int*) malloc((c->_numclauses+1) * sizeof(int));
+	if(out->_constants == NULL || out->_variables == NULL || nf->_atoms == NULL || 
+			nf->_negated == NULL || nf->_clauses == NULL) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return 0;
+	}
+	
+	/* Store the root. With no clauses the form is constant. */
+	children = NULL;
+	if(c->_numclauses == 0)
+		pbg_store_constant(out, pbg_field_init(cnf ? PBG_LT_TRUE : PBG_LT_FALSE, 
+				0, NULL));
+	if(c->_numclauses > 1) {
+		id = pbg_store_constant(out, pbg_parse_op(err, 
+				cnf ? PBG_OP_AND : PBG_OP_OR, c->_numclauses));
+		children = pbg_field_get(out, id)->_data;
+		if(children == NULL) return 0;
+	}
+	
+	/* Store every clause in preorder, so that the root stays first. */
+	for(i = 0; i < c->_numclauses; i++) {
+		kids = NULL;
+		if(c->_starts[i+1] - c->_starts[i] > 1) {
+			id = pbg_store_constant(out, pbg_parse_op(err, 
+					cnf ? PBG_OP_OR : PBG_OP_AND, c->_starts[i+1] - c->_starts[i]));
+			kids = pbg_field_get(out, id)->_data;
+			if(kids == NULL) return 0;
+			if(children != NULL) children[i] = id;
+		}
+		for(k = c->_starts[i]; k < c->_starts[i+1]; k++) {
+			id = pbg_nf_literal(out, err, e, c->_ids[k], 
+					c->_negs[k] ? 1 : wrap, &atom);
+			if(id == 0) return 0;
+			if(kids != NULL) kids[k - c->_starts[i]] = id;
+			else if(children != NULL) children[i] = id;
+			nf->_atoms[k] = pbg_field_get(out, atom);
+			nf->_negated[k] = c->_negs[k];
+		}
+		nf->_clauses[i] = c->_starts[i];
+	}
+	nf->_clauses[c->_numclauses] = numlits;
+	nf->_numclauses = c->_numclauses;
+	
+	/* Sanity check: verify we stored everything we counted. */
+	if(out->_numconst != numconst || out->_numvars != numvars) {
 		pbg_err_state(err, __LINE__, __FILE__, 
-				"Unknown result from select comparison function.");
-		return PBG_ERROR;
+				"Not all fields were stored?");
+		return 0;
 	}
+	return 1;
 }
 
-int pbg_evaluate_op_type(pbg_expr* e, pbg_error* err, pbg_field* field)
+void pbg_normalize(pbg_nf* nf, pbg_error* err, pbg_expr* e, pbg_nf_form form, 
+		int maxfields)
 {
-	int i, child0, childi;
-	pbg_field* c0, *ci;
-	pbg_field_type type;
-	child0 = ((int*)field->_data)[0];
-	c0 = pbg_field_get(e, child0);
-	type = c0->_type;
-	/* Ensure the first argument is a type literal. */
-	if(type < PBG_MIN_LT_TP || type > PBG_MAX_LT_TP) {
-		pbg_err_op_arg_type(err, __LINE__, __FILE__, 
-				"First input to TYPE operator must be a type literal.");
-		return PBG_ERROR;
+	int k, numfields;
+	pbg_clauses c;
+	pbg_nf_state st;
+	
+	/* Always start with a clean error! */
+	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	
+	/* Start empty, so that pbg_nf_free is safe whatever happens. */
+	nf->_expr._constants = NULL;
+	nf->_expr._variables = NULL;
+	nf->_expr._numconst = 0;
+	nf->_expr._numvars = 0;
+	nf->_expr._program = NULL;
+	nf->_expr._names = NULL;
+	nf->_atoms = NULL;
+	nf->_negated = NULL;
+	nf->_clauses = NULL;
+	nf->_numclauses = 0;
+	
+	if(e->_numconst == 0) {
+		pbg_err_state(err, __LINE__, __FILE__, 
+				"Cannot normalize an empty expression.");
+		return;
 	}
-	/* Verify types of all trailing arguments. */
-	for(i = 1; i < field->_int; i++) {
-		childi = ((int*)field->_data)[i];
-		ci = pbg_field_get(e, childi);
-		if(type == PBG_LT_TP_BOOL && !pbg_type_isbool(ci->_type))
-			return PBG_FALSE;
-		if(type == PBG_LT_TP_DATE && ci->_type != PBG_LT_DATE)
-			return PBG_FALSE;
-		if(type == PBG_LT_TP_NUMBER && ci->_type != PBG_LT_NUMBER)
-			return PBG_FALSE;
-		if(type == PBG_LT_TP_STRING && ci->_type != PBG_LT_STRING)
-			return PBG_FALSE;
+	
+	/* Every field may be a distinct atom. */
+	st._e = e;
+	st._cnf = (form == PBG_NF_CNF);
+	st._maxfields = maxfields;
+	st._numatoms = 0;
+	numfields = e->_numconst + e->_numvars;
+	for(st._tablecap = 2; st._tablecap < 2*numfields; st._tablecap *= 2);
+	st._atoms = (int*) malloc(numfields * sizeof(int));
+	st._marks = (int*) calloc(numfields, sizeof(int));
+	st._table = (int*) calloc(st._tablecap, sizeof(int));
+	if(st._atoms == NULL || st._marks == NULL || st._table == NULL) {
+		free(st._atoms);
+		free(st._marks);
+		free(st._table);
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		return;
 	}
-	return PBG_TRUE;
+	
+	/* Compute the clauses over distinct atoms, then build the expression they 
+	 * describe from the fields of those atoms. */
+	k = pbg_nf_build_r(&st, err, &c, 1, 0);
+	free(st._marks);
+	free(st._table);
+	if(!k) {
+		free(st._atoms);
+		return;
+	}
+	for(k = 0; k < c._starts[c._numclauses]; k++)
+		c._ids[k] = st._atoms[c._ids[k]];
+	free(st._atoms);
+	if(!pbg_nf_emit(nf, err, e, &c, form == PBG_NF_CNF, maxfields))
+		pbg_nf_free(nf);
+	pbg_nf_clauses_free(&c);
 }
 
-int pbg_evaluate_r(pbg_expr* e, pbg_error* err, pbg_field* field)
+int pbg_nf_clause(pbg_nf* nf, int i, pbg_field*** atoms, int** negated)
 {
-	if(pbg_type_isbool(field->_type)) {
-		switch(field->_type) {
-			case PBG_OP_NOT:   return pbg_evaluate_op_not(e, err, field);
-			case PBG_OP_AND:   return pbg_evaluate_op_and(e, err, field);
-			case PBG_OP_OR:    return pbg_evaluate_op_or(e, err, field);
-			case PBG_OP_EXST:  return pbg_evaluate_op_exst(e, err, field);
-			case PBG_OP_EQ:    return pbg_evaluate_op_eq(e, err, field);
-			case PBG_OP_NEQ:   return pbg_evaluate_op_neq(e, err, field);
-			case PBG_OP_LT:
-			case PBG_OP_GT:
-			case PBG_OP_LTE:
-			case PBG_OP_GTE:   return pbg_evaluate_op_order(e, err, field);
-			case PBG_OP_TYPE:  return pbg_evaluate_op_type(e, err, field);
-			case PBG_LT_TRUE:  return PBG_TRUE;
-			case PBG_LT_FALSE: return PBG_FALSE;
-			default: pbg_err_state(err, __LINE__, __FILE__,
-							"Unsupported operation.");
-		}
-	}
-	pbg_err_state(err, __LINE__, __FILE__, 
-			"Cannot evaluate a non-BOOL value.");
-	return PBG_ERROR;
+	*atoms = nf->_atoms + nf->_clauses[i];
+	*negated = nf->_negated + nf->_clauses[i];
+	return nf->_clauses[i+1] - nf->_clauses[i];
 }
 
-int pbg_evaluate(pbg_expr* e, pbg_error* err, pbg_field (*dict)(char*, int))
+
+/**************************
+ *                        *
+ * EXPRESSION COMBINATION *
+ *                        *
+ **************************/
+
+void pbg_combine(pbg_expr* e, pbg_error* err, pbg_field_type op, 
+		pbg_expr** exprs, int n)
 {
-	int i, result;
-	pbg_field* newvars, *var, *oldvars;
+	int i, numconst, numvars, compiled, id, *children;
 	
 	/* Always start with a clean error! */
 	pbg_err_init(err, PBG_ERR_NONE, 0, NULL, 0, NULL);
+	e->_constants = NULL;
+	e->_variables = NULL;
+	e->_numconst = 0;
+	e->_numvars = 0;
+	e->_program = NULL;
+	e->_names = NULL;
 	
-	/* Variable resolution. Lookup every variable in provided dictionary. */
-	newvars = (pbg_field*) malloc(e->_numvars * sizeof(pbg_field));
-	if(newvars == NULL) {
-		pbg_err_alloc(err, __LINE__, __FILE__);
-		return PBG_ERROR;
-	}
-	for(i = 0; i < e->_numvars; i++) {
-		var = e->_variables+i;
-		newvars[i] = dict((char*)(var->_data), var->_int);
+	if(pbg_check_op_arity(op, n) == 0) {
+		pbg_err_op_arity(err, __LINE__, __FILE__, op, n);
+		return;
 	}
 	
-	/* Swap out variable literals with dictionary equivalents. */
-	oldvars = e->_variables;
-	e->_variables = newvars;
-	
-	/* Evaluate expression! */
-	result = pbg_evaluate_r(e, err, e->_constants);
+	/* Count fields: the root, and every field reachable from each root. */
+	numconst = 1;
+	numvars = 0;
+	compiled = 0;
+	for(i = 0; i < n; i++) {
+		if(exprs[i]->_numconst == 0) {
+			pbg_err_state(err, __LINE__, __FILE__, 
+					"Cannot combine an empty expression.");
+			return;
+		}
+		if(exprs[i]->_numconst > INT_MAX - numconst || 
+				exprs[i]->_numvars > INT_MAX - numvars) {
+			pbg_err_limit(err, __LINE__, __FILE__, 
+					"Combined expression is too large.");
+			return;
+		}
+		pbg_nf_count_r(exprs[i], 1, &numconst, &numvars);
+		compiled = compiled || exprs[i]->_program != NULL;
+	}
 	
-	/* Restore old variable literal array. */
-	e->_variables = oldvars;
+	/* Allocate everything up front. */
+	e->_constants = (pbg_field*) malloc(numconst * sizeof(pbg_field));
+	e->_variables = (pbg_field*) malloc((numvars+1) * sizeof(pbg_field));
+	if(e->_constants == NULL || e->_variables == NULL) {
+		pbg_err_alloc(err, __LINE__, __FILE__);
+		pbg_free(e);
+		return;
+	}
 	
-	/* Clean up malloc'd memory. */
-	for(i = 0; i < e->_numvars; i++)
-		pbg_field_free(newvars+i);
-	free(newvars);
+	/* Store the root, then copy each expression after it in preorder. */
+	id = pbg_store_constant(e, pbg_parse_op(err, op, n));
+	children = pbg_field_get(e, id)->_data;
+	for(i = 0; i < n && children != NULL; i++)
+		if((children[i] = pbg_nf_copy_r(e, err, exprs[i], 1)) == 0)
+			children = NULL;
+	if(children == NULL) {
+		if(err->_type == PBG_ERR_NONE)
+			pbg_err_alloc(err, __LINE__, __FILE__);
+		pbg_free(e);
+		return;
+	}
 	
-	/* Done! */
-	return result;
+	/* Compiled expressions give a compiled expression. */
+	if(compiled) {
+		pbg_compile(e, err);
+		if(err->_type != PBG_ERR_NONE)
+			pbg_free(e);
+	}
 }
 
 
@@ -1078,6 +7067,25 @@ int pbg_evaluate(pbg_expr* e, pbg_error* err, pbg_field (*dict)(char*, int))
  *                      *
  ************************/
 
+/**
+ * Frees an expression built by a lazy expression, along with the subtrees of 
+ * its PBG_LAZY fields.
+ * @param e  Expression to free.
+ */
+void pbg_lazy_free_r(pbg_expr* e)
+{
+	int i;
+	pbg_lazy_node* node;
+	for(i = 0; i < e->_numconst; i++) {
+		if(e->_constants[i]._type != PBG_LAZY)
+			continue;
+		node = e->_constants[i]._data;
+		if(node->_built)
+			pbg_lazy_free_r(&node->_expr);
+	}
+	pbg_free(e);
+}
+
 void pbg_free(pbg_expr* e)
 {
 	int i;
@@ -1093,6 +7101,97 @@ void pbg_free(pbg_expr* e)
 	/* Free internal field arrays. */
 	if(e->_constants != NULL) free(e->_constants);
 	if(e->_variables != NULL) free(e->_variables);
+	
+	/* Free the compiled program, if any. */
+	pbg_program_free(e->_program);
+	
+	/* Free the split and hashed VAR names, if any. */
+	pbg_names_free(e->_names);
+	
+	/* Leave an empty expression behind so a second pbg_free is harmless. */
+	e->_constants = NULL;
+	e->_variables = NULL;
+	e->_numconst = 0;
+	e->_numvars = 0;
+	e->_program = NULL;
+	e->_names = NULL;
+}
+
+/**
+ * Frees the split and hashed VAR names of an expression, if any.
+ * @param names  VAR names to free, or NULL.
+ */
+void pbg_names_free(pbg_names* names)
+{
+	if(names == NULL) return;
+	free(names->_segments);
+	free(names->_path);
+	free(names->_starts);
+	free(names->_hashes);
+	free(names);
+}
+
+/**
+ * Frees a compiled program, if any.
+ * @param prog  Program to free, or NULL.
+ */
+void pbg_program_free(pbg_program* prog)
+{
+	int i;
+	if(prog == NULL) return;
+	for(i = 0; prog->_nodes != NULL && i < prog->_numnodes; i++) {
+		free(prog->_nodes[i]._members);
+		free(prog->_nodes[i]._bounds);
+		pbg_compile_unmerge(prog->_nodes+i);
+	}
+	free(prog->_nodes);
+	free(prog->_kids);
+	free(prog);
+}
+
+/**
+ * Frees the resources of a scan, and leaves it empty.
+ * @param scan  Scan to free.
+ */
+void pbg_scan_free(pbg_scan* scan)
+{
+	pbg_program_free(scan->_prog);
+	free(scan->_cols);
+	free(scan->_row);
+	free(scan->_numbers);
+	free(scan->_dates);
+	scan->_prog = NULL;
+	scan->_cols = NULL;
+	scan->_row = NULL;
+	scan->_numbers = NULL;
+	scan->_dates = NULL;
+}
+
+void pbg_nf_free(pbg_nf* nf)
+{
+	pbg_free(&nf->_expr);
+	free(nf->_atoms);
+	free(nf->_negated);
+	free(nf->_clauses);
+	nf->_atoms = NULL;
+	nf->_negated = NULL;
+	nf->_clauses = NULL;
+	nf->_numclauses = 0;
+}
+
+/**
+ * Frees the arrays of a clause list and leaves it empty.
+ * @param c  Clause list to free.
+ */
+void pbg_nf_clauses_free(pbg_clauses* c)
+{
+	free(c->_ids);
+	free(c->_negs);
+	free(c->_starts);
+	c->_ids = NULL;
+	c->_negs = NULL;
+	c->_starts = NULL;
+	c->_numclauses = 0;
 }
 
 
@@ -1149,6 +7248,7 @@ char* pbg_error_str(pbg_error_type type)
 		case PBG_ERR_UNKNOWN_TYPE: return "PBG_ERR_UNKNOWN_TYPE";
 		case PBG_ERR_OP_ARITY:     return "PBG_ERR_OP_ARITY";
 		case PBG_ERR_OP_ARG_TYPE:  return "PBG_ERR_OP_ARG_TYPE";
+		case PBG_ERR_LIMIT:        return "PBG_ERR_LIMIT";
 	}
 	return "PBG_ERR_???";
 }
@@ -1249,7 +7349,8 @@ int pbg_isnumber(char* str, int n)
 {
 	int i;
 	
-	/* Start at the beginning of the string. */
+	/* Start at the beginning of the string. Nothing past n is read, as the
+	 * text need not end where the field does. */
 	i = 0;
 	
 	/* Check if negative or positive */
@@ -1259,15 +7360,15 @@ int pbg_isnumber(char* str, int n)
 		return 0;
 	
 	/* Parse everything before the dot. */
-	if(str[i] != '0' && pbg_isdigit(str[i])) {
+	if(i != n && str[i] != '0' && pbg_isdigit(str[i])) {
 		while(i != n && pbg_isdigit(str[i])) i++;
 		if(i != n && !pbg_isdigit(str[i]) && str[i] != '.') return 0;
-	}else if(str[i] == '0') {
+	}else if(i != n && str[i] == '0') {
 		if(++i != n && !(str[i] == '.' || str[i] == 'e' || str[i] == 'E')) return 0;
 	}
 	
 	/* Parse everything after the dot. */
-	if(str[i] == '.') {
+	if(i != n && str[i] == '.') {
 		/* Last character must be a digit. */
 		if(i++ == n-1) return 0;
 		/* Exhaust all digits. */
@@ -1276,11 +7377,11 @@ int pbg_isnumber(char* str, int n)
 	}
 	
 	/* Parse everything after the exponent. */
-	if(str[i] == 'e' || str[i] == 'E') {
+	if(i != n && (str[i] == 'e' || str[i] == 'E')) {
 		/* Last character must be a digit. */
 		if(i++ == n-1) return 0;
 		/* Parse positive or negative sign. */
-		if(str[i] == '-' || str[i] == '+') i++;
+		if(i != n && (str[i] == '-' || str[i] == '+')) i++;
 		/* Exhaust all digits. */
 		while(i != n && pbg_isdigit(str[i])) i++;
 		if(i != n && !pbg_isdigit(str[i])) return 0;
@@ -1290,9 +7391,21 @@ int pbg_isnumber(char* str, int n)
 	return 1;
 }
 
-void pbg_tonumber(pbg_lt_number* ptr, char* str, int n) {
-	PBG_UNUSED(n);
-	ptr->_val = atof(str);
+void pbg_tonumber(pbg_lt_number* ptr, char* str, int n)
+{
+	char buf[64];
+	char* num;
+	/* The text need not end where the NUMBER does, e.g. a field copied out of
+	 * a streamed chunk, so atof is given a terminated copy. */
+	num = (n < (int) sizeof(buf)) ? buf : malloc(n+1);
+	if(num == NULL) {
+		ptr->_val = atof(str);
+		return;
+	}
+	memcpy(num, str, n);
+	num[n] = '\0';
+	ptr->_val = atof(num);
+	if(num != buf) free(num);
 }
 
 int pbg_cmpnumber(pbg_lt_number* n1, pbg_lt_number* n2) {
@@ -1311,8 +7424,27 @@ int pbg_cmpdate(pbg_lt_date* n1, pbg_lt_date* n2) {
 	return 0;
 }
 
-int pbg_cmpstring(pbg_lt_string* s1, pbg_lt_string* s2, int n) {
-	return strncmp(s1, s2, n);
+/**
+ * Compares two STRINGs like strncmp over the length of the first, but never
+ * reads past the end of either. STRINGs are stored without a terminating '\0',
+ * so each compares as if it were followed by one.
+ * @param s1  First STRING.
+ * @param n1  Length of s1, and the number of characters to compare.
+ * @param s2  Second STRING.
+ * @param n2  Length of s2.
+ * @return less than, equal to, or greater than 0, as strncmp.
+ */
+int pbg_cmpstring(pbg_lt_string* s1, int n1, pbg_lt_string* s2, int n2)
+{
+	int i;
+	unsigned char c1, c2;
+	for(i = 0; i < n1; i++) {
+		c1 = (unsigned char) s1[i];
+		c2 = (i < n2) ? (unsigned char) s2[i] : 0;
+		if(c1 != c2) return c1 - c2;
+		if(c1 == 0) return 0;
+	}
+	return 0;
 }
 
 int pbg_isvar(char* str, int n) {
@@ -1340,6 +7472,43 @@ void pbg_todate(pbg_lt_date* ptr, char* str, int n) {
 	ptr->_DD = (str[8]-'0')*10 + (str[9]-'0');
 }
 
+/**
+ * Counts the days from 1970-01-01 to the given DATE in the Gregorian calendar.
+ * @param date  DATE to convert.
+ * @return days since 1970-01-01, negative for earlier DATEs.
+ */
+long pbg_days_from_date(pbg_lt_date* date)
+{
+	long y, m, d, era, yoe, doy, doe;
+	y = (long) date->_YYYY, m = (long) date->_MM, d = (long) date->_DD;
+	/* Count years from March, so leap days fall at the end. */
+	y -= (m <= 2);
+	era = (y >= 0 ? y : y-399) / 400;
+	yoe = y - era*400;
+	doy = (153*(m > 2 ? m-3 : m+9) + 2)/5 + d-1;
+	doe = yoe*365 + yoe/4 - yoe/100 + doy;
+	return era*146097 + doe - 719468;
+}
+
+/**
+ * Converts days since 1970-01-01 to a DATE in the Gregorian calendar.
+ * @param date  Set to the DATE.
+ * @param days  Days since 1970-01-01.
+ */
+void pbg_date_from_days(pbg_lt_date* date, long days)
+{
+	long era, doe, yoe, doy, mp;
+	days += 719468;
+	era = (days >= 0 ? days : days-146096) / 146097;
+	doe = days - era*146097;
+	yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+	doy = doe - (365*yoe + yoe/4 - yoe/100);
+	mp = (5*doy + 2)/153;
+	date->_DD = (unsigned int) (doy - (153*mp + 2)/5 + 1);
+	date->_MM = (unsigned int) (mp < 10 ? mp+3 : mp-9);
+	date->_YYYY = (unsigned int) (yoe + era*400 + (date->_MM <= 2));
+}
+
 /**
  * Checks if the given type is an operator, TRUE, or FALSE. Useful for checking 
  * if both arguments will have a valid return value from pbg_evaluate_r.
@@ -1362,6 +7531,23 @@ int pbg_type_isop(pbg_field_type type) {
 	return type > PBG_MIN_OP && type < PBG_MAX_OP;
 }
 
+/**
+ * Checks if a field of the given type has the type named by a TYPE literal, as
+ * the TYPE operator checks it.
+ * @param tp    TYPE literal, e.g. PBG_LT_TP_NUMBER.
+ * @param type  Type of the field.
+ * @return 1 if the field has the named type, 0 otherwise.
+ */
+int pbg_type_istype(pbg_field_type tp, pbg_field_type type) {
+	switch(tp) {
+		case PBG_LT_TP_BOOL:   return pbg_type_isbool(type);
+		case PBG_LT_TP_DATE:   return type == PBG_LT_DATE;
+		case PBG_LT_TP_NUMBER: return type == PBG_LT_NUMBER;
+		case PBG_LT_TP_STRING: return type == PBG_LT_STRING;
+		default:               return 0;
+	}
+}
+
 
 /********************
  *                  *
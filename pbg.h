@@ -13,6 +13,10 @@
  * dependent, which is just dandy. */
 #define PBG_UNUSED(x) (void)(x)
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* Used to represent the result of an expression evaluation. */
 #define PBG_FALSE  0
 #define PBG_TRUE   1
@@ -82,15 +86,60 @@ typedef struct {
 /**
  * This struct represents a PBG expression. There are two arrays in this 
  * representation: one for constants, and one for variables. Both types are
- * represented by fields. 
+ * represented by fields. An expression may also carry a compiled program, built
+ * by pbg_compile, which is used in place of the fields during evaluation.
  */
 typedef struct {
 	pbg_field*  _constants;  /* Constants. */
 	pbg_field*  _variables;  /* Variables. */
 	int         _numconst;   /* Number of constants. */
 	int         _numvars;    /* Number of variables. */
+	void*       _program;    /* Compiled program, or NULL. */
+	void*       _names;      /* Split and hashed VAR names, or NULL. */
 } pbg_expr;
 
+/**
+ * This struct represents one segment of a dotted VAR name, e.g. "address" in
+ * [user.address.country]. Segments are split once, when the expression is 
+ * parsed, and interned, so equal segments of an expression share one segment
+ * and can be compared by pointer. The text is as written, escapes included; an
+ * escaped '.' does not split the name.
+ */
+typedef struct {
+	char*          _str;   /* Text of the segment. Not terminated. */
+	int            _n;     /* Length of _str. */
+	unsigned long  _hash;  /* Hash of _str by the dictionary's _hash or pbg_hash. */
+} pbg_segment;
+
+/**
+ * Hash function of VAR names, for dictionaries that look names up by hash.
+ */
+typedef unsigned long (*pbg_hash_fn)(char* key, int n);
+
+/**
+ * This struct represents a dictionary used to resolve VAR names during
+ * evaluation. Each VAR is resolved once per evaluation with _get, and every
+ * resolved field is handed back to _release once the evaluation is done. This
+ * lets the dictionary return fields whose data it still owns (borrowed
+ * fields), e.g. a STRING pointing straight into its own storage. A dictionary
+ * of nested records may set _get_path, which then resolves every VAR in place
+ * of _get, given the segments of its name. A dictionary that looks names up by
+ * hash may instead set _get_hashed, which is also given the hash of the name 
+ * by _hash. Segments given to _get_path are hashed by _hash as well, so a
+ * dictionary can hash its own keys to match. Names and segments are hashed
+ * with pbg_hash when parsed, and with any other function the first time it is
+ * used, so no name is hashed per evaluation.
+ */
+typedef struct {
+	pbg_field  (*_get)(void* ctx, char* key, int n);  /* Resolves a VAR. */
+	void       (*_release)(void* ctx, pbg_field* f);  /* NULL frees _data. */
+	void*        _ctx;                                /* Passed to all. */
+	pbg_field  (*_get_path)(void* ctx, pbg_segment** path, int n);  /* Or NULL. */
+	pbg_field  (*_get_hashed)(void* ctx, char* key, int n, 
+			unsigned long hash);                      /* Or NULL. */
+	pbg_hash_fn  _hash;                               /* NULL for pbg_hash. */
+} pbg_dict;
+
 
 /************************
  *                      *
@@ -108,7 +157,8 @@ typedef enum {
 	PBG_ERR_SYNTAX,
 	PBG_ERR_UNKNOWN_TYPE,
 	PBG_ERR_OP_ARITY,
-	PBG_ERR_OP_ARG_TYPE
+	PBG_ERR_OP_ARG_TYPE,
+	PBG_ERR_LIMIT
 } pbg_error_type;
 
 /**
@@ -147,8 +197,195 @@ void pbg_parse(pbg_expr* e, pbg_error* err, char* str);
  */
 void pbg_parse_n(pbg_expr* e, pbg_error* err, char* str, int n);
 
+/**
+ * Checks that the string is a valid expression in Prefix Boolean Grammar,
+ * without building it. Syntax, literal formats, operator arity, and field
+ * ordering are checked, and err is set to the same error pbg_parse_n would
+ * give. The string is read in three linear passes, and only a stack as deep
+ * as the expression is allocated.
+ * @param err  Container to store error, if any occurs.
+ * @param str  String to check. It need not be terminated with '\0'.
+ * @param n    Length of str.
+ * @return 1 if pbg_parse_n would succeed, 0 otherwise.
+ */
+int pbg_validate(pbg_error* err, char* str, int n);
+
+/**
+ * This struct represents a parser, which keeps its scratch buffers between 
+ * expressions so that parsing many of them does not allocate them each time.
+ * It also parses streamed text, which arrives in chunks. Each chunk is parsed
+ * as it is fed, so the text is never put back together; only a field cut by the
+ * end of a chunk is copied. A parser must not be shared between threads. Its 
+ * members are private.
+ */
+typedef struct {
+	pbg_expr   _expr;         /* Expression being built. */
+	int        _constcap;     /* Capacity of _expr._constants. */
+	int        _varcap;       /* Capacity of _expr._variables. */
+	int*       _groups;       /* Open groups, innermost last. */
+	int        _numgroups;    /* Number of open groups. */
+	int        _groupcap;     /* Capacity of _groups, in ints. */
+	int*       _children;     /* Children of the open operators. */
+	int        _numchildren;  /* Number of children in _children. */
+	int        _childcap;     /* Capacity of _children. */
+	char*      _tok;          /* Start of a field cut by the end of a chunk. */
+	int        _toklen;       /* Length of _tok. */
+	int        _tokcap;       /* Capacity of _tok. */
+	int        _tokstart;     /* Offset of the last field started. */
+	int        _state;        /* Kind of field the last chunk ended in. */
+	char       _prev;         /* Last character read in a STRING or VAR. */
+	int        _pos;          /* Number of characters fed. */
+	int        _numfields;    /* Number of fields read. */
+	int        _depth;        /* Number of groups open. */
+	int        _reachedend;   /* Offset ending the first expression, or 0. */
+	int        _ended;        /* 1 if the first expression has ended. */
+	int        _stopped;      /* Offset reading stopped at, or -1. */
+	int        _opened;       /* 1 if the next field must be an operator. */
+	int        _orderi;       /* Offset of the first misplaced field, or -1. */
+	int        _erri;         /* Offset of the field behind _err, or -1. */
+	pbg_error  _err;          /* Earliest arity or literal error. */
+	pbg_error  _fail;         /* Allocation or limit error, if any. */
+	int*       _scratch;      /* Scratch space of pbg_parser_parse_n. */
+	int        _scratchcap;   /* Capacity of _scratch. */
+} pbg_parser;
+
+/**
+ * Initializes a streaming parser.
+ * @param p  Parser to initialize.
+ */
+void pbg_parser_init(pbg_parser* p);
+
+/**
+ * Parses the string as pbg_parse_n does, using the scratch buffers of the 
+ * parser. Only the fields of the expression are allocated once the buffers are
+ * large enough. Any streamed text being fed is left alone.
+ * @param p    Parser to use.
+ * @param e    PBG expression instance to initialize.
+ * @param err  Container to store error, if any occurs.
+ * @param str  String to parse.
+ * @param n    Length of the string.
+ */
+void pbg_parser_parse_n(pbg_parser* p, pbg_expr* e, pbg_error* err, 
+		char* str, int n);
+
+/**
+ * Feeds the next chunk of text to the parser. Chunks may end anywhere, even in
+ * the middle of a STRING, a VAR, or an escape, and are not kept once this
+ * returns. Syntax errors are held back until pbg_parser_finish.
+ * @param p    Parser to feed.
+ * @param err  Container to store error, if any occurs. Only allocation and
+ *             limit errors are reported here.
+ * @param str  Chunk of text. It need not be terminated with '\0'.
+ * @param n    Length of str.
+ */
+void pbg_parser_feed(pbg_parser* p, pbg_error* err, char* str, int n);
+
+/**
+ * Builds the expression from the text fed so far, and readies the parser for
+ * the next one. The expression and error are those pbg_parse_n would give for
+ * the whole text, except that syntax errors carry the offset of the error but
+ * not the text itself.
+ * @param p    Parser to finish.
+ * @param e    PBG expression instance to initialize.
+ * @param err  Container to store error, if any occurs.
+ */
+void pbg_parser_finish(pbg_parser* p, pbg_expr* e, pbg_error* err);
+
+/**
+ * Frees all resources of the parser, including any expression it was building.
+ * This function does not free the provided pointer.
+ * @param p  Parser to free.
+ */
+void pbg_parser_free(pbg_parser* p);
+
+/**
+ * A builder constructs an expression from calls, one per field or closing 
+ * parenthesis, in the order the fields would be written. It is a parser that 
+ * is handed fields instead of text, so it shares the parser's buffers and 
+ * enforces the same rules. Initialize and free it with pbg_parser_init and 
+ * pbg_parser_free. Errors are held back until pbg_builder_finish, and a syntax
+ * error carries the index of the offending call as its offset.
+ */
+typedef pbg_parser pbg_builder;
+
+/**
+ * Opens a group with the given operator, as "(op" would.
+ * @param b     Builder to add to.
+ * @param type  Type of the operator.
+ */
+void pbg_builder_op(pbg_builder* b, pbg_field_type type);
+
+/**
+ * Closes the innermost open group, as ")" would.
+ * @param b  Builder to add to.
+ */
+void pbg_builder_end(pbg_builder* b);
+
+/**
+ * Adds a VAR. The name is given without brackets, and any ']' in it is 
+ * escaped as it is copied. A name ending in a backslash escapes its closing
+ * bracket, so the VAR is left unclosed and later calls are ignored.
+ * @param b     Builder to add to.
+ * @param name  Name of the VAR. It need not be terminated with '\0'.
+ * @param n     Length of name.
+ */
+void pbg_builder_var(pbg_builder* b, char* name, int n);
+
+/**
+ * Adds a NUMBER.
+ * @param b      Builder to add to.
+ * @param value  Value of the NUMBER.
+ */
+void pbg_builder_number(pbg_builder* b, double value);
+
+/**
+ * Adds a DATE. The year must be within 0 to 9999, and the month and day within
+ * 0 to 99, so the DATE can be written as YYYY-MM-DD. Any other DATE is a field
+ * of unknown type.
+ * @param b      Builder to add to.
+ * @param year   Year of the DATE.
+ * @param month  Month of the DATE.
+ * @param day    Day of the DATE.
+ */
+void pbg_builder_date(pbg_builder* b, int year, int month, int day);
+
+/**
+ * Adds a STRING. The text is given without quotes, and any quote in it is
+ * escaped as it is copied. Text ending in a backslash escapes its closing 
+ * quote, so the STRING is left unclosed and later calls are ignored.
+ * @param b    Builder to add to.
+ * @param str  Text of the STRING. It need not be terminated with '\0'.
+ * @param n    Length of str.
+ */
+void pbg_builder_string(pbg_builder* b, char* str, int n);
+
+/**
+ * Adds TRUE or FALSE.
+ * @param b      Builder to add to.
+ * @param truth  Nonzero for TRUE, 0 for FALSE.
+ */
+void pbg_builder_bool(pbg_builder* b, int truth);
+
+/**
+ * Adds a TYPE literal.
+ * @param b     Builder to add to.
+ * @param type  Type literal, e.g. PBG_LT_TP_NUMBER.
+ */
+void pbg_builder_type(pbg_builder* b, pbg_field_type type);
+
+/**
+ * Builds the expression from the calls made so far, and readies the builder
+ * for the next one. The expression and error are those pbg_parse_n would give
+ * for the text the calls spell out.
+ * @param b    Builder to finish.
+ * @param e    PBG expression instance to initialize.
+ * @param err  Container to store error, if any occurs.
+ */
+void pbg_builder_finish(pbg_builder* b, pbg_expr* e, pbg_error* err);
+
 /**
  * Evaluates the PBG expression with the provided assignments.
+ * An expression that failed to parse or was freed is a state error.
  * @param e     PBG expression to evaluate.
  * @param err   Container to store error, if any occurs.
  * @param dict  Dictionary used to resolve VAR names.
@@ -157,20 +394,515 @@ void pbg_parse_n(pbg_expr* e, pbg_error* err, char* str, int n);
  */
 int pbg_evaluate(pbg_expr* e, pbg_error* err, pbg_field (*dict)(char*, int));
 
+/**
+ * Evaluates the PBG expression with the provided dictionary interface.
+ * An expression that failed to parse or was freed is a state error.
+ * @param e     PBG expression to evaluate.
+ * @param err   Container to store error, if any occurs.
+ * @param dict  Dictionary used to resolve VAR names.
+ * @return 1 if the PBG expression evaluates to true with the given dictionary. 
+ *         0 otherwise.
+ */
+int pbg_evaluate_dict(pbg_expr* e, pbg_error* err, pbg_dict* dict);
+
+/**
+ * Hashes a VAR name as names are hashed when parsed: FNV-1a, 64-bit where 
+ * unsigned long is, 32-bit otherwise. The hash is stable across runs, so a
+ * dictionary may store it with its keys.
+ * @param key  VAR name to hash, as written.
+ * @param n    Length of key.
+ * @return the hash of the name.
+ */
+unsigned long pbg_hash(char* key, int n);
+
+/**
+ * Evaluates the string as a PBG expression without building it, for 
+ * expressions that are only evaluated once. Fields are read from the text as
+ * they are needed, so VARs are only resolved if their value is used, and the
+ * text of subtrees skipped by AND and OR is passed over by matching 
+ * parentheses. The result and error are those pbg_parse_n and pbg_evaluate 
+ * would give. The text is validated first with pbg_validate, whose stack as 
+ * deep as the expression is the only allocation besides any error reported.
+ * @param err   Container to store error, if any occurs.
+ * @param str   String to evaluate. It need not be terminated with '\0'.
+ * @param n     Length of str.
+ * @param dict  Dictionary used to resolve VAR names.
+ * @return 1 if the PBG expression evaluates to true with the given dictionary. 
+ *         0 otherwise.
+ */
+int pbg_eval_text(pbg_error* err, char* str, int n, pbg_field (*dict)(char*, int));
+
+/**
+ * This struct represents a lazy expression, which builds its subtrees the first
+ * time evaluation reaches them. Its members are private.
+ */
+typedef struct {
+	void*  _root;  /* Top levels of the expression, and its text. */
+} pbg_lazy;
+
+/**
+ * Parses the string as a lazy expression, for very large expressions of which
+ * evaluation only reaches a small part. Only the top depth levels are built.
+ * Groups below them that are arguments of AND, OR, or NOT are remembered by 
+ * their place in the text, and built the first time evaluation reaches them,
+ * again depth levels at a time. The whole string is checked up front, so err 
+ * is set to the same error pbg_parse_n would give. The string is copied, and
+ * its groups indexed once, so building never reads a deferred group's text.
+ * @param l      Lazy expression to initialize.
+ * @param err    Container to store error, if any occurs.
+ * @param str    String to parse. It need not be terminated with '\0'.
+ * @param n      Length of str.
+ * @param depth  Number of levels to build at once, at least 1.
+ */
+void pbg_parse_lazy(pbg_lazy* l, pbg_error* err, char* str, int n, int depth);
+
+/**
+ * Evaluates the lazy expression with the provided assignments, building any 
+ * subtree reached for the first time. Results and errors are those of 
+ * pbg_evaluate. As subtrees are built during evaluation, a lazy expression must
+ * not be evaluated by several threads at once.
+ * @param l     Lazy expression to evaluate.
+ * @param err   Container to store error, if any occurs.
+ * @param dict  Dictionary used to resolve VAR names.
+ * @return 1 if the expression evaluates to true with the given dictionary. 
+ *         0 otherwise.
+ */
+int pbg_lazy_evaluate(pbg_lazy* l, pbg_error* err, pbg_field (*dict)(char*, int));
+
+/**
+ * Destroys the lazy expression and frees all associated resources, including
+ * the subtrees built so far. Freeing a lazy expression twice is harmless.
+ * @param l  Lazy expression to destroy.
+ */
+void pbg_lazy_free(pbg_lazy* l);
+
+/**
+ * Compiles the PBG expression for faster evaluation. Common shapes are fused
+ * into single operations with their constant stored inline: a VAR compared to
+ * a NUMBER, DATE, or STRING constant, EXST on a single VAR, and NOT over either
+ * of those. An OR of four or more EQs between one VAR and constants of one
+ * type becomes a single set lookup: a binary search for NUMBERs and DATEs, and
+ * a hash table probe for STRINGs. Comparisons between one VAR and NUMBER or
+ * DATE constants under an AND or OR become a single interval test: the 
+ * constants are merged into a sorted set of intervals, which is binary 
+ * searched. The whole AND or OR becomes one test if every child is such a
+ * comparison, and otherwise each run of two or more neighboring ones does, 
+ * e.g. the first two children of (& (>= [age] 18) (< [age] 65) (= [c] 'US')).
+ * VARs of the same name are taken to resolve to the same field. Evaluation 
+ * results and errors are unchanged. Compiling an expression twice is 
+ * harmless, and pbg_free releases the program.
+ * @param e    PBG expression to compile.
+ * @param err  Container to store error, if any occurs.
+ */
+void pbg_compile(pbg_expr* e, pbg_error* err);
+
+/**
+ * Puts the PBG expression in managed mode. The expression starts out in the
+ * interpreter and profiles its first warmup evaluations. It then compiles
+ * itself as pbg_compile does, and reorders the children of every AND and OR so
+ * that those most often decisive for the least work run first. Children that
+ * can produce an error are never moved, so results and errors are unchanged.
+ * After every period further evaluations, it profiles again and reorders to 
+ * follow changes in the data. Calling this again restarts profiling.
+ * @param e       PBG expression to manage.
+ * @param err     Container to store error, if any occurs.
+ * @param warmup  Number of evaluations to profile before recompiling.
+ * @param period  Number of evaluations between profiles, or 0 to profile once.
+ */
+void pbg_manage(pbg_expr* e, pbg_error* err, int warmup, int period);
+
+/**
+ * Combines expressions under a new operator, e.g. the AND of a guard and a 
+ * filter, without going back to their text. Each expression is copied whole
+ * beneath the new root, and is left as it was. The result is compiled if any
+ * of the expressions is.
+ * @param e      PBG expression instance to initialize.
+ * @param err    Container to store error, if any occurs.
+ * @param op     Type of the operator at the root.
+ * @param exprs  Expressions to combine, which become the arguments of op.
+ * @param n      Number of expressions.
+ */
+void pbg_combine(pbg_expr* e, pbg_error* err, pbg_field_type op, 
+		pbg_expr** exprs, int n);
+
+/**
+ * Writes the canonical text of the PBG expression. The text has as little
+ * whitespace as the grammar allows, NUMBERs are written in the shortest form
+ * that reads back to the same value, and DATEs as YYYY-MM-DD. STRINGs and VARs
+ * are written as they were parsed, escapes included. Parsing the text gives
+ * the same expression, and printing it again gives the same text, so the text
+ * can be used as a cache key. Like snprintf, at most n-1 characters are 
+ * written, followed by '\0'.
+ * @param e    PBG expression to print.
+ * @param buf  Buffer to write to.
+ * @param n    Size of buf.
+ * @return the length of the full text, excluding the '\0', 
+ *         -1 if the expression has no text, e.g. it holds a NaN NUMBER.
+ */
+int pbg_print(pbg_expr* e, char* buf, int n);
+
 /**
  * Destroys the PBG expression instance and frees all associated resources.
- * This function does not free the provided pointer.
+ * This function does not free the provided pointer. Freeing an expression twice
+ * is harmless.
  * @param e PBG expression to destroy.
  */
 void pbg_free(pbg_expr* e);
 
 
+/****************
+ *              *
+ * NORMAL FORMS *
+ *              *
+ ****************/
+
+/**
+ * Normal forms an expression can be rewritten into.
+ */
+typedef enum {
+	PBG_NF_DNF,  /* Disjunctive normal form: an OR of ANDs of atoms. */
+	PBG_NF_CNF   /* Conjunctive normal form: an AND of ORs of atoms. */
+} pbg_nf_form;
+
+/**
+ * This struct represents an expression rewritten into a normal form. An atom is
+ * any field that is not an AND, OR, or NOT. Every NOT is pushed down onto the
+ * atoms, so each clause is a flat list of atoms, some of them negated. _expr
+ * holds the rewritten expression, and the atoms point into it. A normal form
+ * with no clauses is FALSE (DNF) or TRUE (CNF).
+ */
+typedef struct {
+	pbg_expr     _expr;        /* Rewritten expression. */
+	pbg_field**  _atoms;       /* Atoms of every clause, one clause after another. */
+	int*         _negated;     /* 1 if the matching atom is negated, 0 otherwise. */
+	int*         _clauses;     /* Index of each clause's first atom, then the end. */
+	int          _numclauses;  /* Number of clauses. */
+} pbg_nf;
+
+/**
+ * Rewrites the expression into the given normal form. The rewrite is bounded:
+ * if the result would need more than maxfields fields, err is set to
+ * PBG_ERR_LIMIT and nothing is kept. Duplicate atoms are merged, and clauses
+ * holding both an atom and its negation are dropped. The result evaluates to
+ * the same value as e whenever none of the atoms produce an error.
+ * @param nf         Normal form instance to initialize.
+ * @param err        Container to store error, if any occurs.
+ * @param e          PBG expression to rewrite. It is not modified.
+ * @param form       Normal form to rewrite into.
+ * @param maxfields  Maximum number of fields in the rewritten expression.
+ */
+void pbg_normalize(pbg_nf* nf, pbg_error* err, pbg_expr* e, pbg_nf_form form, 
+		int maxfields);
+
+/**
+ * Gets the atoms of a clause in a normal form.
+ * @param nf       Normal form to read.
+ * @param i        Index of the clause, from 0 to nf->_numclauses-1.
+ * @param atoms    Set to the first atom of the clause.
+ * @param negated  Set to the negation flag of the first atom of the clause.
+ * @return the number of atoms in the clause.
+ */
+int pbg_nf_clause(pbg_nf* nf, int i, pbg_field*** atoms, int** negated);
+
+/**
+ * Destroys the normal form and frees all associated resources. This function
+ * does not free the provided pointer. Freeing a normal form twice is harmless.
+ * @param nf  Normal form to destroy.
+ */
+void pbg_nf_free(pbg_nf* nf);
+
+
+/************
+ *          *
+ * ANALYSIS *
+ *          *
+ ************/
+
+/**
+ * What an analysis proves about an expression, whatever its VARs resolve to.
+ */
+typedef enum {
+	PBG_AN_UNKNOWN,  /* Nothing was proven. */
+	PBG_AN_NEVER,    /* The expression is never TRUE: it is FALSE or PBG_ERROR. */
+	PBG_AN_ALWAYS    /* The expression is always TRUE. */
+} pbg_analysis;
+
+/**
+ * Tries to prove that the expression is never TRUE, e.g. (& (< [x] 3) (> [x] 5))
+ * or (& (@ DATE [x]) (< [x] 9)), or always TRUE, e.g. (| (? [x]) (! (? [x]))). 
+ * ANDs, ORs, and NOTs are followed with the short-circuiting of pbg_evaluate, 
+ * and EXST, TYPE, VARs used as BOOLs, and comparisons between a VAR and a 
+ * NUMBER, DATE, or STRING constant narrow the types and values each VAR may
+ * have. VARs of the same name are the same VAR. Anything else is assumed to 
+ * be possible, and so is everything if the analysis runs too long, so a proof
+ * is always sound but may be missed.
+ * @param e    PBG expression to analyze.
+ * @param err  Container to store error, if any occurs.
+ * @return PBG_AN_NEVER or PBG_AN_ALWAYS if either was proven, PBG_AN_UNKNOWN
+ *         otherwise or if err was set.
+ */
+pbg_analysis pbg_analyze(pbg_expr* e, pbg_error* err);
+
+/**
+ * Tries to prove that one expression is TRUE whenever another is, e.g. that
+ * (& (= [kind] 'disk') (> [used] 90)) implies (> [used] 80). The expressions
+ * are analyzed together as pbg_analyze does, with VARs of the same name being
+ * the same VAR in both, and b must be neither FALSE nor PBG_ERROR whenever a
+ * is TRUE.
+ * @param a    PBG expression assumed TRUE.
+ * @param b    PBG expression to prove TRUE.
+ * @param err  Container to store error, if any occurs.
+ * @return 1 if a implies b was proven, 0 otherwise or if err was set.
+ */
+int pbg_implies(pbg_expr* a, pbg_expr* b, pbg_error* err);
+
+
+/***********
+ *         *
+ * BATCHES *
+ *         *
+ ***********/
+
+/**
+ * This struct represents one column of a batch of rows. Values are stored
+ * contiguously, one per row, in a layout chosen by the type of the column:
+ *   PBG_LT_TP_NUMBER  _values holds a double per row.
+ *   PBG_LT_TP_DATE    _values holds an int per row: days since 1970-01-01.
+ *   PBG_LT_TP_STRING  _values holds the characters of every row, one after 
+ *                     another, and _offsets holds the start of each row's 
+ *                     characters, then the end of the last row's.
+ *   PBG_LT_TP_BOOL    _values is a bitmap holding a bit per row.
+ * Bitmaps hold the bit of row i in byte i/8 at position i%8, least significant
+ * first. A row whose bit in _valid is 0 is NULL. Every index is shifted by
+ * _offset, so row i is found at index _offset+i.
+ */
+typedef struct {
+	char*           _name;     /* Name of the column as written in VARs. */
+	pbg_field_type  _type;     /* Type literal giving the type of the column. */
+	void*           _values;   /* Values of the column. */
+	int*            _offsets;  /* Offsets of each STRING, NULL for other types. */
+	unsigned char*  _valid;    /* Validity bitmap, NULL if no row is NULL. */
+	int             _offset;   /* Index of the first row in _values, _offsets, 
+	                            * and _valid, so columns can share storage. */
+} pbg_column;
+
+/**
+ * This struct represents a batch of rows stored column by column. Each VAR is
+ * resolved to the column of the same name, and is NULL if there is none.
+ */
+typedef struct {
+	pbg_column*  _columns;     /* Columns of the batch. */
+	int          _numcolumns;  /* Number of columns. */
+	int          _numrows;     /* Number of rows in every column. */
+} pbg_batch;
+
+/**
+ * This struct holds aggregates of a NUMBER column over the rows of a batch for
+ * which an expression is TRUE. NULL values are skipped, as in SQL. If no value
+ * is aggregated, _sum, _min, and _max are 0.
+ */
+typedef struct {
+	int     _matches;  /* Rows for which the expression is TRUE. */
+	int     _count;    /* Matching rows with a value in the target column. */
+	double  _sum;      /* Sum of those values. */
+	double  _min;      /* Least of those values. */
+	double  _max;      /* Greatest of those values. */
+} pbg_agg;
+
+/**
+ * Evaluates the expression for every row of a batch. Rows are evaluated many
+ * at a time: ANDs, ORs, NOTs, TYPEs, EXSTs of a VAR, and comparisons between a
+ * VAR and a constant work on whole blocks of rows, whatever the type of the 
+ * VAR's column. Everything else falls back to evaluating one row at a time: 
+ * comparisons between two VARs or with an operator, EQs of more than two 
+ * fields, EXSTs of more than one field, and orders against TRUE or FALSE. 
+ * Every row gets the result pbg_evaluate would give it. Rows that evaluate to
+ * PBG_ERROR are not selected.
+ * @param e          PBG expression to evaluate.
+ * @param err        Container to store error, if any occurs.
+ * @param batch      Batch of rows to evaluate.
+ * @param selection  Bitmap of at least (batch->_numrows+7)/8 bytes, set to the
+ *                   rows for which the expression is TRUE.
+ * @return the number of rows selected, PBG_ERROR if err was set.
+ */
+int pbg_evaluate_batch(pbg_expr* e, pbg_error* err, pbg_batch* batch, 
+		unsigned char* selection);
+
+/**
+ * Evaluates the expression for every row of a batch as pbg_evaluate_batch 
+ * does, and also reports the rows that evaluate to PBG_ERROR. A bad row never
+ * fails the batch. Errors are worked out a block at a time, alongside results:
+ *   NOT  keeps the errors of its child.
+ *   AND  stops at the first child that is FALSE or PBG_ERROR for a row.
+ *   OR   stops at the first child that is TRUE or PBG_ERROR for a row.
+ * These are the short-circuiting rules of pbg_evaluate, so a row is an error 
+ * exactly when pbg_evaluate gives PBG_ERROR for it. NULL rows of a column are
+ * errors of every comparison with it, and do not stop the block from being
+ * scanned as a whole.
+ * @param e          PBG expression to evaluate.
+ * @param err        Container to store error, if any occurs.
+ * @param batch      Batch of rows to evaluate.
+ * @param selection  Bitmap of at least (batch->_numrows+7)/8 bytes, set to the
+ *                   rows for which the expression is TRUE.
+ * @param errors     Bitmap of at least (batch->_numrows+7)/8 bytes, set to the
+ *                   rows for which the expression is PBG_ERROR. May be NULL.
+ * @return the number of rows selected, PBG_ERROR if err was set.
+ */
+int pbg_evaluate_batch_errors(pbg_expr* e, pbg_error* err, pbg_batch* batch, 
+		unsigned char* selection, unsigned char* errors);
+
+/**
+ * Counts the rows of a batch for which the expression is TRUE. Rows are
+ * evaluated as in pbg_evaluate_batch, but nothing is stored per row.
+ * @param e      PBG expression to evaluate.
+ * @param err    Container to store error, if any occurs.
+ * @param batch  Batch of rows to evaluate.
+ * @return the number of rows for which e is TRUE, PBG_ERROR if err was set.
+ */
+int pbg_count_batch(pbg_expr* e, pbg_error* err, pbg_batch* batch);
+
+/**
+ * Checks if the expression is TRUE for any row in a range of a batch. Rows are
+ * evaluated as in pbg_evaluate_batch, a block at a time, stopping after the
+ * first block that holds a match.
+ * @param e      PBG expression to evaluate.
+ * @param err    Container to store error, if any occurs.
+ * @param batch  Batch of rows to evaluate.
+ * @param start  First row of the range.
+ * @param end    Row after the last row of the range.
+ * @param row    Set to the first row for which e is TRUE, if any. May be NULL.
+ * @return PBG_TRUE if e is TRUE for a row in the range, PBG_FALSE if not, 
+ *         PBG_ERROR if err was set.
+ */
+int pbg_any_batch(pbg_expr* e, pbg_error* err, pbg_batch* batch, int start, 
+		int end, int* row);
+
+/**
+ * Aggregates a NUMBER column over the rows of a batch for which the expression
+ * is TRUE. Rows are evaluated as in pbg_evaluate_batch, and each block of rows
+ * is aggregated as soon as it is evaluated, so no selection is stored.
+ * @param e       PBG expression to evaluate.
+ * @param err     Container to store error, if any occurs.
+ * @param batch   Batch of rows to evaluate.
+ * @param target  Name of the NUMBER column to aggregate.
+ * @param agg     Set to the aggregates.
+ */
+void pbg_aggregate(pbg_expr* e, pbg_error* err, pbg_batch* batch, char* target, 
+		pbg_agg* agg);
+
+
+/*************
+ *           *
+ * RULE SETS *
+ *           *
+ *************/
+
+/**
+ * This struct represents a set of rules evaluated against the same records,
+ * e.g. sparse events. Each rule records the VARs it requires to be non-NULL to
+ * possibly be TRUE: VAR operands of comparisons, EXST, and TYPE, and VARs used
+ * as BOOLs, through every AND, and through an OR only if all of its children
+ * require them. Each record comes with a presence bitmap of its fields, and a
+ * rule whose required VARs are not all present is skipped with a bitmask test.
+ * Rules pbg_analyze proves never TRUE are always skipped, and rules it proves
+ * always TRUE are selected without being evaluated. Rules are evaluated in 
+ * order, and pbg_implies relates each rule to some rules before it: a rule 
+ * implied by an earlier rule that was selected is selected, and a rule 
+ * implying an earlier rule that was not selected is skipped, without being
+ * evaluated either way. The rules are not copied, and must outlive the rule
+ * set. Its members are private.
+ */
+typedef struct {
+	pbg_expr**      _rules;     /* Rules, as given. */
+	int             _numrules;  /* Number of rules. */
+	char**          _keys;      /* Name of the VAR at each bit. */
+	int*            _lens;      /* Length of each name. */
+	int             _numkeys;   /* Number of distinct VAR names. */
+	int*            _table;     /* Bit of each name plus 1 by hash, 0 if empty. */
+	int             _tablecap;  /* Capacity of _table, a power of two. */
+	int             _numwords;  /* Words in a presence bitmap. */
+	unsigned long*  _required;  /* Required bitmap of each rule, one after another. */
+	pbg_analysis*   _analyses;  /* What pbg_analyze proved of each rule. */
+	int*            _links;     /* Earlier rules implying (i) or implied (-i-1) by each. */
+	int*            _linkstart; /* Start of the links of each rule in _links, and the end. */
+} pbg_ruleset;
+
+/**
+ * Initializes a rule set, working out the required VARs of each rule, 
+ * analyzing it, and relating it to the rules before it. A rule is only checked
+ * against the earlier rules sharing an atom with it: first rules comparing a
+ * VAR to the same value, then rules comparing it to a value of the same type,
+ * newest first and at most maxcheck of them. Each check analyzes just the two
+ * rules, so setup takes time in proportion to n times maxcheck. A rule is 
+ * only checked to imply rules whose required VARs it also requires. Ordering
+ * rules from general to specific lets a record that fails a general rule skip
+ * the rules refining it.
+ * @param rs        Rule set to initialize.
+ * @param err       Container to store error, if any occurs.
+ * @param rules     Rules of the set.
+ * @param n         Number of rules.
+ * @param maxcheck  Most earlier rules to check each rule against, 0 to not 
+ *                  relate rules at all, or negative for no limit.
+ */
+void pbg_ruleset_init(pbg_ruleset* rs, pbg_error* err, pbg_expr** rules, int n,
+		int maxcheck);
+
+/**
+ * Gets the size of the presence bitmaps of a rule set.
+ * @param rs  Rule set to size.
+ * @return the number of unsigned longs in a presence bitmap.
+ */
+int pbg_ruleset_words(pbg_ruleset* rs);
+
+/**
+ * Marks a field as present in a presence bitmap. Fields no rule uses are left
+ * out. Records sharing a schema may share a bitmap.
+ * @param rs       Rule set the bitmap is for.
+ * @param present  Presence bitmap, cleared to 0 before the first field.
+ * @param key      Name of the field, as its VARs are written.
+ * @param n        Length of key.
+ */
+void pbg_ruleset_present(pbg_ruleset* rs, unsigned long* present, char* key, 
+		int n);
+
+/**
+ * Evaluates every rule of the set against a record. Rules are evaluated as
+ * pbg_evaluate does, except those skipped, and rules that evaluate to 
+ * PBG_ERROR are not selected. Only running out of memory sets err.
+ * @param rs       Rule set to evaluate.
+ * @param err      Container to store error, if any occurs.
+ * @param present  Presence bitmap of the record's fields.
+ * @param dict     Dictionary used to resolve VAR names.
+ * @param results  Bitmap of at least (n+7)/8 bytes for n rules, set to the 
+ *                 rules that are TRUE.
+ * @return the number of rules selected, PBG_ERROR if err was set.
+ */
+int pbg_ruleset_evaluate(pbg_ruleset* rs, pbg_error* err, unsigned long* present, 
+		pbg_field (*dict)(char*, int), unsigned char* results);
+
+/**
+ * Frees all resources of the rule set, but not its rules. This function does
+ * not free the provided pointer. Freeing a rule set twice is harmless.
+ * @param rs  Rule set to free.
+ */
+void pbg_ruleset_free(pbg_ruleset* rs);
+
+
 /**************
  *            *
  *   FIELDS   *
  *            *
  **************/
 
+/**
+ * Gets a child of an operator field.
+ * @param e      PBG expression holding the operator.
+ * @param field  Operator field in e.
+ * @param i      Index of the child, from 0 to field->_int-1.
+ * @return the i-th child of the operator.
+ */
+pbg_field* pbg_field_child(pbg_expr* e, pbg_field* field, int i);
+
 /**
  * Makes a field representing a DATE.
  * @param year   Year of the date.
@@ -236,4 +968,8 @@ void pbg_error_print(pbg_error* err);
 void pbg_error_free(pbg_error* e);
 
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif  /* __PBG_H__ */
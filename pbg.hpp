@@ -0,0 +1,247 @@
+#ifndef __PBG_HPP__
+#define __PBG_HPP__
+
+/*********************************************************
+ *                                                       *
+ * Thin C++17 ownership wrapper around the PBG library   *
+ *                                                       *
+ *********************************************************/
+
+/* pbg::error and pbg::expr own a pbg_error and a pbg_expr respectively. Both
+ * are move-only with noexcept moves, and release their resources on
+ * destruction, so callers never write pbg_free or pbg_error_free.
+ *
+ *     pbg::error err;
+ *     pbg::expr e(text, err);            // text is a std::string_view
+ *     if(err) { err.print(); return; }
+ *     int result = e.evaluate([&](std::string_view key) {
+ *         if(key == "region") return pbg::value::string(row.region);
+ *         return pbg::value::null();
+ *     }, err);
+ *
+ * Dictionaries receive std::string_view keys and return pbg::value. STRING
+ * values are borrowed: no copy is made, so the viewed characters must outlive
+ * the call to evaluate. Dictionaries must not throw. */
+
+#include "pbg.h"
+#include <cstdlib>
+#include <deque>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace pbg {
+
+/* Owns a pbg_error. */
+class error {
+public:
+	error() noexcept { reset(); }
+	error(const error&) = delete;
+	error& operator=(const error&) = delete;
+	error(error&& other) noexcept : _err(other._err) { other.reset(); }
+	error& operator=(error&& other) noexcept {
+		if(this != &other) {
+			clear();
+			_err = other._err;
+			other.reset();
+		}
+		return *this;
+	}
+	~error() { clear(); }
+
+	/* True if an error has been recorded. */
+	explicit operator bool() const noexcept { return _err._type != PBG_ERR_NONE; }
+
+	pbg_error_type type() const noexcept { return _err._type; }
+
+	/* Prints a human-readable representation to the standard output. */
+	void print() const { pbg_error_print(const_cast<pbg_error*>(&_err)); }
+
+	/* Frees any recorded error data and resets to PBG_ERR_NONE. */
+	void clear() noexcept {
+		if(_err._type != PBG_ERR_NONE) pbg_error_free(&_err);
+		reset();
+	}
+
+	/* Cleared pointer for passing to C functions that report errors. */
+	pbg_error* get() noexcept { clear(); return &_err; }
+
+private:
+	void reset() noexcept {
+		_err._type = PBG_ERR_NONE;
+		_err._line = 0;
+		_err._file = nullptr;
+		_err._int = 0;
+		_err._data = nullptr;
+	}
+
+	pbg_error _err;
+};
+
+/* A value returned by a dictionary. */
+class value {
+public:
+	value() noexcept : _type(PBG_NULL), _number(0), _day{0, 0, 0} {}
+
+	static value null() noexcept { return value(); }
+
+	static value boolean(bool truth) noexcept {
+		value v;
+		v._type = truth ? PBG_LT_TRUE : PBG_LT_FALSE;
+		return v;
+	}
+
+	static value number(double number) noexcept {
+		value v;
+		v._type = PBG_LT_NUMBER;
+		v._number = number;
+		return v;
+	}
+
+	/* Borrows str; it must outlive the evaluation. */
+	static value string(std::string_view str) noexcept {
+		value v;
+		v._type = PBG_LT_STRING;
+		v._string = str;
+		return v;
+	}
+
+	static value date(int year, int month, int day) noexcept {
+		value v;
+		v._type = PBG_LT_DATE;
+		v._day[0] = year, v._day[1] = month, v._day[2] = day;
+		return v;
+	}
+
+private:
+	friend class expr;
+
+	pbg_field_type _type;
+	double _number;
+	std::string_view _string;
+	int _day[3];
+};
+
+/* Owns a pbg_expr. */
+class expr {
+public:
+	expr() noexcept { reset(); }
+
+	/* Parses str. str is not copied, and need not be terminated with '\0'. */
+	expr(std::string_view str, error& err) { reset(); parse(str, err); }
+
+	expr(const expr&) = delete;
+	expr& operator=(const expr&) = delete;
+	expr(expr&& other) noexcept : _e(other._e) { other.reset(); }
+	expr& operator=(expr&& other) noexcept {
+		if(this != &other) {
+			pbg_free(&_e);
+			_e = other._e;
+			other.reset();
+		}
+		return *this;
+	}
+	~expr() { pbg_free(&_e); }
+
+	/* Replaces this expression with the parse of str. */
+	void parse(std::string_view str, error& err) {
+		pbg_free(&_e);
+		pbg_parse_n(&_e, err.get(), const_cast<char*>(str.data()),
+				static_cast<int>(str.size()));
+		if(err) pbg_free(&_e);
+	}
+
+	/**
+	 * Evaluates the expression.
+	 * @param dict  Callable taking a std::string_view and returning pbg::value.
+	 * @param err   Container to store error, if any occurs.
+	 * @return PBG_TRUE or PBG_FALSE, or PBG_ERROR if err was set.
+	 */
+	template<class Dict>
+	int evaluate(Dict&& dict, error& err) {
+		context<std::remove_reference_t<Dict>> ctx{&dict, {}, false};
+		pbg_dict d;
+		int result;
+		d._get = &get<std::remove_reference_t<Dict>>;
+		d._release = &release;
+		d._ctx = &ctx;
+		d._get_path = nullptr;
+		d._get_hashed = nullptr;
+		d._hash = nullptr;
+		result = pbg_evaluate_dict(&_e, err.get(), &d);
+		/* A NUMBER that could not be stored was passed on as NULL. */
+		if(ctx.failed) {
+			pbg_error* failure = err.get();
+			failure->_type = PBG_ERR_ALLOC;
+			failure->_line = __LINE__;
+			failure->_file = const_cast<char*>(__FILE__);
+		}
+		return err ? PBG_ERROR : result;
+	}
+
+	/* Underlying C expression, for use with the rest of the C API. */
+	pbg_expr* get() noexcept { return &_e; }
+	const pbg_expr* get() const noexcept { return &_e; }
+
+private:
+	/* Evaluation state: the dictionary and storage for borrowed NUMBERs. */
+	template<class Dict>
+	struct context {
+		Dict* dict;
+		std::deque<double> numbers;
+		bool failed;  /* Set if storing a NUMBER ran out of memory. */
+	};
+
+	template<class Dict>
+	static pbg_field get(void* ctx, char* key, int n) noexcept {
+		context<Dict>* c = static_cast<context<Dict>*>(ctx);
+		value v = (*c->dict)(std::string_view(key, n));
+		pbg_field f;
+		f._type = v._type;
+		f._int = 0;
+		f._data = nullptr;
+		switch(v._type) {
+			case PBG_LT_NUMBER:
+				try {
+					c->numbers.push_back(v._number);
+				} catch(...) {
+					c->failed = true;
+					f._type = PBG_NULL;
+					break;
+				}
+				f._int = sizeof(double);
+				f._data = &c->numbers.back();
+				break;
+			case PBG_LT_STRING:
+				f._int = static_cast<int>(v._string.size());
+				f._data = const_cast<char*>(v._string.data());
+				break;
+			case PBG_LT_DATE:
+				f = pbg_make_date(v._day[0], v._day[1], v._day[2]);
+				break;
+			default:
+				break;
+		}
+		return f;
+	}
+
+	/* Only DATEs are owned by the library; everything else is borrowed. */
+	static void release(void*, pbg_field* f) noexcept {
+		if(f->_type == PBG_LT_DATE) std::free(f->_data);
+	}
+
+	void reset() noexcept {
+		_e._constants = nullptr;
+		_e._variables = nullptr;
+		_e._numconst = 0;
+		_e._numvars = 0;
+		_e._program = nullptr;
+		_e._names = nullptr;
+	}
+
+	pbg_expr _e;
+};
+
+}  /* namespace pbg */
+
+#endif  /* __PBG_HPP__ */
@@ -0,0 +1,236 @@
+#include "pbg_arrow.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/****************************
+ *                          *
+ * LOCAL FUNCTION DIRECTORY *
+ *                          *
+ ****************************/
+
+void pbg_arrow_err(pbg_error* err, pbg_error_type type, int line, char* file, char* msg);
+pbg_field_type pbg_arrow_type(const char* format);
+int pbg_arrow_hasnull(struct ArrowArray* array);
+void pbg_arrow_release_array(struct ArrowArray* array);
+void pbg_arrow_release_schema(struct ArrowSchema* schema);
+
+
+/********************
+ *                  *
+ * ARROW CONVERSION *
+ *                  *
+ ********************/
+
+/**
+ * Initializes the error, as pbg_err_init does in pbg.c.
+ * @param err   Error to initialize.
+ * @param type  Type of the error.
+ * @param line  Line of file where the error occurred.
+ * @param file  File in which the error occurred.
+ * @param msg   Message of the error, or NULL. It is not freed.
+ */
+void pbg_arrow_err(pbg_error* err, pbg_error_type type, int line, char* file, char* msg)
+{
+	err->_type = type;
+	err->_line = line;
+	err->_file = file;
+	err->_int = 0;
+	err->_data = msg;
+}
+
+/**
+ * Translates an Arrow format string to the type of a PBG column.
+ * @param format  Arrow format string.
+ * @return the type literal of the column, PBG_NULL if it is not supported.
+ */
+pbg_field_type pbg_arrow_type(const char* format)
+{
+	if(strcmp(format, "g") == 0) return PBG_LT_TP_NUMBER;
+	if(strcmp(format, "b") == 0) return PBG_LT_TP_BOOL;
+	/* DATEs and STRING offsets are 32-bit, and columns hold them as int. */
+	if(sizeof(int) != sizeof(int32_t)) return PBG_NULL;
+	if(strcmp(format, "tdD") == 0) return PBG_LT_TP_DATE;
+	if(strcmp(format, "u") == 0) return PBG_LT_TP_STRING;
+	return PBG_NULL;
+}
+
+/**
+ * Checks if an array has NULL slots. A null_count of -1 means it was not 
+ * computed, so the validity buffer is read instead, if there is one.
+ * @param array  Array to check.
+ * @return 1 if some slot is NULL, 0 otherwise.
+ */
+int pbg_arrow_hasnull(struct ArrowArray* array)
+{
+	int64_t i;
+	const unsigned char* valid;
+	if(array->null_count != -1)
+		return array->null_count > 0;
+	if(array->n_buffers < 1 || array->buffers == NULL || array->buffers[0] == NULL)
+		return 0;
+	valid = (const unsigned char*) array->buffers[0];
+	for(i = array->offset; i < array->offset + array->length; i++)
+		if(((valid[i/8] >> (i%8)) & 1) == 0)
+			return 1;
+	return 0;
+}
+
+void pbg_arrow_batch(pbg_batch* batch, pbg_error* err, struct ArrowSchema* schema,
+		struct ArrowArray* array)
+{
+	int i, size;
+	pbg_column* col;
+	struct ArrowSchema* cs;
+	struct ArrowArray* ca;
+
+	/* Always start with a clean error! */
+	pbg_arrow_err(err, PBG_ERR_NONE, 0, NULL, NULL);
+
+	batch->_columns = NULL;
+	batch->_numcolumns = 0;
+	batch->_numrows = 0;
+	if(strcmp(schema->format, "+s") != 0 || schema->n_children != array->n_children) {
+		pbg_arrow_err(err, PBG_ERR_STATE, __LINE__, __FILE__,
+				"Record batch must be a struct array matching its schema.");
+		return;
+	}
+	if(pbg_arrow_hasnull(array)) {
+		pbg_arrow_err(err, PBG_ERR_STATE, __LINE__, __FILE__,
+				"Record batch cannot have NULL rows.");
+		return;
+	}
+	if(array->offset + array->length > INT_MAX || array->n_children > INT_MAX) {
+		pbg_arrow_err(err, PBG_ERR_LIMIT, __LINE__, __FILE__,
+				"Record batch is too large.");
+		return;
+	}
+
+	size = (array->n_children > 0) ? (int) array->n_children : 1;
+	batch->_columns = (pbg_column*) malloc(size * sizeof(pbg_column));
+	if(batch->_columns == NULL) {
+		pbg_arrow_err(err, PBG_ERR_ALLOC, __LINE__, __FILE__, NULL);
+		return;
+	}
+	batch->_numcolumns = (int) array->n_children;
+	batch->_numrows = (int) array->length;
+
+	/* Point every column straight at its buffers. */
+	for(i = 0; i < batch->_numcolumns; i++) {
+		col = batch->_columns+i;
+		cs = schema->children[i];
+		ca = array->children[i];
+		col->_name = (char*) (cs->name != NULL ? cs->name : "");
+		col->_type = pbg_arrow_type(cs->format);
+		col->_values = NULL;
+		col->_offsets = NULL;
+		col->_valid = NULL;
+		col->_offset = 0;
+		if(col->_type == PBG_NULL)
+			continue;
+		if(ca->offset + ca->length > INT_MAX ||
+				ca->length < array->offset + array->length ||
+				ca->n_buffers < (col->_type == PBG_LT_TP_STRING ? 3 : 2)) {
+			pbg_arrow_batch_free(batch);
+			pbg_arrow_err(err, PBG_ERR_STATE, __LINE__, __FILE__,
+					"Column does not match the record batch.");
+			return;
+		}
+		/* The validity buffer may be left out if there are no NULLs. A 
+		 * null_count of -1 was not computed, so the buffer is used as is. */
+		if(ca->null_count != 0 && ca->buffers[0] != NULL)
+			col->_valid = (unsigned char*) ca->buffers[0];
+		if(col->_type == PBG_LT_TP_STRING) {
+			col->_offsets = (int*) ca->buffers[1];
+			col->_values = (void*) ca->buffers[2];
+		}else
+			col->_values = (void*) ca->buffers[1];
+		col->_offset = (int) (ca->offset + array->offset);
+	}
+}
+
+void pbg_arrow_batch_free(pbg_batch* batch)
+{
+	free(batch->_columns);
+	batch->_columns = NULL;
+	batch->_numcolumns = 0;
+	batch->_numrows = 0;
+}
+
+/**
+ * Releases a selection exported by pbg_arrow_evaluate.
+ * @param array  Selection to release.
+ */
+void pbg_arrow_release_array(struct ArrowArray* array)
+{
+	free((void*) array->buffers[1]);
+	free(array->buffers);
+	array->release = NULL;
+}
+
+/**
+ * Releases the schema of a selection exported by pbg_arrow_evaluate.
+ * @param schema  Schema to release.
+ */
+void pbg_arrow_release_schema(struct ArrowSchema* schema) {
+	schema->release = NULL;
+}
+
+int pbg_arrow_evaluate(pbg_expr* e, pbg_error* err, struct ArrowSchema* schema,
+		struct ArrowArray* array, struct ArrowSchema* out_schema,
+		struct ArrowArray* out)
+{
+	int count;
+	pbg_batch batch;
+	unsigned char* selection;
+	const void** buffers;
+
+	pbg_arrow_batch(&batch, err, schema, array);
+	if(err->_type != PBG_ERR_NONE)
+		return PBG_ERROR;
+
+	/* The selection is handed over to the consumer with the array. */
+	selection = (unsigned char*) malloc((batch._numrows+7)/8 + 1);
+	buffers = (const void**) malloc(2 * sizeof(void*));
+	if(selection == NULL || buffers == NULL) {
+		free(selection);
+		free(buffers);
+		pbg_arrow_batch_free(&batch);
+		pbg_arrow_err(err, PBG_ERR_ALLOC, __LINE__, __FILE__, NULL);
+		return PBG_ERROR;
+	}
+	count = pbg_evaluate_batch(e, err, &batch, selection);
+	if(count == PBG_ERROR) {
+		free(selection);
+		free(buffers);
+		pbg_arrow_batch_free(&batch);
+		return PBG_ERROR;
+	}
+
+	/* Export a boolean array with no validity buffer. */
+	buffers[0] = NULL;
+	buffers[1] = selection;
+	out->length = batch._numrows;
+	out->null_count = 0;
+	out->offset = 0;
+	out->n_buffers = 2;
+	out->n_children = 0;
+	out->buffers = buffers;
+	out->children = NULL;
+	out->dictionary = NULL;
+	out->release = pbg_arrow_release_array;
+	out->private_data = NULL;
+	if(out_schema != NULL) {
+		out_schema->format = "b";
+		out_schema->name = "selection";
+		out_schema->metadata = NULL;
+		out_schema->flags = 0;
+		out_schema->n_children = 0;
+		out_schema->children = NULL;
+		out_schema->dictionary = NULL;
+		out_schema->release = pbg_arrow_release_schema;
+		out_schema->private_data = NULL;
+	}
+	pbg_arrow_batch_free(&batch);
+	return count;
+}
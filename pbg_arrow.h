@@ -0,0 +1,101 @@
+#ifndef __PBG_ARROW_H__
+#define __PBG_ARROW_H__
+
+/*********************************************************
+ *                                                       *
+ * Arrow C Data Interface bindings for PBG batches       *
+ *                                                       *
+ *********************************************************/
+
+/* These bindings are optional: build pbg_arrow.c alongside pbg.c to use them.
+ * They read record batches exported through the Arrow C Data Interface, which
+ * is plain C, so no Arrow library is needed. Columns are mapped onto a
+ * pbg_batch without copying:
+ *     float64 ("g")  NUMBER
+ *     date32 ("tdD") DATE
+ *     utf8 ("u")     STRING
+ *     bool ("b")     BOOL
+ * Columns of any other format are left out, so VARs naming them are NULL. */
+
+#include "pbg.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The structs of the Arrow C Data Interface, as given by its specification. */
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+	const char*            format;
+	const char*            name;
+	const char*            metadata;
+	int64_t                flags;
+	int64_t                n_children;
+	struct ArrowSchema**   children;
+	struct ArrowSchema*    dictionary;
+	void                 (*release)(struct ArrowSchema*);
+	void*                  private_data;
+};
+
+struct ArrowArray {
+	int64_t                length;
+	int64_t                null_count;
+	int64_t                offset;
+	int64_t                n_buffers;
+	int64_t                n_children;
+	const void**           buffers;
+	struct ArrowArray**    children;
+	struct ArrowArray*     dictionary;
+	void                 (*release)(struct ArrowArray*);
+	void*                  private_data;
+};
+
+#endif  /* ARROW_C_DATA_INTERFACE */
+
+/**
+ * Maps an Arrow record batch onto a PBG batch. The record batch is a struct
+ * array ("+s") with one child per column. No buffers are copied, so the record
+ * batch must outlive the PBG batch; only the column list is allocated.
+ * @param batch   PBG batch to initialize.
+ * @param err     Container to store error, if any occurs.
+ * @param schema  Schema of the record batch.
+ * @param array   Data of the record batch.
+ */
+void pbg_arrow_batch(pbg_batch* batch, pbg_error* err, struct ArrowSchema* schema,
+		struct ArrowArray* array);
+
+/**
+ * Frees the column list of a batch made by pbg_arrow_batch. The record batch
+ * it maps is left alone.
+ * @param batch  PBG batch to free.
+ */
+void pbg_arrow_batch_free(pbg_batch* batch);
+
+/**
+ * Evaluates the expression for every row of an Arrow record batch, and exports
+ * the selection as an Arrow boolean array with no NULLs. The exported array
+ * owns its buffers, which are freed by its release callback.
+ * @param e           PBG expression to evaluate.
+ * @param err         Container to store error, if any occurs.
+ * @param schema      Schema of the record batch.
+ * @param array       Data of the record batch.
+ * @param out_schema  Set to the schema of the selection, or NULL.
+ * @param out         Set to the selection.
+ * @return the number of rows selected, PBG_ERROR if err was set.
+ */
+int pbg_arrow_evaluate(pbg_expr* e, pbg_error* err, struct ArrowSchema* schema,
+		struct ArrowArray* array, struct ArrowSchema* out_schema,
+		struct ArrowArray* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __PBG_ARROW_H__ */
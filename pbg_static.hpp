@@ -0,0 +1,623 @@
+#ifndef __PBG_STATIC_HPP__
+#define __PBG_STATIC_HPP__
+
+/*********************************************************
+ *                                                       *
+ * Compile-time PBG expressions, an optional C++17       *
+ * companion to the C library                            *
+ *                                                       *
+ *********************************************************/
+
+/* A pbg expression literal is parsed by the compiler into a tree of types, and
+ * evaluated against a user struct through inlined member accessors. Malformed
+ * expressions are compile errors. Results match pbg_parse + pbg_evaluate: an
+ * evaluation returns PBG_TRUE, PBG_FALSE or PBG_ERROR.
+ *
+ *     struct order { double price; std::string_view region; };
+ *
+ *     template<> struct pbg::record<order> {
+ *         static constexpr auto fields = std::make_tuple(
+ *                 pbg::field("price", &order::price),
+ *                 pbg::field("region", &order::region));
+ *     };
+ *
+ *     constexpr auto rule = PBG_STATIC("(& (< [price] 5) (= [region] 'eu'))");
+ *     int result = rule.evaluate(some_order);
+ *
+ * Members map to pbg types: bool is a BOOL, other arithmetic types are
+ * NUMBERs, pbg::date is a DATE, anything convertible to std::string_view is a
+ * STRING, and an empty std::optional is NULL. A VAR without a matching field
+ * is NULL, just like an undefined dictionary key. */
+
+#include "pbg.h"
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/* Compiles the given string literal into a pbg::static_expr. */
+#define PBG_STATIC(str) ([] { \
+		struct _pbg_source { \
+			static constexpr std::string_view value() { return str; } \
+		}; \
+		return ::pbg::compile<_pbg_source>(); \
+	}())
+
+namespace pbg {
+
+/* A DATE member. */
+struct date {
+	int year;
+	int month;
+	int day;
+};
+
+/* Describes one member of a record: the VAR name and the member pointer. */
+template<class R, class T>
+struct field_desc {
+	std::string_view name;
+	T R::* member;
+};
+
+template<class R, class T>
+constexpr field_desc<R, T> field(std::string_view name, T R::* member) {
+	return field_desc<R, T>{name, member};
+}
+
+/* Specialize for each record type with a static constexpr tuple of fields. */
+template<class R>
+struct record;
+
+namespace detail {
+
+/***********************
+ *                     *
+ * COMPILE-TIME PARSER *
+ *                     *
+ ***********************/
+
+/* Field kinds, mirroring pbg_field_type. */
+enum kind {
+	k_invalid, k_null, k_op, k_true, k_false, k_number, k_string, k_date,
+	k_var, k_tp_date, k_tp_bool, k_tp_number, k_tp_string
+};
+
+/* Syntax error codes reported by validate(). */
+enum syntax {
+	s_ok, s_empty, s_unbalanced, s_unclosed_string, s_unclosed_var,
+	s_ordering, s_unknown_type, s_arity, s_trailing
+};
+
+constexpr bool is_digit(char c) { return c >= '0' && c <= '9'; }
+constexpr bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n'; }
+
+constexpr std::size_t skip_space(std::string_view s, std::size_t i) {
+	while(i < s.size() && is_space(s[i])) i++;
+	return i;
+}
+
+/* Index one past the end of the field starting at i, or npos if unclosed. */
+constexpr std::size_t field_end(std::string_view s, std::size_t i) {
+	char close = 0;
+	if(s[i] == '\'') close = '\'';
+	if(s[i] == '[') close = ']';
+	if(close != 0) {
+		do i++; while(i != s.size() && !(s[i] == close && s[i-1] != '\\'));
+		return i == s.size() ? std::string_view::npos : i+1;
+	}
+	while(i != s.size()-1 && !is_space(s[i+1]) && s[i+1] != '[' &&
+			s[i+1] != '(' && s[i+1] != ')') i++;
+	return i+1;
+}
+
+/* Same acceptance rules as pbg_isnumber. */
+constexpr bool is_number(std::string_view s) {
+	std::size_t i = 0, n = s.size();
+	auto at = [&](std::size_t j) { return j < n ? s[j] : '\0'; };
+	if(at(i) == '-' || at(i) == '+') i++;
+	else if(!is_digit(at(i))) return false;
+	if(at(i) != '0' && is_digit(at(i))) {
+		while(i != n && is_digit(at(i))) i++;
+		if(i != n && !is_digit(at(i)) && at(i) != '.') return false;
+	}else if(at(i) == '0') {
+		if(++i != n && !(at(i) == '.' || at(i) == 'e' || at(i) == 'E'))
+			return false;
+	}
+	if(at(i) == '.') {
+		if(i++ == n-1) return false;
+		while(i != n && is_digit(at(i))) i++;
+		if(i != n && !is_digit(at(i)) && at(i) != 'e' && at(i) != 'E')
+			return false;
+	}
+	if(at(i) == 'e' || at(i) == 'E') {
+		if(i++ == n-1) return false;
+		if(at(i) == '-' || at(i) == '+') i++;
+		while(i != n && is_digit(at(i))) i++;
+		if(i != n && !is_digit(at(i))) return false;
+	}
+	return true;
+}
+
+constexpr bool is_date(std::string_view s) {
+	return s.size() == 10 &&
+		is_digit(s[0]) && is_digit(s[1]) && is_digit(s[2]) && is_digit(s[3]) &&
+		s[4] == '-' && is_digit(s[5]) && is_digit(s[6]) &&
+		s[7] == '-' && is_digit(s[8]) && is_digit(s[9]);
+}
+
+/* Same classification order as pbg_gettype. */
+constexpr kind classify(std::string_view s) {
+	if(s == "TRUE") return k_true;
+	if(s == "FALSE") return k_false;
+	if(is_number(s)) return k_number;
+	if(s.front() == '\'' && s.back() == '\'') return k_string;
+	if(is_date(s)) return k_date;
+	if(s.front() == '[' && s.back() == ']') return k_var;
+	if(s == "DATE") return k_tp_date;
+	if(s == "BOOL") return k_tp_bool;
+	if(s == "NUMBER") return k_tp_number;
+	if(s == "STRING") return k_tp_string;
+	if(s == "!" || s == "&" || s == "|" || s == "=" || s == "<" || s == ">" ||
+			s == "?" || s == "@" || s == "!=" || s == "<=" || s == ">=")
+		return k_op;
+	return k_invalid;
+}
+
+/* Maps an operator token to its pbg_field_type. */
+constexpr int op_type(std::string_view s) {
+	if(s == "!") return PBG_OP_NOT;
+	if(s == "&") return PBG_OP_AND;
+	if(s == "|") return PBG_OP_OR;
+	if(s == "=") return PBG_OP_EQ;
+	if(s == "<") return PBG_OP_LT;
+	if(s == ">") return PBG_OP_GT;
+	if(s == "?") return PBG_OP_EXST;
+	if(s == "!=") return PBG_OP_NEQ;
+	if(s == "<=") return PBG_OP_LTE;
+	if(s == ">=") return PBG_OP_GTE;
+	return PBG_OP_TYPE;
+}
+
+/* Same rules as pbg_check_op_arity. */
+constexpr bool check_arity(int op, std::size_t argc) {
+	switch(op) {
+		case PBG_OP_NOT: return argc == 1;
+		case PBG_OP_LT: case PBG_OP_GT: case PBG_OP_NEQ:
+		case PBG_OP_LTE: case PBG_OP_GTE: return argc == 2;
+		case PBG_OP_EXST: return argc >= 1;
+		default: return argc >= 2;
+	}
+}
+
+/* Result of validating one field: an error code and the index past it. */
+struct scan {
+	syntax err;
+	std::size_t end;
+};
+
+/* Validates the field (literal or group) beginning at i. */
+constexpr scan validate_field(std::string_view s, std::size_t i) {
+	std::size_t end = 0, argc = 0;
+	if(s[i] == ')') return scan{s_unbalanced, i};
+	if(s[i] != '(') {
+		end = field_end(s, i);
+		if(end == std::string_view::npos)
+			return scan{s[i] == '[' ? s_unclosed_var : s_unclosed_string, i};
+		switch(classify(s.substr(i, end-i))) {
+			case k_invalid: return scan{s_unknown_type, i};
+			case k_op: return scan{s_ordering, i};
+			default: return scan{s_ok, end};
+		}
+	}
+	/* A group: an operator followed by its arguments. */
+	i = skip_space(s, i+1);
+	if(i == s.size()) return scan{s_unbalanced, i};
+	if(s[i] == '(' || s[i] == ')') return scan{s_ordering, i};
+	end = field_end(s, i);
+	if(end == std::string_view::npos || classify(s.substr(i, end-i)) != k_op)
+		return scan{s_ordering, i};
+	int op = op_type(s.substr(i, end-i));
+	for(i = skip_space(s, end); i != s.size() && s[i] != ')';
+			i = skip_space(s, i)) {
+		scan sub = validate_field(s, i);
+		if(sub.err != s_ok) return sub;
+		i = sub.end, argc++;
+	}
+	if(i == s.size()) return scan{s_unbalanced, i};
+	if(!check_arity(op, argc)) return scan{s_arity, i};
+	return scan{s_ok, i+1};
+}
+
+/* Validates a whole expression. */
+constexpr scan validate(std::string_view s) {
+	std::size_t i = skip_space(s, 0);
+	if(i == s.size()) return scan{s_empty, i};
+	scan root = validate_field(s, i);
+	if(root.err != s_ok) return root;
+	if(skip_space(s, root.end) != s.size())
+		return scan{s[skip_space(s, root.end)] == ')' ? s_unbalanced : s_trailing,
+				root.end};
+	return root;
+}
+
+/* Converts a NUMBER literal. Exact for literals with at most 19 significant
+ * digits and a decimal exponent within 22 of the point, which covers
+ * practically every rule; others may differ from atof in the last place. */
+constexpr double to_number(std::string_view s) {
+	std::size_t i = 0;
+	bool neg = false, eneg = false;
+	unsigned long long mant = 0;
+	int scale = 0, exp = 0, digits = 0;
+	double value = 0;
+	if(s[i] == '-' || s[i] == '+') neg = s[i++] == '-';
+	for(; i < s.size() && is_digit(s[i]); i++) {
+		if(digits < 19) mant = mant*10 + (s[i]-'0'), digits += mant != 0;
+		else scale++;
+	}
+	if(i < s.size() && s[i] == '.')
+		for(i++; i < s.size() && is_digit(s[i]); i++)
+			if(digits < 19) mant = mant*10 + (s[i]-'0'), digits += mant != 0, scale--;
+	if(i < s.size() && (s[i] == 'e' || s[i] == 'E')) {
+		i++;
+		if(s[i] == '-' || s[i] == '+') eneg = s[i++] == '-';
+		for(; i < s.size() && is_digit(s[i]); i++)
+			if(exp < 100000) exp = exp*10 + (s[i]-'0');
+	}
+	scale += eneg ? -exp : exp;
+	value = static_cast<double>(mant);
+	for(; scale >= 22; scale -= 22) value *= 1e22;
+	for(; scale <= -22; scale += 22) value /= 1e22;
+	{
+		double p = 1;
+		for(int k = scale < 0 ? -scale : scale; k > 0; k--) p *= 10;
+		value = scale < 0 ? value / p : value * p;
+	}
+	return neg ? -value : value;
+}
+
+/*************************
+ *                       *
+ * RUNTIME VALUE SUPPORT *
+ *                       *
+ *************************/
+
+/* Operand view, the stack-allocated counterpart of a resolved pbg_field. */
+struct value {
+	kind type;
+	int truth;
+	double number;
+	std::string_view string;
+	unsigned int day[3];
+};
+
+inline value make_null() { return value{k_null, 0, 0, {}, {0, 0, 0}}; }
+
+inline bool is_bool(const value& v) {
+	return v.type == k_true || v.type == k_false || v.type == k_op;
+}
+
+/* Byte equality of two non-BOOL values, as pbg_evaluate_op_eq does it. */
+inline bool same(const value& a, const value& b) {
+	if(a.type != b.type) return false;
+	switch(a.type) {
+		case k_number: return std::memcmp(&a.number, &b.number, sizeof(double)) == 0;
+		case k_string: return a.string.size() == b.string.size() &&
+				std::memcmp(a.string.data(), b.string.data(), a.string.size()) == 0;
+		case k_date: return std::memcmp(a.day, b.day, sizeof(a.day)) == 0;
+		default: return true;
+	}
+}
+
+/* strncmp over the first operand's length, as pbg_cmpstring does it. */
+inline int cmpstring(std::string_view a, std::string_view b) {
+	for(std::size_t i = 0; i < a.size(); i++) {
+		unsigned char ca = a[i], cb = i < b.size() ? b[i] : '\0';
+		if(ca != cb) return ca < cb ? -1 : 1;
+		if(ca == '\0') return 0;
+	}
+	return 0;
+}
+
+inline int cmpdate(const unsigned int* a, const unsigned int* b) {
+	for(int i = 0; i < 3; i++)
+		if(a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+	return 0;
+}
+
+template<class T> struct is_optional : std::false_type {};
+template<class T> struct is_optional<std::optional<T>> : std::true_type {};
+
+/* Converts a record member to an operand. */
+template<class T>
+inline value to_value(const T& m) {
+	if constexpr(is_optional<T>::value) {
+		return m.has_value() ? to_value(*m) : make_null();
+	}else if constexpr(std::is_same<T, bool>::value) {
+		return value{m ? k_true : k_false, m ? PBG_TRUE : PBG_FALSE, 0, {}, {0, 0, 0}};
+	}else if constexpr(std::is_arithmetic<T>::value) {
+		return value{k_number, 0, static_cast<double>(m), {}, {0, 0, 0}};
+	}else if constexpr(std::is_same<T, date>::value) {
+		return value{k_date, 0, 0, {}, {static_cast<unsigned int>(m.year),
+				static_cast<unsigned int>(m.month), static_cast<unsigned int>(m.day)}};
+	}else{
+		static_assert(std::is_convertible<const T&, std::string_view>::value,
+				"pbg: record member has no pbg type");
+		return value{k_string, 0, 0, std::string_view(m), {0, 0, 0}};
+	}
+}
+
+/* Index of the record field called name, or the number of fields if none. */
+template<class R, std::size_t I = 0>
+constexpr std::size_t find_field(std::string_view name) {
+	constexpr auto& fields = record<R>::fields;
+	if constexpr(I == std::tuple_size<std::decay_t<decltype(fields)>>::value)
+		return I;
+	else
+		return std::get<I>(fields).name == name ? I : find_field<R, I+1>(name);
+}
+
+/**************
+ *            *
+ * TREE NODES *
+ *            *
+ **************/
+
+/* Every node provides kind_of (its static kind), get (its operand view) and,
+ * for BOOL-valued nodes, eval (its truth value). */
+
+template<kind K>
+struct flag_node {
+	static constexpr kind kind_of = K;
+	template<class R> static int eval(const R&) {
+		return K == k_true ? PBG_TRUE : K == k_false ? PBG_FALSE : PBG_ERROR;
+	}
+	template<class R> static value get(const R& r) {
+		return value{K, eval(r), 0, {}, {0, 0, 0}};
+	}
+};
+
+template<class S, std::size_t B, std::size_t N>
+struct number_node {
+	static constexpr kind kind_of = k_number;
+	static constexpr double number = to_number(S::value().substr(B, N));
+	template<class R> static int eval(const R&) { return PBG_ERROR; }
+	template<class R> static value get(const R&) {
+		return value{k_number, 0, number, {}, {0, 0, 0}};
+	}
+};
+
+template<class S, std::size_t B, std::size_t N>
+struct string_node {
+	static constexpr kind kind_of = k_string;
+	static constexpr std::string_view text = S::value().substr(B+1, N-2);
+	template<class R> static int eval(const R&) { return PBG_ERROR; }
+	template<class R> static value get(const R&) {
+		return value{k_string, 0, 0, text, {0, 0, 0}};
+	}
+};
+
+template<class S, std::size_t B>
+struct date_node {
+	static constexpr kind kind_of = k_date;
+	static constexpr unsigned int digits(std::size_t at, std::size_t n) {
+		unsigned int v = 0;
+		for(std::size_t i = 0; i < n; i++) v = v*10 + (S::value()[B+at+i]-'0');
+		return v;
+	}
+	template<class R> static int eval(const R&) { return PBG_ERROR; }
+	template<class R> static value get(const R&) {
+		return value{k_date, 0, 0, {}, {digits(0, 4), digits(5, 2), digits(8, 2)}};
+	}
+};
+
+template<class S, std::size_t B, std::size_t N>
+struct var_node {
+	static constexpr kind kind_of = k_var;
+	static constexpr std::string_view name = S::value().substr(B+1, N-2);
+	template<class R> static value get(const R& r) {
+		constexpr std::size_t i = find_field<R>(name);
+		if constexpr(i == std::tuple_size<
+				std::decay_t<decltype(record<R>::fields)>>::value)
+			return make_null();
+		else
+			return to_value(r.*(std::get<i>(record<R>::fields).member));
+	}
+	template<class R> static int eval(const R& r) {
+		value v = get(r);
+		return v.type == k_true ? PBG_TRUE : v.type == k_false ? PBG_FALSE : PBG_ERROR;
+	}
+};
+
+template<int Op, class... Kids>
+struct op_node {
+	static constexpr kind kind_of = k_op;
+	template<class R> static value get(const R& r) {
+		return value{k_op, eval(r), 0, {}, {0, 0, 0}};
+	}
+
+	template<class R> static int eval(const R& r) {
+		if constexpr(Op == PBG_OP_NOT) {
+			int result = (Kids::eval(r), ...);
+			return result == PBG_ERROR ? PBG_ERROR :
+					result == PBG_TRUE ? PBG_FALSE : PBG_TRUE;
+		}else if constexpr(Op == PBG_OP_AND) {
+			int result = PBG_TRUE;
+			(void)((result = Kids::eval(r), result == PBG_TRUE) && ...);
+			return result;
+		}else if constexpr(Op == PBG_OP_OR) {
+			int result = PBG_FALSE;
+			(void)((result = Kids::eval(r), result == PBG_FALSE) && ...);
+			return result;
+		}else if constexpr(Op == PBG_OP_EXST) {
+			return ((Kids::get(r).type != k_null) && ...) ? PBG_TRUE : PBG_FALSE;
+		}else if constexpr(Op == PBG_OP_TYPE) {
+			return type_of(value{}, Kids::get(r)...);
+		}else if constexpr(Op == PBG_OP_EQ) {
+			return equal(Kids::get(r)...);
+		}else if constexpr(Op == PBG_OP_NEQ) {
+			return differ(Kids::get(r)...);
+		}else{
+			return order(Kids::get(r)...);
+		}
+	}
+
+	/* Mirrors pbg_evaluate_op_eq. Any evaluation error yields PBG_ERROR. */
+	template<class... V>
+	static int equal(const value& c0, const V&... rest) {
+		int result = PBG_TRUE;
+		if(c0.type == k_null) return PBG_ERROR;
+		if(is_bool(c0)) {
+			if(c0.truth == PBG_ERROR) return PBG_ERROR;
+			(void)((result = rest.type == k_null || !is_bool(rest) ||
+					rest.truth == PBG_ERROR ? PBG_ERROR :
+					rest.truth != c0.truth ? PBG_FALSE : PBG_TRUE,
+					result == PBG_TRUE) && ...);
+			return result;
+		}
+		(void)((result = rest.type == k_null ? PBG_ERROR :
+				same(c0, rest) ? PBG_TRUE : PBG_FALSE,
+				result == PBG_TRUE) && ...);
+		return result;
+	}
+
+	/* Mirrors pbg_evaluate_op_neq. */
+	static int differ(const value& c0, const value& c1) {
+		if(c0.type == k_null || c1.type == k_null) return PBG_ERROR;
+		if(is_bool(c0) && is_bool(c1)) {
+			if(c0.truth == PBG_ERROR || c1.truth == PBG_ERROR) return PBG_ERROR;
+			return c0.truth != c1.truth ? PBG_TRUE : PBG_FALSE;
+		}
+		return same(c0, c1) ? PBG_FALSE : PBG_TRUE;
+	}
+
+	/* Mirrors pbg_evaluate_op_order. */
+	static int order(const value& c0, const value& c1) {
+		int result;
+		if(c0.type == k_null || c1.type == k_null) return PBG_ERROR;
+		if(c0.type == k_number && c1.type == k_number)
+			result = c0.number < c1.number ? -1 : c0.number > c1.number ? 1 : 0;
+		else if(c0.type == k_date && c1.type == k_date)
+			result = cmpdate(c0.day, c1.day);
+		else if(c0.type == k_string && c1.type == k_string)
+			result = cmpstring(c0.string, c1.string);
+		else if(is_bool(c0) && is_bool(c1)) {
+			if(c0.truth == PBG_ERROR || c1.truth == PBG_ERROR) return PBG_ERROR;
+			result = c0.truth - c1.truth;
+		}else
+			return PBG_ERROR;
+		if(Op == PBG_OP_LT) return result < 0 ? PBG_TRUE : PBG_FALSE;
+		if(Op == PBG_OP_GT) return result > 0 ? PBG_TRUE : PBG_FALSE;
+		if(Op == PBG_OP_LTE) return result <= 0 ? PBG_TRUE : PBG_FALSE;
+		return result >= 0 ? PBG_TRUE : PBG_FALSE;
+	}
+
+	/* Mirrors pbg_evaluate_op_type. The first pack element is the type literal,
+	 * which is checked statically. */
+	template<class... V>
+	static int type_of(const value&, const value&, const V&... rest) {
+		using first = std::tuple_element_t<0, std::tuple<Kids...>>;
+		constexpr kind tp = first::kind_of;
+		if constexpr(tp != k_tp_date && tp != k_tp_bool &&
+				tp != k_tp_number && tp != k_tp_string) {
+			return PBG_ERROR;
+		}else{
+			return ((tp == k_tp_bool ? is_bool(rest) :
+					tp == k_tp_date ? rest.type == k_date :
+					tp == k_tp_number ? rest.type == k_number :
+					rest.type == k_string) && ...) ? PBG_TRUE : PBG_FALSE;
+		}
+	}
+};
+
+/*********************
+ *                   *
+ * TREE CONSTRUCTION *
+ *                   *
+ *********************/
+
+/* A parsed node and the index one past its text. */
+template<class Node, std::size_t End>
+struct parsed {
+	using type = Node;
+	static constexpr std::size_t end = End;
+};
+
+template<class S, std::size_t I> constexpr auto parse_field();
+
+/* Parses the remaining arguments of a group into op_node<Op, Kids...>. */
+template<class S, int Op, std::size_t I, class... Kids>
+constexpr auto parse_args() {
+	constexpr std::size_t i = skip_space(S::value(), I);
+	if constexpr(S::value()[i] == ')') {
+		return parsed<op_node<Op, Kids...>, i+1>{};
+	}else{
+		using kid = decltype(parse_field<S, i>());
+		return parse_args<S, Op, kid::end, Kids..., typename kid::type>();
+	}
+}
+
+/* Parses the field beginning at I. The text has already been validated. */
+template<class S, std::size_t I>
+constexpr auto parse_field() {
+	constexpr std::string_view s = S::value();
+	if constexpr(s[I] == '(') {
+		constexpr std::size_t op = skip_space(s, I+1);
+		constexpr std::size_t end = field_end(s, op);
+		return parse_args<S, op_type(s.substr(op, end-op)), end>();
+	}else{
+		constexpr std::size_t end = field_end(s, I);
+		constexpr kind k = classify(s.substr(I, end-I));
+		if constexpr(k == k_number)
+			return parsed<number_node<S, I, end-I>, end>{};
+		else if constexpr(k == k_string)
+			return parsed<string_node<S, I, end-I>, end>{};
+		else if constexpr(k == k_date)
+			return parsed<date_node<S, I>, end>{};
+		else if constexpr(k == k_var)
+			return parsed<var_node<S, I, end-I>, end>{};
+		else
+			return parsed<flag_node<k>, end>{};
+	}
+}
+
+}  /* namespace detail */
+
+/* A compiled expression. Node is the root of the type-level tree. */
+template<class Node>
+struct static_expr {
+	/**
+	 * Evaluates the expression against a record.
+	 * @param r  Record whose type specializes pbg::record.
+	 * @return PBG_TRUE, PBG_FALSE, or PBG_ERROR, as pbg_evaluate would.
+	 */
+	template<class R>
+	int evaluate(const R& r) const { return Node::eval(r); }
+};
+
+/* Compiles S::value() into a pbg::static_expr. Prefer the PBG_STATIC macro. */
+template<class S>
+constexpr auto compile() {
+	constexpr detail::scan check = detail::validate(S::value());
+	static_assert(check.err != detail::s_empty, "pbg: no fields in expression");
+	static_assert(check.err != detail::s_unbalanced, "pbg: unbalanced parentheses");
+	static_assert(check.err != detail::s_unclosed_string, "pbg: unclosed string");
+	static_assert(check.err != detail::s_unclosed_var, "pbg: unclosed variable");
+	static_assert(check.err != detail::s_ordering, "pbg: field ordering not respected");
+	static_assert(check.err != detail::s_unknown_type, "pbg: unknown field type");
+	static_assert(check.err != detail::s_arity, "pbg: wrong number of operator arguments");
+	static_assert(check.err != detail::s_trailing, "pbg: multiple expressions");
+	if constexpr(check.err == detail::s_ok) {
+		using root = decltype(detail::parse_field<S,
+				detail::skip_space(S::value(), 0)>());
+		return static_expr<typename root::type>{};
+	}else{
+		return static_expr<detail::flag_node<detail::k_invalid>>{};
+	}
+}
+
+}  /* namespace pbg */
+
+#endif  /* __PBG_STATIC_HPP__ */
@@ -1,4 +1,5 @@
 #include "../pbg.h"
+#include "../pbg_arrow.h"
 #include "test.h"
 #include <stdio.h>
 #include <string.h>
@@ -6,13 +7,53 @@
 
 /* Test suites in this file. */
 pbg_field dict(char* key, int n);
+pbg_field dict_none(char* key, int n);
+pbg_field dict_path(void* ctx, pbg_segment** path, int n);
+pbg_field dict_hashed(void* ctx, char* key, int n, unsigned long hash);
+unsigned long hash_len(char* key, int n);
+int suite_hashed(void);
+int suite_path(void);
 int suite_evaluate(void);
 int suite_gettype(void);
+int suite_validate(void);
+int suite_eval_text(void);
+int suite_lazy(void);
+int suite_parser(void);
+int suite_builder(void);
+int suite_normalize(void);
+int suite_compile(void);
+int suite_manage(void);
+int suite_print(void);
+int suite_combine(void);
+int suite_analyze(void);
+pbg_field dict_count(char* key, int n);
+int suite_ruleset(void);
+void batch_init(void);
+pbg_field dict_row(char* key, int n);
+int suite_batch(void);
+void arrow_init(void);
+int suite_arrow(void);
 
 /* Run and summarize test suites. */
 int main(void)
 {
 	summ_test("pbg_evaluate", suite_evaluate());
+	summ_test("pbg_evaluate_dict", suite_path());
+	summ_test("pbg_hash", suite_hashed());
+	summ_test("pbg_validate", suite_validate());
+	summ_test("pbg_eval_text", suite_eval_text());
+	summ_test("pbg_parse_lazy", suite_lazy());
+	summ_test("pbg_parser", suite_parser());
+	summ_test("pbg_builder", suite_builder());
+	summ_test("pbg_normalize", suite_normalize());
+	summ_test("pbg_compile", suite_compile());
+	summ_test("pbg_manage", suite_manage());
+	summ_test("pbg_print", suite_print());
+	summ_test("pbg_combine", suite_combine());
+	summ_test("pbg_analyze", suite_analyze());
+	summ_test("pbg_ruleset", suite_ruleset());
+	summ_test("pbg_evaluate_batch", suite_batch());
+	summ_test("pbg_arrow", suite_arrow());
 	return 0;
 }
 
@@ -24,7 +65,8 @@ int main(void)
  ***************/
 
 /* This is a dictionary used for testing purposes. 
- * It defines keys [a]=5.0, [b]=5.0, and [c]=6.0. */
+ * It defines keys [a]=5.0, [b]=5.0, [c]=6.0, [s]='hi', [t]=2018-10-12, 
+ * [u]=TRUE, and [z]=-0.0. */
 pbg_field dict(char* key, int n)
 {
 	pbg_field keylt;
@@ -42,13 +84,108 @@ pbg_field dict(char* key, int n)
 		keylt._int = sizeof(double);
 		keylt._data = malloc(keylt._int);
 		*((double*)keylt._data) = 6.0;
+	}else if(key[0] == 's') {
+		keylt = pbg_make_string("hi");
+	}else if(key[0] == 't') {
+		keylt = pbg_make_date(2018, 10, 12);
+	}else if(key[0] == 'u') {
+		keylt = pbg_make_bool(1);
+	}else if(key[0] == 'z') {
+		keylt = pbg_make_number(-0.0);
 	}
 	return keylt;
 }
 
+/* This dictionary defines no keys at all. */
+pbg_field dict_none(char* key, int n)
+{
+	PBG_UNUSED(key);
+	PBG_UNUSED(n);
+	return pbg_make_null();
+}
+
+/* This is a path-aware dictionary used for testing purposes. It defines the
+ * nested record {user: {age: 30, address: {country: 'NZ'}}, tags: TRUE}. ctx
+ * holds the first "user" segment seen, and any other "user" segment resolves
+ * to NULL, as it should have been interned, as does one whose hash is not that
+ * of the function after it in ctx. */
+pbg_field dict_path(void* ctx, pbg_segment** path, int n)
+{
+	pbg_segment** user;
+	pbg_hash_fn fn;
+	user = (pbg_segment**) ((void**) ctx)[0];
+	fn = *(pbg_hash_fn*) ((void**) ctx)[1];
+	if(n == 1 && path[0]->_n == 4 && strncmp(path[0]->_str, "tags", 4) == 0)
+		return pbg_make_bool(1);
+	if(n < 2 || path[0]->_n != 4 || strncmp(path[0]->_str, "user", 4) != 0 ||
+			path[0]->_hash != fn(path[0]->_str, path[0]->_n))
+		return pbg_make_null();
+	if(*user == NULL) *user = path[0];
+	if(*user != path[0])
+		return pbg_make_null();
+	if(n == 2 && path[1]->_n == 3 && strncmp(path[1]->_str, "age", 3) == 0)
+		return pbg_make_number(30);
+	if(n == 3 && path[1]->_n == 7 && strncmp(path[1]->_str, "address", 7) == 0 &&
+			path[2]->_n == 7 && strncmp(path[2]->_str, "country", 7) == 0)
+		return pbg_make_string("NZ");
+	return pbg_make_null();
+}
+
+/* Tests for pbg_evaluate_dict with a path-aware dictionary. */
+int suite_path()
+{
+	init_test();
+	
+	check(test_path(&err, "(= [user.age] 30)", PBG_TRUE));
+	check(test_path(&err, "(& [tags] (= [user.address.country] 'NZ'))", PBG_TRUE));
+	check(test_path(&err, "(& (< [user.age] 40) (= [user.address.country] 'AU'))", PBG_FALSE));
+	check(test_path(&err, "(| (?[user.name]) (?[user.address]) (?[age]))", PBG_FALSE));
+	/* Plain names are split too, and escaped dots do not split. */
+	check(test_path(&err, "(? [tags] [user.age])", PBG_TRUE));
+	check(test_path(&err, "(?[user\\.age])", PBG_FALSE));
+	
+	end_test();
+}
+
+/* This is a hashing dictionary used for testing purposes. It defines the keys
+ * of dict, and checks each hash against ctx, the hash function in use. Keys 
+ * with the wrong hash resolve to NULL. */
+pbg_field dict_hashed(void* ctx, char* key, int n, unsigned long hash)
+{
+	pbg_hash_fn fn;
+	fn = *(pbg_hash_fn*) ctx;
+	if(hash != fn(key, n))
+		return pbg_make_null();
+	return dict(key, n);
+}
+
+/* This is a hash function used for testing purposes. It counts its calls. */
+static int hash_calls;
+unsigned long hash_len(char* key, int n)
+{
+	PBG_UNUSED(key);
+	hash_calls++;
+	return (unsigned long) n;
+}
+
+/* Tests for pbg_evaluate_dict with a hashing dictionary. */
+int suite_hashed()
+{
+	init_test();
+	
+	check(pbg_hash("", 0) == pbg_hash("a", 0) && pbg_hash("ab", 2) != pbg_hash("ba", 2) ?
+			PBG_TEST_PASS : PBG_TEST_FAIL);
+	check(test_hashed(&err, "(= [a] 5)", PBG_TRUE));
+	check(test_hashed(&err, "(& (= [a] [b]) (! (< [c] 5.5e1)) (= [t] 2018-10-12))", PBG_FALSE));
+	check(test_hashed(&err, "(| [u] (?[d]))", PBG_TRUE));
+	
+	end_test();
+}
+
 /* Tests for pbg_evaluate. */
 int suite_evaluate()
 {
+	pbg_expr e;
 	init_test();
 	
 	/* TRUE */
@@ -331,6 +468,935 @@ int suite_evaluate()
 	check(test_evaluate(&err, "(!= (?[1])(?[0]))", dict, PBG_TRUE));
 	check(test_evaluate(&err, "(!= (?[0])(?[0]))", dict, PBG_FALSE));
 	
+	/* Expressions that failed to parse, or were freed, have nothing to give. */
+	pbg_parse(&e, &err, "(< 1 2 3)");
+	pbg_error_free(&err);
+	check(pbg_evaluate(&e, &err, dict) == PBG_ERROR && err._type == PBG_ERR_STATE ? 
+			PBG_TEST_PASS : PBG_TEST_FAIL);
+	pbg_error_free(&err);
+	pbg_parse(&e, &err, "(< 1 2)");
+	pbg_free(&e);
+	check(pbg_evaluate(&e, &err, dict) == PBG_ERROR && err._type == PBG_ERR_STATE ? 
+			PBG_TEST_PASS : PBG_TEST_FAIL);
+	pbg_error_free(&err);
+	
+	end_test();
+}
+
+/* Tests for pbg_validate. */
+#define DEEP_NOTS 80000
+int suite_validate()
+{
+	char* deep;
+	int i;
+	init_test();
+	
+	check(test_validate(&err, "TRUE", 1));
+	check(test_validate(&err, "(&(=[a][b])(?[d]))", 1));
+	check(test_validate(&err, "(= 'a, b\\'c' [d\\]] 2018-10-12 -3.14e-2)", 1));
+	check(test_validate(&err, "(@ NUMBER [a] (! FALSE))", 1));
+	check(test_validate(&err, "", 0));
+	check(test_validate(&err, "   ", 0));
+	check(test_validate(&err, "(& TRUE TRUE", 0));
+	check(test_validate(&err, "(& TRUE TRUE))", 0));
+	check(test_validate(&err, "(& TRUE TRUE) (| TRUE TRUE)", 0));
+	check(test_validate(&err, "(= [a] 'abc)", 0));
+	check(test_validate(&err, "(= 'abc' [a)", 0));
+	check(test_validate(&err, "(TRUE)", 0));
+	check(test_validate(&err, "(& TRUE (| FALSE TRUE) &)", 0));
+	check(test_validate(&err, "(& (| TRUE) FOO)", 0));
+	check(test_validate(&err, "(& FOO (| TRUE))", 0));
+	check(test_validate(&err, "(< 1 2 3)", 0));
+	check(test_validate(&err, "(! (! (! 2018-1-01)))", 0));
+	check(test_validate(&err, "(= 314e-2 1)", 0));
+	/* Groups open with a field, and nothing follows the whole expression. */
+	check(test_validate(&err, "( (! (> 7 [a])))", 0));
+	check(test_validate(&err, "(& TRUE ())", 0));
+	check(test_validate(&err, "0(& FALSE)", 0));
+	check(test_validate(&err, "0(> [d] 2019-02-30)", 0));
+	check(test_validate(&err, "TRUE FALSE", 0));
+	check(test_validate(&err, "(! TRUE) 5", 0));
+	
+	/* Deep nesting is checked in a single pass. */
+	deep = (char*) malloc(4*DEEP_NOTS + 8);
+	if(deep != NULL) {
+		for(i = 0; i < DEEP_NOTS; i++)
+			memcpy(deep + 3*i, "(! ", 3);
+		memcpy(deep + 3*DEEP_NOTS, "TRUE", 4);
+		memset(deep + 3*DEEP_NOTS + 4, ')', DEEP_NOTS);
+		deep[4*DEEP_NOTS + 4] = '\0';
+		check(test_validate(&err, deep, 1));
+		/* The innermost NOT becomes an AND of one. */
+		deep[3*DEEP_NOTS - 2] = '&';
+		check(test_validate(&err, deep, 0));
+	}
+	free(deep);
+	
+	end_test();
+}
+
+/* Tests for pbg_eval_text. Evaluation recurses once per level, so chains stay
+ * within the stack. */
+#define DEEP_CHAIN 20000
+int suite_eval_text()
+{
+	char* deep;
+	int i;
+	init_test();
+	
+	check(test_eval_text(&err, "TRUE", PBG_TRUE));
+	check(test_eval_text(&err, "  (! (= 9 10))  ", PBG_TRUE));
+	check(test_eval_text(&err, "(& (< [a] [c]) (= [s] 'hi') (= [t] 2018-10-12))", PBG_TRUE));
+	check(test_eval_text(&err, "(| (> [a] [c]) (!= [s] 'hi') (<= [t] 2017-10-12))", PBG_FALSE));
+	check(test_eval_text(&err, "(= 'a, b\\'c' 'a, b\\'c' [d])", PBG_ERROR));
+	check(test_eval_text(&err, "(@ NUMBER [a] 10 (! FALSE))", PBG_FALSE));
+	check(test_eval_text(&err, "(= (?[0])(?[1]) FALSE)", PBG_FALSE));
+	check(test_eval_text(&err, "(!= [u] (= 1 1))", PBG_FALSE));
+	check(test_eval_text(&err, "(>= 2.5e1 25 )", PBG_TRUE));
+	/* Skipped subtrees are never evaluated. */
+	check(test_eval_text(&err, "(& FALSE (< [d] 1))", PBG_FALSE));
+	check(test_eval_text(&err, "(| (= [b] 5) (& (< 'x' 1) (? [q])))", PBG_TRUE));
+	check(test_eval_text(&err, "(& (< [d] 1) FALSE)", PBG_ERROR));
+	/* Errors are those of pbg_parse and pbg_evaluate. */
+	check(test_eval_text(&err, "(& TRUE (| FALSE TRUE) &)", PBG_ERROR));
+	check(test_eval_text(&err, "(< 1 2 3)", PBG_ERROR));
+	check(test_eval_text(&err, "(& TRUE TRUE", PBG_ERROR));
+	check(test_eval_text(&err, "(< 'x' 1)", PBG_ERROR));
+	check(test_eval_text(&err, "(@ [a] 1)", PBG_ERROR));
+	
+	/* Each argument's text is read once, however deep the chain. */
+	deep = (char*) malloc(9*DEEP_CHAIN + 8);
+	if(deep != NULL) {
+		for(i = 0; i < DEEP_CHAIN; i++) {
+			memcpy(deep + 3*i, "(& ", 3);
+			memcpy(deep + 3*DEEP_CHAIN + 5 + 6*i, " TRUE)", 6);
+		}
+		memcpy(deep + 3*DEEP_CHAIN, " TRUE", 5);
+		deep[9*DEEP_CHAIN + 5] = '\0';
+		check(test_eval_text(&err, deep, PBG_TRUE));
+		/* The innermost FALSE short-circuits every AND around it. */
+		memcpy(deep + 3*DEEP_CHAIN, "FALSE", 5);
+		check(test_eval_text(&err, deep, PBG_FALSE));
+	}
+	free(deep);
+	
+	end_test();
+}
+
+/* Tests for pbg_parse_lazy. Each deferred subtree evaluates as a nested
+ * expression, so chains are kept shorter. */
+#define DEEP_LAZY 5000
+int suite_lazy()
+{
+	char* deep;
+	int i;
+	init_test();
+	
+	check(test_lazy(&err, "TRUE", PBG_TRUE));
+	check(test_lazy(&err, "(& (< [a] [c]) (| (= [s] 'ho') (! (= [t] 2017-10-12))))", PBG_TRUE));
+	check(test_lazy(&err, "(| (& (> [a] [c]) (?[d])) (& (! (! FALSE)) (= [b] 5)))", PBG_FALSE));
+	check(test_lazy(&err, "(| (! (& TRUE (| FALSE (= [u] (?[a]))))) (< [a] 3))", PBG_FALSE));
+	check(test_lazy(&err, "(= (& TRUE (! FALSE)) (| (?[d]) (= 1 1)))", PBG_TRUE));
+	/* Deferred subtrees report their errors when reached. */
+	check(test_lazy(&err, "(| FALSE (& TRUE (< [d] 1)))", PBG_ERROR));
+	check(test_lazy(&err, "(| TRUE (& TRUE (< [d] 1)))", PBG_TRUE));
+	/* Parse errors are reported up front. */
+	check(test_lazy(&err, "(| TRUE (& TRUE (< [d] 1 2)))", PBG_ERROR));
+	
+	/* Building never reads the text of the groups it defers. */
+	deep = (char*) malloc(9*DEEP_LAZY + 8);
+	if(deep != NULL) {
+		for(i = 0; i < DEEP_LAZY; i++)
+			memcpy(deep + 3*i, "(! ", 3);
+		memcpy(deep + 3*DEEP_LAZY, "TRUE", 4);
+		memset(deep + 3*DEEP_LAZY + 4, ')', DEEP_LAZY);
+		deep[4*DEEP_LAZY + 4] = '\0';
+		check(test_lazy(&err, deep, PBG_TRUE));
+		for(i = 0; i < DEEP_LAZY; i++) {
+			memcpy(deep + 3*i, "(& ", 3);
+			memcpy(deep + 3*DEEP_LAZY + 4 + 6*i, " TRUE)", 6);
+		}
+		deep[9*DEEP_LAZY + 4] = '\0';
+		check(test_lazy(&err, deep, PBG_TRUE));
+	}
+	free(deep);
+	
+	end_test();
+}
+
+/* Tests for pbg_parser_feed and pbg_parser_parse_n. */
+int suite_parser()
+{
+	static char* chunks1[] = {"(& (> 1.", "0e2 [a]) (> [a] 0.5", "))", NULL};
+	static char* chunks2[] = {"(& (> [a] 1234567", "8) (> [a] 1", ".0))", NULL};
+	init_test();
+	
+	check(test_parser(&err, "TRUE"));
+	check(test_parser(&err, "(&(=[a][b])(?[d]))"));
+	check(test_parser(&err, "(& (= [a] [b]) (! (< [c] 5.5e1)) (= [t] 2018-10-12))"));
+	/* Chunks end inside STRINGs, VARs, and escapes. */
+	check(test_parser(&err, "(= 'a, b\\'c' [d\\]] 2018-10-12 -3.14e-2)"));
+	check(test_parser(&err, "(| (= [s] 'hi') (= [s\\]x] '\\\\'))"));
+	check(test_parser(&err, "(@ NUMBER [a] (! FALSE))"));
+	check(test_parser(&err, "  (=\n\t[a]\t5 )  "));
+	/* Errors are those of pbg_parse. */
+	check(test_parser(&err, ""));
+	check(test_parser(&err, "(& TRUE TRUE"));
+	check(test_parser(&err, "(& TRUE TRUE))"));
+	check(test_parser(&err, "(& TRUE TRUE) (| TRUE TRUE)"));
+	check(test_parser(&err, "(= [a] 'abc)"));
+	check(test_parser(&err, "(= 'abc' [a)"));
+	check(test_parser(&err, "(TRUE)"));
+	check(test_parser(&err, "(& TRUE (| FALSE TRUE) &)"));
+	check(test_parser(&err, "(& (| TRUE) FOO)"));
+	check(test_parser(&err, "(& FOO (| TRUE))"));
+	check(test_parser(&err, "(< 1 2 3)"));
+	check(test_parser(&err, "(= 314e-2 1)"));
+	check(test_parser(&err, "( (! (> 7 [a])))"));
+	check(test_parser(&err, "(& TRUE ())"));
+	check(test_parser(&err, "0(& FALSE)"));
+	check(test_parser(&err, "0(> [d] 2019-02-30)"));
+	check(test_parser(&err, "TRUE FALSE"));
+	/* A field cut by a chunk is not read past its end, even when a longer 
+	 * field was cut before it. */
+	check(test_parser_chunks(&err, chunks1));
+	check(test_parser_chunks(&err, chunks2));
+	
+	end_test();
+}
+
+/* Tests for pbg_builder_op and friends. */
+int suite_builder()
+{
+	pbg_builder b;
+	init_test();
+	pbg_parser_init(&b);
+	
+	pbg_builder_bool(&b, 1);
+	check(test_builder(&err, &b, "TRUE"));
+	pbg_builder_op(&b, PBG_OP_AND);
+		pbg_builder_op(&b, PBG_OP_EQ);
+			pbg_builder_var(&b, "a", 1);
+			pbg_builder_var(&b, "b", 1);
+		pbg_builder_end(&b);
+		pbg_builder_op(&b, PBG_OP_NOT);
+			pbg_builder_op(&b, PBG_OP_LT);
+				pbg_builder_var(&b, "c", 1);
+				pbg_builder_number(&b, 55);
+			pbg_builder_end(&b);
+		pbg_builder_end(&b);
+		pbg_builder_op(&b, PBG_OP_EQ);
+			pbg_builder_var(&b, "t", 1);
+			pbg_builder_date(&b, 2018, 10, 12);
+		pbg_builder_end(&b);
+	pbg_builder_end(&b);
+	check(test_builder(&err, &b, "(& (= [a] [b]) (! (< [c] 55)) (= [t] 2018-10-12))"));
+	/* Values are escaped by the builder. */
+	pbg_builder_op(&b, PBG_OP_EQ);
+		pbg_builder_string(&b, "it's", 4);
+		pbg_builder_var(&b, "d]x", 3);
+	pbg_builder_end(&b);
+	check(test_builder(&err, &b, "(= 'it\\'s' [d\\]x])"));
+	pbg_builder_op(&b, PBG_OP_TYPE);
+		pbg_builder_type(&b, PBG_LT_TP_NUMBER);
+		pbg_builder_var(&b, "a", 1);
+		pbg_builder_bool(&b, 0);
+	pbg_builder_end(&b);
+	check(test_builder(&err, &b, "(@ NUMBER [a] FALSE)"));
+	/* Errors are those of the text the calls spell out. */
+	check(test_builder(&err, &b, ""));
+	pbg_builder_op(&b, PBG_OP_AND);
+		pbg_builder_bool(&b, 1);
+	check(test_builder(&err, &b, "(& TRUE"));
+	pbg_builder_bool(&b, 1);
+	pbg_builder_end(&b);
+	check(test_builder(&err, &b, "TRUE)"));
+	pbg_builder_op(&b, PBG_OP_LT);
+		pbg_builder_number(&b, 1);
+		pbg_builder_number(&b, 2);
+		pbg_builder_number(&b, 3);
+	pbg_builder_end(&b);
+	check(test_builder(&err, &b, "(< 1 2 3)"));
+	pbg_builder_op(&b, PBG_LT_TRUE);
+	pbg_builder_end(&b);
+	check(test_builder(&err, &b, "(TRUE)"));
+	pbg_builder_op(&b, PBG_OP_AND);
+		pbg_builder_op(&b, PBG_OP_NOT);
+			pbg_builder_bool(&b, 1);
+			pbg_builder_bool(&b, 1);
+		pbg_builder_end(&b);
+		pbg_builder_type(&b, PBG_OP_NOT);
+	pbg_builder_end(&b);
+	check(test_builder(&err, &b, "(& (! TRUE TRUE) FOO)"));
+	/* A trailing backslash escapes the closing character. */
+	pbg_builder_op(&b, PBG_OP_EQ);
+		pbg_builder_var(&b, "a\\", 2);
+		pbg_builder_number(&b, 1);
+	pbg_builder_end(&b);
+	check(test_builder(&err, &b, "(= [a\\] 1)"));
+	pbg_builder_string(&b, "x\\", 2);
+	check(test_builder(&err, &b, "'x\\'"));
+	/* Only DATEs that can be written are DATEs. */
+	pbg_builder_op(&b, PBG_OP_EQ);
+		pbg_builder_var(&b, "t", 1);
+		pbg_builder_date(&b, 12345, 13, 99);
+	pbg_builder_end(&b);
+	check(test_builder(&err, &b, "(= [t] 12345-13-99)"));
+	pbg_builder_op(&b, PBG_OP_EQ);
+		pbg_builder_var(&b, "t", 1);
+		pbg_builder_date(&b, -5, 1, 1);
+	pbg_builder_end(&b);
+	check(test_builder(&err, &b, "(= [t] -005-01-01)"));
+	pbg_builder_op(&b, PBG_OP_EQ);
+		pbg_builder_var(&b, "t", 1);
+		pbg_builder_date(&b, 0, 0, 99);
+	pbg_builder_end(&b);
+	check(test_builder(&err, &b, "(= [t] 0000-00-99)"));
+	
+	pbg_parser_free(&b);
+	end_test();
+}
+
+/* Tests for pbg_normalize. */
+#define WIDE_ANDS 20000
+int suite_normalize()
+{
+	pbg_expr e;
+	pbg_nf nf;
+	pbg_field** atoms;
+	int* negated;
+	char* wide;
+	int i, len;
+	init_test();
+	
+	/* Distribution. */
+	check(test_normalize(&err, "(& (| (?[a]) (?[d])) (| (?[c]) (?[e])))", PBG_NF_DNF, 100, 4));
+	check(test_normalize(&err, "(& (| (?[a]) (?[d])) (| (?[c]) (?[e])))", PBG_NF_CNF, 100, 2));
+	check(test_normalize(&err, "(| (& (?[a]) (?[d])) (?[c]) (= [c] 6))", PBG_NF_DNF, 100, 3));
+	check(test_normalize(&err, "(| (& (?[a]) (?[d])) (?[c]) (= [c] 6))", PBG_NF_CNF, 100, 2));
+	/* De Morgan. */
+	check(test_normalize(&err, "(! (| (?[a]) (?[d])))", PBG_NF_DNF, 100, 1));
+	check(test_normalize(&err, "(! (| (?[a]) (?[d])))", PBG_NF_CNF, 100, 2));
+	check(test_normalize(&err, "(! (& (= [a] 5) (! (< [c] 5))))", PBG_NF_DNF, 100, 2));
+	check(test_normalize(&err, "(! (& (= [a] 5) (! (< [c] 5))))", PBG_NF_CNF, 100, 1));
+	/* Duplicate atoms merge, and contradictions drop out. */
+	check(test_normalize(&err, "(& (?[a]) (| (?[a]) (?[d])))", PBG_NF_DNF, 100, 2));
+	check(test_normalize(&err, "(& (?[a]) (! (?[a])))", PBG_NF_DNF, 100, 0));
+	check(test_normalize(&err, "(& (?[d]) (! (?[d])))", PBG_NF_CNF, 100, 2));
+	check(test_normalize(&err, "(| (?[a]) (! (?[a])))", PBG_NF_CNF, 100, 0));
+	/* Single atoms. */
+	check(test_normalize(&err, "TRUE", PBG_NF_DNF, 100, 1));
+	check(test_normalize(&err, "(! FALSE)", PBG_NF_CNF, 100, 1));
+	check(test_normalize(&err, "(! (! [a]))", PBG_NF_DNF, 100, 1));
+	/* Budget: 1 OR, 27 ANDs, 81 EXSTs and 81 VARs in DNF; 22 fields in CNF. */
+	check(test_normalize(&err, "(& (| (?[a]) (?[b]) (?[c])) (| (?[d]) (?[e]) (?[f])) "
+			"(| (?[g]) (?[h]) (?[1])))", PBG_NF_DNF, 190, 27));
+	check(test_normalize(&err, "(& (| (?[a]) (?[b]) (?[c])) (| (?[d]) (?[e]) (?[f])) "
+			"(| (?[g]) (?[h]) (?[1])))", PBG_NF_DNF, 189, PBG_ERROR));
+	check(test_normalize(&err, "(& (| (?[a]) (?[b]) (?[c])) (| (?[d]) (?[e]) (?[f])) "
+			"(| (?[g]) (?[h]) (?[1])))", PBG_NF_DNF, 20, PBG_ERROR));
+	check(test_normalize(&err, "(& (| (?[a]) (?[b]) (?[c])) (| (?[d]) (?[e]) (?[f])) "
+			"(| (?[g]) (?[h]) (?[1])))", PBG_NF_CNF, 22, 3));
+	/* Wide groups are gathered at once, and repeated atoms found by hash. */
+	wide = (char*) malloc(16*WIDE_ANDS + 8);
+	if(wide != NULL) {
+		len = sprintf(wide, "(&");
+		for(i = 0; i < WIDE_ANDS; i++)
+			len += sprintf(wide+len, " (!= [a] %d)", i % (WIDE_ANDS/2));
+		sprintf(wide+len, ")");
+		check(test_normalize(&err, wide, PBG_NF_DNF, 4*WIDE_ANDS, 1));
+		check(test_normalize(&err, wide, PBG_NF_CNF, 4*WIDE_ANDS, WIDE_ANDS));
+		wide[1] = '|';
+		check(test_normalize(&err, wide, PBG_NF_CNF, 4*WIDE_ANDS, 1));
+	}
+	free(wide);
+	
+	/* Clauses expose their atoms. */
+	pbg_parse(&e, &err, "(! (| (?[a]) (= [c] 6)))");
+	pbg_normalize(&nf, &err, &e, PBG_NF_DNF, 100);
+	check((!pbg_iserror(&err) && nf._numclauses == 1 && 
+			pbg_nf_clause(&nf, 0, &atoms, &negated) == 2 &&
+			atoms[0]->_type == PBG_OP_EXST && negated[0] == 1 && 
+			atoms[1]->_type == PBG_OP_EQ && negated[1] == 1 &&
+			pbg_field_child(&nf._expr, atoms[1], 0)->_type == PBG_LT_VAR) ?
+			PBG_TEST_PASS : PBG_TEST_FAIL);
+	pbg_nf_free(&nf);
+	pbg_free(&e);
+	
+	end_test();
+}
+
+/* Tests for pbg_compile. */
+int suite_compile()
+{
+	init_test();
+	
+	/* VAR against NUMBER, in both orders. */
+	check(test_compile(&err, "(< [a] 6)", PBG_TRUE));
+	check(test_compile(&err, "(< 6 [a])", PBG_FALSE));
+	check(test_compile(&err, "(>= [c] 6)", PBG_TRUE));
+	check(test_compile(&err, "(<= 6.5 [c])", PBG_FALSE));
+	check(test_compile(&err, "(> [a] 5)", PBG_FALSE));
+	check(test_compile(&err, "(= [a] 5)", PBG_TRUE));
+	check(test_compile(&err, "(= 5.0 [a])", PBG_TRUE));
+	check(test_compile(&err, "(!= [a] 5)", PBG_FALSE));
+	check(test_compile(&err, "(!= 6 [a])", PBG_TRUE));
+	/* VAR against DATE and STRING. */
+	check(test_compile(&err, "(< [t] 2018-10-13)", PBG_TRUE));
+	check(test_compile(&err, "(> 2018-10-13 [t])", PBG_TRUE));
+	check(test_compile(&err, "(= [t] 2018-10-12)", PBG_TRUE));
+	check(test_compile(&err, "(!= 2018-10-12 [t])", PBG_FALSE));
+	check(test_compile(&err, "(= [s] 'hi')", PBG_TRUE));
+	check(test_compile(&err, "(= [s] 'h')", PBG_FALSE));
+	check(test_compile(&err, "(< [s] 'hz')", PBG_TRUE));
+	check(test_compile(&err, "(< 'h' [s])", PBG_FALSE));
+	check(test_compile(&err, "(>= 'hz' [s])", PBG_TRUE));
+	/* Mismatched and missing types behave like the interpreter. */
+	check(test_compile(&err, "(< [s] 5)", PBG_ERROR));
+	check(test_compile(&err, "(< [d] 5)", PBG_ERROR));
+	check(test_compile(&err, "(= [d] 5)", PBG_ERROR));
+	check(test_compile(&err, "(= 5 [s])", PBG_FALSE));
+	check(test_compile(&err, "(= [u] 5)", PBG_ERROR));
+	check(test_compile(&err, "(= 5 [u])", PBG_FALSE));
+	check(test_compile(&err, "(< [a] 2018-10-12)", PBG_ERROR));
+	/* VAR against TRUE and FALSE. */
+	check(test_compile(&err, "(= [u] TRUE)", PBG_TRUE));
+	check(test_compile(&err, "(= FALSE [u])", PBG_FALSE));
+	check(test_compile(&err, "(!= [u] FALSE)", PBG_TRUE));
+	check(test_compile(&err, "(! (= [u] TRUE))", PBG_FALSE));
+	check(test_compile(&err, "(= [a] TRUE)", PBG_FALSE));
+	check(test_compile(&err, "(!= TRUE [s])", PBG_TRUE));
+	check(test_compile(&err, "(= [d] TRUE)", PBG_ERROR));
+	/* EXST and NOT. */
+	check(test_compile(&err, "(? [a])", PBG_TRUE));
+	check(test_compile(&err, "(? [d])", PBG_FALSE));
+	check(test_compile(&err, "(! (? [d]))", PBG_TRUE));
+	check(test_compile(&err, "(! (! (? [d])))", PBG_FALSE));
+	check(test_compile(&err, "(! (< [a] 6))", PBG_FALSE));
+	check(test_compile(&err, "(! (< [s] 6))", PBG_ERROR));
+	check(test_compile(&err, "(! (= [t] 2018-10-12))", PBG_FALSE));
+	/* Fused nodes inside other operators. */
+	check(test_compile(&err, "(& (? [a]) (< [a] 6) (= [s] 'hi') [u])", PBG_TRUE));
+	check(test_compile(&err, "(| (? [d]) (! (< [a] 6)) (> [t] 2019-01-01))", PBG_FALSE));
+	check(test_compile(&err, "(| (? [a]) (< [d] 6))", PBG_TRUE));
+	check(test_compile(&err, "(& (? [a]) (< [d] 6))", PBG_ERROR));
+	check(test_compile(&err, "(| (? [d]) (! [u]) (= [a] 5) [u])", PBG_TRUE));
+	check(test_compile(&err, "(& [u] (! (! [u])) (? [s]) [a])", PBG_ERROR));
+	check(test_compile(&err, "(= (< [a] 6) (? [c]) TRUE)", PBG_TRUE));
+	check(test_compile(&err, "(@ NUMBER [a] [c])", PBG_TRUE));
+	check(test_compile(&err, "(< [a] [c])", PBG_TRUE));
+	check(test_compile(&err, "FALSE", PBG_FALSE));
+	/* ORs of EQs become set lookups. */
+	check(test_compile(&err, "(| (= [a] 1) (= 2 [a]) (= [a] -0) (= [a] 5) (= [a] 9))", PBG_TRUE));
+	check(test_compile(&err, "(| (= [c] 1) (= [c] 2) (= [c] 0) (= [c] 5) (= [c] 9))", PBG_FALSE));
+	check(test_compile(&err, "(| (= [t] 2018-10-11) (= [t] 2018-02-30) (= [t] 2018-10-12) (= [t] 2019-10-12))", PBG_TRUE));
+	check(test_compile(&err, "(| (= [t] 2018-10-11) (= [t] 2018-10-13) (= [t] 2017-10-12) (= [t] 2019-10-12))", PBG_FALSE));
+	check(test_compile(&err, "(| (= [s] 'h') (= [s] 'hi') (= [s] 'hi') (= 'ih' [s]) (= [s] 'hii'))", PBG_TRUE));
+	check(test_compile(&err, "(| (= [s] 'h') (= [s] 'i') (= [s] '') (= 'ih' [s]) (= [s] 'hii'))", PBG_FALSE));
+	check(test_compile(&err, "(! (| (= [s] 'h') (= [s] 'i') (= [s] '') (= [s] 'hi')))", PBG_FALSE));
+	check(test_compile(&err, "(| (= [s] 1) (= [s] 2) (= [s] 3) (= [s] 4))", PBG_FALSE));
+	check(test_compile(&err, "(| (= [u] 1) (= [u] 2) (= [u] 3) (= [u] 4))", PBG_ERROR));
+	check(test_compile(&err, "(| (= [d] 1) (= [d] 2) (= [d] 3) (= [d] 4))", PBG_ERROR));
+	check(test_compile(&err, "(| (= [a] 1) (= [a] 2) (= [c] 3) (= [a] 5))", PBG_TRUE));
+	check(test_compile(&err, "(| (= [a] 1) (= [a] 2) (!= [a] 3) (= [a] 4))", PBG_TRUE));
+	/* ANDs and ORs of comparisons on one NUMBER VAR become interval tests. */
+	check(test_compile(&err, "(| (< [a] 5) (> [a] 10) (= [a] 7))", PBG_FALSE));
+	check(test_compile(&err, "(| (< [c] 5) (> [c] 10) (= [c] 6))", PBG_TRUE));
+	check(test_compile(&err, "(& (> [a] 3) (> [a] 5))", PBG_FALSE));
+	check(test_compile(&err, "(& (> [c] 3) (> [c] 5))", PBG_TRUE));
+	check(test_compile(&err, "(& (>= [a] 5) (<= 5 [a]) (!= [a] 6))", PBG_TRUE));
+	check(test_compile(&err, "(& (> [a] 3) (! (< [a] 5)) (< 4 [a]) (= [a] 5))", PBG_TRUE));
+	check(test_compile(&err, "(| (< [a] 5) (>= [a] 5))", PBG_TRUE));
+	check(test_compile(&err, "(& (< [c] 5) (> [c] 5))", PBG_FALSE));
+	check(test_compile(&err, "(| (= [z] 0) (< [z] 0))", PBG_FALSE));
+	check(test_compile(&err, "(& (<= [z] 0) (>= 0 [z]))", PBG_TRUE));
+	check(test_compile(&err, "(| (= [z] -0) (> [z] 1))", PBG_TRUE));
+	check(test_compile(&err, "(| (= [s] 1) (< [s] 5))", PBG_ERROR));
+	check(test_compile(&err, "(& (= [s] 1) (< [s] 5))", PBG_FALSE));
+	check(test_compile(&err, "(| (< [d] 1) (> [d] 5))", PBG_ERROR));
+	check(test_compile(&err, "(| (< [a] 5) (> [c] 10))", PBG_FALSE));
+	/* Runs of them inside larger ANDs and ORs become interval tests too. */
+	check(test_compile(&err, "(& (>= [a] 1) (< [a] 6) (= [s] 'hi'))", PBG_TRUE));
+	check(test_compile(&err, "(& (= [s] 'hi') (>= [c] 1) (< [c] 6))", PBG_FALSE));
+	check(test_compile(&err, "(| (= [s] 'x') (< [a] 1) (> [a] 4) [u])", PBG_TRUE));
+	check(test_compile(&err, "(& (> [a] 3) (< [a] 9) (> [c] 3) (< [c] 6))", PBG_FALSE));
+	check(test_compile(&err, "(& (? [a]) (> [a] 3) (< [a] 9) [u] (<= [c] 6) (> [c] 0))", PBG_TRUE));
+	check(test_compile(&err, "(& (< [z] 1) (> [z] -1) (= [z] -0) (? [z]))", PBG_TRUE));
+	check(test_compile(&err, "(& (? [a]) (> [s] 3) (< [s] 9) (= [a] 5))", PBG_ERROR));
+	check(test_compile(&err, "(| (? [d]) (< [a] 5) (> [a] 5) (= [d] 1))", PBG_ERROR));
+	/* DATEs, alone or in runs. */
+	check(test_compile(&err, "(& (>= [t] 2018-10-01) (< [t] 2018-11-01))", PBG_TRUE));
+	check(test_compile(&err, "(& (> [t] 2018-10-12) (<= 2018-01-01 [t]))", PBG_FALSE));
+	check(test_compile(&err, "(| (= [t] 2018-10-12) (> [t] 2019-01-01))", PBG_TRUE));
+	check(test_compile(&err, "(| (< [t] 2018-02-30) (= [t] 2018-02-30) (> [t] 2018-10-12))", PBG_FALSE));
+	check(test_compile(&err, "(& (!= [t] 2018-02-30) (> [t] 2018-02-28) (< [t] 2018-10-13))", PBG_TRUE));
+	check(test_compile(&err, "(& (< [a] 6) (> [a] 4) (< [t] 2018-01-01) (> [t] 2017-01-01))", PBG_FALSE));
+	check(test_compile(&err, "(& (? [t]) (< [t] 2018-10-13) (> [t] 2018-10-11) (= [s] 'hi'))", PBG_TRUE));
+	check(test_compile(&err, "(| (< [a] 2018-01-01) (> [a] 2019-01-01))", PBG_ERROR));
+	check(test_compile(&err, "(& (= [s] 2018-01-01) (< [s] 2019-01-01))", PBG_FALSE));
+	
+	end_test();
+}
+
+/* Tests for pbg_manage. */
+int suite_manage()
+{
+	pbg_expr e;
+	init_test();
+	
+	/* Decisive children move forward. */
+	check(test_manage(&err, "(& (? [a]) (? [c]) (? [d]))", 3, 0, PBG_FALSE, PBG_FALSE));
+	check(test_manage(&err, "(| (? [d]) (? [e]) (? [a]))", 3, 0, PBG_TRUE, PBG_FALSE));
+	check(test_manage(&err, "(| (? [d]) (! (? [a])) (? [c]))", 2, 5, PBG_TRUE, PBG_TRUE));
+	check(test_manage(&err, "(& (? [a]) (| (? [d]) (? [b])) (! (? [e])))", 4, 3, PBG_TRUE, PBG_FALSE));
+	/* Children that may fail are never moved. */
+	check(test_manage(&err, "(& (? [a]) (< [s] 5) (? [d]))", 3, 0, PBG_ERROR, PBG_FALSE));
+	check(test_manage(&err, "(& (? [d]) (< [a] 6) (? [b]))", 3, 2, PBG_FALSE, PBG_FALSE));
+	check(test_manage(&err, "(| (< [a] 6) (? [d]) (< [s] 5) (? [c]))", 1, 1, PBG_TRUE, PBG_ERROR));
+	check(test_manage(&err, "(& (? [d]) [u] (? [a]))", 2, 2, PBG_FALSE, PBG_FALSE));
+	check(test_manage(&err, "(& (= [s] 'hi') (> [t] 2018-01-01) (! (= [a] 6)))", 2, 2, 
+			PBG_TRUE, PBG_ERROR));
+	check(test_manage(&err, "(| (= [s] 'a') (= [s] 'b') (= [s] 'c') (= [s] 'hi'))", 2, 3, 
+			PBG_TRUE, PBG_ERROR));
+	check(test_manage(&err, "(& (? [a]) (> [a] 3) (< [a] 9) (? [c]) (= [s] 'hi') (? [t]))", 
+			2, 3, PBG_TRUE, PBG_FALSE));
+	
+	/* Bad settings. */
+	pbg_parse(&e, &err, "(? [a])");
+	pbg_manage(&e, &err, 0, 0);
+	check(err._type == PBG_ERR_STATE ? PBG_TEST_PASS : PBG_TEST_FAIL);
+	pbg_free(&e);
+	
+	end_test();
+}
+
+/* Tests for pbg_print. */
+int suite_print()
+{
+	pbg_expr e;
+	char buf[8];
+	init_test();
+	
+	check(test_print(&err, "  TRUE ", "TRUE"));
+	check(test_print(&err, "(&\n\t(> [c] [a])\n\t(! (= [s] 'ho'))\n)", 
+			"(&(>[c][a])(!(=[s]'ho')))"));
+	check(test_print(&err, "(= 'a, b\\'c' [d] 2018-10-12 FALSE)", 
+			"(= 'a, b\\'c'[d]2018-10-12 FALSE)"));
+	check(test_print(&err, "(@ NUMBER [a] 10)", "(@ NUMBER[a]10)"));
+	check(test_print(&err, "(!= (? [a]) TRUE)", "(!=(?[a])TRUE)"));
+	/* NUMBERs are written the shortest way that reads back exactly. */
+	check(test_print(&err, "(= 5.000 0.314 -0.0)", "(= 5 0.314 -0)"));
+	check(test_print(&err, "(= 5.5e1 1.0e+20 2.5e-07 1200)", "(= 55 1.0e20 2.5e-7 1200)"));
+	check(test_print(&err, "(= 0.1 1.7976931348623157e308 1.0e999)", 
+			"(= 0.1 1.7976931348623157e308 1.0e999)"));
+	
+	/* Short buffers are truncated and terminated, like snprintf. */
+	pbg_parse(&e, &err, "(? [abcdef])");
+	check(pbg_print(&e, buf, sizeof(buf)) == 11 && strcmp(buf, "(?[abcd") == 0 ?
+			PBG_TEST_PASS : PBG_TEST_FAIL);
+	check(pbg_print(&e, NULL, 0) == 11 ? PBG_TEST_PASS : PBG_TEST_FAIL);
+	pbg_free(&e);
+	
+	end_test();
+}
+
+/* Tests for pbg_combine. */
+int suite_combine()
+{
+	pbg_expr e, *none;
+	init_test();
+	
+	check(test_combine(&err, PBG_OP_AND, "(= [a] 5)", "(! (= [s] 'ho'))", 
+			"(&(=[a]5)(!(=[s]'ho')))", PBG_TRUE));
+	check(test_combine(&err, PBG_OP_OR, "(| FALSE (< [c] [a]))", "(?[d])", 
+			"(|(| FALSE(<[c][a]))(?[d]))", PBG_FALSE));
+	check(test_combine(&err, PBG_OP_EQ, "TRUE", "(@ BOOL [u])", 
+			"(= TRUE(@ BOOL[u]))", PBG_TRUE));
+	check(test_combine(&err, PBG_OP_AND, "TRUE", "(< [d] 1)", 
+			"(& TRUE(<[d]1))", PBG_ERROR));
+	/* Arity is enforced, and expressions must not be empty. */
+	check(test_combine(&err, PBG_OP_NOT, "TRUE", "TRUE", NULL, PBG_ERROR));
+	none = NULL;
+	pbg_combine(&e, &err, PBG_OP_AND, &none, 0);
+	check(err._type == PBG_ERR_OP_ARITY ? PBG_TEST_PASS : PBG_TEST_FAIL);
+	pbg_parse(&e, &err, "");
+	pbg_error_free(&err);
+	none = &e;
+	pbg_combine(&e, &err, PBG_OP_NOT, &none, 1);
+	check(err._type == PBG_ERR_STATE ? PBG_TEST_PASS : PBG_TEST_FAIL);
+	
+	end_test();
+}
+
+/* Tests for pbg_analyze. */
+int suite_analyze()
+{
+	pbg_expr e;
+	init_test();
+	
+	/* Never TRUE. */
+	check(test_analyze(&err, "FALSE", PBG_AN_NEVER));
+	check(test_analyze(&err, "(& (< [x] 3) (> [x] 5))", PBG_AN_NEVER));
+	check(test_analyze(&err, "(& (< [x] 3) (< 5 [x]))", PBG_AN_NEVER));
+	check(test_analyze(&err, "(& (< [x] 3) (>= [x] 3))", PBG_AN_NEVER));
+	check(test_analyze(&err, "(& (= [x] 3) (= [x] 4))", PBG_AN_NEVER));
+	check(test_analyze(&err, "(& (@ DATE [x]) (< [x] 9))", PBG_AN_NEVER));
+	check(test_analyze(&err, "(& (@ NUMBER [x]) (= [x] 'a'))", PBG_AN_NEVER));
+	check(test_analyze(&err, "(& (> [d] 2018-10-12) (< [d] 2018-01-01))", PBG_AN_NEVER));
+	check(test_analyze(&err, "(& (= [s] 'a') (!= [s] 'a'))", PBG_AN_NEVER));
+	check(test_analyze(&err, "(& (? [x]) (! (? [x])))", PBG_AN_NEVER));
+	check(test_analyze(&err, "(& [x] (! [x]))", PBG_AN_NEVER));
+	check(test_analyze(&err, "(| (& (< [x] 1) (> [x] 2)) (@ STRING 5))", PBG_AN_NEVER));
+	check(test_analyze(&err, "(! (| (< [x] 1) (>= [x] 1)))", PBG_AN_NEVER));
+	check(test_analyze(&err, "(& (< [x] 3) (| (> [x] 5) (= [x] 4)))", PBG_AN_NEVER));
+	check(test_analyze(&err, "(@ 5 [x])", PBG_AN_NEVER));
+	/* Always TRUE. */
+	check(test_analyze(&err, "TRUE", PBG_AN_ALWAYS));
+	check(test_analyze(&err, "(| (? [x]) (! (? [x])))", PBG_AN_ALWAYS));
+	check(test_analyze(&err, "(| (! (@ NUMBER [x])) (< [x] 3) (>= [x] 3))", 
+			PBG_AN_ALWAYS));
+	check(test_analyze(&err, "(! (& (? [x]) (! (? [x]))))", PBG_AN_ALWAYS));
+	check(test_analyze(&err, "(| (@ BOOL [x]) (! (@ BOOL [x])))", PBG_AN_ALWAYS));
+	/* Neither, or not provable. */
+	check(test_analyze(&err, "(| (< [x] 3) (>= [x] 3))", PBG_AN_UNKNOWN));
+	check(test_analyze(&err, "(& (<= [x] 3) (>= [x] 5))", PBG_AN_UNKNOWN));
+	check(test_analyze(&err, "(& (= [x] 0) (!= [x] -0))", PBG_AN_UNKNOWN));
+	check(test_analyze(&err, "(& (< [x] 3) (> [y] 5))", PBG_AN_UNKNOWN));
+	check(test_analyze(&err, "(& (< [x] [y]) (> [x] [y]))", PBG_AN_UNKNOWN));
+	check(test_analyze(&err, "(& (< [s] 'b') (> [s] 'c'))", PBG_AN_UNKNOWN));
+	check(test_analyze(&err, "(| (< [x] 1) (> [x] 2))", PBG_AN_UNKNOWN));
+	/* NaN is neither less nor more than 3, and STRINGs cannot be ordered by 3. */
+	check(test_analyze(&err, "(& (<= [x] 3) (>= [x] 3) (!= [x] 3))", PBG_AN_UNKNOWN));
+	check(test_analyze(&err, "(| (! (? [x])) (< [x] 3) (>= [x] 3) (@ NUMBER [x]))", 
+			PBG_AN_UNKNOWN));
+	/* Empty expressions cannot be analyzed. */
+	pbg_parse(&e, &err, "");
+	pbg_error_free(&err);
+	check(pbg_analyze(&e, &err) == PBG_AN_UNKNOWN && err._type == PBG_ERR_STATE ? 
+			PBG_TEST_PASS : PBG_TEST_FAIL);
+	
+	/* Implications. */
+	check(test_implies(&err, "(& (= [s] 'hi') (> [a] 4))", "(> [a] 1)", 1));
+	check(test_implies(&err, "(> [a] 1)", "(& (= [s] 'hi') (> [a] 4))", 0));
+	check(test_implies(&err, "(= [a] 5)", "(>= [a] 5)", 1));
+	check(test_implies(&err, "(= [a] 5)", "(| (= [a] 5) (= [d] 1))", 1));
+	check(test_implies(&err, "(< [a] 3)", "(! (> [a] 5))", 1));
+	check(test_implies(&err, "(& (> [a] 1) (< [a] 9))", "(!= [a] 10)", 1));
+	check(test_implies(&err, "(@ DATE [t])", "(? [t])", 1));
+	check(test_implies(&err, "FALSE", "(= [x] 1)", 1));
+	check(test_implies(&err, "(> [a] 1)", "TRUE", 1));
+	/* A NULL [d] is an error before [a] is compared. */
+	check(test_implies(&err, "(= [a] 5)", "(| (= [d] 1) (= [a] 5))", 0));
+	/* NaN is at most 5. */
+	check(test_implies(&err, "(<= [a] 5)", "(< [a] 6)", 0));
+	check(test_implies(&err, "(< [s] 'b')", "(< [s] 'c')", 0));
+	check(test_implies(&err, "(< [a] [b])", "(< [a] [b])", 0));
+	check(pbg_implies(&e, &e, &err) == 0 && err._type == PBG_ERR_STATE ? 
+			PBG_TEST_PASS : PBG_TEST_FAIL);
+	
+	end_test();
+}
+
+/* This dictionary defines the keys of dict, and counts its calls. */
+static int dict_calls;
+pbg_field dict_count(char* key, int n)
+{
+	dict_calls++;
+	return dict(key, n);
+}
+
+/* Tests for pbg_ruleset_evaluate. */
+int suite_ruleset()
+{
+	static char* rules[] = {
+		"(= [a] 5)",
+		"(& (= [d] 1) (< [a] 9))",
+		"(| (= [d] 1) (= [a] 5))",
+		"(| (= [d] 1) (! (= [d] 2)))",
+		"(! (? [d]))",
+		"(& [u] (@ STRING [s]) (? [e]))",
+		"(& [u] (@ STRING [s]))"
+	};
+	static char* refined[] = {
+		"(& (> [a] 4) (= [s] 'hi'))",
+		"(> [a] 1)",
+		"(> [c] 9)",
+		"(& (> [c] 10) (> [a] 0))"
+	};
+	static char* dead[] = {
+		"(& (< [a] 3) (> [a] 5))",
+		"(& (@ DATE [a]) (< [a] 9))",
+		"(| (? [a]) (! (? [a])))",
+		"(= [a] 5)"
+	};
+	init_test();
+	
+	/* Rules needing [d] or [e] are skipped. */
+	check(test_ruleset(&err, rules, 7, -1, 8, 3));
+	check(test_ruleset(&err, rules, 1, -1, 1, 1));
+	check(test_ruleset(&err, rules+1, 1, -1, 0, 0));
+	check(test_ruleset(&err, rules, 0, -1, 0, 0));
+	/* Dead rules are skipped, and rules always TRUE are not evaluated. */
+	check(test_ruleset(&err, dead, 4, -1, 1, 2));
+	/* Rules implied by a selected rule are selected, and rules implying a rule
+	 * not selected are skipped. */
+	check(test_ruleset(&err, refined, 4, -1, 3, 2));
+	check(test_ruleset(&err, refined, 4, 1, 3, 2));
+	/* Rules are not related at all if asked not to. */
+	check(test_ruleset(&err, refined, 4, 0, 6, 2));
+	/* Thousands of rules are related in time, each checked against a few. */
+	check(test_ruleset_many(&err, 3000, 8, 300, 150));
+	check(test_ruleset_many(&err, 3000, 0, 9000, 150));
+	
+	end_test();
+}
+
+/* This batch holds BATCH_ROWS rows, spanning several blocks, with columns 
+ * [n] NUMBER, [d] DATE, [s] STRING, and [b] BOOL, some of them NULL. */
+#define BATCH_ROWS 150
+static double batch_n[BATCH_ROWS];
+static int batch_d[BATCH_ROWS];
+static char batch_s[BATCH_ROWS*6];
+static int batch_offsets[BATCH_ROWS+1];
+static unsigned char batch_b[(BATCH_ROWS+7)/8];
+static unsigned char batch_valid[3][(BATCH_ROWS+7)/8];
+static pbg_column batch_columns[4];
+static pbg_batch batch;
+static int batch_rownum;
+
+void batch_init()
+{
+	int i;
+	char* words[] = {"apple", "app", "banana", ""};
+	memset(batch_b, 0, sizeof(batch_b));
+	memset(batch_valid, 0, sizeof(batch_valid));
+	batch_offsets[0] = 0;
+	for(i = 0; i < BATCH_ROWS; i++) {
+		batch_n[i] = (i % 7) - 2.5;
+		batch_d[i] = 17800 + (i % 30);  /* 2018-09-26 onwards. */
+		strcpy(batch_s + batch_offsets[i], words[i % 4]);
+		batch_offsets[i+1] = batch_offsets[i] + strlen(words[i % 4]);
+		if(i % 3 == 0)  batch_b[i/8] |= 1 << (i%8);
+		if(i % 11 != 0) batch_valid[0][i/8] |= 1 << (i%8);
+		if(i % 13 != 0) batch_valid[1][i/8] |= 1 << (i%8);
+		if(i % 17 != 0) batch_valid[2][i/8] |= 1 << (i%8);
+	}
+	batch_columns[0]._name = "n";
+	batch_columns[0]._type = PBG_LT_TP_NUMBER;
+	batch_columns[0]._values = batch_n;
+	batch_columns[0]._offset = 0;
+	batch_columns[0]._offsets = NULL;
+	batch_columns[0]._valid = batch_valid[0];
+	batch_columns[1]._name = "d";
+	batch_columns[1]._type = PBG_LT_TP_DATE;
+	batch_columns[1]._values = batch_d;
+	batch_columns[1]._offset = 0;
+	batch_columns[1]._offsets = NULL;
+	batch_columns[1]._valid = NULL;
+	batch_columns[2]._name = "s";
+	batch_columns[2]._type = PBG_LT_TP_STRING;
+	batch_columns[2]._values = batch_s;
+	batch_columns[2]._offset = 0;
+	batch_columns[2]._offsets = batch_offsets;
+	batch_columns[2]._valid = batch_valid[1];
+	batch_columns[3]._name = "b";
+	batch_columns[3]._type = PBG_LT_TP_BOOL;
+	batch_columns[3]._values = batch_b;
+	batch_columns[3]._offset = 0;
+	batch_columns[3]._offsets = NULL;
+	batch_columns[3]._valid = batch_valid[2];
+	batch._columns = batch_columns;
+	batch._numcolumns = 4;
+	batch._numrows = BATCH_ROWS;
+}
+
+/* This dictionary resolves VARs to row batch_rownum of the batch. */
+pbg_field dict_row(char* key, int n)
+{
+	int i;
+	char str[8];
+	i = batch_rownum;
+	if(n != 1) return pbg_make_null();
+	if(key[0] == 'n' && i % 11 != 0)
+		return pbg_make_number(batch_n[i]);
+	if(key[0] == 'd')
+		return pbg_make_date(2018, 9 + (26 + i % 30 > 30), 
+				(26 + i % 30 > 30) ? i % 30 - 4 : 26 + i % 30);
+	if(key[0] == 's' && i % 13 != 0) {
+		memcpy(str, batch_s + batch_offsets[i], batch_offsets[i+1] - batch_offsets[i]);
+		str[batch_offsets[i+1] - batch_offsets[i]] = '\0';
+		return pbg_make_string(str);
+	}
+	if(key[0] == 'b' && i % 17 != 0)
+		return pbg_make_bool(i % 3 == 0);
+	return pbg_make_null();
+}
+
+/* Tests for pbg_evaluate_batch, pbg_evaluate_batch_errors, and pbg_aggregate. */
+int suite_batch()
+{
+	int row;
+	pbg_expr e;
+	pbg_agg agg;
+	init_test();
+	batch_init();
+	
+	/* Scanned a block at a time. */
+	check(test_batch(&err, "(? [n])", 136));
+	check(test_batch(&err, "(> [n] 0)", 76));
+	check(test_batch(&err, "(| (! (? [n])) (<= [n] -1.5))", 54));
+	check(test_batch(&err, "(= [s] 'app')", 35));
+	check(test_batch(&err, "(< [s] 'b')", 70));
+	/* A STRING written first is still compared first, even as a prefix. */
+	check(test_batch(&err, "(> 'apple' [s])", 69));
+	check(test_batch(&err, "(<= 'app' [s])", 104));
+	check(test_batch(&err, "(>= 2018-10-01 [d])", 30));
+	/* DATEs off the calendar are still ordered. */
+	check(test_batch(&err, "(< [d] 2018-09-31)", 25));
+	check(test_batch(&err, "(<= 2018-09-31 [d])", 125));
+	check(test_batch(&err, "(& [b] (!= [s] 'banana'))", 34));
+	check(test_batch(&err, "(! (? [x]))", BATCH_ROWS));
+	check(test_batch(&err, "(| (= [x] 1) TRUE)", 0));
+	check(test_batch(&err, "(& (< [s] 5) TRUE)", 0));
+	check(test_batch(&err, "(| (= [s] 5) (> [n] 0))", 69));
+	check(test_batch(&err, "(| (= [n] -2.5) (= [n] 0.5) (= [n] 3.5) (= [n] 7))", 58));
+	check(test_batch(&err, "(| (= [s] 'app') (= [s] '') (= [s] 'apple') (= [s] 'ban'))", 104));
+	check(test_batch(&err, "(| (= [d] 2018-09-26) (= [d] 2018-10-01) (= [d] 2018-02-30) (= [d] 2018-10-25))", 15));
+	check(test_batch(&err, "(| (= [s] 1) (= [s] 2) (= [s] 3) (= [s] 4))", 0));
+	check(test_batch(&err, "(| (< [n] -1) (> [n] 2) (= [n] 0.5))", 97));
+	check(test_batch(&err, "(& (> [n] -2) (<= [n] 1.5) (!= [n] -0.5))", 58));
+	check(test_batch(&err, "(& (> [s] 1) (<= [s] 2))", 0));
+	check(test_batch(&err, "(! (!= [n] 'app'))", 0));
+	check(test_batch(&err, "(& (? [d]) (> [d] 'x'))", 0));
+	check(test_batch(&err, "(= [d] 2018-02-30)", 0));
+	/* Interval tests, alone or merged from runs inside larger ANDs and ORs. */
+	check(test_batch(&err, "(& (>= [n] -1) (< [n] 2) (= [s] 'app'))", 14));
+	check(test_batch(&err, "(| (= [s] 'app') (< [n] -1) (> [n] 2) [b])", 101));
+	check(test_batch(&err, "(& (>= [d] 2018-10-01) (< [d] 2018-10-10))", 45));
+	check(test_batch(&err, "(| (< [d] 2018-09-28) (= [d] 2018-02-30) (> [d] 2018-10-20) (= [s] ''))", 61));
+	check(test_batch(&err, "(& (? [s]) (> [d] 2018-09-30) (<= [d] 2018-10-31) (!= [n] 0.5) (> [n] -2))", 73));
+	check(test_batch(&err, "(| (< [b] 1) (> [b] 2) (< [s] 5) (> [s] 6))", 0));
+	/* TYPEs, BOOL constants, and BOOL columns. */
+	check(test_batch(&err, "(& (@ NUMBER [n]) (> [n] 1))", 57));
+	check(test_batch(&err, "(@ BOOL [b] (< [n] 1))", 141));
+	check(test_batch(&err, "(@ STRING [s] 'x' [x])", 0));
+	check(test_batch(&err, "(! (@ DATE [d] [n]))", 150));
+	check(test_batch(&err, "(= [b] TRUE)", 47));
+	check(test_batch(&err, "(!= FALSE [b])", 47));
+	check(test_batch(&err, "(! (= [b] FALSE))", 47));
+	check(test_batch(&err, "(| (= [n] TRUE) (!= [s] FALSE))", 126));
+	check(test_batch(&err, "(= [b] 1)", 0));
+	check(test_batch(&err, "(| (!= [b] 'x') (< [b] 2))", 141));
+	check(test_batch(&err, "(& (> [b] 1) (<= [b] 2))", 0));
+	/* Run row by row. */
+	check(test_batch(&err, "(| [b] (= [n] [n]))", 132));
+	check(test_batch(&err, "(< [b] TRUE)", 94));
+	
+	/* Counts and probes. */
+	pbg_parse(&e, &err, "(& (> [n] 3) [b])");
+	check(pbg_count_batch(&e, &err, &batch) == 6 ? PBG_TEST_PASS : PBG_TEST_FAIL);
+	check(pbg_any_batch(&e, &err, &batch, 0, BATCH_ROWS, &row) == PBG_TRUE && 
+			row == 6 ? PBG_TEST_PASS : PBG_TEST_FAIL);
+	check(pbg_any_batch(&e, &err, &batch, 7, BATCH_ROWS, &row) == PBG_TRUE && 
+			row == 27 ? PBG_TEST_PASS : PBG_TEST_FAIL);
+	check(pbg_any_batch(&e, &err, &batch, 7, 27, NULL) == PBG_FALSE ? 
+			PBG_TEST_PASS : PBG_TEST_FAIL);
+	check(pbg_any_batch(&e, &err, &batch, 140, 160, NULL) == PBG_ERROR ? 
+			PBG_TEST_PASS : PBG_TEST_FAIL);
+	pbg_free(&e);
+	
+	/* Aggregates. */
+	pbg_parse(&e, &err, "(> [n] 0)");
+	pbg_aggregate(&e, &err, &batch, "n", &agg);
+	check(agg._matches == 76 && agg._count == 76 && agg._sum == 152.0 && 
+			agg._min == 0.5 && agg._max == 3.5 ? PBG_TEST_PASS : PBG_TEST_FAIL);
+	pbg_free(&e);
+	pbg_parse(&e, &err, "(| [b] FALSE)");
+	pbg_aggregate(&e, &err, &batch, "n", &agg);
+	check(agg._matches == 47 && agg._count == 43 && agg._sum == 18.5 && 
+			agg._min == -2.5 && agg._max == 3.5 ? PBG_TEST_PASS : PBG_TEST_FAIL);
+	pbg_aggregate(&e, &err, &batch, "s", &agg);
+	check(err._type == PBG_ERR_STATE ? PBG_TEST_PASS : PBG_TEST_FAIL);
+	pbg_free(&e);
+	
+	end_test();
+}
+
+/* This record batch exports the test batch through the Arrow C Data Interface,
+ * from row ARROW_OFFSET on, with an extra int64 column [x] that is not
+ * supported. */
+#define ARROW_OFFSET 5
+static struct ArrowSchema arrow_schemas[6];
+static struct ArrowSchema* arrow_schema_kids[5];
+static struct ArrowArray arrow_arrays[6];
+static struct ArrowArray* arrow_array_kids[5];
+static const void* arrow_buffers[5][3];
+
+void arrow_init()
+{
+	int i;
+	char* names[] = {"n", "d", "s", "b", "x"};
+	char* formats[] = {"g", "tdD", "u", "b", "l"};
+	memset(arrow_schemas, 0, sizeof(arrow_schemas));
+	memset(arrow_arrays, 0, sizeof(arrow_arrays));
+	for(i = 0; i < 5; i++) {
+		arrow_schemas[i].format = formats[i];
+		arrow_schemas[i].name = names[i];
+		arrow_schema_kids[i] = arrow_schemas+i;
+		arrow_arrays[i].length = BATCH_ROWS;
+		arrow_arrays[i].n_buffers = (i == 2) ? 3 : 2;
+		arrow_arrays[i].buffers = arrow_buffers[i];
+		arrow_array_kids[i] = arrow_arrays+i;
+		arrow_buffers[i][0] = batch_columns[i % 4]._valid;
+		arrow_arrays[i].null_count = (arrow_buffers[i][0] != NULL);
+		arrow_buffers[i][1] = (i == 2) ? (void*) batch_offsets : batch_columns[i % 4]._values;
+		arrow_buffers[i][2] = batch_s;
+	}
+	arrow_schemas[5].format = "+s";
+	arrow_schemas[5].n_children = 5;
+	arrow_schemas[5].children = arrow_schema_kids;
+	arrow_arrays[5].length = BATCH_ROWS - ARROW_OFFSET;
+	arrow_arrays[5].offset = ARROW_OFFSET;
+	arrow_arrays[5].n_children = 5;
+	arrow_arrays[5].children = arrow_array_kids;
+}
+
+/* Tests for pbg_arrow.h. */
+int suite_arrow()
+{
+	pbg_expr e;
+	struct ArrowSchema schema;
+	struct ArrowArray array;
+	int i;
+	init_test();
+	batch_init();
+	arrow_init();
+	
+	check(test_arrow(&err, "(| (! (? [n])) (<= [n] -1.5))"));
+	check(test_arrow(&err, "(< [s] 'b')"));
+	check(test_arrow(&err, "(>= 2018-10-01 [d])"));
+	check(test_arrow(&err, "(| [b] (= [n] [n]))"));
+	check(test_arrow(&err, "(? [x])"));
+	
+	/* A null_count of -1 was not computed, and the validity buffers tell. */
+	for(i = 0; i < 6; i++)
+		arrow_arrays[i].null_count = -1;
+	check(test_arrow(&err, "(| (! (? [n])) (<= [n] -1.5))"));
+	check(test_arrow(&err, "(< [s] 'b')"));
+	arrow_arrays[5].n_buffers = 1;
+	arrow_arrays[5].buffers = arrow_buffers[0];
+	pbg_parse(&e, &err, "(? [n])");
+	pbg_arrow_evaluate(&e, &err, arrow_schemas+5, arrow_arrays+5, &schema, &array);
+	check(err._type == PBG_ERR_STATE ? PBG_TEST_PASS : PBG_TEST_FAIL);
+	pbg_free(&e);
+	arrow_init();
+	
+	/* Only record batches are accepted. */
+	pbg_parse(&e, &err, "(? [n])");
+	pbg_arrow_evaluate(&e, &err, arrow_schemas, arrow_arrays, &schema, &array);
+	check(err._type == PBG_ERR_STATE ? PBG_TEST_PASS : PBG_TEST_FAIL);
+	pbg_free(&e);
+	
 	end_test();
 }
 
@@ -361,6 +1427,656 @@ int test_evaluate(pbg_error* err, char* str, pbg_field (*dict)(char*,int), int e
 	return (expect == output) ? PBG_TEST_PASS : PBG_TEST_FAIL;
 }
 
+int test_path(pbg_error* err, char* str, int expect)
+{
+	pbg_expr e;
+	pbg_dict d;
+	pbg_segment* user;
+	pbg_hash_fn fn;
+	void* ctx[2];
+	int i, output, pass;
+	/* Parse the string expression. */
+	pbg_parse(&e, err, str);
+	if(err->_type != PBG_ERR_NONE)
+		return PBG_TEST_FAIL;
+	ctx[0] = &user;
+	ctx[1] = &fn;
+	d._get = NULL;
+	d._release = NULL;
+	d._ctx = ctx;
+	d._get_path = dict_path;
+	d._get_hashed = NULL;
+	user = NULL;
+	/* Evaluate it twice, then once more compiled, then once hashing segments
+	 * with hash_len. */
+	pass = 1;
+	for(i = 0; i < 4 && pass; i++) {
+		if(i == 2) pbg_compile(&e, err);
+		d._hash = (i < 3) ? NULL : hash_len;
+		fn = (i < 3) ? pbg_hash : hash_len;
+		output = pbg_evaluate_dict(&e, err, &d);
+		pass = err->_type == PBG_ERR_NONE && output == expect;
+	}
+	/* Clean up. */
+	pbg_free(&e);
+	/* Did we pass?? */
+	return pass ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_hashed(pbg_error* err, char* str, int expect)
+{
+	pbg_expr e;
+	pbg_dict d;
+	pbg_hash_fn fn;
+	int i, output, pass;
+	/* Parse the string expression. */
+	pbg_parse(&e, err, str);
+	if(err->_type != PBG_ERR_NONE)
+		return PBG_TEST_FAIL;
+	d._get = NULL;
+	d._release = NULL;
+	d._ctx = &fn;
+	d._get_path = NULL;
+	d._get_hashed = dict_hashed;
+	/* Evaluate it twice with pbg_hash, then twice with hash_len. */
+	pass = 1;
+	hash_calls = 0;
+	for(i = 0; i < 4 && pass; i++) {
+		d._hash = (i < 2) ? NULL : hash_len;
+		fn = (i < 2) ? pbg_hash : hash_len;
+		output = pbg_evaluate_dict(&e, err, &d);
+		pass = err->_type == PBG_ERR_NONE && output == expect;
+	}
+	/* Names are only hashed once with hash_len. The test dictionary hashes 
+	 * every name again to check it. */
+	pass = pass && hash_calls == 3*e._numvars;
+	/* Clean up. */
+	pbg_free(&e);
+	/* Did we pass?? */
+	return pass ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_eval_text(pbg_error* err, char* str, int expect)
+{
+	pbg_expr e;
+	pbg_error perr;
+	int output, parsed;
+	/* Evaluate the string expression as is. */
+	output = pbg_eval_text(err, str, strlen(str), dict);
+	/* Parse and evaluate it. */
+	pbg_parse(&e, &perr, str);
+	parsed = PBG_ERROR;
+	if(perr._type == PBG_ERR_NONE)
+		parsed = pbg_evaluate(&e, &perr, dict);
+	pbg_free(&e);
+	/* Both must give the same result and error, if any. */
+	if(output != parsed || perr._type != err->_type) {
+		pbg_error_free(&perr);
+		return PBG_TEST_FAIL;
+	}
+	pbg_error_free(&perr);
+	/* Did we pass?? */
+	return (output == expect) ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_lazy(pbg_error* err, char* str, int expect)
+{
+	pbg_lazy l;
+	int depth, output, i, pass;
+	pass = 1;
+	for(depth = 1; depth <= 3 && pass; depth++) {
+		/* Parse the string expression lazily. */
+		pbg_parse_lazy(&l, err, str, strlen(str), depth);
+		if(err->_type != PBG_ERR_NONE)
+			return (expect == PBG_ERROR) ? PBG_TEST_PASS : PBG_TEST_FAIL;
+		/* Evaluate it twice, building subtrees the first time. */
+		for(i = 0; i < 2 && pass; i++) {
+			output = pbg_lazy_evaluate(&l, err, dict);
+			if(err->_type != PBG_ERR_NONE) output = PBG_ERROR;
+			pass = (output == expect);
+			pbg_error_free(err);
+			err->_type = PBG_ERR_NONE;
+		}
+		pbg_lazy_free(&l);
+	}
+	/* Did we pass?? */
+	return pass ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_validate(pbg_error* err, char* str, int expect)
+{
+	pbg_expr e;
+	pbg_error perr;
+	int valid;
+	/* Check the string expression, then parse it. */
+	valid = pbg_validate(err, str, strlen(str));
+	pbg_parse(&e, &perr, str);
+	pbg_free(&e);
+	/* Both must report the same error, if any. */
+	if(valid != (err->_type == PBG_ERR_NONE) || perr._type != err->_type) {
+		pbg_error_free(&perr);
+		return PBG_TEST_FAIL;
+	}
+	pbg_error_free(&perr);
+	/* Did we pass?? */
+	return (valid == expect) ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_parser(pbg_error* err, char* str)
+{
+	static int sizes[] = { 1, 2, 3, 5, 8, 0 };
+	pbg_parser p;
+	pbg_expr e1, e2;
+	pbg_error perr;
+	char text1[128], text2[128];
+	int i, k, n, size, pass;
+	/* Parse the string expression in one go. */
+	pbg_parse(&e1, err, str);
+	pbg_print(&e1, text1, sizeof(text1));
+	/* Feed it in chunks of each size, reusing the parser. The last size feeds 
+	 * it whole. */
+	n = strlen(str);
+	pass = 1;
+	pbg_parser_init(&p);
+	for(k = 0; k < (int) (sizeof(sizes)/sizeof(sizes[0])) && pass; k++) {
+		size = (sizes[k] > 0) ? sizes[k] : n;
+		for(i = 0; i < n; i += size) {
+			pbg_parser_feed(&p, &perr, str+i, (n-i < size) ? n-i : size);
+			if(perr._type != PBG_ERR_NONE) pass = 0;
+		}
+		pbg_parser_finish(&p, &e2, &perr);
+		/* Both must report the same error, or print the same text. */
+		if(perr._type != err->_type)
+			pass = 0;
+		else if(perr._type == PBG_ERR_NONE) {
+			pbg_print(&e2, text2, sizeof(text2));
+			pass = pass && strcmp(text1, text2) == 0;
+		}
+		pbg_error_free(&perr);
+		pbg_free(&e2);
+	}
+	/* Parse it whole with the same parser. */
+	pbg_parser_parse_n(&p, &e2, &perr, str, n);
+	if(perr._type != err->_type)
+		pass = 0;
+	else if(perr._type == PBG_ERR_NONE) {
+		pbg_print(&e2, text2, sizeof(text2));
+		pass = pass && strcmp(text1, text2) == 0;
+	}
+	pbg_error_free(&perr);
+	pbg_free(&e2);
+	pbg_parser_free(&p);
+	pbg_free(&e1);
+	/* Did we pass?? */
+	return pass ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_parser_chunks(pbg_error* err, char** chunks)
+{
+	pbg_parser p;
+	pbg_expr e1, e2;
+	pbg_error perr;
+	char str[128], text1[128], text2[128];
+	int i, pass;
+	/* Parse the chunks joined in one go. */
+	str[0] = '\0';
+	for(i = 0; chunks[i] != NULL; i++)
+		strcat(str, chunks[i]);
+	pbg_parse(&e1, err, str);
+	/* Feed the chunks as given. */
+	pass = 1;
+	pbg_parser_init(&p);
+	for(i = 0; chunks[i] != NULL; i++) {
+		pbg_parser_feed(&p, &perr, chunks[i], strlen(chunks[i]));
+		if(perr._type != PBG_ERR_NONE) pass = 0;
+	}
+	pbg_parser_finish(&p, &e2, &perr);
+	/* Both must report the same error, or print the same text. */
+	if(perr._type != err->_type)
+		pass = 0;
+	else if(perr._type == PBG_ERR_NONE) {
+		pbg_print(&e1, text1, sizeof(text1));
+		pbg_print(&e2, text2, sizeof(text2));
+		pass = pass && strcmp(text1, text2) == 0;
+	}
+	pbg_error_free(&perr);
+	pbg_free(&e2);
+	pbg_parser_free(&p);
+	pbg_free(&e1);
+	/* Did we pass?? */
+	return (pass && err->_type == PBG_ERR_NONE) ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_builder(pbg_error* err, pbg_builder* b, char* str)
+{
+	pbg_expr e1, e2;
+	pbg_error berr;
+	char text1[128], text2[128];
+	int pass;
+	/* Parse the string expression. */
+	pbg_parse(&e1, err, str);
+	/* Build the expression from the calls made. */
+	pbg_builder_finish(b, &e2, &berr);
+	/* Both must report the same error, or print the same text. */
+	pass = berr._type == err->_type;
+	if(pass && berr._type == PBG_ERR_NONE) {
+		pbg_print(&e1, text1, sizeof(text1));
+		pbg_print(&e2, text2, sizeof(text2));
+		pass = strcmp(text1, text2) == 0;
+	}
+	pbg_error_free(&berr);
+	pbg_free(&e2);
+	pbg_free(&e1);
+	/* Did we pass?? */
+	return pass ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_compile(pbg_error* err, char* str, int expect)
+{
+	pbg_expr e;
+	int output, compiled;
+	/* Parse the string expression. */
+	pbg_parse(&e, err, str);
+	if(err->_type != PBG_ERR_NONE)
+		return PBG_TEST_FAIL;
+	/* Evaluate it as is. */
+	output = pbg_evaluate(&e, err, dict);
+	if(err->_type != PBG_ERR_NONE) output = PBG_ERROR;
+	pbg_error_free(err);
+	/* Compile it, and evaluate it again. */
+	pbg_compile(&e, err);
+	if(err->_type != PBG_ERR_NONE) {
+		pbg_free(&e);
+		return PBG_TEST_FAIL;
+	}
+	compiled = pbg_evaluate(&e, err, dict);
+	if(err->_type != PBG_ERR_NONE) compiled = PBG_ERROR;
+	pbg_error_free(err);
+	err->_type = PBG_ERR_NONE;
+	/* Clean up. */
+	pbg_free(&e);
+	/* Did we pass?? */
+	return (output == expect && compiled == expect) ? 
+			PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_manage(pbg_error* err, char* str, int warmup, int period, 
+		int expect, int expect_none)
+{
+	pbg_expr e;
+	int i, output, pass;
+	/* Parse the string expression. */
+	pbg_parse(&e, err, str);
+	if(err->_type != PBG_ERR_NONE)
+		return PBG_TEST_FAIL;
+	pbg_manage(&e, err, warmup, period);
+	if(err->_type != PBG_ERR_NONE) {
+		pbg_free(&e);
+		return PBG_TEST_FAIL;
+	}
+	/* Switch dictionaries every ten evaluations, so profiles go stale. */
+	pass = 1;
+	for(i = 0; i < 40; i++) {
+		output = pbg_evaluate(&e, err, (i/10) % 2 ? dict_none : dict);
+		if(err->_type != PBG_ERR_NONE) output = PBG_ERROR;
+		pbg_error_free(err);
+		err->_type = PBG_ERR_NONE;
+		if(output != ((i/10) % 2 ? expect_none : expect))
+			pass = 0;
+	}
+	/* Clean up. */
+	pbg_free(&e);
+	/* Did we pass?? */
+	return pass ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_normalize(pbg_error* err, char* str, pbg_nf_form form, int maxfields, 
+		int expect)
+{
+	pbg_expr e;
+	pbg_nf nf;
+	int output, normal, numclauses;
+	/* Parse the string expression. */
+	pbg_parse(&e, err, str);
+	if(err->_type != PBG_ERR_NONE)
+		return PBG_TEST_FAIL;
+	/* Rewrite it. */
+	pbg_normalize(&nf, err, &e, form, maxfields);
+	if(err->_type != PBG_ERR_NONE) {
+		pbg_free(&e);
+		return (expect == PBG_ERROR && err->_type == PBG_ERR_LIMIT) ? 
+				PBG_TEST_PASS : PBG_TEST_FAIL;
+	}
+	/* Both expressions must agree. */
+	output = pbg_evaluate(&e, err, dict);
+	if(err->_type != PBG_ERR_NONE) output = PBG_ERROR;
+	pbg_error_free(err);
+	normal = pbg_evaluate(&nf._expr, err, dict);
+	if(err->_type != PBG_ERR_NONE) normal = PBG_ERROR;
+	pbg_error_free(err);
+	err->_type = PBG_ERR_NONE;
+	numclauses = nf._numclauses;
+	/* Clean up. */
+	pbg_free(&e);
+	pbg_nf_free(&nf);
+	/* Did we pass?? */
+	return (output == normal && numclauses == expect) ? 
+			PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_print(pbg_error* err, char* str, char* expect)
+{
+	pbg_expr e1, e2;
+	char text1[128], text2[128];
+	int output1, output2;
+	/* Parse and print the string expression. */
+	pbg_parse(&e1, err, str);
+	if(err->_type != PBG_ERR_NONE)
+		return PBG_TEST_FAIL;
+	if(pbg_print(&e1, text1, sizeof(text1)) != (int) strlen(expect)) {
+		pbg_free(&e1);
+		return PBG_TEST_FAIL;
+	}
+	/* Parse and print the text again. */
+	pbg_parse(&e2, err, text1);
+	if(err->_type != PBG_ERR_NONE) {
+		pbg_free(&e1);
+		return PBG_TEST_FAIL;
+	}
+	pbg_print(&e2, text2, sizeof(text2));
+	/* Both expressions must agree. */
+	output1 = pbg_evaluate(&e1, err, dict);
+	if(err->_type != PBG_ERR_NONE) output1 = PBG_ERROR;
+	pbg_error_free(err);
+	output2 = pbg_evaluate(&e2, err, dict);
+	if(err->_type != PBG_ERR_NONE) output2 = PBG_ERROR;
+	pbg_error_free(err);
+	err->_type = PBG_ERR_NONE;
+	/* Clean up. */
+	pbg_free(&e1);
+	pbg_free(&e2);
+	/* Did we pass?? */
+	return (strcmp(text1, expect) == 0 && strcmp(text2, expect) == 0 && 
+			output1 == output2) ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_combine(pbg_error* err, pbg_field_type op, char* str1, char* str2, 
+		char* expect, int result)
+{
+	pbg_expr e1, e2, e;
+	pbg_expr* exprs[2];
+	char text[128];
+	int output, pass;
+	/* Parse both string expressions, and compile the second. */
+	pbg_parse(&e1, err, str1);
+	if(err->_type != PBG_ERR_NONE)
+		return PBG_TEST_FAIL;
+	pbg_parse(&e2, err, str2);
+	if(err->_type == PBG_ERR_NONE)
+		pbg_compile(&e2, err);
+	if(err->_type != PBG_ERR_NONE) {
+		pbg_free(&e1);
+		pbg_free(&e2);
+		return PBG_TEST_FAIL;
+	}
+	/* Combine them. */
+	exprs[0] = &e1;
+	exprs[1] = &e2;
+	pbg_combine(&e, err, op, exprs, 2);
+	if(err->_type != PBG_ERR_NONE)
+		pass = (expect == NULL);
+	else {
+		pbg_print(&e, text, sizeof(text));
+		output = pbg_evaluate(&e, err, dict);
+		if(err->_type != PBG_ERR_NONE) output = PBG_ERROR;
+		pbg_error_free(err);
+		err->_type = PBG_ERR_NONE;
+		pass = expect != NULL && strcmp(text, expect) == 0 && output == result &&
+				e._program != NULL;
+	}
+	/* Clean up. */
+	pbg_free(&e1);
+	pbg_free(&e2);
+	pbg_free(&e);
+	/* Did we pass?? */
+	return pass ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_analyze(pbg_error* err, char* str, pbg_analysis expect)
+{
+	pbg_expr e;
+	pbg_analysis output;
+	int result, result_none, pass;
+	/* Parse the string expression. */
+	pbg_parse(&e, err, str);
+	if(err->_type != PBG_ERR_NONE)
+		return PBG_TEST_FAIL;
+	/* Analyze it. */
+	output = pbg_analyze(&e, err);
+	pass = (output == expect && err->_type == PBG_ERR_NONE);
+	/* Whatever was proven must hold with both dictionaries. */
+	result = pbg_evaluate(&e, err, dict);
+	pbg_error_free(err);
+	result_none = pbg_evaluate(&e, err, dict_none);
+	pbg_error_free(err);
+	err->_type = PBG_ERR_NONE;
+	if(output == PBG_AN_NEVER && (result == PBG_TRUE || result_none == PBG_TRUE))
+		pass = 0;
+	if(output == PBG_AN_ALWAYS && (result != PBG_TRUE || result_none != PBG_TRUE))
+		pass = 0;
+	/* Clean up. */
+	pbg_free(&e);
+	/* Did we pass?? */
+	return pass ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_implies(pbg_error* err, char* str1, char* str2, int expect)
+{
+	pbg_expr e1, e2;
+	int output, pass, i;
+	pbg_field (*dicts[2])(char*, int);
+	/* Parse both string expressions. */
+	pbg_parse(&e1, err, str1);
+	if(err->_type != PBG_ERR_NONE)
+		return PBG_TEST_FAIL;
+	pbg_parse(&e2, err, str2);
+	if(err->_type != PBG_ERR_NONE) {
+		pbg_free(&e1);
+		return PBG_TEST_FAIL;
+	}
+	/* Check the implication. */
+	output = pbg_implies(&e1, &e2, err);
+	pass = (output == expect && err->_type == PBG_ERR_NONE);
+	/* Whatever was proven must hold with both dictionaries. */
+	dicts[0] = dict;
+	dicts[1] = dict_none;
+	for(i = 0; i < 2 && output == 1; i++) {
+		if(pbg_evaluate(&e1, err, dicts[i]) == PBG_TRUE && 
+				pbg_evaluate(&e2, err, dicts[i]) != PBG_TRUE)
+			pass = 0;
+		pbg_error_free(err);
+		err->_type = PBG_ERR_NONE;
+	}
+	/* Clean up. */
+	pbg_free(&e1);
+	pbg_free(&e2);
+	/* Did we pass?? */
+	return pass ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_ruleset(pbg_error* err, char** rules, int n, int maxcheck, int calls, 
+		int expect)
+{
+	pbg_expr e[8];
+	pbg_expr* ptrs[8];
+	pbg_ruleset rs;
+	unsigned long* present;
+	unsigned char results[1];
+	int i, count, pass;
+	/* Parse every rule. */
+	for(i = 0; i < n; i++) {
+		pbg_parse(e+i, err, rules[i]);
+		if(err->_type != PBG_ERR_NONE) {
+			while(i-- > 0) pbg_free(e+i);
+			return PBG_TEST_FAIL;
+		}
+		ptrs[i] = e+i;
+	}
+	/* Mark the fields of the test dictionary present. */
+	pbg_ruleset_init(&rs, err, ptrs, n, maxcheck);
+	pass = err->_type == PBG_ERR_NONE;
+	present = (unsigned long*) calloc(pbg_ruleset_words(&rs) + 1, sizeof(unsigned long));
+	if(pass && present != NULL) {
+		pbg_ruleset_present(&rs, present, "a", 1);
+		pbg_ruleset_present(&rs, present, "b", 1);
+		pbg_ruleset_present(&rs, present, "c", 1);
+		pbg_ruleset_present(&rs, present, "s", 1);
+		pbg_ruleset_present(&rs, present, "t", 1);
+		pbg_ruleset_present(&rs, present, "u", 1);
+		pbg_ruleset_present(&rs, present, "z", 1);
+		dict_calls = 0;
+		count = pbg_ruleset_evaluate(&rs, err, present, dict_count, results);
+		pass = count == expect && dict_calls == calls;
+		/* Skipping must not change which rules are selected. */
+		for(i = 0; i < n && pass; i++)
+			pass = ((results[i/8] >> (i%8)) & 1) == 
+					(pbg_evaluate(e+i, err, dict) == PBG_TRUE);
+		pbg_error_free(err);
+		err->_type = PBG_ERR_NONE;
+	}
+	/* Clean up. */
+	free(present);
+	pbg_ruleset_free(&rs);
+	for(i = 0; i < n; i++)
+		pbg_free(e+i);
+	/* Did we pass?? */
+	return pass ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_ruleset_many(pbg_error* err, int n, int maxcheck, int calls, int expect)
+{
+	pbg_expr* e;
+	pbg_expr** ptrs;
+	pbg_ruleset rs;
+	unsigned long present[1];
+	unsigned char* results;
+	char str[64];
+	int i, count, pass;
+	e = (pbg_expr*) malloc(n * sizeof(pbg_expr));
+	ptrs = (pbg_expr**) malloc(n * sizeof(pbg_expr*));
+	results = (unsigned char*) malloc((n+7)/8);
+	pass = e != NULL && ptrs != NULL && results != NULL;
+	/* Parse every rule. Rules 100 apart are the same. */
+	for(i = 0; i < n && pass; i++) {
+		sprintf(str, "(& (= [b] 5) (> [a] %d) (< [c] %d))", i%100, i%100 + 7);
+		pbg_parse(e+i, err, str);
+		if(err->_type != PBG_ERR_NONE)
+			pass = 0;
+		ptrs[i] = e+i;
+	}
+	if(pass) {
+		pbg_ruleset_init(&rs, err, ptrs, n, maxcheck);
+		pass = err->_type == PBG_ERR_NONE && pbg_ruleset_words(&rs) == 1;
+		if(pass) {
+			present[0] = 0;
+			pbg_ruleset_present(&rs, present, "a", 1);
+			pbg_ruleset_present(&rs, present, "b", 1);
+			pbg_ruleset_present(&rs, present, "c", 1);
+			dict_calls = 0;
+			count = pbg_ruleset_evaluate(&rs, err, present, dict_count, results);
+			pass = count == expect && dict_calls == calls;
+			/* Skipping must not change which rules are selected. */
+			for(i = 0; i < n && pass; i++)
+				pass = ((results[i/8] >> (i%8)) & 1) == 
+						(pbg_evaluate(e+i, err, dict) == PBG_TRUE);
+			pbg_error_free(err);
+			err->_type = PBG_ERR_NONE;
+		}
+		pbg_ruleset_free(&rs);
+	}
+	/* Clean up. */
+	while(i-- > 0)
+		pbg_free(e+i);
+	free(e);
+	free(ptrs);
+	free(results);
+	/* Did we pass?? */
+	return pass ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_batch(pbg_error* err, char* str, int expect)
+{
+	pbg_expr e;
+	unsigned char selection[(BATCH_ROWS+7)/8];
+	unsigned char errors[(BATCH_ROWS+7)/8];
+	int i, count, output, pass;
+	/* Parse the string expression. */
+	pbg_parse(&e, err, str);
+	if(err->_type != PBG_ERR_NONE)
+		return PBG_TEST_FAIL;
+	/* Evaluate the whole batch, with and without errors. */
+	count = pbg_evaluate_batch_errors(&e, err, &batch, selection, errors);
+	if(err->_type != PBG_ERR_NONE) {
+		pbg_free(&e);
+		return PBG_TEST_FAIL;
+	}
+	pass = (count == expect);
+	if(pbg_evaluate_batch(&e, err, &batch, selection) != count)
+		pass = 0;
+	/* Every row must be selected exactly when it evaluates to TRUE, and be an
+	 * error exactly when it evaluates to PBG_ERROR. */
+	for(batch_rownum = 0; batch_rownum < BATCH_ROWS; batch_rownum++) {
+		output = pbg_evaluate(&e, err, dict_row);
+		pbg_error_free(err);
+		err->_type = PBG_ERR_NONE;
+		i = batch_rownum;
+		if((output == PBG_TRUE) != ((selection[i/8] >> (i%8)) & 1))
+			pass = 0;
+		if((output == PBG_ERROR) != ((errors[i/8] >> (i%8)) & 1))
+			pass = 0;
+	}
+	/* Clean up. */
+	pbg_free(&e);
+	/* Did we pass?? */
+	return pass ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+int test_arrow(pbg_error* err, char* str)
+{
+	pbg_expr e;
+	unsigned char selection[(BATCH_ROWS+7)/8];
+	unsigned char* bits;
+	struct ArrowSchema schema;
+	struct ArrowArray array;
+	int i, j, count, pass;
+	/* Parse the string expression. */
+	pbg_parse(&e, err, str);
+	if(err->_type != PBG_ERR_NONE)
+		return PBG_TEST_FAIL;
+	/* Evaluate the record batch, and the test batch it exports. */
+	count = pbg_arrow_evaluate(&e, err, arrow_schemas+5, arrow_arrays+5, &schema, &array);
+	if(err->_type != PBG_ERR_NONE) {
+		pbg_free(&e);
+		return PBG_TEST_FAIL;
+	}
+	pbg_evaluate_batch(&e, err, &batch, selection);
+	/* The selection must be the test batch's, from ARROW_OFFSET on. */
+	pass = (strcmp(schema.format, "b") == 0 && array.length == BATCH_ROWS-ARROW_OFFSET &&
+			array.n_buffers == 2 && array.buffers[0] == NULL);
+	bits = (unsigned char*) array.buffers[1];
+	for(i = 0; i < array.length; i++) {
+		j = i + ARROW_OFFSET;
+		if(((bits[i/8] >> (i%8)) & 1) != ((selection[j/8] >> (j%8)) & 1))
+			pass = 0;
+		count -= (bits[i/8] >> (i%8)) & 1;
+	}
+	/* Clean up. */
+	array.release(&array);
+	schema.release(&schema);
+	pbg_free(&e);
+	/* Did we pass?? */
+	return (pass && count == 0 && array.release == NULL) ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
 
 void pbg_err_print(pbg_error* err)
 {
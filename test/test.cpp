@@ -0,0 +1,231 @@
+#include "../pbg.hpp"
+#include "../pbg_static.hpp"
+#include "test.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Test suites in this file. */
+int suite_static(void);
+int suite_wrapper(void);
+
+/* Run and summarize test suites. */
+int main(void)
+{
+	summ_test("pbg_static", suite_static());
+	summ_test("pbg.hpp", suite_wrapper());
+	return 0;
+}
+
+
+/***************
+ *             *
+ * TEST SUITES *
+ *             *
+ ***************/
+
+/* Mirrors the dictionary in test.c: [a]=5.0, [b]=5.0, [1]=5.0, [c]=6.0. */
+struct rec {
+	double a, b, c;
+	int one;
+	std::optional<double> d;
+	std::string_view s;
+	pbg::date day;
+	bool flag;
+};
+
+template<> struct pbg::record<rec> {
+	static constexpr auto fields = std::make_tuple(
+			pbg::field("a", &rec::a),
+			pbg::field("b", &rec::b),
+			pbg::field("c", &rec::c),
+			pbg::field("1", &rec::one),
+			pbg::field("d", &rec::d),
+			pbg::field("s", &rec::s),
+			pbg::field("day", &rec::day),
+			pbg::field("flag", &rec::flag));
+};
+
+static const rec r0 = {5.0, 5.0, 6.0, 5, std::nullopt, "hi", {2018, 10, 12}, true};
+
+/* Same fields as r0, as a C dictionary. */
+pbg_field dict(char* key, int n);
+pbg_field dict(char* key, int n)
+{
+	std::string_view k(key, n);
+	if(k == "a" || k == "b" || k == "1") return pbg_make_number(5.0);
+	if(k == "c") return pbg_make_number(6.0);
+	if(k == "s") return pbg_make_string((char*) "hi");
+	if(k == "day") return pbg_make_date(2018, 10, 12);
+	if(k == "flag") return pbg_make_bool(1);
+	return pbg_make_null();
+}
+
+/* Compares a static evaluation with pbg_parse + pbg_evaluate of the same text. */
+int test_static(pbg_error* err, int result, const char* str, int expect);
+int test_static(pbg_error* err, int result, const char* str, int expect)
+{
+	pbg_expr e;
+	int output;
+	pbg_parse(&e, err, (char*) str);
+	if(pbg_iserror(err))
+		return PBG_TEST_FAIL;
+	output = pbg_evaluate(&e, err, dict);
+	pbg_free(&e);
+	if(pbg_iserror(err))
+		output = PBG_ERROR;
+	pbg_error_free(err);
+	err->_type = PBG_ERR_NONE;
+	return (output == expect && result == expect) ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+#define check_static(str, expect) \
+	check(test_static(&err, PBG_STATIC(str).evaluate(r0), str, expect))
+
+/* Tests for pbg_static.hpp. */
+int suite_static()
+{
+	init_test();
+
+	check_static("TRUE", PBG_TRUE);
+	check_static("  FALSE ", PBG_FALSE);
+	check_static("(! FALSE)", PBG_TRUE);
+	check_static("(! [1])", PBG_ERROR);
+	check_static("(! [0])", PBG_ERROR);
+	check_static("(& TRUE TRUE TRUE FALSE TRUE)", PBG_FALSE);
+	check_static("(& [1] [1])", PBG_ERROR);
+	check_static("(| FALSE TRUE FALSE)", PBG_TRUE);
+	check_static("(| TRUE [0])", PBG_TRUE);
+	check_static("(| [0] TRUE)", PBG_ERROR);
+	check_static("(? [a] [c])", PBG_TRUE);
+	check_static("(? [a] [d])", PBG_FALSE);
+	check_static("(= [a] [b])", PBG_TRUE);
+	check_static("(= [a] [c])", PBG_FALSE);
+	check_static("(= [a] [1])", PBG_TRUE);
+	check_static("(= [0] [1])", PBG_ERROR);
+	check_static("(= 10 10 10 9 10)", PBG_FALSE);
+	check_static("(= 'a, b\\'c' 'a, b\\'c')", PBG_TRUE);
+	check_static("(= [s] 'hi')", PBG_TRUE);
+	check_static("(= [s] 'h')", PBG_FALSE);
+	check_static("(= [day] 2018-10-12)", PBG_TRUE);
+	check_static("(= [flag] TRUE)", PBG_TRUE);
+	check_static("(= [flag] 5)", PBG_ERROR);
+	check_static("(= 5 [flag])", PBG_FALSE);
+	check_static("(!= [a] [c])", PBG_TRUE);
+	check_static("(!= [0] [c])", PBG_ERROR);
+	check_static("(< [a] [c])", PBG_TRUE);
+	check_static("(< [a] 5)", PBG_FALSE);
+	check_static("(<= [a] 5)", PBG_TRUE);
+	check_static("(> 5.5e1 [c])", PBG_TRUE);
+	check_static("(>= 0.314 [c])", PBG_FALSE);
+	check_static("(< [d] 5)", PBG_ERROR);
+	check_static("(< [s] 5)", PBG_ERROR);
+	check_static("(< 'aaa' 'aab')", PBG_TRUE);
+	check_static("(< [s] 'hz')", PBG_TRUE);
+	check_static("(< 2018-10-11 [day])", PBG_TRUE);
+	check_static("(>= [day] 2019-01-01)", PBG_FALSE);
+	check_static("(< (?[0])(?[1]))", PBG_TRUE);
+	check_static("(@ NUMBER [a] 10)", PBG_TRUE);
+	check_static("(@ NUMBER [a] [s])", PBG_FALSE);
+	check_static("(@ STRING [s])", PBG_TRUE);
+	check_static("(@ DATE [day])", PBG_TRUE);
+	check_static("(@ BOOL [flag] (& 10 10))", PBG_TRUE);
+	check_static("(@ 10 10)", PBG_ERROR);
+	check_static("(&(=[a][b])(?[d]))", PBG_FALSE);
+	check_static("(|(=[a][b])(?[d]))", PBG_TRUE);
+	check_static("(&\n\t(> [c] [a])\n\t(! (= [s] 'ho'))\n)", PBG_TRUE);
+
+	end_test();
+}
+
+/* Borrowing dictionary over r0 for the C++ wrapper. */
+static pbg::value lookup(std::string_view key)
+{
+	if(key == "a" || key == "b") return pbg::value::number(r0.a);
+	if(key == "c") return pbg::value::number(r0.c);
+	if(key == "s") return pbg::value::string(r0.s);
+	if(key == "day") return pbg::value::date(2018, 10, 12);
+	if(key == "flag") return pbg::value::boolean(r0.flag);
+	return pbg::value::null();
+}
+
+/* Evaluates str with the C++ wrapper. */
+int test_wrapper(std::string_view str, int expect);
+int test_wrapper(std::string_view str, int expect)
+{
+	pbg::error err;
+	pbg::expr e(str, err);
+	if(err)
+		return (expect == PBG_ERROR) ? PBG_TEST_PASS : PBG_TEST_FAIL;
+	return e.evaluate(lookup, err) == expect ? PBG_TEST_PASS : PBG_TEST_FAIL;
+}
+
+/* Tests for pbg.hpp. */
+int suite_wrapper()
+{
+	init_test();
+	
+	check(test_wrapper("(&(=[a][b])(?[d]))", PBG_FALSE));
+	check(test_wrapper("(& (= [s] 'hi') (= [day] 2018-10-12) [flag])", PBG_TRUE));
+	check(test_wrapper("(< [s] 5)", PBG_ERROR));
+	check(test_wrapper("(< [a] 5", PBG_ERROR));
+	/* Expressions and keys arrive as views, unterminated and uncopied. */
+	check(test_wrapper(std::string_view("(= 'x' 'y') trailing", 11), PBG_FALSE));
+	check(test_wrapper(std::string_view("(? [a])(", 7), PBG_TRUE));
+	
+	/* Moves transfer ownership; the moved-from objects are empty. */
+	{
+		pbg::error perr;
+		pbg::expr e1("(> [c] [a])", perr);
+		pbg::expr e2(std::move(e1));
+		std::vector<pbg::expr> v;
+		v.push_back(std::move(e2));
+		v.emplace_back("(! [flag])", perr);
+		check(e1.get()->_numconst == 0 && e2.get()->_numconst == 0 ?
+				PBG_TEST_PASS : PBG_TEST_FAIL);
+		check(v[0].evaluate(lookup, perr) == PBG_TRUE ? 
+				PBG_TEST_PASS : PBG_TEST_FAIL);
+		check(v[1].evaluate(lookup, perr) == PBG_FALSE ? 
+				PBG_TEST_PASS : PBG_TEST_FAIL);
+		e1 = std::move(v[0]);
+		check(e1.evaluate(lookup, perr) == PBG_TRUE ? 
+				PBG_TEST_PASS : PBG_TEST_FAIL);
+		/* Empty expressions report their state instead of evaluating. */
+		check(v[0].evaluate(lookup, perr) == PBG_ERROR && 
+				perr.type() == PBG_ERR_STATE ? PBG_TEST_PASS : PBG_TEST_FAIL);
+		pbg::expr e3;
+		check(e3.evaluate(lookup, perr) == PBG_ERROR && 
+				perr.type() == PBG_ERR_STATE ? PBG_TEST_PASS : PBG_TEST_FAIL);
+		pbg::expr e4("(< [a]", perr);
+		check(e4.evaluate(lookup, perr) == PBG_ERROR && 
+				perr.type() == PBG_ERR_STATE ? PBG_TEST_PASS : PBG_TEST_FAIL);
+	}
+	{
+		pbg::error e1, e2;
+		pbg::expr e("(<= 1 2 3)", e1);
+		e2 = std::move(e1);
+		check(!e1 && e2.type() == PBG_ERR_OP_ARITY ? 
+				PBG_TEST_PASS : PBG_TEST_FAIL);
+	}
+	
+	end_test();
+}
+
+
+/**************************
+ *                        *
+ * UNIT TESTING FUNCTIONS *
+ *                        *
+ **************************/
+
+void pbg_err_print(pbg_error* err)
+{
+	if(err->_type != PBG_ERR_NONE) {
+		printf("---");
+		pbg_error_print(err);
+	}
+}
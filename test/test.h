@@ -39,5 +39,248 @@ int test_gettype(char* str, pbg_field_type expect);
 int test_evaluate(pbg_error* err, char* str, 
 		pbg_field (*dict)(char*,int), int expect);
 
+/**
+ * Tests pbg_evaluate_dict with the path-aware test dictionary. The expression 
+ * is evaluated twice, then compiled and evaluated again, and then evaluated 
+ * with segments hashed by another function.
+ * @param err     Container to store parse & evaluation errors to, if any.
+ * @param str     String expression to parse.
+ * @param expect  Expected result of evaluation.
+ * @return PBG_TEST_PASS if every evaluation matches expect,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_path(pbg_error* err, char* str, int expect);
+
+/**
+ * Tests pbg_evaluate_dict with the hashing test dictionary. The expression is
+ * evaluated twice with pbg_hash, then twice with a hash function that counts
+ * its calls.
+ * @param err     Container to store parse & evaluation errors to, if any.
+ * @param str     String expression to parse.
+ * @param expect  Expected result of evaluation.
+ * @return PBG_TEST_PASS if every evaluation matches expect and the names are
+ *         hashed only once with the counting function,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_hashed(pbg_error* err, char* str, int expect);
+
+/**
+ * Tests pbg_eval_text with the test dictionary. The string is also parsed and
+ * evaluated with pbg_parse and pbg_evaluate.
+ * @param err     Container to store parse & evaluation errors to, if any.
+ * @param str     String expression to evaluate.
+ * @param expect  Expected result of evaluation.
+ * @return PBG_TEST_PASS if the result matches expect and both give the same
+ *         result and error,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_eval_text(pbg_error* err, char* str, int expect);
+
+/**
+ * Tests pbg_parse_lazy. The expression is parsed with depths 1 to 3, and each
+ * lazy expression is evaluated twice with the test dictionary.
+ * @param err     Container to store parse & evaluation errors to, if any.
+ * @param str     String expression to parse.
+ * @param expect  Expected result of evaluation.
+ * @return PBG_TEST_PASS if every evaluation matches expect,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_lazy(pbg_error* err, char* str, int expect);
+
+/**
+ * Tests pbg_validate. The string is also parsed with pbg_parse.
+ * @param err     Container to store validation errors to, if any.
+ * @param str     String expression to check.
+ * @param expect  1 if the string should be valid, 0 if not.
+ * @return PBG_TEST_PASS if the result matches expect and the error matches
+ *         that of pbg_parse,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_validate(pbg_error* err, char* str, int expect);
+
+/**
+ * Tests the parser. The string is fed in chunks of several sizes, then parsed 
+ * whole with pbg_parser_parse_n using the same parser, and also parsed with 
+ * pbg_parse.
+ * @param err  Container to store parse errors to, if any.
+ * @param str  String expression to parse.
+ * @return PBG_TEST_PASS if every parse gives the error or the expression 
+ *         pbg_parse gives,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_parser(pbg_error* err, char* str);
+
+/**
+ * Tests the parser on a string fed in the given chunks, which is also parsed
+ * joined with pbg_parse.
+ * @param err     Container to store parse errors to, if any.
+ * @param chunks  Chunks to feed, ending with NULL, at most 127 characters in
+ *                all.
+ * @return PBG_TEST_PASS if both parses succeed with the same expression,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_parser_chunks(pbg_error* err, char** chunks);
+
+/**
+ * Tests pbg_builder_finish. The string is also parsed with pbg_parse.
+ * @param err  Container to store parse errors to, if any.
+ * @param b    Builder the expression was built with.
+ * @param str  String expression the builder calls spell out.
+ * @return PBG_TEST_PASS if the builder gives the error or the expression 
+ *         pbg_parse gives,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_builder(pbg_error* err, pbg_builder* b, char* str);
+
+/**
+ * Tests pbg_compile.
+ * @param err     Container to store parse & evaluation errors to, if any.
+ * @param str     String expression to parse.
+ * @param expect  Expected result of evaluation.
+ * @return PBG_TEST_PASS if evaluation matches expect both before and after
+ *         compiling,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_compile(pbg_error* err, char* str, int expect);
+
+/**
+ * Tests pbg_manage. The expression is evaluated forty times, switching between
+ * dict and a dictionary with no keys every ten evaluations.
+ * @param err          Container to store parse & evaluation errors to, if any.
+ * @param str          String expression to parse.
+ * @param warmup       Evaluations to profile before recompiling.
+ * @param period       Evaluations between profiles.
+ * @param expect       Expected result of evaluation with dict.
+ * @param expect_none  Expected result of evaluation with no keys.
+ * @return PBG_TEST_PASS if every evaluation matches its expectation,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_manage(pbg_error* err, char* str, int warmup, int period, 
+		int expect, int expect_none);
+
+/**
+ * Tests pbg_normalize.
+ * @param err        Container to store parse & normalization errors to, if any.
+ * @param str        String expression to parse.
+ * @param form       Normal form to rewrite into.
+ * @param maxfields  Field budget of the rewrite.
+ * @param expect     Expected number of clauses, or PBG_ERROR if the budget
+ *                   should be exceeded.
+ * @return PBG_TEST_PASS if the clause count matches expect and the rewritten
+ *         expression evaluates like the original,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_normalize(pbg_error* err, char* str, pbg_nf_form form, int maxfields, 
+		int expect);
+
+/**
+ * Tests pbg_print. The printed text is parsed and printed again.
+ * @param err     Container to store parse & evaluation errors to, if any.
+ * @param str     String expression to parse.
+ * @param expect  Expected canonical text.
+ * @return PBG_TEST_PASS if both prints give expect and both expressions
+ *         evaluate alike,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_print(pbg_error* err, char* str, char* expect);
+
+/**
+ * Tests pbg_combine. Both strings are parsed, and the second is compiled.
+ * @param err     Container to store parse & evaluation errors to, if any.
+ * @param op      Operator to combine with.
+ * @param str1    First string expression to parse.
+ * @param str2    Second string expression to parse.
+ * @param expect  Expected canonical text of the result, or NULL if combining
+ *                should fail.
+ * @param result  Expected result of evaluation.
+ * @return PBG_TEST_PASS if the result prints as expect, is compiled, and 
+ *         evaluates to result,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_combine(pbg_error* err, pbg_field_type op, char* str1, char* str2, 
+		char* expect, int result);
+
+/**
+ * Tests pbg_analyze. The expression is also evaluated with the test dictionary
+ * and with a dictionary with no keys.
+ * @param err     Container to store parse & analysis errors to, if any.
+ * @param str     String expression to parse.
+ * @param expect  Expected result of the analysis.
+ * @return PBG_TEST_PASS if the result matches expect and holds for both 
+ *         evaluations,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_analyze(pbg_error* err, char* str, pbg_analysis expect);
+
+/**
+ * Tests pbg_implies. Both expressions are also evaluated with the test 
+ * dictionary and with a dictionary with no keys.
+ * @param err     Container to store parse & analysis errors to, if any.
+ * @param str1    String expression assumed TRUE.
+ * @param str2    String expression to prove TRUE.
+ * @param expect  1 if the implication should be proven, 0 if not.
+ * @return PBG_TEST_PASS if the result matches expect and holds for both 
+ *         evaluations,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_implies(pbg_error* err, char* str1, char* str2, int expect);
+
+/**
+ * Tests pbg_ruleset_evaluate over a record holding the fields of the test 
+ * dictionary. Each rule is also evaluated on its own with pbg_evaluate.
+ * @param err     Container to store parse & evaluation errors to, if any.
+ * @param rules     String rules to parse, at most 8.
+ * @param n         Number of rules.
+ * @param maxcheck  Most earlier rules to check each rule against.
+ * @param calls     Expected number of dictionary calls, which only the rules 
+ *                  not skipped make.
+ * @param expect    Expected number of rules selected.
+ * @return PBG_TEST_PASS if the counts match and every rule is selected exactly
+ *         when pbg_evaluate gives PBG_TRUE,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_ruleset(pbg_error* err, char** rules, int n, int maxcheck, int calls, 
+		int expect);
+
+/**
+ * Tests pbg_ruleset_init and pbg_ruleset_evaluate over many rules, each of the
+ * form (& (= [b] 5) (> [a] i) (< [c] i+7)) for i from 0 to 99, over and over.
+ * Each rule is also evaluated on its own with pbg_evaluate.
+ * @param err       Container to store parse & evaluation errors to, if any.
+ * @param n         Number of rules.
+ * @param maxcheck  Most earlier rules to check each rule against.
+ * @param calls     Expected number of dictionary calls, which only the rules 
+ *                  not skipped make.
+ * @param expect    Expected number of rules selected.
+ * @return PBG_TEST_PASS if the counts match and every rule is selected exactly
+ *         when pbg_evaluate gives PBG_TRUE,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_ruleset_many(pbg_error* err, int n, int maxcheck, int calls, int expect);
+
+/**
+ * Tests pbg_evaluate_batch and pbg_evaluate_batch_errors over the test batch. 
+ * Each row is also evaluated on its own with pbg_evaluate.
+ * @param err     Container to store parse & evaluation errors to, if any.
+ * @param str     String expression to parse.
+ * @param expect  Expected number of rows selected.
+ * @return PBG_TEST_PASS if the count matches expect and every row is selected
+ *         exactly when pbg_evaluate gives PBG_TRUE, and is an error exactly 
+ *         when it gives PBG_ERROR,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_batch(pbg_error* err, char* str, int expect);
+
+/**
+ * Tests pbg_arrow_evaluate over the test record batch, which exports the test
+ * batch from row ARROW_OFFSET on.
+ * @param err  Container to store parse & evaluation errors to, if any.
+ * @param str  String expression to parse.
+ * @return PBG_TEST_PASS if the exported selection matches pbg_evaluate_batch
+ *         over the test batch,
+ *         PBG_TEST_FAIL if not.
+ */
+int test_arrow(pbg_error* err, char* str);
+
 
 #endif /* __PBG_TEST_H__ */